@@ -0,0 +1,213 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * This program measures the throughput of events emitted by several threads
+ * depending on the number of threads: every producer thread emits events
+ * with `Event::emit_async()` while the connection thread drains the queue
+ * and sends the events in frames. For comparison, it also measures
+ * `Event::emit()` called by the producers with a mutex held.
+ *
+ * usage: emit-queue [events per thread]
+ */
+#include <cstdio>
+#include <cstdlib>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/event.hpp>
+#include "../src/core/message_builder.hpp"
+
+#include <cassert>
+
+using namespace deepstream;
+
+namespace {
+const std::size_t MAX_NUM_THREADS = 32;
+const std::size_t FRAME_SIZE = 64 * 1024;
+
+typedef std::chrono::steady_clock Clock;
+
+double events_per_second(std::size_t num_events, Clock::duration d)
+{
+    const double s = std::chrono::duration<double>(d).count();
+    return num_events / s;
+}
+
+/**
+ * Stands in for the connection: the messages are serialized into a frame
+ * that is discarded once it is full.
+ */
+struct Sink {
+    Sink()
+        : num_bytes(0)
+    {
+        frame.reserve(2 * FRAME_SIZE);
+    }
+
+    bool send(const Message& message)
+    {
+        segments.clear();
+        message.to_segments(segments);
+
+        for (const BufferView& segment : segments) {
+            frame.insert(frame.end(), segment.cbegin(), segment.cend());
+            num_bytes += segment.size();
+        }
+
+        if (frame.size() >= FRAME_SIZE)
+            frame.clear();
+
+        return true;
+    }
+
+    bool send_serialized(const BufferView& messages)
+    {
+        frame.insert(frame.end(), messages.cbegin(), messages.cend());
+        num_bytes += messages.size();
+
+        if (frame.size() >= FRAME_SIZE)
+            frame.clear();
+
+        return true;
+    }
+
+    Message::SegmentList segments;
+    Buffer frame;
+    std::size_t num_bytes;
+};
+
+Clock::duration run_queue(std::size_t num_threads, std::size_t num_events,
+        const Buffer& name, const Buffer& data, std::size_t* p_num_bytes)
+{
+    Sink sink;
+    auto send = [&sink](const Message& message) { return sink.send(message); };
+    auto send_serialized = [&sink](const BufferView& messages) {
+        return sink.send_serialized(messages);
+    };
+
+    SubscriptionSlots subscription_slots;
+    Event event(send, send, []() { return true; }, send_serialized, subscription_slots);
+
+    std::atomic<bool> done(false);
+    const Clock::time_point start = Clock::now();
+
+    std::vector<std::thread> producers;
+    for (std::size_t t = 0; t < num_threads; ++t) {
+        producers.emplace_back([&event, &name, &data, num_events]() {
+            for (std::size_t i = 0; i < num_events;) {
+                if (event.emit_async(name, data))
+                    ++i;
+                else
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    // the connection thread
+    std::thread consumer([&event, &done]() {
+        while (!done.load(std::memory_order_acquire))
+            event.drain_emits_();
+
+        while (!event.drain_emits_())
+            ;
+    });
+
+    for (std::thread& producer : producers)
+        producer.join();
+
+    done.store(true, std::memory_order_release);
+    consumer.join();
+
+    const Clock::duration d = Clock::now() - start;
+    *p_num_bytes = sink.num_bytes;
+
+    return d;
+}
+
+Clock::duration run_mutex(std::size_t num_threads, std::size_t num_events,
+        const Buffer& name, const Buffer& data, std::size_t* p_num_bytes)
+{
+    Sink sink;
+    auto send = [&sink](const Message& message) { return sink.send(message); };
+
+    SubscriptionSlots subscription_slots;
+    Event event(send, subscription_slots);
+
+    std::mutex mutex;
+    const Clock::time_point start = Clock::now();
+
+    std::vector<std::thread> producers;
+    for (std::size_t t = 0; t < num_threads; ++t) {
+        producers.emplace_back([&event, &mutex, &name, &data, num_events]() {
+            for (std::size_t i = 0; i < num_events; ++i) {
+                std::lock_guard<std::mutex> lock(mutex);
+                event.emit(name, data);
+            }
+        });
+    }
+
+    for (std::thread& producer : producers)
+        producer.join();
+
+    const Clock::duration d = Clock::now() - start;
+    *p_num_bytes = sink.num_bytes;
+
+    return d;
+}
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t num_events = 200000;
+
+    if (argc > 2) {
+        std::fprintf(stderr, "usage: %s [events per thread]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (argc == 2)
+        num_events = std::strtoul(argv[1], nullptr, 10);
+
+    const Buffer name("benchmark/event");
+    const Buffer data("Sdata");
+
+    MessageBuilder message(Topic::EVENT, Action::EVENT);
+    message.add_argument_reference(name);
+    message.add_argument_reference(data);
+    const std::size_t message_size = message.to_binary().size();
+
+    std::printf("%15s %15s %15s\n", "threads", "emits/s", "mutex emits/s");
+
+    for (std::size_t n = 1; n <= MAX_NUM_THREADS; n *= 2) {
+        std::size_t queue_bytes = 0;
+        const Clock::duration queue_time = run_queue(n, num_events, name, data, &queue_bytes);
+
+        std::size_t mutex_bytes = 0;
+        const Clock::duration mutex_time = run_mutex(n, num_events, name, data, &mutex_bytes);
+
+        std::printf("%15zu %15.0f %15.0f\n", n,
+            events_per_second(n * num_events, queue_time),
+            events_per_second(n * num_events, mutex_time));
+
+        if (queue_bytes != n * num_events * message_size || mutex_bytes != queue_bytes)
+            std::fprintf(stderr, "unexpected number of bytes sent\n");
+    }
+}
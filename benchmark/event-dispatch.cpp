@@ -0,0 +1,136 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * This program measures the time needed to dispatch a received event (E|EVT)
+ * to its subscriber depending on the number of event subscriptions. For
+ * comparison, it also measures the look-up in a `std::map<Buffer, ...>` that
+ * was used by the event module before the names were interned.
+ *
+ * usage: event-dispatch [max num subscriptions]
+ */
+#include <cstdio>
+#include <cstdlib>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/event.hpp>
+#include "../src/core/message_builder.hpp"
+
+#include <cassert>
+
+using namespace deepstream;
+
+namespace {
+const std::size_t NUM_MESSAGES = 1024;
+const std::size_t NUM_DISPATCHES = 1000000;
+
+typedef std::chrono::steady_clock Clock;
+
+double nanoseconds_per_dispatch(Clock::duration d)
+{
+    const double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    return ns / NUM_DISPATCHES;
+}
+
+std::vector<Buffer> make_names(std::size_t num_names)
+{
+    std::vector<Buffer> names;
+    names.reserve(num_names);
+
+    for (std::size_t i = 0; i < num_names; ++i)
+        names.emplace_back("benchmark/event/" + std::to_string(i));
+
+    return names;
+}
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t max_num_subscriptions = 100000;
+
+    if (argc > 2) {
+        std::fprintf(stderr, "usage: %s [max num subscriptions]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (argc == 2)
+        max_num_subscriptions = std::strtoul(argv[1], nullptr, 10);
+
+    std::printf("%15s %15s %15s\n", "subscriptions", "ns/dispatch", "ns/map-lookup");
+
+    for (std::size_t n = 1; n <= max_num_subscriptions; n *= 10) {
+        const std::vector<Buffer> names = make_names(n);
+        const Buffer data("data");
+
+        SubscriptionSlots subscription_slots;
+        Event event([](const Message&) { return true; }, subscription_slots);
+
+        std::size_t num_calls = 0;
+        for (const Buffer& name : names)
+            event.subscribe(name, [&num_calls](const BufferView&) { ++num_calls; });
+
+        // the received events are picked uniformly at random
+        std::mt19937 engine(n);
+        std::uniform_int_distribution<std::size_t> dist(0, n - 1);
+
+        std::vector<std::unique_ptr<MessageBuilder> > messages;
+        std::vector<const Buffer*> keys;
+        for (std::size_t i = 0; i < NUM_MESSAGES; ++i) {
+            const Buffer& name = names[dist(engine)];
+
+            messages.emplace_back(new MessageBuilder(Topic::EVENT, Action::EVENT));
+            messages.back()->add_argument_reference(name);
+            messages.back()->add_argument_reference(data);
+            keys.push_back(&name);
+        }
+
+        const Clock::time_point start = Clock::now();
+        for (std::size_t i = 0; i < NUM_DISPATCHES; ++i)
+            event.notify_(*messages[i % NUM_MESSAGES]);
+        const Clock::duration dispatch_time = Clock::now() - start;
+
+        assert(num_calls == NUM_DISPATCHES);
+
+        // the baseline: copy the name into a buffer and search a tree
+        std::map<Buffer, std::size_t> map;
+        for (std::size_t i = 0; i < n; ++i)
+            map[names[i]] = i;
+
+        Buffer lookup_name;
+        std::size_t checksum = 0;
+        const Clock::time_point map_start = Clock::now();
+        for (std::size_t i = 0; i < NUM_DISPATCHES; ++i) {
+            const Buffer& key = *keys[i % NUM_MESSAGES];
+            lookup_name.assign(key.cbegin(), key.cend());
+            checksum += map.find(lookup_name)->second;
+        }
+        const Clock::duration map_time = Clock::now() - map_start;
+
+        std::printf("%15zu %15.1f %15.1f\n", n,
+            nanoseconds_per_dispatch(dispatch_time),
+            nanoseconds_per_dispatch(map_time));
+
+        if (checksum == 0 && n > 1)
+            std::fprintf(stderr, "unexpected checksum\n");
+    }
+}
@@ -0,0 +1,422 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * This program compares the WebSocket transports on the loopback interface:
+ * a server thread stands in for deepstream and returns every received event
+ * message. The program measures
+ * - the round-trip time of single messages,
+ * - the throughput with up to WINDOW_SIZE messages in flight, and
+ * - the average number of messages handed to the frame handler per round
+ *   in the throughput test.
+ *
+ * The Poco transport is measured with and without TLS; the stand-in uses a
+ * self-signed certificate then.
+ *
+ * usage: ws-transport [num messages]
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/ws.hpp>
+#include <deepstream/lib/epoll-ws.hpp>
+#include <deepstream/lib/poco-ws.hpp>
+#include <deepstream/lib/uring-ws.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+using namespace deepstream;
+
+namespace {
+const std::size_t NUM_ROUND_TRIPS = 10000;
+const std::size_t WINDOW_SIZE = 1000;
+const std::size_t PAYLOAD_SIZE = 100;
+const char RECORD_SEPARATOR = '\x1e';
+
+typedef std::chrono::steady_clock Clock;
+
+/*
+ * Creates a TLS server context with a new self-signed certificate.
+ */
+SSL_CTX* make_tls_context()
+{
+    EVP_PKEY* key = nullptr;
+    EVP_PKEY_CTX* key_context = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+    if (!key_context || EVP_PKEY_keygen_init(key_context) <= 0
+        || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(key_context, NID_X9_62_prime256v1) <= 0
+        || EVP_PKEY_keygen(key_context, &key) <= 0) {
+        std::fprintf(stderr, "stand-in: unable to create a key\n");
+        std::exit(EXIT_FAILURE);
+    }
+    EVP_PKEY_CTX_free(key_context);
+
+    X509* certificate = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+    X509_gmtime_adj(X509_get_notBefore(certificate), 0);
+    X509_gmtime_adj(X509_get_notAfter(certificate), 24 * 60 * 60);
+    X509_set_pubkey(certificate, key);
+
+    X509_NAME* name = X509_get_subject_name(certificate);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+        reinterpret_cast<const unsigned char*>("127.0.0.1"), -1, -1, 0);
+    X509_set_issuer_name(certificate, name);
+
+    SSL_CTX* context = SSL_CTX_new(TLS_server_method());
+    if (!X509_sign(certificate, key, EVP_sha256()) || !context
+        || SSL_CTX_use_certificate(context, certificate) != 1
+        || SSL_CTX_use_PrivateKey(context, key) != 1) {
+        std::fprintf(stderr, "stand-in: unable to create a certificate\n");
+        std::exit(EXIT_FAILURE);
+    }
+
+    X509_free(certificate);
+    EVP_PKEY_free(key);
+
+    return context;
+}
+
+/*
+ * A WebSocket server for a single client returning every text frame; the
+ * server uses TLS if a context is given.
+ */
+class StandIn {
+public:
+    explicit StandIn(SSL_CTX* tls_context = nullptr)
+        : listen_fd_(socket(AF_INET, SOCK_STREAM, 0))
+        , port_(0)
+        , tls_context_(tls_context)
+        , ssl_(nullptr)
+    {
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        socklen_t length = sizeof(address);
+        if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), length) != 0
+            || listen(listen_fd_, 1) != 0
+            || getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            std::perror("stand-in");
+            std::exit(EXIT_FAILURE);
+        }
+
+        port_ = ntohs(address.sin_port);
+        thread_ = std::thread(&StandIn::run, this);
+    }
+
+    ~StandIn()
+    {
+        thread_.join();
+        close(listen_fd_);
+    }
+
+    std::string uri() const
+    {
+        return (tls_context_ ? "wss://127.0.0.1:" : "ws://127.0.0.1:") + std::to_string(port_) + "/deepstream";
+    }
+
+private:
+    void run()
+    {
+        const int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0)
+            return;
+
+        const int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        if (tls_context_) {
+            ssl_ = SSL_new(tls_context_);
+            SSL_set_fd(ssl_, fd);
+
+            if (SSL_accept(ssl_) != 1) {
+                std::fprintf(stderr, "stand-in: TLS handshake failed\n");
+                std::exit(EXIT_FAILURE);
+            }
+        }
+
+        std::string in;
+        std::string out;
+        std::vector<char> chunk(64 * 1024);
+
+        for (;;) {
+            const ssize_t n = receive(fd, chunk.data(), chunk.size());
+            if (n <= 0)
+                break;
+            in.append(chunk.data(), static_cast<std::size_t>(n));
+
+            if (!is_upgraded_) {
+                const std::size_t end = in.find("\r\n\r\n");
+                if (end == std::string::npos)
+                    continue;
+
+                const std::string field = "Sec-WebSocket-Key: ";
+                const std::size_t begin = in.find(field) + field.size();
+                const std::string key = in.substr(begin, in.find("\r\n", begin) - begin);
+
+                out = "HTTP/1.1 101 Switching Protocols\r\n"
+                      "Upgrade: websocket\r\n"
+                      "Connection: Upgrade\r\n"
+                      "Sec-WebSocket-Accept: "
+                    + EpollWSHandler::accept_key(key) + "\r\n\r\n";
+                in.erase(0, end + 4);
+                is_upgraded_ = true;
+            }
+
+            std::size_t offset = 0;
+            bool is_closed = false;
+            while (!is_closed && parse_frame(in, &offset, &out, &is_closed)) {
+            }
+            in.erase(0, offset);
+
+            if (!write_all(fd, out) || is_closed)
+                break;
+            out.clear();
+        }
+
+        if (ssl_) {
+            SSL_free(ssl_);
+            ssl_ = nullptr;
+        }
+
+        close(fd);
+    }
+
+    ssize_t receive(int fd, char* data, std::size_t size)
+    {
+        if (ssl_)
+            return SSL_read(ssl_, data, static_cast<int>(size));
+
+        return read(fd, data, size);
+    }
+
+    /*
+     * Appends the unmasked frame at `*p_offset` to `*p_out`.
+     * returns false if the frame is incomplete
+     */
+    static bool parse_frame(const std::string& in, std::size_t* p_offset, std::string* p_out, bool* p_is_closed)
+    {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(in.data() + *p_offset);
+        const std::size_t available = in.size() - *p_offset;
+
+        if (available < 2)
+            return false;
+
+        std::uint64_t size = p[1] & 0x7F;
+        std::size_t header_size = 2;
+        if (size == 126) {
+            if (available < 4)
+                return false;
+            size = (std::uint64_t(p[2]) << 8) | p[3];
+            header_size = 4;
+        } else if (size == 127) {
+            if (available < 10)
+                return false;
+            size = 0;
+            for (std::size_t i = 0; i < 8; ++i)
+                size = (size << 8) | p[2 + i];
+            header_size = 10;
+        }
+
+        if (available < header_size + 4 + size)
+            return false;
+
+        const unsigned char* key = p + header_size;
+        p_out->push_back(static_cast<char>(p[0]));
+        p_out->push_back(static_cast<char>(p[1] & 0x7F));
+        p_out->append(reinterpret_cast<const char*>(p + 2), header_size - 2);
+        for (std::size_t i = 0; i < size; ++i)
+            p_out->push_back(static_cast<char>(p[header_size + 4 + i] ^ key[i % 4]));
+
+        *p_offset += header_size + 4 + static_cast<std::size_t>(size);
+        *p_is_closed = (p[0] & 0x0F) == 0x8;
+
+        return true;
+    }
+
+    bool write_all(int fd, const std::string& data)
+    {
+        std::size_t offset = 0;
+        while (offset < data.size()) {
+            const ssize_t n = ssl_
+                ? SSL_write(ssl_, data.data() + offset, static_cast<int>(data.size() - offset))
+                : write(fd, data.data() + offset, data.size() - offset);
+            if (n <= 0)
+                return false;
+            offset += static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    const int listen_fd_;
+    int port_;
+    SSL_CTX* const tls_context_;
+    SSL* ssl_;
+    bool is_upgraded_ = false;
+    std::thread thread_;
+};
+
+struct Result {
+    double median_rtt_us;
+    double p99_rtt_us;
+    double messages_per_second;
+    double messages_per_round;
+};
+
+/*
+ * Processes messages until the condition holds.
+ */
+void wait_until(WSHandler& wsh, const std::function<bool()>& condition)
+{
+    while (!condition()) {
+        pollfd fd = { wsh.native_handle(), POLLIN, 0 };
+        poll(&fd, 1, 10);
+        wsh.process_messages();
+    }
+}
+
+Result measure(WSHandler& wsh, std::size_t num_messages, SSL_CTX* tls_context = nullptr)
+{
+    StandIn stand_in(tls_context);
+
+    bool is_open = false;
+    std::size_t num_received = 0;
+    std::size_t num_rounds = 0;
+
+    wsh.on_open([&is_open]() { is_open = true; });
+    wsh.on_close([]() {});
+    wsh.on_error([](const std::string&& what) {
+        std::fprintf(stderr, "transport error: %s\n", what.c_str());
+        std::exit(EXIT_FAILURE);
+    });
+    wsh.on_frame([&num_received, &num_rounds](char* data, std::size_t size) {
+        num_received += std::count(data, data + size, RECORD_SEPARATOR);
+        ++num_rounds;
+    });
+
+    wsh.URI(stand_in.uri());
+    wsh.open();
+    wait_until(wsh, [&is_open]() { return is_open; });
+
+    Buffer message("E|EVT|benchmark/transport|S");
+    message.insert(message.end(), PAYLOAD_SIZE, 'x');
+    message.push_back(RECORD_SEPARATOR);
+
+    std::vector<double> rtts;
+    rtts.reserve(NUM_ROUND_TRIPS);
+
+    for (std::size_t i = 0; i < NUM_ROUND_TRIPS; ++i) {
+        const std::size_t n = num_received;
+        const Clock::time_point start = Clock::now();
+
+        wsh.send(message);
+        wait_until(wsh, [&num_received, n]() { return num_received > n; });
+
+        const std::chrono::duration<double, std::micro> rtt = Clock::now() - start;
+        rtts.push_back(rtt.count());
+    }
+
+    std::sort(rtts.begin(), rtts.end());
+
+    const std::size_t first = num_received;
+    const std::size_t first_round = num_rounds;
+    std::size_t num_sent = 0;
+    const Clock::time_point start = Clock::now();
+
+    while (num_sent < num_messages) {
+        while (num_sent < num_messages && num_sent - (num_received - first) < WINDOW_SIZE) {
+            wsh.send(message);
+            ++num_sent;
+        }
+
+        wsh.process_messages();
+    }
+    wait_until(wsh, [&num_received, first, num_messages]() { return num_received - first == num_messages; });
+
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    wsh.close();
+
+    return Result{ rtts[rtts.size() / 2], rtts[rtts.size() * 99 / 100], num_messages / elapsed.count(),
+        static_cast<double>(num_messages) / (num_rounds - first_round) };
+}
+
+void print(const char* name, const Result& result)
+{
+    std::printf("%10s %15.1f %15.1f %15.0f %15.1f\n", name, result.median_rtt_us, result.p99_rtt_us,
+        result.messages_per_second, result.messages_per_round);
+}
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t num_messages = 1000000;
+
+    if (argc > 2) {
+        std::fprintf(stderr, "usage: %s [num messages]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (argc == 2)
+        num_messages = std::strtoul(argv[1], nullptr, 10);
+
+    std::printf("%10s %15s %15s %15s %15s\n", "transport", "median rtt/us", "p99 rtt/us", "messages/s",
+        "messages/round");
+
+    {
+        PocoWSHandler wsh;
+        print("poco", measure(wsh, num_messages));
+    }
+
+    {
+        SSL_CTX* tls_context = make_tls_context();
+        PocoWSHandler wsh;
+        print("poco (wss)", measure(wsh, num_messages, tls_context));
+        SSL_CTX_free(tls_context);
+    }
+
+    {
+        EpollWSHandler wsh;
+        print("epoll", measure(wsh, num_messages));
+    }
+
+    if (UringWSHandler::is_supported()) {
+        UringWSHandler wsh;
+        print("io_uring", measure(wsh, num_messages));
+    } else {
+        std::printf("%10s (not supported)\n", "io_uring");
+    }
+}
@@ -13,8 +13,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
-#include <unistd.h> // usleep
-
+#include <chrono>
 #include <exception>
 #include <iostream>
 
@@ -31,7 +30,8 @@ int main(int argc, char* argv[])
 
     std::string uri(argv[1]);
 
-    deepstream::Deepstream client(uri);
+    // the socket is read by a background thread
+    deepstream::Deepstream client(uri, deepstream::Deepstream::IOMode::THREADED);
 
     client.login([](const json &&user_data) {
         std::cout << "Client logged in with user data: "
@@ -76,7 +76,6 @@ int main(int argc, char* argv[])
     });
 
     while (true) {
-        client.process_messages();
-        usleep(10000);
+        client.process_messages(std::chrono::milliseconds(-1));
     }
 }
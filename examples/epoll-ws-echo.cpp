@@ -0,0 +1,86 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdlib>
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include <deepstream/core.hpp>
+#include <deepstream/lib/epoll-ws.hpp>
+
+#include <poll.h>
+#include <unistd.h>
+
+/*
+ * This program sends every line read from stdin to a WebSocket echo server
+ * using the epoll transport and prints the answers; "q" closes the
+ * connection.
+ */
+int main(int argc, char* argv[])
+{
+    std::string uri = "ws://localhost:8080/";
+
+    if (argc >= 2) {
+        uri = argv[1];
+    }
+
+    bool done = false;
+    try {
+        deepstream::EpollWSHandler wsh;
+        wsh.URI(uri);
+        wsh.on_open([](){
+                std::cout << "OPEN" << std::endl;
+                });
+        wsh.on_close([&done](){
+                std::cout << "CLOSE" << std::endl;
+                done = true;
+                });
+        wsh.on_error([&done](const std::string &&error){
+                std::cout << "ERROR: " << error << std::endl;
+                done = true;
+                });
+        wsh.on_message([](const deepstream::Buffer &&message){
+                std::string message_str(message.cbegin(), message.cend());
+                std::cout << "MESSAGE: " << message_str << std::endl;
+                });
+        wsh.open();
+
+        while (!done) {
+            pollfd fds[2] = {
+                { STDIN_FILENO, POLLIN, 0 },
+                { wsh.native_handle(), POLLIN, 0 }
+            };
+            poll(fds, 2, -1);
+
+            if (fds[0].revents & POLLIN) {
+                std::string input;
+                if (!std::getline(std::cin, input) || input == "q") {
+                    wsh.close();
+                    break;
+                }
+
+                deepstream::Buffer input_buff(input.cbegin(), input.cend());
+                wsh.send(input_buff);
+            }
+
+            wsh.process_messages();
+        }
+    } catch (std::exception& e) {
+        std::cerr << "EXCEPTION: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
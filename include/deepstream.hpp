@@ -20,15 +20,27 @@
 #include <deepstream/core/client.hpp>
 #include <deepstream/core/error_handler.hpp>
 #include <deepstream/core/event.hpp>
+#include <deepstream/core/executor.hpp>
+#include <deepstream/core/persistent_outbox.hpp>
 #include <deepstream/core/presence.hpp>
+#include <deepstream/core/thread_pool.hpp>
 #include <deepstream/core/version.hpp>
 #include <deepstream/lib/poco-ws.hpp>
+#include <deepstream/lib/threaded-ws.hpp>
 #include <deepstream/lib/basic-error-handler.hpp>
 #include <deepstream/lib/json.hpp>
 #include <deepstream/lib/type-serializer.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <string>
 #include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
 
 namespace deepstream {
 
@@ -42,7 +54,8 @@ namespace deepstream {
      *
      * Single-threaded, blocking WebSockets are implemented using the POCO
      * library. The user must regularly poll Deepstream::process_messages() to
-     * check for new messages, and run the necessary handlers.
+     * check for new messages, and run the necessary handlers. Optionally,
+     * the socket is served by a background thread (see IOMode).
      *
      * @see <a href="https://pocoproject.org/docs/Poco.Net.WebSocket.html">
      *          POCO WebSocket Documentation
@@ -63,6 +76,22 @@ namespace deepstream {
          */
         typedef std::function<void(const json &&client_data)> LoginCallback;
 
+        /**
+         * With `IOMode::POLLING`, the socket is read by process_messages()
+         * on the calling thread. With `IOMode::THREADED`, a background
+         * thread reads the socket as soon as data arrives and sends the
+         * outgoing messages; process_messages() dispatches the received
+         * messages and the application may block in wait_for_messages()
+         * instead of sleeping.
+         *
+         * All callbacks are called by the thread calling process_messages()
+         * in both modes.
+         */
+        enum class IOMode {
+            POLLING,
+            THREADED
+        };
+
         Deepstream() = delete;
 
         Deepstream(const Deepstream &) = delete;
@@ -79,25 +108,187 @@ namespace deepstream {
          *
          * @param[in] uri The URI of the deepstream server to connect to,
          *                  including the path. e.g. "0.0.0.0:6020/deepstream".
+         * @param[in] io_mode Whether the socket is read by a background
+         *                  thread.
          */
-        Deepstream(const std::string &uri)
+        Deepstream(const std::string &uri, IOMode io_mode = IOMode::POLLING)
             : wsh_()
+            , p_threaded_wsh_(io_mode == IOMode::THREADED ? new ThreadedWSHandler(wsh_) : nullptr)
             , error_handler_()
-            , client_(uri, wsh_, error_handler_)
+            , client_(uri, ws_handler(), error_handler_)
             , type_serializer_(error_handler_)
             , event(client_, error_handler_, type_serializer_)
             , presence(client_, error_handler_)
         {
+            if (p_threaded_wsh_) {
+                // events emitted by other threads end the wait of the
+                // application thread
+                client_.event.on_emit_async(std::bind(&ThreadedWSHandler::wake, p_threaded_wsh_.get()));
+            }
         }
 
         /**
          * This function reads all incoming messages from the websocket and
-         * executes the appropriate callbacks; it blocks until there are no
+         * executes the appropriate callbacks; it returns when there are no
          * remaining messages to be read.
          */
         void process_messages()
         {
-            wsh_.process_messages();
+            client_.process_messages();
+        }
+
+        /**
+         * Like process_messages() but the dispatching of received messages
+         * stops once the budget is spent, e.g., to keep the frame deadline
+         * of a game loop. The remaining messages are dispatched first by
+         * the next call.
+         *
+         * @return true if received messages wait to be processed
+         */
+        bool process_messages(const ProcessingBudget& budget)
+        {
+            return client_.process_messages(budget);
+        }
+
+        /**
+         * Block until messages were received or the timeout passed, then
+         * process the messages. This replaces calling process_messages() in
+         * a loop with a sleep.
+         *
+         * @param[in] timeout The maximum waiting time; a negative timeout
+         *                      waits indefinitely.
+         * @return true if messages may have been processed
+         */
+        bool process_messages(std::chrono::milliseconds timeout)
+        {
+            const bool is_ready = wait_for_messages(timeout);
+            process_messages();
+
+            return is_ready;
+        }
+
+        /**
+         * Return a file descriptor for the integration with an event loop
+         * (epoll, libuv, Asio, ...): when it becomes readable, call
+         * on_readable(). The application must only wait for readability; it
+         * must not read from the descriptor.
+         *
+         * In polling mode, this is the socket of the connection: it is -1
+         * while there is no connection and it changes when the connection
+         * is reopened, so it should be queried again after on_readable().
+         * In threaded mode, the descriptor is stable. Messages left over by
+         * a budgeted process_messages() call do not make it readable.
+         */
+        int native_handle() const
+        {
+            return p_threaded_wsh_ ? p_threaded_wsh_->native_handle() : wsh_.native_handle();
+        }
+
+        /**
+         * Process the messages without blocking; to be called by an event
+         * loop when native_handle() is readable.
+         */
+        void on_readable()
+        {
+            process_messages();
+        }
+
+        /**
+         * Block until messages were received or the timeout passed.
+         *
+         * In polling mode, this function waits for the socket to become
+         * readable. The wait ends early when a timer of the connection
+         * expires, e.g., the heartbeat check.
+         *
+         * @param[in] timeout The maximum waiting time; a negative timeout
+         *                      waits indefinitely.
+         * @return true if there may be messages to process
+         */
+        bool wait_for_messages(std::chrono::milliseconds timeout)
+        {
+            if (client_.has_pending_messages()) {
+                return true;
+            }
+
+            std::chrono::steady_clock::time_point deadline;
+            if (client_.next_timer_deadline(&deadline)) {
+                // round up so that the timer has expired on wake-up
+                const auto now = std::chrono::steady_clock::now();
+                const auto until_deadline = (deadline > now)
+                    ? std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now)
+                        + std::chrono::milliseconds(1)
+                    : std::chrono::milliseconds(0);
+
+                if (timeout.count() < 0 || until_deadline < timeout) {
+                    timeout = until_deadline;
+                }
+            }
+
+            if (p_threaded_wsh_) {
+                return p_threaded_wsh_->wait(timeout);
+            }
+
+            pollfd fd = { wsh_.native_handle(), POLLIN, 0 };
+            if (fd.fd < 0) {
+                std::this_thread::sleep_for(std::max(timeout, std::chrono::milliseconds(0)));
+                return false;
+            }
+
+            const int timeout_ms = (timeout.count() < 0) ? -1 : static_cast<int>(timeout.count());
+            return poll(&fd, 1, timeout_ms) > 0;
+        }
+
+        /**
+         * Collect outgoing messages and send them in a single WebSocket
+         * frame; the messages are sent when `max_size` bytes were
+         * collected, when a message is sent `max_delay` after the oldest
+         * collected message, at the end of process_messages(), or on
+         * flush().
+         *
+         * @param[in] max_size The batch size in bytes; zero disables
+         *                      batching (default).
+         * @param[in] max_delay The maximum time a message is held back
+         *                      while messages are sent.
+         */
+        void batching(std::size_t max_size, std::chrono::milliseconds max_delay)
+        {
+            client_.batching(max_size, max_delay);
+        }
+
+        /**
+         * Detect dead connections: if nothing was received for the given
+         * time, the connection is closed and reopened right away. The
+         * server pings every 30 seconds by default. The check runs in
+         * process_messages(); wait_for_messages() wakes up for it.
+         *
+         * @param[in] timeout Zero disables the detection (default).
+         */
+        void heartbeat_timeout(std::chrono::milliseconds timeout)
+        {
+            client_.heartbeat_timeout(timeout);
+        }
+
+        /**
+         * Send all collected outgoing messages.
+         */
+        void flush()
+        {
+            client_.flush();
+        }
+
+        /**
+         * Run the event and presence callbacks with the given executor,
+         * e.g., a ThreadPool, instead of the thread calling
+         * process_messages(). Events with the same name are still
+         * delivered in order. The callbacks must not call the client
+         * when they run on other threads.
+         *
+         * @param[in] p_executor The executor; it must outlive the client
+         *                      or be removed by passing a null pointer.
+         */
+        void executor(Executor *p_executor)
+        {
+            client_.executor(p_executor);
         }
 
         /**
@@ -209,6 +400,11 @@ namespace deepstream {
             {
             }
 
+            ~EventWrapper()
+            {
+                client_.event.persistent_outbox(nullptr);
+            }
+
             /**
              * Emit/(Publish) an event to all local and remote subscribers.
              *
@@ -222,6 +418,26 @@ namespace deepstream {
                 client_.event.emit(name_buff, data_buff);
             }
 
+            /**
+             * Emit an event from any thread.
+             *
+             * The event is queued and sent by the thread calling
+             * process_messages() or flush(), which also notifies the local
+             * subscribers. With `IOMode::THREADED`, wait_for_messages()
+             * returns when events were queued.
+             *
+             * @param[in] name The name of the event to emit.
+             * @param[in] data The payload to be sent.
+             *
+             * @return false if the queue of the calling thread is full
+             */
+            bool emit_async(const std::string &name, json data)
+            {
+                const Buffer &data_buff = type_serializer_.to_prefixed_buffer(data);
+                const Buffer name_buff(name);
+                return client_.event.emit_async(name_buff, data_buff);
+            }
+
             /**
              * Subscribe to an event.
              * A function can be subscribed to many events (or the same event,
@@ -245,7 +461,7 @@ namespace deepstream {
             SubscriptionId subscribe(const std::string &name, SubscribeFn callback)
             {
                 Buffer name_buff(name);
-                Event::SubscribeFn core_callback([callback, this](const Buffer &prefixed_buff) {
+                Event::SubscribeFn core_callback([callback, this](const BufferView &prefixed_buff) {
                     const json &data = type_serializer_.prefixed_to_json(prefixed_buff);
                     callback(data);
                 });
@@ -253,6 +469,28 @@ namespace deepstream {
                 return subscription_id;
             }
 
+            /**
+             * Subscribe a function to many events at once. The
+             * subscriptions are sent to the server together.
+             *
+             * @see subscribe(const std::string &, SubscribeFn)
+             *
+             * @param[in] names The names to subscribe to.
+             * @param[in] callback The function to invoke for all events.
+             *
+             * @return The identifiers of the subscriptions in the order of
+             *         the names.
+             */
+            std::vector<SubscriptionId> subscribe_many(const std::vector<std::string> &names, SubscribeFn callback)
+            {
+                std::vector<Event::Name> name_buffs(names.cbegin(), names.cend());
+                Event::SubscribeFn core_callback([callback, this](const BufferView &prefixed_buff) {
+                    const json &data = type_serializer_.prefixed_to_json(prefixed_buff);
+                    callback(data);
+                });
+                return client_.event.subscribe_many(name_buffs, core_callback);
+            }
+
             /**
              * Unsubscribe from an event with subscription id.
              *
@@ -282,6 +520,53 @@ namespace deepstream {
                 client_.event.unsubscribe(name_buff);
             }
 
+            /**
+             * Unsubscribe all functions from many events at once.
+             *
+             * @see unsubscribe(const std::string &)
+             *
+             * @param[in] names The event names.
+             */
+            void unsubscribe_many(const std::vector<std::string> &names)
+            {
+                const std::vector<Event::Name> name_buffs(names.cbegin(), names.cend());
+                client_.event.unsubscribe_many(name_buffs);
+            }
+
+            /**
+             * Configure how events emitted while offline are kept until the
+             * connection is re-established.
+             *
+             * @param[in] max_bytes The memory budget of the kept events.
+             * @param[in] drop_oldest Drop the oldest events if the budget
+             *                      is exhausted; otherwise, new events are
+             *                      dropped.
+             * @param[in] conflate Keep only the last event for every name.
+             */
+            void outbox_policy(std::size_t max_bytes, bool drop_oldest = true, bool conflate = false)
+            {
+                const Outbox::Overflow overflow = drop_oldest
+                    ? Outbox::Overflow::DROP_OLDEST : Outbox::Overflow::DROP_NEWEST;
+                client_.event.outbox_policy(Outbox::Policy(max_bytes, overflow, conflate));
+            }
+
+            /**
+             * Keep events emitted while offline in files in the given
+             * directory so that they are sent even if the process is
+             * restarted before the connection is re-established.
+             *
+             * @param[in] directory The directory of the outbox files; it is
+             *                      created if necessary.
+             *
+             * @throws std::system_error if the files cannot be opened
+             */
+            void persistent_outbox(const std::string &directory)
+            {
+                std::unique_ptr<PersistentOutbox> p_outbox(new PersistentOutbox(directory));
+                client_.event.persistent_outbox(p_outbox.get());
+                p_persistent_outbox_.swap(p_outbox);
+            }
+
             /**
              * Register the client as a listener for event subscriptions made
              * by other clients.
@@ -320,6 +605,7 @@ namespace deepstream {
             Client &client_;
             ErrorHandler &error_handler_;
             TypeSerializer &type_serializer_;
+            std::unique_ptr<PersistentOutbox> p_persistent_outbox_;
         };
 
         /**
@@ -375,7 +661,7 @@ namespace deepstream {
              */
             SubscriptionId subscribe(SubscribeFn callback)
             {
-                Presence::SubscribeFn core_callback([callback, this](const Buffer &name, bool online) {
+                Presence::SubscribeFn core_callback([callback, this](const BufferView &name, bool online) {
                     callback(std::string(name.data(), name.size()), online);
                 });
                 return client_.presence.subscribe(core_callback);
@@ -409,10 +695,10 @@ namespace deepstream {
              */
             void get_all(QueryFn callback)
             {
-                Presence::QueryFn core_callback([callback, this](const std::vector<Buffer> users) {
+                Presence::QueryFn core_callback([callback, this](const Presence::UserList &users) {
                     std::vector<std::string> users_str(users.size());
                     for (std::size_t i = 0; i < users.size(); ++i) {
-                        const Buffer &user = users[i];
+                        const BufferView &user = users[i];
                         users_str[i] = std::string(user.data(), user.size());
                     }
                     callback(users_str);
@@ -426,7 +712,16 @@ namespace deepstream {
         };
 
     private:
+        WSHandler &ws_handler()
+        {
+            if (p_threaded_wsh_) {
+                return *p_threaded_wsh_;
+            }
+            return wsh_;
+        }
+
         PocoWSHandler wsh_;
+        const std::unique_ptr<ThreadedWSHandler> p_threaded_wsh_;
         BasicErrorHandler error_handler_;
         Client client_;
         TypeSerializer type_serializer_;
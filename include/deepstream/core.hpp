@@ -22,6 +22,7 @@
 #include <deepstream/core/error_handler.hpp>
 #include <deepstream/core/event.hpp>
 #include <deepstream/core/presence.hpp>
+#include <deepstream/core/thread_pool.hpp>
 #include <deepstream/core/version.hpp>
 
 #endif // DEEPSTREAM_CORE_HPP
@@ -22,6 +22,8 @@
 #include <cassert>
 
 namespace deepstream {
+struct BufferView;
+
 /**
  * This class represents sequential, writable storage for binary data.
  *
@@ -74,7 +76,81 @@ struct Buffer : public std::vector<char> {
         : Base(str.cbegin(), str.cend())
     {
     }
+
+    /**
+     * Copies the referenced bytes.
+     */
+    explicit Buffer(const BufferView& view);
+};
+
+/**
+ * This class references sequential, read-only binary data owned by someone
+ * else, e.g., an argument of a received message. The referenced memory must
+ * outlive the view; copy the view into a Buffer to keep the data.
+ */
+struct BufferView {
+    typedef char value_type;
+    typedef std::size_t size_type;
+    typedef const char* const_iterator;
+    typedef const_iterator iterator;
+
+    BufferView()
+        : data_(nullptr)
+        , size_(0)
+    {
+    }
+
+    BufferView(const char* p, std::size_t sz)
+        : data_(p)
+        , size_(sz)
+    {
+        assert(p || sz == 0);
+    }
+
+    BufferView(const Buffer& buffer)
+        : data_(buffer.data())
+        , size_(buffer.size())
+    {
+    }
+
+    const char* data() const { return data_; }
+
+    std::size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    const char& operator[](std::size_t i) const
+    {
+        assert(i < size_);
+        return data_[i];
+    }
+
+    const_iterator begin() const { return data_; }
+    const_iterator end() const { return data_ + size_; }
+
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+private:
+    const char* data_;
+    std::size_t size_;
 };
+
+inline Buffer::Buffer(const BufferView& view)
+    : Base(view.cbegin(), view.cend())
+{
+}
+
+inline bool operator==(const BufferView& left, const BufferView& right)
+{
+    return left.size() == right.size()
+        && (left.empty() || std::memcmp(left.data(), right.data(), left.size()) == 0);
+}
+
+inline bool operator!=(const BufferView& left, const BufferView& right)
+{
+    return !(left == right);
+}
 }
 
 #endif
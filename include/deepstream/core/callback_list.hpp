@@ -0,0 +1,298 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEEPSTREAM_CALLBACK_LIST_HPP
+#define DEEPSTREAM_CALLBACK_LIST_HPP
+
+#include <cassert>
+#include <cstddef>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <deepstream/core/fwd.hpp>
+#include <deepstream/core/subscription_slots.hpp>
+
+namespace deepstream {
+
+/**
+ * This class stores subscription callbacks together with their subscription
+ * ids in contiguous memory.
+ *
+ * The list may be modified by the callbacks while it is notifying them:
+ * - removed subscribers are only marked as removed (tombstones) and the
+ *   storage is compacted once the outermost notification finished,
+ * - subscribers added during a notification are kept aside and appended
+ *   afterwards; they are not called by the running notification.
+ * Hence, a notification is a linear walk over the callbacks without copying
+ * the list.
+ *
+ * The subscription ids are acquired from a `SubscriptionSlots` object which
+ * stores the position of every subscriber so that subscribers are found in
+ * constant time. The slots may be shared by several lists; they must outlive
+ * the lists.
+ *
+ * The list must not be moved or destroyed while it is notifying.
+ *
+ * For callbacks running on other threads, the list provides an immutable
+ * copy of the callbacks that is shared until the list is modified.
+ */
+template <typename Fn>
+class CallbackList {
+public:
+    struct Subscriber {
+        SubscriptionId id;
+        Fn callback;
+        bool removed;
+    };
+
+    explicit CallbackList(SubscriptionSlots& slots)
+        : slots_(slots)
+        , num_subscribers_(0)
+        , num_removed_(0)
+        , depth_(0)
+    {
+    }
+
+    ~CallbackList()
+    {
+        assert(!is_notifying());
+        clear();
+    }
+
+    CallbackList(const CallbackList&) = delete;
+    CallbackList& operator=(const CallbackList&) = delete;
+
+    /**
+     * @return The number of subscribers that were not removed
+     */
+    std::size_t size() const { return num_subscribers_; }
+
+    bool empty() const { return num_subscribers_ == 0; }
+
+    /**
+     * @return `true` while the callbacks are being notified
+     */
+    bool is_notifying() const { return depth_ > 0; }
+
+    /**
+     * @return `false` for ids of other lists and for stale ids
+     */
+    bool contains(SubscriptionId id) const
+    {
+        return find(id) != nullptr;
+    }
+
+    /**
+     * @return The subscription id of the new subscriber
+     */
+    SubscriptionId add(const Fn& callback)
+    {
+        const bool is_added = is_notifying();
+        std::vector<Subscriber>& subscribers = is_added ? added_ : subscribers_;
+        const SubscriptionSlots::Position position
+            = static_cast<SubscriptionSlots::Position>(subscribers.size())
+            | (is_added ? ADDED : 0);
+
+        assert(subscribers.size() < ADDED);
+
+        const SubscriptionId id = slots_.acquire(position);
+        subscribers.push_back(Subscriber{ id, callback, false });
+        ++num_subscribers_;
+        snapshot_.reset();
+
+        return id;
+    }
+
+    /**
+     * @return `false` if there is no subscriber with the given id
+     */
+    bool remove(SubscriptionId id)
+    {
+        Subscriber* p = find(id);
+
+        if (!p)
+            return false;
+
+        mark_removed(p);
+        compact_if_sparse();
+
+        return true;
+    }
+
+    void clear()
+    {
+        for (Subscriber& s : subscribers_)
+            if (!s.removed)
+                mark_removed(&s);
+
+        for (Subscriber& s : added_)
+            if (!s.removed)
+                mark_removed(&s);
+
+        compact_if_sparse();
+    }
+
+    typedef std::vector<Fn> Snapshot;
+
+    /**
+     * @return The callbacks of the subscribers at the time of the call
+     */
+    std::shared_ptr<const Snapshot> snapshot() const
+    {
+        if (snapshot_)
+            return snapshot_;
+
+        std::shared_ptr<Snapshot> p(new Snapshot());
+        p->reserve(num_subscribers_);
+
+        for (const Subscriber& s : subscribers_)
+            if (!s.removed)
+                p->push_back(s.callback);
+
+        for (const Subscriber& s : added_)
+            if (!s.removed)
+                p->push_back(s.callback);
+
+        snapshot_ = p;
+        return snapshot_;
+    }
+
+    /**
+     * Calls every subscriber with the given arguments.
+     */
+    template <typename... Args>
+    void notify(const Args&... args)
+    {
+        ++depth_;
+
+        // `subscribers_` does not grow during the notification so the
+        // reference to the called function stays valid
+        const std::size_t n = subscribers_.size();
+
+        try {
+            for (std::size_t i = 0; i < n; ++i) {
+                const Subscriber& s = subscribers_[i];
+
+                if (!s.removed)
+                    s.callback(args...);
+            }
+        } catch (...) {
+            finish_notification();
+            throw;
+        }
+
+        finish_notification();
+    }
+
+private:
+    /**
+     * This bit marks the positions in `added_`.
+     */
+    static const SubscriptionSlots::Position ADDED = SubscriptionSlots::Position(1) << 31;
+
+    Subscriber* find(SubscriptionId id) const
+    {
+        if (!slots_.is_valid(id))
+            return nullptr;
+
+        const SubscriptionSlots::Position position = slots_.position(id);
+        const std::vector<Subscriber>& subscribers
+            = (position & ADDED) ? added_ : subscribers_;
+        const std::size_t i = position & ~ADDED;
+
+        // the id may belong to another list
+        if (i >= subscribers.size() || subscribers[i].id != id)
+            return nullptr;
+
+        assert(!subscribers[i].removed);
+        return const_cast<Subscriber*>(&subscribers[i]);
+    }
+
+    void mark_removed(Subscriber* p)
+    {
+        assert(p);
+        assert(!p->removed);
+        assert(num_subscribers_ > 0);
+
+        p->removed = true;
+        slots_.release(p->id);
+        --num_subscribers_;
+        snapshot_.reset();
+
+        // the callback may be running
+        if (!is_notifying())
+            p->callback = nullptr;
+
+        ++num_removed_;
+    }
+
+    void compact_if_sparse()
+    {
+        if (!is_notifying() && 2 * num_removed_ > subscribers_.size())
+            compact();
+    }
+
+    void compact()
+    {
+        assert(!is_notifying());
+
+        std::size_t j = 0;
+        for (std::size_t i = 0; i < subscribers_.size(); ++i) {
+            if (subscribers_[i].removed)
+                continue;
+
+            if (i != j) {
+                subscribers_[j] = std::move(subscribers_[i]);
+                slots_.set_position(subscribers_[j].id, SubscriptionSlots::Position(j));
+            }
+            ++j;
+        }
+        subscribers_.resize(j);
+        num_removed_ = 0;
+
+        for (Subscriber& s : added_) {
+            if (s.removed)
+                continue;
+
+            slots_.set_position(s.id, SubscriptionSlots::Position(subscribers_.size()));
+            subscribers_.push_back(std::move(s));
+        }
+        added_.clear();
+    }
+
+    void finish_notification()
+    {
+        assert(depth_ > 0);
+
+        if (--depth_ > 0)
+            return;
+
+        if (num_removed_ > 0 || !added_.empty())
+            compact();
+    }
+
+    SubscriptionSlots& slots_;
+    std::vector<Subscriber> subscribers_;
+    std::vector<Subscriber> added_;
+    std::size_t num_subscribers_;
+    std::size_t num_removed_;
+    unsigned depth_;
+    mutable std::shared_ptr<const Snapshot> snapshot_;
+};
+}
+
+#endif
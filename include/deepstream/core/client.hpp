@@ -20,10 +20,13 @@
 #include <deepstream/core/buffer.hpp>
 #include <deepstream/core/event.hpp>
 #include <deepstream/core/presence.hpp>
+#include <deepstream/core/subscription_slots.hpp>
 #include <deepstream/core/ws.hpp>
 
+#include <cstddef>
 #include <cstdint>
 
+#include <chrono>
 #include <functional>
 #include <iosfwd>
 #include <memory>
@@ -32,8 +35,6 @@
 
 namespace deepstream {
 
-typedef unsigned long SubscriptionId;
-
 enum class ConnectionState {
     CLOSED,
     AWAIT_CONNECTION,
@@ -72,6 +73,40 @@ inline std::ostream &operator<<(std::ostream &os, ConnectionState state) {
     return os;
 }
 
+/**
+ * This structure limits the work of one call to `Client::process_messages()`:
+ * dispatching stops once `max_messages` messages or `max_bytes` bytes were
+ * dispatched or once `max_duration` passed, whichever comes first. A limit
+ * of zero means no limit. At least one message is dispatched per call so
+ * that the messages are processed eventually.
+ */
+struct ProcessingBudget {
+    ProcessingBudget()
+        : max_messages(0)
+        , max_bytes(0)
+        , max_duration(std::chrono::microseconds::zero())
+    {
+    }
+
+    ProcessingBudget(std::size_t max_messages_, std::size_t max_bytes_,
+        std::chrono::microseconds max_duration_)
+        : max_messages(max_messages_)
+        , max_bytes(max_bytes_)
+        , max_duration(max_duration_)
+    {
+    }
+
+    bool is_limited() const
+    {
+        return max_messages > 0 || max_bytes > 0
+            || max_duration > std::chrono::microseconds::zero();
+    }
+
+    std::size_t max_messages;
+    std::size_t max_bytes;
+    std::chrono::microseconds max_duration;
+};
+
 struct Client {
 
     typedef std::function<void(Buffer &&)> LoginCallback;
@@ -106,9 +141,72 @@ struct Client {
 
     ConnectionState get_connection_state() const;
 
+    /**
+     * This function reads the received messages with the WebSocket handler
+     * and dispatches them until the budget is spent. The messages left over
+     * are kept in serialized form and dispatched first by the next call,
+     * which reads the WebSocket handler only if they fit into its budget.
+     *
+     * @return `true` if received messages wait to be dispatched
+     */
+    bool process_messages(const ProcessingBudget& = ProcessingBudget());
+
+    /**
+     * @return `true` if received messages wait to be dispatched by
+     * process_messages()
+     */
+    bool has_pending_messages() const;
+
+    /**
+     * This function enables the detection of dead connections, e.g.,
+     * half-open TCP connections: if nothing was received for the given
+     * time, the connection is closed and reopened right away. The server
+     * pings its clients regularly (every 30 seconds by default) so the
+     * timeout should be a multiple of the ping interval. A timeout of zero
+     * disables the detection (the default).
+     *
+     * The check is driven by process_messages(), which must be called by
+     * the time next_timer_deadline() returns even if nothing was received.
+     */
+    void heartbeat_timeout(std::chrono::milliseconds);
+
+    /**
+     * @return `false` if no timer is active; otherwise, the time by which
+     * process_messages() should be called is stored in `*p_deadline`
+     */
+    bool next_timer_deadline(std::chrono::steady_clock::time_point* p_deadline) const;
+
+    /**
+     * This function enables the batching of outgoing messages: messages are
+     * collected and sent in a single WebSocket frame when `max_size` bytes
+     * were collected, when a message is sent `max_delay` after the oldest
+     * collected message, at the end of `process_messages()`, or on flush().
+     * Subscription messages and events are collected separately and the
+     * subscription messages are sent first; connection messages, e.g.,
+     * pongs, are never collected and overtake the collected messages.
+     *
+     * A maximum size of zero disables batching (the default).
+     */
+    void batching(std::size_t max_size, std::chrono::milliseconds max_delay);
+
+    /**
+     * This function sends all collected outgoing messages including the
+     * events queued by `Event::emit_async()`.
+     */
+    bool flush();
+
+    /**
+     * This function sets the executor running the event and the presence
+     * callbacks; a null pointer restores the default of calling them on the
+     * thread processing the messages.
+     *
+     * @see Event::executor()
+     */
+    void executor(Executor*);
+
 private:
     const std::unique_ptr<Connection> p_connection_;
-    SubscriptionId subscription_counter_;
+    SubscriptionSlots subscription_slots_;
 
 public:
     Event event;
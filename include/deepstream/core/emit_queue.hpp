@@ -0,0 +1,152 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEEPSTREAM_EMIT_QUEUE_HPP
+#define DEEPSTREAM_EMIT_QUEUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/spsc_ring.hpp>
+
+namespace deepstream {
+
+/**
+ * This class is a lock-free multi-producer/single-consumer queue of
+ * serialized events.
+ *
+ * Every producer thread gets its own lane, a single-producer/single-consumer
+ * ring, when it pushes its first event; afterwards, pushing is wait-free
+ * and the producers do not share any memory with each other. The consumer
+ * drains all lanes in turn. Events of one producer thread keep their order,
+ * events of different threads are interleaved arbitrarily. When a thread
+ * exits, its lane is handed to the next new producer thread as soon as the
+ * consumer drained it.
+ *
+ * The events are serialized by the producers so that the consumer only
+ * concatenates them. The records circulate between the threads: drained
+ * records are handed back to the lanes and their buffers are reused.
+ */
+class EmitQueue {
+public:
+    /**
+     * A serialized event message together with the location of the event
+     * name and the data in the message.
+     */
+    struct Record {
+        Record()
+            : name_offset(0)
+            , name_size(0)
+            , data_offset(0)
+            , data_size(0)
+        {
+        }
+
+        BufferView name() const { return BufferView(message.data() + name_offset, name_size); }
+
+        BufferView data() const { return BufferView(message.data() + data_offset, data_size); }
+
+        Buffer message;
+        std::size_t name_offset;
+        std::size_t name_size;
+        std::size_t data_offset;
+        std::size_t data_size;
+    };
+
+    enum { DEFAULT_LANE_CAPACITY = 4096 };
+
+    /**
+     * The maximum number of lanes, i.e., of producer threads at a time.
+     */
+    enum { MAX_LANES = 256 };
+
+    explicit EmitQueue(std::size_t lane_capacity = DEFAULT_LANE_CAPACITY);
+
+    EmitQueue(const EmitQueue&) = delete;
+    EmitQueue& operator=(const EmitQueue&) = delete;
+
+    /**
+     * Appends an event; this method may be called by any thread.
+     *
+     * @return `false` if the lane of the calling thread is full or if there
+     * are too many producer threads
+     */
+    bool push(const BufferView& name, const BufferView& data);
+
+    /**
+     * Moves up to `records.size()` records into the given vector; the
+     * previous contents of the records are handed back to the producers.
+     * This method may only be called by the consumer.
+     *
+     * @return The number of drained records
+     */
+    std::size_t drain(std::vector<Record>& records);
+
+    /**
+     * @return The number of lanes, i.e., the largest number of producer
+     * threads at a time so far
+     */
+    std::size_t num_lanes() const { return num_lanes_.load(std::memory_order_acquire); }
+
+private:
+    enum LaneState { ACTIVE, EXITED, FREE };
+
+    struct Lane {
+        explicit Lane(std::size_t capacity)
+            : ring(capacity)
+            , state(ACTIVE)
+        {
+        }
+
+        SpscRing<Record> ring;
+        // the record filled by the producer
+        Record record;
+        // EXITED is set by the producer thread when it exits, FREE by the
+        // consumer after it drained the lane of an exited thread
+        std::atomic<int> state;
+    };
+
+    struct LaneCache;
+
+    /**
+     * @return The lane of the calling thread or a null pointer if there are
+     * too many lanes
+     */
+    Lane* lane();
+
+    const std::uint64_t id_;
+    const std::size_t lane_capacity_;
+
+    // serializes the creation of lanes
+    std::mutex mutex_;
+    // the lanes are shared with the caches of the producer threads
+    std::vector<std::shared_ptr<Lane>> lane_storage_;
+    std::atomic<Lane*> lanes_[MAX_LANES];
+    std::atomic<std::size_t> num_lanes_;
+
+    // the lane where the consumer starts draining next
+    std::size_t next_lane_;
+
+    static thread_local LaneCache lane_cache_;
+};
+}
+
+#endif
@@ -16,13 +16,18 @@
 #ifndef DEEPSTREAM_EVENT_HPP
 #define DEEPSTREAM_EVENT_HPP
 
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/callback_list.hpp>
+#include <deepstream/core/emit_queue.hpp>
+#include <deepstream/core/executor.hpp>
 #include <deepstream/core/fwd.hpp>
+#include <deepstream/core/name_table.hpp>
+#include <deepstream/core/outbox.hpp>
 
+#include <deque>
 #include <functional>
-#include <map>
 #include <memory>
 #include <vector>
-#include <queue>
 
 namespace deepstream {
 
@@ -32,29 +37,30 @@ struct Event {
     /**
      * This alias is the signature of a deepstream event subscription
      * callback.
+     *
+     * The event data references the received message; it is only valid
+     * during the call.
      */
-    typedef std::function<void(const Buffer&)> SubscribeFn;
+    typedef std::function<void(const BufferView&)> SubscribeFn;
     /**
      * Subscriptions are identified by a unique id returned by the subscribe()
      * function
      *
      * Given an event name, the deepstream API allows the selective removal
      * of subscription callbacks by providing the given identifier in calls to
-     * unsubscribe.
+     * unsubscribe. The ids are handles into a `SubscriptionSlots` object;
+     * stale ids and ids of other events are ignored.
+     *
+     * The callbacks are stored with their ids; callbacks may subscribe and
+     * unsubscribe while they are being notified.
      */
-    typedef std::vector<SubscriptionId> SubscriberList;
-    typedef std::map<SubscriptionId, SubscribeFn> SubscribeFnMap;
-    typedef std::map<Name, SubscriberList> SubscriberMap;
+    typedef CallbackList<SubscribeFn> SubscriberList;
 
     /**
      * The following alias is the signature of a deepstream event listener
      * callback.
      */
     typedef std::function<bool(const Name&, bool)> ListenFn;
-    /**
-     * The representation of a callback is stored as a smart pointer.
-     */
-    typedef std::map<Name, ListenFn> ListenerMap;
 
     /**
      * This alias is the signature of the function used to send messages to
@@ -65,6 +71,35 @@ struct Event {
      */
     typedef std::function<bool(const Message&)> SendFn;
 
+    /**
+     * This alias is the signature of the function sending all messages
+     * collected by the function for bulk messages.
+     */
+    typedef std::function<bool()> FlushFn;
+
+    /**
+     * This alias is the signature of the function sending a run of
+     * serialized messages in a single frame; it is used to replay the
+     * outbox.
+     */
+    typedef Outbox::WriteFn SendSerializedFn;
+
+    /**
+     * The default number of messages sent per step when the subscriptions
+     * are renewed after a reconnect.
+     */
+    static const std::size_t RESUBSCRIPTION_STEP_SIZE = 1024;
+
+    /**
+     * The maximum size of the frames replaying the outbox.
+     */
+    static const std::size_t REPLAY_FRAME_SIZE = 64 * 1024;
+
+    /**
+     * The maximum number of events taken from the emit queue at once.
+     */
+    static const std::size_t EMIT_BATCH_SIZE = 1024;
+
     /**
      * The constructor takes a function that sends a message to the
      * deepstream server.
@@ -72,7 +107,24 @@ struct Event {
      * With this constructor instead of `Event(deepstream::Client*)` it
      * becomes easier to test this module.
      */
-    explicit Event(const SendFn &, SubscriptionId &);
+    explicit Event(const SendFn &, SubscriptionSlots &);
+
+    /**
+     * This constructor takes an additional function for messages that may
+     * be collected and sent together in large frames (bulk subscriptions and
+     * resubscriptions) and a function sending the collected messages.
+     */
+    explicit Event(const SendFn &send, const SendFn &send_bulk,
+        const FlushFn &flush, SubscriptionSlots &);
+
+    /**
+     * This constructor takes an additional function for replaying the
+     * outbox. Without it, the messages in the outbox are parsed again and
+     * passed to `send` one by one.
+     */
+    explicit Event(const SendFn &send, const SendFn &send_bulk,
+        const FlushFn &flush, const SendSerializedFn &send_serialized,
+        SubscriptionSlots &);
 
     ~Event();
 
@@ -84,9 +136,69 @@ struct Event {
     /**
      * This function emits an event with the provided name and the given
      * buffer as its data.
+     *
+     * If the event cannot be sent, it is kept in the outbox and sent after
+     * the connection was re-established. While the outbox waits for its
+     * replay, i.e., until the resubscription finished, new events are
+     * appended to it so that they do not overtake the kept events.
      */
     void emit(const Name&, const Buffer&);
 
+    /**
+     * This function queues an event for the thread serving the connection;
+     * unlike all other functions, it may be called by any thread. The event
+     * is sent and the local subscribers are notified when the connection
+     * thread drains the queue (see `drain_emits_()`).
+     *
+     * @return `false` if the queue of the calling thread is full
+     */
+    bool emit_async(const Name&, const Buffer&);
+
+    /**
+     * This function sets a callback that is invoked by the emitting thread
+     * after every call to `emit_async()`, e.g., to wake up the connection
+     * thread. It must be set before other threads emit events.
+     */
+    void on_emit_async(const std::function<void()>&);
+
+    /**
+     * This function sets the byte budget, the overflow behaviour, and the
+     * conflation of the outbox. By default, at most
+     * `Outbox::DEFAULT_MAX_BYTES` are kept, the oldest events are dropped
+     * first, and events are not conflated.
+     */
+    void outbox_policy(const Outbox::Policy&);
+
+    const Outbox& outbox() const { return outbox_; }
+
+    /**
+     * This function makes the event module keep the events that cannot be
+     * sent in the given persistent outbox instead of the outbox in memory.
+     * The events in the persistent outbox, including those of previous
+     * processes, are sent before the events in memory. Pass a null pointer
+     * to stop using the persistent outbox.
+     *
+     * The persistent outbox is not owned by the event module; it must
+     * outlive the module or be removed before its destruction.
+     */
+    void persistent_outbox(PersistentOutbox*);
+
+    /**
+     * This function makes the event module run the subscription callbacks
+     * with the given executor; the events are keyed by the hash of their
+     * name so that events with the same name arrive in order. Pass a null
+     * pointer to restore the default: the callbacks are called directly by
+     * the thread dispatching the messages.
+     *
+     * With an executor, the callbacks receive a copy of the event data and
+     * the callbacks subscribed at the time of dispatch. Callbacks running
+     * on other threads must not call the client.
+     *
+     * The executor is not owned by the event module; it must outlive the
+     * module or be removed before its destruction.
+     */
+    void executor(Executor*);
+
     /**
      * This method subscribes the given function to the event with the given
      * name.
@@ -95,11 +207,25 @@ struct Event {
      */
     SubscriptionId subscribe(const Name&, const SubscribeFn);
 
+    /**
+     * This method subscribes the given function to all events with the
+     * given names. The subscription messages are sent together.
+     *
+     * @return The SubscriptionIds in the order of the names
+     */
+    std::vector<SubscriptionId> subscribe_many(const std::vector<Name>&, const SubscribeFn);
+
     /**
      * This function unsubscribes *all* callbacks from the given event.
      */
     void unsubscribe(const Name&);
 
+    /**
+     * This function unsubscribes all callbacks from all given events. The
+     * unsubscription messages are sent together.
+     */
+    void unsubscribe_many(const std::vector<Name>&);
+
     /**
      * This function removes the given callback from the list of subscribers
      * for the given event.
@@ -137,20 +263,126 @@ struct Event {
      */
     void notify_listeners_(const Message&);
 
+    /**
+     * When the connection is (re-)established, all subscriptions and
+     * listeners are renewed in steps of at most `max_messages` messages (zero
+     * means no limit) so that other traffic, e.g., heartbeats, is not held
+     * up. Every step is sent in as few frames as possible.
+     */
+    void pace_resubscription(std::size_t max_messages);
+
     void on_connection_state_change_(const ConnectionState);
 
+    /**
+     * This method sends the next step of a pending resubscription. It is
+     * called by the connection whenever the received data was processed.
+     *
+     * @return `true` if there is no pending resubscription
+     */
+    bool resubscribe_();
+
+    /**
+     * This method sends the events queued by `emit_async()` in as few
+     * frames as possible and notifies the local subscribers. It is called by
+     * the connection whenever the received data was processed and on flush.
+     *
+     * @return `true` if the queue was drained completely
+     */
+    bool drain_emits_();
+
+    /**
+     * @return The subscribers of the given event or a null pointer if there
+     * is no subscription
+     */
+    const SubscriberList* subscribers(const BufferView& name) const;
+
+    /**
+     * @return The callback listening to the given pattern or a null pointer
+     */
+    const ListenFn* listener(const BufferView& pattern) const;
+
     const SendFn send_;
-    SubscriberMap subscriber_map_;
-    SubscribeFnMap subscribe_fn_map_;
-    ListenerMap listener_map_;
+    const SendFn send_bulk_;
+    const FlushFn flush_;
+    const SendSerializedFn send_serialized_;
+
+    /**
+     * The names of all events with subscribers; the name ids index
+     * `subscriber_lists_`. A deque is used because subscriber lists must not
+     * move while they are notifying.
+     */
+    NameTable subscription_names_;
+    std::deque<SubscriberList> subscriber_lists_;
+
+    /**
+     * The patterns of all listeners; the name ids index `listeners_`.
+     */
+    NameTable listener_patterns_;
+    std::vector<ListenFn> listeners_;
 
   private:
+    SubscriptionId subscribe(const Name&, const SubscribeFn, const SendFn&);
+
+    void unsubscribe(const Name&, const SendFn&);
+
+    /**
+     * Releases the name of an event without subscribers and tells the server.
+     */
+    void drop_subscription(NameTable::Id, const Name&, const SendFn&);
+
+    /**
+     * Sends the first `n` records of `emit_records_` and notifies the local
+     * subscribers.
+     */
+    void send_emits(std::size_t n);
+
+    /**
+     * Keeps an event that could not be sent in the outbox.
+     */
+    void keep(const Message&);
+
+    /**
+     * @return `true` if events must be kept because sending them would
+     * overtake the events in the outbox
+     */
+    bool is_holding_emits() const;
+
+    /**
+     * Sends the events kept in the persistent outbox and in the outbox.
+     */
+    void replay_outbox();
+
+    /**
+     * The events that could not be sent; the outbox is replayed in runs of
+     * at most `max_replay_size_` bytes.
+     */
+    Outbox outbox_;
+    PersistentOutbox* p_persistent_outbox_;
+    Executor* p_executor_;
+    std::size_t max_replay_size_;
 
-    void send_buffered(const std::unique_ptr<Message> &&);
+    /**
+     * The events emitted by other threads, the records taken from the queue,
+     * and the frame the records are concatenated into.
+     */
+    EmitQueue emit_queue_;
+    std::vector<EmitQueue::Record> emit_records_;
+    Buffer emit_frame_;
+    std::function<void()> on_emit_async_;
 
-    std::queue<std::unique_ptr<Message>> send_queue_;
+    SubscriptionSlots &subscription_slots_;
 
-    SubscriptionId &subscription_counter_;
+    /**
+     * The state of the resubscription: flags marking the names and the
+     * patterns (indexed by their ids) that still need to be sent to the
+     * server, and the ids where the next step begins.
+     */
+    std::size_t resubscription_step_size_;
+    bool is_resubscribing_;
+    std::vector<bool> pending_subscriptions_;
+    std::vector<bool> pending_listeners_;
+    NameTable::Id next_subscription_;
+    NameTable::Id next_listener_;
 };
 }
 
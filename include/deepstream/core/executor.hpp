@@ -0,0 +1,51 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEEPSTREAM_EXECUTOR_HPP
+#define DEEPSTREAM_EXECUTOR_HPP
+
+#include <cstddef>
+
+#include <functional>
+
+namespace deepstream {
+
+/**
+ * An executor runs the subscription callbacks of the event and the presence
+ * modules.
+ *
+ * Every task comes with a key, e.g., the hash of an event name. Tasks with
+ * equal keys must run in the order they were submitted and must not run
+ * concurrently; tasks with different keys may run in parallel.
+ */
+class Executor {
+public:
+    typedef std::function<void()> Task;
+
+    virtual ~Executor() {}
+
+    virtual void execute(std::size_t key, Task task) = 0;
+};
+
+/**
+ * This executor runs every task immediately on the calling thread.
+ */
+class InlineExecutor : public Executor {
+public:
+    void execute(std::size_t, Task task) override { task(); }
+};
+}
+
+#endif
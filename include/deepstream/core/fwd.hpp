@@ -16,15 +16,21 @@
 #ifndef DEEPSTREAM_CORE_FWD_HPP
 #define DEEPSTREAM_CORE_FWD_HPP
 
+#include <cstdint>
+
 namespace deepstream {
 
 
     struct ErrorHandler;
     struct Connection;
     struct Buffer;
+    struct BufferView;
     struct Message;
+    class Executor;
+    class PersistentOutbox;
+    class SubscriptionSlots;
 
-    typedef unsigned long SubscriptionId;
+    typedef std::uint64_t SubscriptionId;
 
     enum class ConnectionState;
 
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEEPSTREAM_NAME_TABLE_HPP
+#define DEEPSTREAM_NAME_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <deepstream/core/buffer.hpp>
+
+namespace deepstream {
+
+/**
+ * This class interns names (e.g., event names): every name in the table is
+ * identified by a small integer id so that data belonging to a name can be
+ * stored in plain arrays indexed by the id.
+ *
+ * The names are found with a flat open-addressing hash table (linear probing)
+ * whose slots store the id and the precomputed hash of the name; the bytes of
+ * a name are only compared when the hashes are equal. Thus, look-ups cost one
+ * hash computation and, on average, a single comparison regardless of the
+ * number of names in the table.
+ *
+ * Ids are dense: the ids of erased names are reused by the next insertions.
+ */
+class NameTable {
+public:
+    typedef std::uint32_t Id;
+    typedef std::uint32_t Hash;
+
+    /**
+     * This value is returned by look-ups for names that are not in the table.
+     */
+    static const Id NONE;
+
+    NameTable();
+
+    /**
+     * @return The id of the given name or `NONE`
+     */
+    Id find(const BufferView& name) const;
+
+    /**
+     * Adds the given name to the table if it is not present yet.
+     *
+     * @return The id of the given name
+     */
+    Id intern(const BufferView& name);
+
+    /**
+     * Removes the name with the given id from the table; the id may be
+     * returned by later calls to `intern()`.
+     */
+    void erase(Id id);
+
+    /**
+     * @return `true` if the id belongs to a name in the table
+     */
+    bool contains(Id id) const
+    {
+        return id < entries_.size() && entries_[id].used;
+    }
+
+    BufferView name(Id id) const
+    {
+        assert(contains(id));
+        return entries_[id].name;
+    }
+
+    Hash hash(Id id) const
+    {
+        assert(contains(id));
+        return entries_[id].hash;
+    }
+
+    /**
+     * All ids in the table are smaller than the returned value; use this
+     * function to size arrays indexed by name ids.
+     */
+    Id id_limit() const { return static_cast<Id>(entries_.size()); }
+
+    std::size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    /**
+     * Computes the 32-bit FNV-1a hash of the given bytes.
+     */
+    static Hash hash_of(const BufferView& name);
+
+private:
+    struct Entry {
+        Buffer name;
+        Hash hash;
+        bool used;
+    };
+
+    struct Slot {
+        Id id;
+        Hash hash;
+    };
+
+    /**
+     * @return The index of the slot holding the name or of the empty slot
+     * where the name would be inserted.
+     */
+    std::size_t find_slot(const BufferView& name, Hash hash) const;
+
+    void grow();
+
+    std::vector<Entry> entries_;
+    std::vector<Id> free_ids_;
+    std::vector<Slot> slots_;
+    std::size_t size_;
+};
+}
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEEPSTREAM_OUTBOX_HPP
+#define DEEPSTREAM_OUTBOX_HPP
+
+#include <cstddef>
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/fwd.hpp>
+#include <deepstream/core/name_table.hpp>
+
+namespace deepstream {
+
+/**
+ * This class keeps outgoing messages that could not be sent, e.g., events
+ * emitted while the connection is down, until they can be replayed.
+ *
+ * The messages are serialized into a single contiguous byte log so that
+ * queueing a message does not allocate memory in the steady state and so
+ * that the replay hands large runs of messages to the connection at once.
+ *
+ * The memory use is bounded by a byte budget; when it is exhausted, either
+ * the oldest messages are discarded or the new message is rejected. With
+ * conflation, only the last message for every name (the first message
+ * argument) is kept; the conflated message takes the place of the newest
+ * message in the queue.
+ */
+class Outbox {
+public:
+    enum class Overflow {
+        DROP_OLDEST,
+        DROP_NEWEST
+    };
+
+    static const std::size_t DEFAULT_MAX_BYTES = 16 * 1024 * 1024;
+
+    struct Policy {
+        explicit Policy(std::size_t max_bytes = DEFAULT_MAX_BYTES,
+            Overflow overflow = Overflow::DROP_OLDEST, bool conflate = false)
+            : max_bytes(max_bytes)
+            , overflow(overflow)
+            , conflate(conflate)
+        {
+        }
+
+        /**
+         * The maximum number of serialized bytes in the outbox.
+         */
+        std::size_t max_bytes;
+        Overflow overflow;
+        bool conflate;
+    };
+
+    /**
+     * This alias is the signature of the function receiving a run of
+     * serialized messages during the replay; it returns `false` if the
+     * messages could not be sent.
+     */
+    typedef std::function<bool(const BufferView&)> WriteFn;
+
+    Outbox();
+
+    explicit Outbox(const Policy&);
+
+    Outbox(const Outbox&) = delete;
+    Outbox& operator=(const Outbox&) = delete;
+
+    const Policy& policy() const { return policy_; }
+
+    /**
+     * Changes the policy; messages exceeding a smaller budget are discarded
+     * immediately. Conflation affects only messages queued afterwards.
+     */
+    void policy(const Policy&);
+
+    /**
+     * Appends the given message.
+     *
+     * @return `false` if the message was discarded
+     */
+    bool push(const Message&);
+
+    /**
+     * Passes the messages in order to the given function in runs of at most
+     * `max_write_size` bytes (a larger message is passed on its own) and
+     * removes every run that was written. The replay stops at the first
+     * failed write.
+     *
+     * @return `true` if the outbox is empty
+     */
+    bool replay(const WriteFn&, std::size_t max_write_size);
+
+    void clear();
+
+    /**
+     * @return The number of queued messages
+     */
+    std::size_t size() const { return num_messages_; }
+
+    bool empty() const { return num_messages_ == 0; }
+
+    /**
+     * @return The number of serialized bytes of the queued messages
+     */
+    std::size_t num_bytes() const { return num_bytes_; }
+
+    /**
+     * @return The number of messages discarded because of the byte budget
+     * (conflated messages are not counted)
+     */
+    std::size_t num_dropped() const { return num_dropped_; }
+
+private:
+    /**
+     * An entry locates a message in the log. Conflated messages are marked
+     * as removed and skipped until the log is compacted. The sequence number
+     * of an entry is its index plus `first_sequence_number_`.
+     */
+    struct Entry {
+        std::size_t offset;
+        std::size_t size;
+        NameTable::Id name;
+        bool removed;
+    };
+
+    /**
+     * Discards the oldest message.
+     */
+    void pop_front();
+
+    /**
+     * Removes the entry at the given index from the name index.
+     */
+    void forget_name(std::size_t index);
+
+    void compact_if_sparse();
+
+    /**
+     * Moves all messages to the start of the log and drops the entries of
+     * removed messages.
+     */
+    void compact();
+
+    Policy policy_;
+
+    Buffer log_;
+    Buffer spare_log_;
+    std::vector<BufferView> segments_;
+    std::deque<Entry> entries_;
+    std::size_t first_sequence_number_;
+
+    /**
+     * The names of conflated messages together with the sequence numbers of
+     * their newest entries (indexed by name id).
+     */
+    NameTable names_;
+    std::vector<std::size_t> latest_;
+
+    std::size_t num_messages_;
+    std::size_t num_bytes_;
+    std::size_t num_dropped_;
+};
+}
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEEPSTREAM_PERSISTENT_OUTBOX_HPP
+#define DEEPSTREAM_PERSISTENT_OUTBOX_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/fwd.hpp>
+#include <deepstream/core/outbox.hpp>
+
+namespace deepstream {
+
+/**
+ * This class keeps outgoing messages that could not be sent in files so
+ * that they survive restarts of the process.
+ *
+ * The serialized messages are appended to memory-mapped segment files in
+ * the given directory; appending a message is a copy into the mapping
+ * without system calls. The blocks of a segment are reserved when it is
+ * created; if this fails, e.g., because the disk is full, the messages are
+ * discarded until a segment can be reserved.
+ *
+ * A message is identified by its byte offset in the concatenation of all
+ * segments (the name of a segment file is the offset of its first byte).
+ * The offset up to which the messages were sent and the end offset of the
+ * messages are kept in a memory-mapped checkpoint file; the messages
+ * between these offsets are replayed when the connection is re-established,
+ * possibly by a new process. Without a checkpoint, the messages of the last
+ * segment end at the last ASCII record separator before its zero-filled
+ * tail.
+ *
+ * The data and the checkpoint are flushed to disk in batches: after
+ * `sync_bytes` bytes were appended, after `sync_interval` elapsed, when a
+ * segment is full, after a replay, and on destruction. A crash of the
+ * process loses nothing, a crash of the system loses at most the messages
+ * of the last batch. Messages may be sent twice if the system crashes
+ * after a replay.
+ *
+ * The disk usage is bounded by `max_segments` segments of `segment_size`
+ * bytes; when a new segment is needed and there are too many segments, the
+ * oldest segment is deleted together with its unsent messages.
+ *
+ * This class is only available on POSIX systems.
+ */
+class PersistentOutbox {
+public:
+    typedef Outbox::WriteFn WriteFn;
+
+    static const std::size_t DEFAULT_SEGMENT_SIZE = 4 * 1024 * 1024;
+
+    struct Options {
+        explicit Options(std::size_t segment_size = DEFAULT_SEGMENT_SIZE,
+            std::size_t max_segments = 16,
+            std::size_t sync_bytes = 256 * 1024,
+            std::chrono::milliseconds sync_interval = std::chrono::milliseconds(100))
+            : segment_size(segment_size)
+            , max_segments(max_segments)
+            , sync_bytes(sync_bytes)
+            , sync_interval(sync_interval)
+        {
+        }
+
+        /**
+         * The size of new segment files; larger messages are discarded.
+         */
+        std::size_t segment_size;
+        std::size_t max_segments;
+        std::size_t sync_bytes;
+        std::chrono::milliseconds sync_interval;
+    };
+
+    /**
+     * Opens the outbox in the given directory, creating the directory if
+     * necessary, and recovers the messages that were not sent yet.
+     *
+     * @throws std::system_error if a file cannot be created or mapped
+     */
+    explicit PersistentOutbox(const std::string& directory, const Options& = Options());
+
+    ~PersistentOutbox();
+
+    PersistentOutbox(const PersistentOutbox&) = delete;
+    PersistentOutbox& operator=(const PersistentOutbox&) = delete;
+
+    /**
+     * Appends the given message.
+     *
+     * @return `false` if the message was discarded
+     */
+    bool push(const Message&);
+
+    /**
+     * Passes the unsent messages in order to the given function in runs of
+     * at most `max_write_size` bytes (a larger message is passed on its own)
+     * and advances the checkpoint after every run that was written. The
+     * replay stops at the first failed write.
+     *
+     * @return `true` if all messages were sent
+     */
+    bool replay(const WriteFn&, std::size_t max_write_size);
+
+    /**
+     * Flushes the appended messages and the checkpoint to disk.
+     */
+    void sync();
+
+    bool empty() const { return acknowledged_ == end_; }
+
+    /**
+     * @return The number of bytes of the unsent messages
+     */
+    std::uint64_t num_bytes() const { return end_ - acknowledged_; }
+
+    /**
+     * @return The number of unsent bytes deleted because of the disk budget,
+     * because a message did not fit into a segment, or because a segment
+     * could not be reserved
+     */
+    std::uint64_t num_dropped_bytes() const { return num_dropped_bytes_; }
+
+    /**
+     * @return The offset up to which all messages were sent
+     */
+    std::uint64_t acknowledged_offset() const { return acknowledged_; }
+
+    std::uint64_t end_offset() const { return end_; }
+
+    /**
+     * @return The number of segment files
+     */
+    std::size_t num_segments() const { return segments_.size(); }
+
+private:
+    struct Checkpoint {
+        std::uint64_t acknowledged;
+        std::uint64_t end;
+    };
+
+    struct Segment {
+        std::uint64_t base;
+        int fd;
+        char* data;
+        std::size_t capacity;
+        std::size_t size;
+    };
+
+    void recover();
+
+    Segment open_segment(std::uint64_t base, bool create);
+
+    void close_segment(Segment&);
+
+    std::string segment_path(std::uint64_t base) const;
+
+    /**
+     * Closes the current segment and starts a new one, deleting the oldest
+     * segment if there are too many.
+     */
+    void rotate();
+
+    /**
+     * Deletes the segments whose messages were all sent, except the last
+     * one.
+     */
+    void remove_sent_segments();
+
+    void acknowledge(std::uint64_t offset);
+
+    const std::string directory_;
+    const Options options_;
+
+    std::deque<Segment> segments_;
+
+    int checkpoint_fd_;
+    Checkpoint* checkpoint_;
+
+    std::uint64_t acknowledged_;
+    std::uint64_t end_;
+
+    /**
+     * The number of bytes of the last segment that were flushed to disk.
+     */
+    std::size_t synced_size_;
+    std::chrono::steady_clock::time_point last_sync_;
+
+    std::vector<BufferView> message_segments_;
+    std::uint64_t num_dropped_bytes_;
+};
+}
+
+#endif
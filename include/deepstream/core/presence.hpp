@@ -16,12 +16,13 @@
 #ifndef DEEPSTREAM_PRESENCE_HPP
 #define DEEPSTREAM_PRESENCE_HPP
 
+#include <deepstream/core/callback_list.hpp>
+#include <deepstream/core/executor.hpp>
 #include <deepstream/core/fwd.hpp>
 
 #include <functional>
 #include <memory>
 #include <vector>
-#include <map>
 
 namespace deepstream {
 
@@ -31,16 +32,21 @@ struct Presence {
     /**
      * This alias is the signature of a deepstream present subscription
      * callback.
+     *
+     * The user name references the received message; it is only valid
+     * during the call.
      */
-    typedef std::function<void(const Name&, bool online)> SubscribeFn;
+    typedef std::function<void(const BufferView&, bool online)> SubscribeFn;
 
-    typedef std::map<SubscriptionId, SubscribeFn> SubscribeFnMap;
-    typedef std::vector<SubscriptionId> SubscriberList;
+    typedef CallbackList<SubscribeFn> SubscriberList;
 
-    typedef std::vector<Name> UserList;
+    typedef std::vector<BufferView> UserList;
     /**
      * This alias is the signature of a deepstream callback for presence
      * queries.
+     *
+     * The user names reference the received message; they are only valid
+     * during the call.
      */
     typedef std::function<void(const UserList&)> QueryFn;
     // "querent" is actually an obsolete word:
@@ -66,7 +72,7 @@ struct Presence {
      * With this constructor instead of `Presence(deepstream::Client*)` it
      * becomes easier to test this module.
      */
-    explicit Presence(const SendFn&, SubscriptionId &subscription_counter_);
+    explicit Presence(const SendFn&, SubscriptionSlots &subscription_slots);
 
     ~Presence();
 
@@ -107,6 +113,17 @@ struct Presence {
     // here, too.
     void get_all(const QueryFn&);
 
+    /**
+     * This function makes the presence module run the callbacks with the
+     * given executor; the notifications are keyed by the hash of the user
+     * name so that the notifications for a user arrive in order. Pass a
+     * null pointer to call the callbacks directly (the default).
+     *
+     * With an executor, the callbacks receive copies of the user names.
+     * Callbacks running on other threads must not call the client.
+     */
+    void executor(Executor*);
+
     /**
      * This method handles resence-related messages (messages with topic
      * `Topic::PRESENCE`) from the server.
@@ -114,10 +131,9 @@ struct Presence {
     void notify_(const Message&);
 
     SendFn send_;
-    SubscriptionId &subscription_counter_;
-    SubscribeFnMap subscribe_fn_map_;
     SubscriberList subscribers_;
     QuerentList querents_;
+    Executor* p_executor_;
 };
 }
 
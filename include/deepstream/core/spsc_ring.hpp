@@ -0,0 +1,161 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEEPSTREAM_SPSC_RING_HPP
+#define DEEPSTREAM_SPSC_RING_HPP
+
+#include <cstddef>
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace deepstream {
+
+/**
+ * This class is a bounded, wait-free queue for exactly one producer thread
+ * and one consumer thread.
+ *
+ * The elements are exchanged with the slots of the ring instead of being
+ * copied: `try_push()` swaps the given value into a slot and returns the
+ * value the consumer left there, `try_pop()` swaps the value out of the slot
+ * and leaves the consumer's old value behind. Thus, elements owning memory
+ * (e.g., buffers) circulate between the threads and are reused without
+ * allocations once their capacity suffices.
+ *
+ * The producer and the consumer indices are kept on separate cache lines;
+ * each side caches the last seen index of the other side so that the
+ * shared indices are only read when the ring seems to be full or empty.
+ * The indices are separated by padding rather than by over-alignment so
+ * that rings can be members of heap-allocated objects in C++11.
+ */
+template <typename T>
+class SpscRing {
+public:
+    /**
+     * The capacity is rounded up to a power of two.
+     */
+    explicit SpscRing(std::size_t capacity)
+        : consumer_()
+        , producer_()
+        , slots_(round_up(capacity))
+        , mask_(slots_.size() - 1)
+    {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    std::size_t capacity() const { return slots_.size(); }
+
+    /**
+     * This method may only be called by the producer.
+     *
+     * @return `false` if the ring is full; the value is not modified then
+     */
+    bool try_push(T& value)
+    {
+        const std::size_t tail = producer_.tail.load(std::memory_order_relaxed);
+
+        if (tail - producer_.cached_head == slots_.size()) {
+            producer_.cached_head = consumer_.head.load(std::memory_order_acquire);
+
+            if (tail - producer_.cached_head == slots_.size())
+                return false;
+        }
+
+        using std::swap;
+        swap(slots_[tail & mask_], value);
+        producer_.tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * This method may only be called by the consumer.
+     *
+     * @return `false` if the ring is empty; the value is not modified then
+     */
+    bool try_pop(T& value)
+    {
+        const std::size_t head = consumer_.head.load(std::memory_order_relaxed);
+
+        if (head == consumer_.cached_tail) {
+            consumer_.cached_tail = producer_.tail.load(std::memory_order_acquire);
+
+            if (head == consumer_.cached_tail)
+                return false;
+        }
+
+        using std::swap;
+        swap(slots_[head & mask_], value);
+        consumer_.head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * Both threads may call this method; the result may be outdated when
+     * it is returned.
+     */
+    bool empty() const
+    {
+        return consumer_.head.load(std::memory_order_acquire)
+            == producer_.tail.load(std::memory_order_acquire);
+    }
+
+private:
+    static std::size_t round_up(std::size_t capacity)
+    {
+        std::size_t n = 1;
+        while (n < capacity)
+            n *= 2;
+        return n;
+    }
+
+    enum { CACHE_LINE_SIZE = 64 };
+
+    struct Consumer {
+        Consumer()
+            : head(0)
+            , cached_tail(0)
+        {
+        }
+
+        std::atomic<std::size_t> head;
+        std::size_t cached_tail;
+        char padding[CACHE_LINE_SIZE];
+    };
+
+    struct Producer {
+        Producer()
+            : tail(0)
+            , cached_head(0)
+        {
+        }
+
+        std::atomic<std::size_t> tail;
+        std::size_t cached_head;
+        char padding[CACHE_LINE_SIZE];
+    };
+
+    Consumer consumer_;
+    Producer producer_;
+    std::vector<T> slots_;
+    const std::size_t mask_;
+};
+}
+
+#endif
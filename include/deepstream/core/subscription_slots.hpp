@@ -0,0 +1,111 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEEPSTREAM_SUBSCRIPTION_SLOTS_HPP
+#define DEEPSTREAM_SUBSCRIPTION_SLOTS_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <vector>
+
+#include <deepstream/core/fwd.hpp>
+
+namespace deepstream {
+
+/**
+ * This class hands out subscription ids; it is a generational slot map.
+ *
+ * A subscription id combines the index of a slot (lower 32 bits) with the
+ * generation of the slot (upper 32 bits). The slot stores where the
+ * subscriber is kept (its position in a `CallbackList`) so that ids are
+ * resolved in constant time. When an id is released, the generation of its
+ * slot is incremented so that the released id and all copies of it are
+ * recognized as stale even after the slot was reused.
+ *
+ * The generation of a slot is odd while the slot is in use, i.e., valid ids
+ * are never zero.
+ */
+class SubscriptionSlots {
+public:
+    typedef std::uint32_t Position;
+
+    SubscriptionSlots();
+
+    SubscriptionSlots(const SubscriptionSlots&) = delete;
+    SubscriptionSlots& operator=(const SubscriptionSlots&) = delete;
+
+    /**
+     * @return A new subscription id referring to the given position
+     */
+    SubscriptionId acquire(Position);
+
+    /**
+     * Invalidates the given subscription id.
+     */
+    void release(SubscriptionId);
+
+    /**
+     * @return `true` if the id was acquired and not released yet
+     */
+    bool is_valid(SubscriptionId id) const
+    {
+        const std::size_t index = index_of(id);
+
+        return index < slots_.size() && slots_[index].generation == generation_of(id)
+            && (generation_of(id) & 1);
+    }
+
+    Position position(SubscriptionId id) const
+    {
+        assert(is_valid(id));
+        return slots_[index_of(id)].position;
+    }
+
+    void set_position(SubscriptionId id, Position position)
+    {
+        assert(is_valid(id));
+        slots_[index_of(id)].position = position;
+    }
+
+    /**
+     * @return The number of valid subscription ids
+     */
+    std::size_t size() const { return size_; }
+
+private:
+    struct Slot {
+        std::uint32_t generation;
+        Position position;
+    };
+
+    static std::size_t index_of(SubscriptionId id)
+    {
+        return static_cast<std::uint32_t>(id);
+    }
+
+    static std::uint32_t generation_of(SubscriptionId id)
+    {
+        return static_cast<std::uint32_t>(id >> 32);
+    }
+
+    std::vector<Slot> slots_;
+    std::vector<std::uint32_t> free_slots_;
+    std::size_t size_;
+};
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEEPSTREAM_THREAD_POOL_HPP
+#define DEEPSTREAM_THREAD_POOL_HPP
+
+#include <cstddef>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <deepstream/core/executor.hpp>
+
+namespace deepstream {
+
+/**
+ * This class is a work-stealing thread pool that keeps the order of tasks
+ * with equal keys.
+ *
+ * The keys are hashed onto a fixed number of strands; a strand is a queue
+ * of tasks that is run by at most one thread at a time. A strand with tasks
+ * is scheduled on the queue of one of the threads; idle threads steal
+ * strands from the queues of the other threads. Thus, tasks with equal keys
+ * run one after another in the order of submission while tasks with
+ * different keys are spread over all threads.
+ *
+ * An exception thrown by a task is passed to the exception handler; the
+ * remaining tasks run nonetheless.
+ */
+class ThreadPool : public Executor {
+public:
+    /**
+     * This function is called by the thread of the pool that caught an
+     * exception, possibly concurrently with other threads; it must not
+     * throw.
+     */
+    typedef std::function<void(std::exception_ptr)> ExceptionHandler;
+
+    /**
+     * A number of zero selects the number of hardware threads for the
+     * threads and 64 strands per thread. Exceptions thrown by tasks are
+     * ignored if no exception handler is given.
+     */
+    explicit ThreadPool(std::size_t num_threads = 0, std::size_t num_strands = 0,
+        ExceptionHandler = ExceptionHandler());
+
+    /**
+     * Runs the pending tasks and stops the threads.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * This method may be called by any thread including the threads of the
+     * pool.
+     */
+    void execute(std::size_t key, Task task) override;
+
+    /**
+     * Blocks until all tasks submitted so far were run; this method must not
+     * be called by a task.
+     */
+    void wait();
+
+    std::size_t num_threads() const { return threads_.size(); }
+
+private:
+    struct Strand {
+        Strand()
+            : is_scheduled(false)
+        {
+        }
+
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        // true while the strand is queued or running
+        bool is_scheduled;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Strand*> strands;
+    };
+
+    void run(std::size_t index);
+
+    /**
+     * Puts the strand on the queue of the given worker.
+     */
+    void schedule(Strand*, std::size_t index);
+
+    /**
+     * @return A strand from the queue of the given worker or, failing that,
+     * from the queue of another worker; a null pointer if all queues are
+     * empty
+     */
+    Strand* next_strand(std::size_t index);
+
+    /**
+     * Runs the tasks queued in the strand and schedules the strand again if
+     * more tasks were added meanwhile.
+     */
+    void run_strand(Strand*, std::size_t index, std::deque<Task>& tasks);
+
+    void finish_tasks(std::size_t n);
+
+    const ExceptionHandler exception_handler_;
+
+    std::vector<Strand> strands_;
+    std::vector<Worker> workers_;
+
+    // protects the sleeping workers and `stopping_`
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable idle_;
+    bool stopping_;
+
+    // the number of strands in the queues of the workers
+    std::atomic<std::size_t> num_queued_;
+    std::atomic<std::size_t> num_sleeping_;
+    // the number of tasks that were submitted and did not finish
+    std::atomic<std::size_t> num_pending_;
+
+    std::vector<std::thread> threads_;
+};
+}
+
+#endif
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <cstddef>
+
 #include <functional>
 #include <string>
 #include <memory>
@@ -34,12 +36,22 @@ namespace deepstream {
     public:
         typedef std::function<void(const std::string&&)> HandlerWithMsgFn;
         typedef std::function<void(const Buffer&&)> HandlerWithBufFn;
+        typedef std::function<void(char*, std::size_t)> HandlerWithFrameFn;
         typedef std::function<void()> HandlerFn;
 
+        /*
+         * The number of writable bytes a transport must reserve behind the
+         * data it hands to the frame handler. The receiver may overwrite
+         * these bytes, e.g., with the sentinels needed by the scanner.
+         */
+        enum { FRAME_PADDING = 2 };
+
         WSHandler()
             : on_open_(nullptr)
             , on_close_(nullptr)
             , on_message_(nullptr)
+            , on_frame_(nullptr)
+            , on_processed_(nullptr)
             , on_error_(nullptr)
             , state_(WSState::CLOSED)
         {}
@@ -59,6 +71,38 @@ namespace deepstream {
         // The frame should always be sent as FRAME_TEXT.
         virtual bool send(const Buffer&) = 0;
 
+        // Sends the concatenation of the given segments as a single frame.
+        //
+        // Transports that can write the segments directly, e.g., with
+        // writev(2), should override this method. By default, the segments
+        // are copied into a reused buffer which is handed to send() above.
+        virtual bool send_segments(const BufferView* segments, std::size_t num_segments)
+        {
+            // take the storage so that nested calls (a transport may
+            // receive and dispatch messages while sending) do not modify it
+            Buffer buffer;
+            buffer.swap(send_buffer_);
+            buffer.clear();
+
+            for (std::size_t i = 0; i < num_segments; ++i)
+                buffer.insert(buffer.end(), segments[i].cbegin(), segments[i].cend());
+
+            bool ret = send(buffer);
+
+            if (buffer.capacity() > send_buffer_.capacity())
+                send_buffer_.swap(buffer);
+
+            return ret;
+        }
+
+        // Reads the received data and hands it to the message or frame
+        // handler without blocking.
+        virtual void process_messages() {}
+
+        // Returns a file descriptor that becomes readable when data was
+        // received, or -1 if the transport does not have one.
+        virtual int native_handle() const { return -1; }
+
         virtual void open() = 0;
 
         virtual void close() = 0;
@@ -89,6 +133,30 @@ namespace deepstream {
             on_message_ = std::unique_ptr<HandlerWithBufFn>(new HandlerWithBufFn(on_message));
         }
 
+        /*
+         * Set the callback for handling received data in place. If this
+         * callback is set, transports should prefer it over the message
+         * handler: the callback is invoked with a pointer into the receive
+         * buffer of the transport and the number of bytes received, and
+         * there must be at least FRAME_PADDING writable bytes behind the
+         * received data. The memory is only valid during the callback.
+         */
+        void on_frame(const HandlerWithFrameFn& on_frame)
+        {
+            on_frame_ = std::unique_ptr<HandlerWithFrameFn>(new HandlerWithFrameFn(on_frame));
+        }
+
+        /*
+         * Set the callback invoked by transports after all data received in
+         * one round of message processing was handed to the message or
+         * frame handler, e.g., at the end of `process_messages()`. The
+         * receiver may use it to send buffered outgoing messages.
+         */
+        void on_processed(const HandlerFn& on_processed)
+        {
+            on_processed_ = std::unique_ptr<HandlerFn>(new HandlerFn(on_processed));
+        }
+
         void on_error(const HandlerWithMsgFn& on_error)
         {
             on_error_ = std::unique_ptr<HandlerWithMsgFn>(new HandlerWithMsgFn(on_error));
@@ -104,8 +172,13 @@ namespace deepstream {
         std::unique_ptr<HandlerFn> on_open_;
         std::unique_ptr<HandlerFn> on_close_;
         std::unique_ptr<HandlerWithBufFn> on_message_;
+        std::unique_ptr<HandlerWithFrameFn> on_frame_;
+        std::unique_ptr<HandlerFn> on_processed_;
         std::unique_ptr<HandlerWithMsgFn> on_error_;
 
         WSState state_;
+
+    private:
+        Buffer send_buffer_;
     };
 }
@@ -0,0 +1,254 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <random>
+#include <string>
+
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/ws.hpp>
+
+struct addrinfo;
+
+namespace deepstream {
+
+    /*
+     * A WebSocket transport without Poco: the RFC 6455 framing is
+     * implemented on top of a non-blocking TCP socket watched by an epoll
+     * instance (Linux only).
+     *
+     * Nothing blocks except the name resolution in open(): the connection
+     * and the opening handshake are completed by process_messages(), which
+     * calls the open handler once the server accepted the upgrade. If the
+     * connection to a resolved address fails, the next address is tried.
+     * Received data is read into a buffer that grows with the size of the
+     * messages; fragmented messages are reassembled and only complete
+     * messages are handed to the frame or message handler. Outgoing frames
+     * are queued if the socket cannot take them and written as soon as it
+     * becomes writable again. Pings are answered automatically.
+     *
+     * Only the "ws" scheme is supported (no TLS).
+     */
+    class EpollWSHandler : public WSHandler {
+    public:
+        enum { DEFAULT_MAX_MESSAGE_SIZE = 64 * 1024 * 1024 };
+
+        explicit EpollWSHandler(std::size_t max_message_size = DEFAULT_MAX_MESSAGE_SIZE);
+        ~EpollWSHandler();
+
+        void process_messages() override;
+
+        /*
+         * returns the file descriptor of the epoll instance; it is readable
+         * while the socket is readable or while queued data can be written
+         */
+        int native_handle() const override;
+
+        std::string URI() const override;
+
+        void URI(std::string URI) override;
+
+        /*
+         * Queues a text frame; returns false if the connection is not open.
+         */
+        bool send(const Buffer&) override;
+
+        bool send_segments(const BufferView* segments, std::size_t num_segments) override;
+
+        void open() override;
+
+        void close() override;
+
+        void reconnect() override;
+
+        void shutdown() override;
+
+        /*
+         * returns the value of the Sec-WebSocket-Accept header field the
+         * server has to send for the given Sec-WebSocket-Key
+         */
+        static std::string accept_key(const std::string& key);
+
+        /*
+         * returns the number of bytes waiting to be written to the socket
+         */
+        std::size_t num_queued_bytes() const { return out_.size() - out_begin_; }
+
+    protected:
+        /*
+         * The socket I/O of the connection; a subclass may replace it once
+         * the opening handshake is complete (see UringWSHandler). Until
+         * then, the socket is watched by the epoll instance.
+         */
+
+        /*
+         * returns the pending EPOLL* events of the socket without blocking
+         */
+        virtual std::uint32_t poll_events();
+
+        /*
+         * Writes as much of the output queue as the socket takes.
+         * returns false if the connection failed
+         */
+        virtual bool write_queued();
+
+        /*
+         * Reads from the socket until it would block or until enough data
+         * for this round was read.
+         * returns false if the connection failed; `*p_eof` is set if the
+         * server closed the connection
+         */
+        virtual bool read_available(bool* p_eof);
+
+        /*
+         * Watches the socket for writability only while data is queued.
+         */
+        virtual void update_events();
+
+        virtual void close_socket();
+
+        /*
+         * Called when the server accepted the upgrade, before the open
+         * handler.
+         * returns false if the connection failed
+         */
+        virtual bool on_upgraded() { return true; }
+
+        /*
+         * returns a pointer to at least `size` bytes of free space behind
+         * the unparsed received data; commit_input() appends them
+         */
+        char* reserve_input(std::size_t size);
+
+        void commit_input(std::size_t size) { in_end_ += size; }
+
+        const char* queued_data() const { return out_.data() + out_begin_; }
+
+        /*
+         * Removes the given number of bytes from the front of the output
+         * queue.
+         */
+        void consume_queued(std::size_t size);
+
+        void fail(const std::string& what);
+
+        int epoll_fd() const { return epoll_fd_; }
+
+        int socket_fd() const { return socket_fd_; }
+
+    private:
+        enum class Phase {
+            IDLE,
+            CONNECTING,
+            HANDSHAKE,
+            OPEN
+        };
+
+        enum Opcode {
+            OP_CONTINUATION = 0x0,
+            OP_TEXT = 0x1,
+            OP_BINARY = 0x2,
+            OP_CLOSE = 0x8,
+            OP_PING = 0x9,
+            OP_PONG = 0xA
+        };
+
+        /*
+         * Appends a masked frame with the concatenated segments to the
+         * output queue.
+         */
+        void queue_frame(Opcode, const BufferView* segments, std::size_t num_segments);
+
+        /*
+         * Starts connecting to the remaining resolved addresses in turn
+         * until a connection attempt is under way; `error` is reported if
+         * no address is left.
+         * returns false if the connection failed
+         */
+        bool connect_next(int error);
+
+        /*
+         * Completes the connection attempt and sends the upgrade request;
+         * if the attempt failed, connecting to the next address is started.
+         * returns false if the connection is not established
+         */
+        bool finish_connect();
+
+        void free_addresses();
+
+        /*
+         * Parses the upgrade response once it was received completely.
+         * returns false if the server refused the upgrade
+         */
+        bool finish_handshake();
+
+        /*
+         * Parses the received frames; the payloads of complete messages are
+         * collected in `message_`. Parsing stops at a closing frame.
+         * returns false on protocol errors
+         */
+        bool parse_frames();
+
+        /*
+         * Hands the complete messages to the frame or message handler.
+         */
+        void dispatch();
+
+        /*
+         * Answers a closing frame and closes the connection.
+         */
+        void finish_close();
+
+        std::string uri_;
+        std::string host_;
+        std::string port_;
+        std::string path_;
+        const std::size_t max_message_size_;
+
+        int epoll_fd_;
+        int socket_fd_;
+        // the resolved addresses while connecting and the next one to try
+        addrinfo* addresses_;
+        addrinfo* next_address_;
+        Phase phase_;
+        bool is_writable_watched_;
+        std::string key_;
+
+        // the received bytes: [in_begin_, in_end_) are unparsed; the buffer
+        // only grows, it is never zero-filled again
+        Buffer in_;
+        std::size_t in_begin_;
+        std::size_t in_end_;
+        // the size of the incomplete frame at in_begin_, if known
+        std::size_t in_needed_;
+
+        // the payloads of the complete messages and of the fragments of an
+        // unfinished message
+        Buffer message_;
+        Buffer fragments_;
+        bool is_fragmented_;
+        bool is_close_received_;
+
+        // the frames to be written: [out_begin_, out_.size())
+        Buffer out_;
+        std::size_t out_begin_;
+
+        std::mt19937 mask_engine_;
+    };
+}
@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <cstddef>
+
 #include <functional>
+#include <memory>
 #include <string>
 #include <deepstream/core/ws.hpp>
 
@@ -26,13 +29,36 @@
 
 namespace deepstream {
 
+    /*
+     * Received frames are read into an arena that is reused by all calls to
+     * process_messages(). Before a frame is read, its header is peeked at
+     * and the arena grows to fit the frame; the arena is never zero-filled.
+     * After a frame larger than the high-water mark, the arena shrinks back
+     * to the mark, which is at least 16 KiB.
+     *
+     * The header of frames received over TLS cannot be peeked at. For these
+     * connections, the arena has room for the high-water mark plus a frame
+     * of the maximum size; frames are read while a frame of the maximum size
+     * still fits. The pages of the arena that were never written do not take
+     * up memory. Since the decrypted data buffered by OpenSSL does not make
+     * the socket readable, frames are read as long as the socket reports
+     * buffered data.
+     */
     class PocoWSHandler : public WSHandler {
     public:
-
-        explicit PocoWSHandler();
+        enum {
+            DEFAULT_MAX_FRAME_SIZE = 64 * 1024 * 1024,
+            DEFAULT_HIGH_WATER_MARK = 1024 * 1024
+        };
+
+        explicit PocoWSHandler(
+            std::size_t max_frame_size = DEFAULT_MAX_FRAME_SIZE,
+            std::size_t high_water_mark = DEFAULT_HIGH_WATER_MARK);
         virtual ~PocoWSHandler();
 
-        void process_messages();
+        void process_messages() override;
+
+        int native_handle() const override;
 
         std::string URI() const override;
 
@@ -54,15 +80,32 @@ namespace deepstream {
 
     private:
         /*
-         * Read a websocket frame into a buffer at the given byte offset
+         * Read all available frames and hand them to the frame or message
+         * handler.
+         */
+        void receive_frames();
+
+        /*
+         * Read a websocket frame with a payload of at most `size` bytes
          * returns the number of bytes read.
-         * Will not overflow buffer, but may lead to error state if there is
-         * insufficient space in buffer for the frame to be read.
          */
-        int read_frame(Buffer &, int offset);
+        int read_frame(char* data, std::size_t size);
 
         bool next_read_non_blocking();
 
+        /*
+         * Peeks at the header of the next frame; not possible over TLS.
+         * returns false if the header was not received completely
+         */
+        bool next_frame_size(std::size_t* p_size);
+
+        /*
+         * Grows the arena to at least `size` bytes keeping the first `used`
+         * bytes.
+         * returns false if the memory could not be allocated
+         */
+        bool reserve_arena(std::size_t size, std::size_t used);
+
         void state(const WSState);
 
         Poco::URI uri_;
@@ -71,5 +114,10 @@ namespace deepstream {
         std::unique_ptr<Poco::Net::HTTPResponse> response_;
         std::unique_ptr<Poco::Net::WebSocket> websocket_;
 
+        const std::size_t max_frame_size_;
+        const std::size_t high_water_mark_;
+        std::unique_ptr<char[]> arena_;
+        std::size_t arena_size_;
+
     };
 }
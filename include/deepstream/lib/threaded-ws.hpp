@@ -0,0 +1,222 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/spsc_ring.hpp>
+#include <deepstream/core/ws.hpp>
+
+namespace deepstream {
+
+    /*
+     * A file descriptor that can be made readable from another thread: an
+     * eventfd on Linux, a pipe elsewhere.
+     */
+    class Notifier {
+    public:
+        Notifier();
+        ~Notifier();
+
+        Notifier(const Notifier&) = delete;
+        Notifier& operator=(const Notifier&) = delete;
+
+        /*
+         * Makes the file descriptor readable; may be called by any thread.
+         */
+        void notify();
+
+        /*
+         * Makes the file descriptor unreadable again.
+         */
+        void clear();
+
+        /*
+         * Blocks until the file descriptor is readable or the timeout
+         * passed; a negative timeout blocks indefinitely.
+         * returns true if the file descriptor is readable
+         */
+        bool wait(std::chrono::milliseconds timeout) const;
+
+        int native_handle() const { return read_fd_; }
+
+    private:
+        int read_fd_;
+        int write_fd_;
+    };
+
+    /*
+     * This class runs a transport, e.g., a PocoWSHandler, on a background
+     * I/O thread.
+     *
+     * The I/O thread owns the transport: it opens and closes the socket,
+     * reads frames as soon as they arrive, and writes the outgoing frames.
+     * The application thread uses this handler like any other transport:
+     * frames travel from the I/O thread to the application thread over one
+     * single-producer/single-consumer ring, outgoing frames and commands
+     * over a second ring. The buffers circulate between the threads so
+     * there are no allocations in the steady state.
+     *
+     * process_messages() does not block; it hands the frames received so
+     * far to the frame or message handler on the calling thread. Instead of
+     * polling, the application may block in wait() or watch native_handle(),
+     * which becomes readable when frames are received.
+     *
+     * Opening, closing, and sending are asynchronous: send() returns true
+     * if the frame was queued while the connection was open, failures are
+     * reported through the error handler. The transport is driven from
+     * open() until it reports the outcome, thus transports that connect in
+     * process_messages(), e.g., an EpollWSHandler, are supported.
+     *
+     * The transport must not be used by other threads after it was handed
+     * to this class.
+     */
+    class ThreadedWSHandler : public WSHandler {
+    public:
+        enum { DEFAULT_RING_CAPACITY = 1024 };
+
+        explicit ThreadedWSHandler(WSHandler &transport,
+            std::size_t ring_capacity = DEFAULT_RING_CAPACITY);
+
+        /*
+         * Stops the I/O thread; the transport is not closed.
+         */
+        ~ThreadedWSHandler();
+
+        void process_messages() override;
+
+        /*
+         * Blocks until frames were received, wake() was called, or the
+         * timeout passed; a negative timeout blocks indefinitely.
+         * returns true if there is work for process_messages()
+         */
+        bool wait(std::chrono::milliseconds timeout);
+
+        /*
+         * Makes wait() return and native_handle() readable so that the
+         * application thread calls process_messages(), e.g., because other
+         * threads emitted events. May be called by any thread; the
+         * notifier is written only once until the next process_messages().
+         */
+        void wake();
+
+        /*
+         * returns a file descriptor that is readable while there may be
+         * work for process_messages()
+         */
+        int native_handle() const override;
+
+        std::string URI() const override;
+
+        void URI(std::string URI) override;
+
+        bool send(const Buffer&) override;
+
+        bool send_segments(const BufferView* segments, std::size_t num_segments) override;
+
+        void open() override;
+
+        void close() override;
+
+        void reconnect() override;
+
+        void shutdown() override;
+
+    private:
+        /*
+         * Events passed from the I/O thread to the application thread; the
+         * data of a frame is followed by FRAME_PADDING bytes.
+         */
+        struct IOEvent {
+            enum Type { OPEN, CLOSE, ERROR, FRAME };
+
+            Type type;
+            Buffer data;
+            std::size_t size;
+        };
+
+        /*
+         * Commands passed from the application thread to the I/O thread.
+         */
+        struct IOCommand {
+            enum Type { SEND, SET_URI, OPEN, CLOSE, RECONNECT, SHUTDOWN, STOP };
+
+            Type type;
+            Buffer data;
+        };
+
+        void command(IOCommand::Type, const char* data = nullptr, std::size_t size = 0);
+
+        void push_command(IOCommand &);
+
+        void run();
+
+        /*
+         * Executes the queued commands on the I/O thread.
+         * returns false if the thread shall stop
+         */
+        bool execute_commands();
+
+        void push_event(IOEvent::Type, const char* data, std::size_t size);
+
+        /*
+         * Waits on the I/O thread for received data or commands.
+         */
+        void wait_for_io();
+
+        /*
+         * returns true if the I/O thread must call the process_messages()
+         * method of the transport
+         */
+        bool is_transport_active();
+
+        WSHandler &transport_;
+        std::string uri_;
+
+        SpscRing<IOEvent> events_;
+        SpscRing<IOCommand> commands_;
+
+        // the objects given to the rings in exchange for the next element
+        IOEvent event_;
+        IOCommand command_;
+        IOEvent io_event_;
+        IOCommand io_command_;
+
+        Notifier events_notifier_;
+        Notifier commands_notifier_;
+
+        // set by the I/O thread before it blocks; the application thread
+        // notifies it only in this case
+        std::atomic<bool> io_waiting_;
+        // true if events were pushed since the application thread was
+        // notified; used by the I/O thread only
+        bool events_pushed_;
+        // true from opening the transport until it reported the outcome;
+        // used by the I/O thread only
+        bool io_connecting_;
+        std::atomic<bool> stopping_;
+        // set by wake() until the next process_messages()
+        std::atomic<bool> wake_pending_;
+
+        std::thread thread_;
+    };
+}
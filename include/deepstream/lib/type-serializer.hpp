@@ -1,7 +1,7 @@
 #ifndef DEEPSTREAM_LIB_TYPE_SERIALIZER_HPP
 #define DEEPSTREAM_LIB_TYPE_SERIALIZER_HPP
 
-#include <deepstream/core/buffer.hpp> // Buffer
+#include <deepstream/core/buffer.hpp> // Buffer, BufferView
 #include <deepstream/core/client.hpp> // PayloadType
 #include <deepstream/core/error_handler.hpp> // ErrorHandler
 #include <deepstream/lib/json.hpp> // nlohmann::json
@@ -81,7 +81,7 @@ public:
         }
     }
 
-    json to_json(const Buffer &buff, const std::size_t offset = 0)
+    json to_json(const BufferView &buff, const std::size_t offset = 0)
     {
         assert(offset <= buff.size());
         std::string str(buff.data() + offset, buff.size() - offset);
@@ -93,7 +93,7 @@ public:
         }
     }
 
-    json prefixed_to_json(const Buffer &buff)
+    json prefixed_to_json(const BufferView &buff)
     {
         if (buff.size() < 1) {
             error_handler_.on_error("Received unprefixed empty buffer");
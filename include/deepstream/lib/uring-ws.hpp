@@ -0,0 +1,176 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+#include <vector>
+
+#include <deepstream/lib/epoll-ws.hpp>
+
+struct io_uring_cqe;
+struct io_uring_sqe;
+
+namespace deepstream {
+
+    /*
+     * A WebSocket transport that performs the I/O of open connections with
+     * io_uring (Linux 6.0 or newer); connecting and the opening handshake
+     * are left to the EpollWSHandler.
+     *
+     * A single multishot receive request reports the received data for the
+     * whole connection. It picks its buffers from a ring of buffers that is
+     * registered with the kernel and the completions are reaped by
+     * process_messages() from shared memory, i.e., without a system call.
+     * The frames are parsed as soon as their data was reaped.
+     *
+     * There is at most one send request in flight. Frames queued meanwhile
+     * are coalesced in the output queue and written with one request once
+     * the previous one completed. The requests prepared during one call to
+     * process_messages() or send() are submitted with one system call.
+     *
+     * native_handle() still returns the epoll instance; it watches the
+     * io_uring instance while the connection is open.
+     *
+     * The constructor throws if io_uring is not available; use
+     * make_native_ws_handler() to fall back to the EpollWSHandler.
+     */
+    class UringWSHandler : public EpollWSHandler {
+    public:
+        enum {
+            NUM_RECEIVE_BUFFERS = 64,
+            RECEIVE_BUFFER_SIZE = 16 * 1024,
+            SEND_BUFFER_SIZE = 256 * 1024
+        };
+
+        /*
+         * throws std::system_error if the io_uring instance cannot be set up
+         */
+        explicit UringWSHandler(std::size_t max_message_size = DEFAULT_MAX_MESSAGE_SIZE);
+        ~UringWSHandler();
+
+        /*
+         * returns true if the kernel provides the io_uring features used by
+         * this class; the result is computed once
+         */
+        static bool is_supported();
+
+    protected:
+        std::uint32_t poll_events() override;
+
+        bool write_queued() override;
+
+        bool read_available(bool* p_eof) override;
+
+        void update_events() override;
+
+        void close_socket() override;
+
+        bool on_upgraded() override;
+
+    private:
+        enum Request {
+            RECEIVE = 1,
+            SEND = 2,
+            CANCEL = 3
+        };
+
+        void set_up();
+
+        void release();
+
+        /*
+         * returns a zeroed submission queue entry
+         */
+        io_uring_sqe* prepare(Request);
+
+        /*
+         * Submits the prepared requests.
+         * returns false and sets errno on failure
+         */
+        bool submit();
+
+        /*
+         * Handles the available completions.
+         * returns the EPOLL* events that occurred on the open connection
+         */
+        std::uint32_t reap_completions();
+
+        std::uint32_t complete(const io_uring_cqe&);
+
+        void prepare_receive();
+
+        void prepare_send();
+
+        /*
+         * Hands a receive buffer back to the kernel; the buffers are
+         * published by publish_buffers().
+         */
+        void recycle_buffer(unsigned id);
+
+        void publish_buffers();
+
+        int ring_fd_;
+        void* ring_;
+        std::size_t ring_size_;
+        io_uring_sqe* sqes_;
+        std::size_t sqes_size_;
+
+        unsigned* sq_head_;
+        unsigned* sq_tail_;
+        unsigned* sq_array_;
+        unsigned sq_mask_;
+        unsigned sq_entries_;
+        // the tail including the prepared entries
+        unsigned sq_local_tail_;
+        unsigned num_prepared_;
+
+        unsigned* cq_head_;
+        unsigned* cq_tail_;
+        unsigned cq_mask_;
+        io_uring_cqe* cqes_;
+
+        // the ring of provided receive buffers and the buffers
+        void* buffer_ring_;
+        char* receive_buffers_;
+        std::uint16_t buffer_ring_tail_;
+
+        // [send_begin_, send_end_) is being sent
+        std::vector<char> send_buffer_;
+        std::size_t send_begin_;
+        std::size_t send_end_;
+
+        // completions of requests of earlier connections are recognized by
+        // the generation in the user data
+        std::uint64_t generation_;
+        bool is_active_;
+        bool is_receiving_;
+        bool is_sending_;
+        bool is_eof_;
+        int receive_error_;
+        int send_error_;
+        std::size_t num_in_flight_;
+    };
+
+    /*
+     * returns an UringWSHandler if io_uring is supported and an
+     * EpollWSHandler otherwise
+     */
+    std::unique_ptr<EpollWSHandler> make_native_ws_handler(
+        std::size_t max_message_size = EpollWSHandler::DEFAULT_MAX_MESSAGE_SIZE);
+}
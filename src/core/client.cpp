@@ -34,9 +34,13 @@ namespace deepstream {
 
 Client::Client(const std::string &uri, WSHandler &ws_handler, ErrorHandler &error_handler)
     : p_connection_(new Connection(uri, ws_handler, error_handler, event, presence))
-    , subscription_counter_(0)
-    , event(std::bind(&Connection::send, p_connection_.get(), std::placeholders::_1), subscription_counter_)
-    , presence(std::bind(&Connection::send, p_connection_.get(), std::placeholders::_1), subscription_counter_)
+    , subscription_slots_()
+    , event(std::bind(&Connection::send, p_connection_.get(), std::placeholders::_1),
+            std::bind(&Connection::send_bulk, p_connection_.get(), std::placeholders::_1),
+            std::bind(&Connection::flush, p_connection_.get()),
+            std::bind(&Connection::send_serialized, p_connection_.get(), std::placeholders::_1),
+            subscription_slots_)
+    , presence(std::bind(&Connection::send, p_connection_.get(), std::placeholders::_1), subscription_slots_)
 {
 }
 
@@ -58,4 +62,41 @@ ConnectionState Client::get_connection_state() const
 {
     return p_connection_->state();
 }
+
+bool Client::process_messages(const ProcessingBudget& budget)
+{
+    return p_connection_->process_messages(budget);
+}
+
+bool Client::has_pending_messages() const
+{
+    return p_connection_->has_backlog();
+}
+
+void Client::heartbeat_timeout(std::chrono::milliseconds timeout)
+{
+    p_connection_->heartbeat_timeout(timeout);
+}
+
+bool Client::next_timer_deadline(std::chrono::steady_clock::time_point* p_deadline) const
+{
+    return p_connection_->next_timer_deadline(p_deadline);
+}
+
+void Client::batching(std::size_t max_size, std::chrono::milliseconds max_delay)
+{
+    p_connection_->batching(max_size, max_delay);
+}
+
+bool Client::flush()
+{
+    event.drain_emits_();
+    return p_connection_->flush();
+}
+
+void Client::executor(Executor* p_executor)
+{
+    event.executor(p_executor);
+    presence.executor(p_executor);
+}
 }
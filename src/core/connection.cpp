@@ -23,6 +23,7 @@
 #include "connection.hpp"
 #include "message.hpp"
 #include "message_builder.hpp"
+#include "scope_guard.hpp"
 #include "use.hpp"
 #include <deepstream/core/buffer.hpp>
 #include <deepstream/core/client.hpp>
@@ -52,6 +53,21 @@ namespace deepstream {
         , presence_(presence)
         , deliberate_close_(false)
         , reconnection_attempt_(0)
+        , dispatching_(false)
+        , is_budgeted_(false)
+        , num_dispatched_(0)
+        , num_dispatched_bytes_(0)
+        , backlog_begin_(0)
+        , dispatching_backlog_(false)
+        , backlog_stopped_(false)
+        , backlog_chunk_begin_(0)
+        , timers_(std::chrono::milliseconds(TIMER_RESOLUTION_MS), NUM_TIMER_SLOTS,
+            std::chrono::steady_clock::now())
+        , heartbeat_timeout_(std::chrono::steady_clock::duration::zero())
+        , heartbeat_timer_(0)
+        , is_data_received_(false)
+        , batch_max_size_(0)
+        , batch_max_delay_(std::chrono::steady_clock::duration::zero())
     {
         assert(ws_handler.state() == WSState::CLOSED);
 
@@ -59,9 +75,11 @@ namespace deepstream {
 
         using namespace std::placeholders;
         ws_handler.on_message(std::bind(&Connection::on_message, this, _1));
+        ws_handler.on_frame(std::bind(&Connection::on_frame, this, _1, _2));
         ws_handler.on_error(std::bind(&Connection::on_error, this, _1));
         ws_handler.on_open(std::bind(&Connection::on_open, this));
         ws_handler.on_close(std::bind(&Connection::on_close, this));
+        ws_handler.on_processed(std::bind(&Connection::on_processed, this));
 
         ws_handler.open();
     }
@@ -120,52 +138,281 @@ namespace deepstream {
 
     void Connection::on_message(const Buffer &&raw_message)
     {
-        Buffer buffer(raw_message.size() + 2, 0);
+        is_data_received_ = true;
+
+        // the handler did not reserve any space behind the message
+        Buffer buffer(raw_message.size() + WSHandler::FRAME_PADDING);
         std::copy(raw_message.cbegin(), raw_message.cend(), buffer.begin());
 
-        auto parser_result = parser::execute(buffer.data(), buffer.size());
-        const parser::ErrorList& errors = parser_result.second;
+        on_frame(buffer.data(), raw_message.size());
+    }
 
-        for (auto it = errors.cbegin(); it != errors.cend(); ++it) {
-            const parser::Error &error = *it;
-            std::stringstream error_message;
-            error_message << "parser error: " << error << " \""
-                << Message::to_human_readable(raw_message) << "\"";
-            error_handler_.on_error(error_message.str());
+    void Connection::on_frame(char *data, std::size_t size)
+    {
+        assert(data);
+
+        is_data_received_ = true;
+
+        if (dispatching_) {
+            deferred_frames_.emplace_back(data, data + size);
+            return;
         }
 
-        parser::MessageList parsed_messages(std::move(parser_result.first));
+        dispatching_ = true;
+        DEEPSTREAM_ON_EXIT([this]() { this->dispatching_ = false; });
+
+        // older messages go first
+        dispatch_backlog();
+        parse_frame(data, size);
+        parse_deferred_frames();
+    }
+
+    void Connection::parse_deferred_frames()
+    {
+        assert(dispatching_);
+
+        while (!deferred_frames_.empty()) {
+            Buffer frame(std::move(deferred_frames_.front()));
+            deferred_frames_.pop_front();
 
-        for (auto it = parsed_messages.cbegin(); it != parsed_messages.cend(); ++it) {
-            const Message &parsed_message = *it;
-            DEBUG_MSG("Message received: " << parsed_message.header());
+            const std::size_t frame_size = frame.size();
+            frame.resize(frame_size + WSHandler::FRAME_PADDING);
+
+            parse_frame(frame.data(), frame_size);
+        }
+    }
 
-            switch (parsed_message.topic()) {
-                case Topic::EVENT:
-                    event_.notify_(parsed_message);
-                    break;
+    void Connection::parse_frame(char *data, std::size_t size)
+    {
+        // The stream parses complete messages in place: the transport
+        // reserved space for the two null characters expected by the
+        // scanner so the parsed messages reference the receive buffer
+        // directly. Incomplete messages are kept until the rest arrives.
+        static_assert(WSHandler::FRAME_PADDING >= 2, "");
+
+        // messages are dispatched as soon as they are parsed
+        stream_.feed(data, size, *this);
+    }
 
-                case Topic::PRESENCE:
-                    presence_.notify_(parsed_message);
-                    break;
+    bool Connection::process_messages(const ProcessingBudget& budget)
+    {
+        is_budgeted_ = budget.is_limited();
+        budget_ = budget;
+        num_dispatched_ = 0;
+        num_dispatched_bytes_ = 0;
 
-                case Topic::CONNECTION:
-                    handle_connection_response(parsed_message);
-                    break;
+        if (budget.max_duration > std::chrono::microseconds::zero())
+            deadline_ = std::chrono::steady_clock::now() + budget.max_duration;
 
-                case Topic::AUTH:
-                    handle_authentication_response(parsed_message);
-                    break;
+        DEEPSTREAM_ON_EXIT([this]() { this->is_budgeted_ = false; });
 
-                default:
-                    {
-                        std::stringstream error_message;
-                        error_message << "unsolicited message: " << parsed_message.header();
-                        error_handler_.on_error(error_message.str());
-                        assert(0);
-                    }
+        if (has_backlog() && !dispatching_) {
+            dispatching_ = true;
+            DEEPSTREAM_ON_EXIT([this]() { this->dispatching_ = false; });
+
+            dispatch_backlog();
+            parse_deferred_frames();
+        }
+
+        if (is_budget_spent()) {
+            // the socket is read by the next call but the collected
+            // outgoing messages are sent now; the timers wait, too, because
+            // received data may be waiting
+            on_processed();
+            return has_backlog();
+        }
+
+        ws_handler_.process_messages();
+
+        const auto now = std::chrono::steady_clock::now();
+
+        if (is_data_received_) {
+            last_received_ = now;
+            is_data_received_ = false;
+        }
+
+        timers_.advance(now);
+
+        return has_backlog();
+    }
+
+    void Connection::heartbeat_timeout(std::chrono::milliseconds timeout)
+    {
+        heartbeat_timeout_ = timeout;
+        timers_.cancel(heartbeat_timer_);
+        heartbeat_timer_ = 0;
+
+        if (state_ != ConnectionState::CLOSED && state_ != ConnectionState::RECONNECTING)
+            start_heartbeat_timer();
+    }
+
+    bool Connection::next_timer_deadline(std::chrono::steady_clock::time_point* p_deadline) const
+    {
+        return timers_.next_expiry(p_deadline);
+    }
+
+    void Connection::start_heartbeat_timer()
+    {
+        assert(!timers_.is_active(heartbeat_timer_));
+
+        if (heartbeat_timeout_ == std::chrono::steady_clock::duration::zero())
+            return;
+
+        heartbeat_timer_ = timers_.start(last_received_ + heartbeat_timeout_,
+            std::bind(&Connection::check_heartbeat, this));
+    }
+
+    void Connection::check_heartbeat()
+    {
+        heartbeat_timer_ = 0;
+
+        const auto now = std::chrono::steady_clock::now();
+
+        if (now < last_received_ + heartbeat_timeout_) {
+            start_heartbeat_timer();
+            return;
+        }
+
+        using std::chrono::duration_cast;
+        using std::chrono::milliseconds;
+
+        std::stringstream error_message;
+        error_message << "heartbeat timeout: nothing received for "
+            << duration_cast<milliseconds>(now - last_received_).count() << "ms";
+
+        if (last_ping_ != std::chrono::steady_clock::time_point())
+            error_message << ", last ping "
+                << duration_cast<milliseconds>(now - last_ping_).count() << "ms ago";
+
+        error_handler_.on_error(error_message.str());
+
+        // the WebSocket handler calls on_close() which reconnects
+        ws_handler_.close();
+    }
+
+    bool Connection::is_budget_spent() const
+    {
+        // every call dispatches at least one message
+        if (!is_budgeted_ || num_dispatched_ == 0)
+            return false;
+
+        if (budget_.max_messages > 0 && num_dispatched_ >= budget_.max_messages)
+            return true;
+
+        if (budget_.max_bytes > 0 && num_dispatched_bytes_ >= budget_.max_bytes)
+            return true;
+
+        return budget_.max_duration > std::chrono::microseconds::zero()
+            && std::chrono::steady_clock::now() >= deadline_;
+    }
+
+    void Connection::dispatch_backlog()
+    {
+        assert(dispatching_);
+
+        dispatching_backlog_ = true;
+        DEEPSTREAM_ON_EXIT([this]() { this->dispatching_backlog_ = false; });
+
+        while (has_backlog() && !is_budget_spent()) {
+            // The backlog holds complete messages only. A chunk ending at a
+            // record separator is copied (the scanner needs two null
+            // characters behind its input) so that the stopping point does
+            // not depend on the scanner; messages beyond the budget are
+            // skipped and parsed again by the next call.
+            const char* begin = backlog_.data() + backlog_begin_;
+            const char* end = backlog_.data() + backlog_.size();
+            const std::size_t min_size = std::min<std::size_t>(end - begin, BACKLOG_CHUNK_SIZE);
+            const char* chunk_end = std::find(begin + min_size - 1, end, ASCII_RECORD_SEPARATOR);
+            assert(chunk_end != end);
+            ++chunk_end;
+
+            backlog_chunk_.assign(begin, chunk_end);
+            backlog_chunk_.resize(backlog_chunk_.size() + 2, 0);
+            backlog_chunk_begin_ = backlog_begin_;
+            backlog_stopped_ = false;
+
+            backlog_context_.execute(backlog_chunk_.data(), backlog_chunk_.size(), *this);
+
+            // erroneous messages at the end of the chunk are skipped, too
+            if (!backlog_stopped_)
+                backlog_begin_ = backlog_chunk_begin_ + (chunk_end - begin);
+        }
+
+        if (!has_backlog()) {
+            backlog_.clear();
+            backlog_begin_ = 0;
+        } else if (2 * backlog_begin_ > backlog_.size()) {
+            backlog_.erase(backlog_.begin(), backlog_.begin() + backlog_begin_);
+            backlog_begin_ = 0;
+        }
+    }
+
+    void Connection::handle_error(const parser::Error &error)
+    {
+        // the error will be reported when the chunk is parsed again
+        if (dispatching_backlog_ && backlog_stopped_)
+            return;
+
+        const Buffer input = dispatching_backlog_
+            ? Buffer(backlog_chunk_.cbegin(), backlog_chunk_.cend() - 2)
+            : Buffer(stream_.data(), stream_.data() + stream_.size());
+        std::stringstream error_message;
+        error_message << "parser error: " << error << " \""
+            << Message::to_human_readable(input) << "\"";
+        error_handler_.on_error(error_message.str());
+    }
+
+    void Connection::handle_message(const parser::MessageProxy &parsed_message)
+    {
+        if (dispatching_backlog_) {
+            if (backlog_stopped_ || is_budget_spent()) {
+                backlog_stopped_ = true;
+                return;
             }
 
+            backlog_begin_ = backlog_chunk_begin_ + parsed_message.offset() + parsed_message.size();
+        } else if (has_backlog() || is_budget_spent()) {
+            // the parsed message references the receive buffer of the
+            // WebSocket handler; it is kept in serialized form
+            const char* p = parsed_message.base() + parsed_message.offset();
+            backlog_.insert(backlog_.end(), p, p + parsed_message.size());
+            return;
+        }
+
+        ++num_dispatched_;
+        num_dispatched_bytes_ += parsed_message.size();
+
+        dispatch_message(parsed_message);
+    }
+
+    void Connection::dispatch_message(const parser::MessageProxy &parsed_message)
+    {
+        DEBUG_MSG("Message received: " << parsed_message.header());
+
+        switch (parsed_message.topic()) {
+            case Topic::EVENT:
+                event_.notify_(parsed_message);
+                break;
+
+            case Topic::PRESENCE:
+                presence_.notify_(parsed_message);
+                break;
+
+            case Topic::CONNECTION:
+                handle_connection_response(parsed_message);
+                break;
+
+            case Topic::AUTH:
+                handle_authentication_response(parsed_message);
+                break;
+
+            default:
+                {
+                    std::stringstream error_message;
+                    error_message << "unsolicited message: " << parsed_message.header();
+                    error_handler_.on_error(error_message.str());
+                    assert(0);
+                }
         }
     }
 
@@ -184,6 +431,7 @@ namespace deepstream {
         switch(message.action()) {
             case Action::PING:
                 {
+                    last_ping_ = std::chrono::steady_clock::now();
                     const MessageBuilder pong(Topic::CONNECTION, Action::PONG);
                     send(pong);
                 } break;
@@ -205,7 +453,7 @@ namespace deepstream {
                         error_handler_.on_error("No URI given in connection redirect message");
                         break;
                     }
-                    const Buffer &uri_buff(message[0]);
+                    const BufferView uri_buff = message[0];
                     const std::string uri(uri_buff.cbegin(), uri_buff.cend());
                     DEBUG_MSG("redirecting to \"" << uri << "\"");
                     ws_handler_.URI(uri);
@@ -247,7 +495,7 @@ namespace deepstream {
                             Buffer null{ static_cast<char>(PayloadType::NULL_) };
                             login_callback(std::move(null));
                         } else {
-                            login_callback(message[0]);
+                            login_callback(Buffer(message[0]));
                         }
                     }
                 } break;
@@ -280,12 +528,30 @@ namespace deepstream {
 
     void Connection::on_open()
     {
+        // a new connection never continues a message of the previous one;
+        // undispatched messages of the previous connection are dropped, too,
+        // because they may belong to its handshake
+        stream_.reset();
+        backlog_.clear();
+        backlog_begin_ = 0;
+
+        for (Batch& batch : batches_)
+            batch.data.clear();
+
         reconnection_attempt_ = 0;
+
+        timers_.cancel(heartbeat_timer_);
+        last_received_ = std::chrono::steady_clock::now();
+        start_heartbeat_timer();
+
         state(ConnectionState::AWAIT_CONNECTION);
     }
 
     void Connection::on_close()
     {
+        timers_.cancel(heartbeat_timer_);
+        heartbeat_timer_ = 0;
+
         if (deliberate_close_ || reconnection_attempt_ >= 3) {
             state(ConnectionState::CLOSED);
             return;
@@ -295,11 +561,24 @@ namespace deepstream {
         ws_handler_.open();
     }
 
+    Connection::Lane Connection::lane(const Message& message)
+    {
+        if (message.topic() == Topic::CONNECTION || message.topic() == Topic::AUTH)
+            return CONTROL;
+
+        if (message.action() == Action::EVENT)
+            return EVENTS;
+
+        return SUBSCRIPTIONS;
+    }
+
     bool Connection::send(const Message& message)
     {
         DEBUG_MSG("--> Sending message: " << message.header());
 
-        if (message.topic() == Topic::CONNECTION || message.topic() == Topic::AUTH) {
+        const Lane message_lane = lane(message);
+
+        if (message_lane == CONTROL) {
             ConnectionState new_state = transition_outgoing(state_, message);
             assert(new_state != ConnectionState::ERROR);
 
@@ -310,9 +589,130 @@ namespace deepstream {
             state(new_state);
         } else if (state_ != ConnectionState::OPEN) {
             return false;
+        } else if (batch_max_size_ > 0) {
+            return send_batched(message, message_lane, batch_max_size_, batch_max_delay_);
+        }
+
+        // keep the order of messages within the lanes; control messages
+        // overtake the collected messages
+        flush_lanes(message_lane);
+
+        // the list is taken for the same reason as in WSHandler::send_segments()
+        Message::SegmentList segments;
+        segments.swap(segments_);
+        segments.clear();
+
+        message.to_segments(segments);
+        bool ret = ws_handler_.send_segments(segments.data(), segments.size());
+
+        if (segments.capacity() > segments_.capacity())
+            segments_.swap(segments);
+
+        return ret;
+    }
+
+    bool Connection::send_bulk(const Message& message)
+    {
+        DEBUG_MSG("--> Collecting message: " << message.header());
+
+        const Lane message_lane = lane(message);
+        assert(message_lane != CONTROL);
+
+        if (state_ != ConnectionState::OPEN)
+            return false;
+
+        // without batching, bulk messages wait for the next flush
+        const std::size_t max_size = std::max<std::size_t>(batch_max_size_, BULK_FRAME_SIZE);
+        const auto max_delay = (batch_max_size_ > 0)
+            ? batch_max_delay_ : std::chrono::steady_clock::duration::max();
+
+        return send_batched(message, message_lane, max_size, max_delay);
+    }
+
+    bool Connection::send_serialized(const BufferView& messages)
+    {
+        DEBUG_MSG("--> Sending " << messages.size() << " bytes of serialized messages");
+
+        if (state_ != ConnectionState::OPEN)
+            return false;
+
+        // keep the order of messages
+        if (!flush())
+            return false;
+
+        return ws_handler_.send_segments(&messages, 1);
+    }
+
+    bool Connection::send_batched(const Message& message, Lane message_lane,
+            std::size_t max_size, std::chrono::steady_clock::duration max_delay)
+    {
+        assert(message_lane != CONTROL);
+
+        const auto now = std::chrono::steady_clock::now();
+        Batch& batch = batches_[message_lane];
+
+        if (batch.data.empty())
+            batch.start = now;
+
+        segments_.clear();
+        message.to_segments(segments_);
+
+        for (const BufferView& segment : segments_)
+            batch.data.insert(batch.data.end(), segment.cbegin(), segment.cend());
+
+        if (batch.data.size() >= max_size || now - batch.start >= max_delay)
+            return flush_lanes(message_lane);
+
+        return true;
+    }
+
+    void Connection::batching(std::size_t max_size, std::chrono::milliseconds max_delay)
+    {
+        batch_max_size_ = max_size;
+        batch_max_delay_ = max_delay;
+
+        if (batch_max_size_ == 0)
+            flush();
+    }
+
+    void Connection::on_processed()
+    {
+        // the resubscription is sent in steps so that the received
+        // messages, e.g., pings, are handled in between
+        if (state_ == ConnectionState::OPEN)
+            event_.resubscribe_();
+
+        event_.drain_emits_();
+        flush();
+    }
+
+    bool Connection::flush()
+    {
+        return flush_lanes(EVENTS);
+    }
+
+    bool Connection::flush_lanes(Lane last)
+    {
+        for (int i = CONTROL; i <= last; ++i) {
+            if (batches_[i].data.empty())
+                continue;
+
+            // messages sent while the batch is sent (e.g., replies of
+            // message handlers) are collected in a new batch
+            Buffer data;
+            data.swap(batches_[i].data);
+
+            const bool ret = ws_handler_.send(data);
+
+            data.clear();
+            if (batches_[i].data.empty())
+                batches_[i].data.swap(data);
+
+            if (!ret)
+                return false;
         }
 
-        return ws_handler_.send(message.to_binary());
+        return true;
     }
 
     ConnectionState transition_incoming(const ConnectionState state, const Message& message)
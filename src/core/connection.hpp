@@ -18,21 +18,25 @@
 
 #include <cstdint>
 
+#include <chrono>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <string>
 
 #include "parser.hpp"
+#include "timer_wheel.hpp"
 #include <deepstream/core/client.hpp>
 
 namespace deepstream {
     struct Buffer;
+    struct BufferView;
     struct ErrorHandler;
     struct Event;
     struct Message;
     struct Presence;
 
-    struct Connection {
+    struct Connection : private parser::Handler {
 
         Connection() = delete;
 
@@ -50,19 +54,138 @@ namespace deepstream {
 
         ConnectionState state() const;
 
+        /**
+         * Outgoing messages are assigned to lanes in the order of their
+         * priority:
+         * - control messages (connection and authentication messages) are
+         *   never collected; they are sent right away, ahead of the
+         *   messages collected in the other lanes, e.g., a pong does not
+         *   wait for a batch of events,
+         * - subscription messages (subscriptions, listening, presence
+         *   queries),
+         * - events.
+         * Each lane collects its messages separately and flushing a lane
+         * first flushes the lanes with a higher priority.
+         */
+        enum Lane {
+            CONTROL,
+            SUBSCRIPTIONS,
+            EVENTS,
+            NUM_LANES
+        };
+
+        static Lane lane(const Message&);
+
         /**
          * This method serializes the given message and sends it as a
          * non-fragmented text frame to the server.
+         *
+         * If batching is enabled, messages other than control messages are
+         * collected in their lane and sent together.
          */
         bool send(const Message&);
 
+        /**
+         * With batching, outgoing messages are collected and sent in one
+         * WebSocket frame if
+         * - at least `max_size` bytes were collected,
+         * - a message is sent at least `max_delay` after the first
+         *   collected message,
+         * - the WebSocket handler finished processing received messages, or
+         * - flush() is called.
+         *
+         * A maximum size of zero disables batching (the default) and sends
+         * collected messages.
+         */
+        void batching(std::size_t max_size, std::chrono::milliseconds max_delay);
+
+        /**
+         * This method collects messages that are not urgent, e.g., bulk
+         * subscriptions, irrespective of the batching settings. The
+         * collected messages are sent when they fill a frame of
+         * `BULK_FRAME_SIZE` bytes (or the batch size, if it is larger) and on
+         * flush().
+         */
+        bool send_bulk(const Message&);
+
+        /**
+         * This method sends the given serialized messages in one frame
+         * after the collected messages, e.g., when the outbox of the event
+         * module is replayed.
+         */
+        bool send_serialized(const BufferView&);
+
+        /**
+         * This method sends all collected messages, one frame per lane in
+         * the order of the lane priorities.
+         */
+        bool flush();
+
+        /**
+         * This method dispatches the messages left over by the previous
+         * call and reads the WebSocket handler if the budget allows it.
+         * Messages received beyond the budget are copied to a backlog.
+         *
+         * @return `true` if the backlog is not empty
+         */
+        bool process_messages(const ProcessingBudget&);
+
+        bool has_backlog() const { return backlog_begin_ < backlog_.size(); }
+
+        /**
+         * If nothing was received for the given time, the connection is
+         * considered dead: it is closed and reopened right away. The check
+         * is driven by process_messages(); zero disables it.
+         */
+        void heartbeat_timeout(std::chrono::milliseconds);
+
+        /**
+         * @return `false` if no timer is active; otherwise, the time by
+         * which process_messages() should be called is stored
+         */
+        bool next_timer_deadline(std::chrono::steady_clock::time_point* p_deadline) const;
+
+        enum { BULK_FRAME_SIZE = 64 * 1024 };
+
+        /**
+         * The backlog is parsed in chunks of at least this size.
+         */
+        enum { BACKLOG_CHUNK_SIZE = 16 * 1024 };
+
+        /**
+         * The timer wheel turns once in about 25 seconds.
+         */
+        enum { TIMER_RESOLUTION_MS = 100, NUM_TIMER_SLOTS = 256 };
+
     private:
         void send_authentication_request();
 
+        bool send_batched(const Message&, Lane, std::size_t max_size,
+            std::chrono::steady_clock::duration max_delay);
+
+        /**
+         * Sends the collected messages of the lanes up to and including the
+         * given one.
+         */
+        bool flush_lanes(Lane last);
+
+        void on_processed();
+
+        void start_heartbeat_timer();
+        void check_heartbeat();
+
         void handle_connection_response(const Message &message);
         void handle_authentication_response(const Message &message);
 
         void on_message(const Buffer &&message);
+        void on_frame(char *data, std::size_t size);
+        void parse_frame(char *data, std::size_t size);
+        void parse_deferred_frames();
+        void dispatch_backlog();
+        bool is_budget_spent() const;
+        void handle_message(const parser::MessageProxy &message) override;
+        void dispatch_message(const parser::MessageProxy &message);
+        void handle_error(const parser::Error &error) override;
         void on_error(const std::string &&error);
         void on_open();
         void on_close();
@@ -85,6 +208,79 @@ namespace deepstream {
         bool deliberate_close_;
         int reconnection_attempt_;
 
+        /**
+         * The parser and its storage live as long as the connection so that
+         * receiving messages does not allocate memory in the steady state.
+         */
+        parser::Stream stream_;
+
+        /**
+         * Frames received while the messages of another frame are
+         * dispatched, e.g., because a message handler sent a message.
+         * The parser context is in use so these frames are parsed after
+         * the current one.
+         */
+        bool dispatching_;
+        std::deque<Buffer> deferred_frames_;
+
+        /**
+         * The budget of the running process_messages() call and the work
+         * done so far.
+         */
+        bool is_budgeted_;
+        ProcessingBudget budget_;
+        std::chrono::steady_clock::time_point deadline_;
+        std::size_t num_dispatched_;
+        std::size_t num_dispatched_bytes_;
+
+        /**
+         * The received messages that were not dispatched because the budget
+         * was spent; [backlog_begin_, backlog_.size()) is pending. The
+         * backlog is parsed again chunk by chunk with its own parser
+         * context; `backlog_chunk_begin_` is the position of the current
+         * chunk in the backlog.
+         */
+        Buffer backlog_;
+        std::size_t backlog_begin_;
+        bool dispatching_backlog_;
+        bool backlog_stopped_;
+        Buffer backlog_chunk_;
+        std::size_t backlog_chunk_begin_;
+        parser::Context backlog_context_;
+
+        /**
+         * The heartbeat check: the time the WebSocket handler last handed
+         * over data is taken at the end of process_messages() (the clock is
+         * not read for every frame) and the timer is restarted lazily when
+         * it expires.
+         */
+        TimerWheel timers_;
+        std::chrono::steady_clock::duration heartbeat_timeout_;
+        TimerWheel::TimerId heartbeat_timer_;
+        bool is_data_received_;
+        std::chrono::steady_clock::time_point last_received_;
+        std::chrono::steady_clock::time_point last_ping_;
+
+        /**
+         * The serialized message handed to the WebSocket handler; the
+         * storage is reused.
+         */
+        Message::SegmentList segments_;
+
+        std::size_t batch_max_size_;
+        std::chrono::steady_clock::duration batch_max_delay_;
+
+        struct Batch {
+            std::chrono::steady_clock::time_point start;
+            Buffer data;
+        };
+
+        /**
+         * The collected messages of every lane; the batch of the control
+         * lane stays empty.
+         */
+        Batch batches_[NUM_LANES];
+
         /**
          * Given the current client state and a message, return the next state
          * of the client's finite state machine.
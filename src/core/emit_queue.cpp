@@ -0,0 +1,159 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cassert>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include <deepstream/core/emit_queue.hpp>
+
+#include "message.hpp"
+
+namespace deepstream {
+
+namespace {
+    std::atomic<std::uint64_t> next_queue_id(0);
+}
+
+/**
+ * Every thread keeps the lanes it uses until it exits; it shares them with
+ * the queues because a queue may be destroyed before the thread exits. The
+ * ids of destroyed queues are never reused, thus stale entries are never
+ * matched.
+ */
+struct EmitQueue::LaneCache {
+    struct Entry {
+        std::uint64_t queue_id;
+        std::shared_ptr<Lane> lane;
+    };
+
+    ~LaneCache()
+    {
+        for (Entry& entry : entries)
+            entry.lane->state.store(EXITED, std::memory_order_release);
+    }
+
+    std::vector<Entry> entries;
+};
+
+thread_local EmitQueue::LaneCache EmitQueue::lane_cache_;
+
+EmitQueue::EmitQueue(std::size_t lane_capacity)
+    : id_(next_queue_id.fetch_add(1))
+    , lane_capacity_(lane_capacity)
+    , num_lanes_(0)
+    , next_lane_(0)
+{
+    for (std::atomic<Lane*>& lane : lanes_)
+        lane.store(nullptr, std::memory_order_relaxed);
+}
+
+bool EmitQueue::push(const BufferView& name, const BufferView& data)
+{
+    if (name.size() == 0)
+        throw std::invalid_argument("Empty event name");
+
+    Lane* p_lane = lane();
+
+    if (!p_lane)
+        return false;
+
+    Record& record = p_lane->record;
+    Buffer& message = record.message;
+    const BufferView header = Message::Header(Topic::EVENT, Action::EVENT).to_binary_view();
+
+    message.clear();
+    message.insert(message.end(), header.cbegin(), header.cend());
+    message.push_back(ASCII_UNIT_SEPARATOR);
+    record.name_offset = message.size();
+    record.name_size = name.size();
+    message.insert(message.end(), name.cbegin(), name.cend());
+    message.push_back(ASCII_UNIT_SEPARATOR);
+    record.data_offset = message.size();
+    record.data_size = data.size();
+    message.insert(message.end(), data.cbegin(), data.cend());
+    message.push_back(ASCII_RECORD_SEPARATOR);
+
+    return p_lane->ring.try_push(record);
+}
+
+std::size_t EmitQueue::drain(std::vector<Record>& records)
+{
+    const std::size_t num_lanes = num_lanes_.load(std::memory_order_acquire);
+    std::size_t n = 0;
+
+    if (num_lanes == 0)
+        return 0;
+
+    // start with another lane every time so that no producer is starved
+    for (std::size_t i = 0; i < num_lanes && n < records.size(); ++i) {
+        const std::size_t index = (next_lane_ + i) % num_lanes;
+        Lane* p_lane = lanes_[index].load(std::memory_order_acquire);
+        assert(p_lane);
+
+        const bool has_exited = p_lane->state.load(std::memory_order_acquire) == EXITED;
+
+        while (n < records.size() && p_lane->ring.try_pop(records[n]))
+            ++n;
+
+        if (has_exited && p_lane->ring.empty())
+            p_lane->state.store(FREE, std::memory_order_release);
+    }
+
+    next_lane_ = (next_lane_ + 1) % num_lanes;
+
+    return n;
+}
+
+EmitQueue::Lane* EmitQueue::lane()
+{
+    std::vector<LaneCache::Entry>& entries = lane_cache_.entries;
+
+    for (const LaneCache::Entry& entry : entries)
+        if (entry.queue_id == id_)
+            return entry.lane.get();
+
+    // forget the lanes of destroyed queues
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                      [](const LaneCache::Entry& entry) { return entry.lane.use_count() == 1; }),
+        entries.end());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (const std::shared_ptr<Lane>& lane : lane_storage_) {
+        if (lane->state.load(std::memory_order_acquire) == FREE) {
+            lane->state.store(ACTIVE, std::memory_order_relaxed);
+            entries.push_back(LaneCache::Entry{ id_, lane });
+            return lane.get();
+        }
+    }
+
+    const std::size_t num_lanes = num_lanes_.load(std::memory_order_relaxed);
+    if (num_lanes == MAX_LANES)
+        return nullptr;
+
+    lane_storage_.push_back(std::make_shared<Lane>(lane_capacity_));
+    const std::shared_ptr<Lane>& lane = lane_storage_.back();
+
+    lanes_[num_lanes].store(lane.get(), std::memory_order_release);
+    num_lanes_.store(num_lanes + 1, std::memory_order_release);
+
+    entries.push_back(LaneCache::Entry{ id_, lane });
+
+    return lane.get();
+}
+}
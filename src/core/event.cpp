@@ -18,23 +18,100 @@
 #include <cstdio>
 
 #include <algorithm>
+#include <functional>
+#include <memory>
 #include <stdexcept>
-#include <map>
+#include <utility>
 
 #include <deepstream/core/buffer.hpp>
 #include <deepstream/core/event.hpp>
+#include <deepstream/core/persistent_outbox.hpp>
 #include <deepstream/core/client.hpp>
 
 #include "message_builder.hpp"
+#include "parser.hpp"
 
 namespace deepstream {
 
-Event::Event(const SendFn& send, SubscriptionId &subscription_counter)
+const std::size_t Event::REPLAY_FRAME_SIZE;
+const std::size_t Event::EMIT_BATCH_SIZE;
+
+namespace {
+    /**
+     * The maximum number of batches sent by one call of `drain_emits_()`
+     * so that fast producers cannot hold up the connection thread.
+     */
+    const std::size_t MAX_EMIT_BATCHES = 16;
+
+    /**
+     * Notifies the subscribers of an event on the thread of an executor.
+     */
+    struct NotificationTask {
+        void operator()() const
+        {
+            for (const Event::SubscribeFn& callback : *p_callbacks)
+                callback(data);
+        }
+
+        std::shared_ptr<const Event::SubscriberList::Snapshot> p_callbacks;
+        Buffer data;
+    };
+}
+
+namespace {
+    /**
+     * Without a function for serialized messages, the outbox is replayed one
+     * message at a time: the message is parsed and sent as usual.
+     */
+    bool send_parsed(const Event::SendFn& send, const BufferView& message)
+    {
+        // the parser expects two trailing NUL characters
+        Buffer input(message);
+        input.push_back(0);
+        input.push_back(0);
+
+        const auto result = parser::execute(input.data(), input.size());
+        assert(result.first.size() == 1);
+        assert(result.second.empty());
+
+        return send(result.first.front());
+    }
+}
+
+Event::Event(const SendFn& send, SubscriptionSlots &subscription_slots)
+    : Event(send, send, []() { return true; }, subscription_slots)
+{
+}
+
+Event::Event(const SendFn& send, const SendFn& send_bulk, const FlushFn& flush,
+        SubscriptionSlots &subscription_slots)
+    : Event(send, send_bulk, flush,
+          std::bind(send_parsed, send, std::placeholders::_1), subscription_slots)
+{
+    max_replay_size_ = 1;
+}
+
+Event::Event(const SendFn& send, const SendFn& send_bulk, const FlushFn& flush,
+        const SendSerializedFn& send_serialized, SubscriptionSlots &subscription_slots)
     : send_(send)
-    , send_queue_()
-    , subscription_counter_(subscription_counter)
+    , send_bulk_(send_bulk)
+    , flush_(flush)
+    , send_serialized_(send_serialized)
+    , outbox_()
+    , p_persistent_outbox_(nullptr)
+    , p_executor_(nullptr)
+    , max_replay_size_(REPLAY_FRAME_SIZE)
+    , emit_records_(EMIT_BATCH_SIZE)
+    , subscription_slots_(subscription_slots)
+    , resubscription_step_size_(RESUBSCRIPTION_STEP_SIZE)
+    , is_resubscribing_(false)
+    , next_subscription_(0)
+    , next_listener_(0)
 {
     assert(send_);
+    assert(send_bulk_);
+    assert(flush_);
+    assert(send_serialized_);
 }
 
 Event::~Event()
@@ -46,45 +123,160 @@ void Event::emit(const Name& name, const Buffer& buffer)
     if (name.empty())
         throw std::invalid_argument("Empty event name");
 
+    // the arguments are not copied unless the message is queued
     MessageBuilder evt(Topic::EVENT, Action::EVENT);
-    evt.add_argument(name);
-    evt.add_argument(buffer);
+    evt.add_argument_reference(name);
+    evt.add_argument_reference(buffer);
 
-    if (!send_(evt)) {
-      // sending failed, or the connection is down
-      send_queue_.emplace(new MessageBuilder(evt));
+    if (is_holding_emits() || !send_(evt)) {
+        // sending failed, the connection is down, or older events wait
+        keep(evt);
     }
 
-    if (subscriber_map_.find(name) == subscriber_map_.end())
+    if (!subscribers(name))
         return;
 
     notify_(evt);
 }
 
+void Event::keep(const Message& message)
+{
+    if (p_persistent_outbox_)
+        p_persistent_outbox_->push(message);
+    else
+        outbox_.push(message);
+}
+
+bool Event::is_holding_emits() const
+{
+    return is_resubscribing_ || !outbox_.empty()
+        || (p_persistent_outbox_ && !p_persistent_outbox_->empty());
+}
+
+void Event::replay_outbox()
+{
+    if (p_persistent_outbox_
+        && !p_persistent_outbox_->replay(send_serialized_, max_replay_size_))
+        return;
+
+    outbox_.replay(send_serialized_, max_replay_size_);
+}
+
+bool Event::emit_async(const Name& name, const Buffer& buffer)
+{
+    const bool ok = emit_queue_.push(name, buffer);
+
+    if (ok && on_emit_async_)
+        on_emit_async_();
+
+    return ok;
+}
+
+void Event::on_emit_async(const std::function<void()>& callback)
+{
+    on_emit_async_ = callback;
+}
+
+bool Event::drain_emits_()
+{
+    for (std::size_t i = 0; i < MAX_EMIT_BATCHES; ++i) {
+        const std::size_t n = emit_queue_.drain(emit_records_);
+        send_emits(n);
+
+        if (n < emit_records_.size())
+            return true;
+    }
+
+    return false;
+}
+
+void Event::send_emits(std::size_t n)
+{
+    assert(n <= emit_records_.size());
+
+    const bool is_holding = is_holding_emits();
+
+    // the serialized events are concatenated into frames of at most
+    // `max_replay_size_` bytes; a larger event is sent in a frame of its own
+    for (std::size_t begin = 0; begin < n;) {
+        std::size_t end = begin;
+
+        emit_frame_.clear();
+        do {
+            const Buffer& message = emit_records_[end].message;
+            emit_frame_.insert(emit_frame_.end(), message.cbegin(), message.cend());
+            ++end;
+        } while (end < n
+            && emit_frame_.size() + emit_records_[end].message.size() <= max_replay_size_);
+
+        if (is_holding || !send_serialized_(emit_frame_)) {
+            for (std::size_t i = begin; i < end; ++i) {
+                MessageBuilder evt(Topic::EVENT, Action::EVENT);
+                evt.add_argument_reference(emit_records_[i].name());
+                evt.add_argument_reference(emit_records_[i].data());
+                keep(evt);
+            }
+        }
+
+        begin = end;
+    }
+
+    for (std::size_t i = 0; i < n; ++i) {
+        const EmitQueue::Record& record = emit_records_[i];
+
+        if (!subscribers(record.name()))
+            continue;
+
+        MessageBuilder evt(Topic::EVENT, Action::EVENT);
+        evt.add_argument_reference(record.name());
+        evt.add_argument_reference(record.data());
+        notify_(evt);
+    }
+}
+
 SubscriptionId Event::subscribe(const Name& name, const SubscribeFn callback)
+{
+    return subscribe(name, callback, send_);
+}
+
+std::vector<SubscriptionId> Event::subscribe_many(const std::vector<Name>& names,
+        const SubscribeFn callback)
+{
+    std::vector<SubscriptionId> subscription_ids;
+    subscription_ids.reserve(names.size());
+
+    for (const Name& name : names)
+        subscription_ids.push_back(subscribe(name, callback, send_bulk_));
+
+    flush_();
+
+    return subscription_ids;
+}
+
+SubscriptionId Event::subscribe(const Name& name, const SubscribeFn callback,
+        const SendFn& send)
 {
     if (name.empty()) {
         throw std::invalid_argument("Empty event subscription pattern");
     }
 
-    const SubscriptionId subscription_id = subscription_counter_++;
-    const auto insert_result =
-        subscribe_fn_map_.insert(std::make_pair(subscription_id, callback));
-    assert(insert_result.second);
+    const NameTable::Id name_id = subscription_names_.intern(name);
+    while (name_id >= subscriber_lists_.size())
+        subscriber_lists_.emplace_back(subscription_slots_);
 
-    SubscriberList &subscribers = subscriber_map_[name];
+    SubscriberList &subscribers = subscriber_lists_[name_id];
 
     if (subscribers.empty()) {
+        // the name must not be sent again by a pending resubscription
+        if (name_id < pending_subscriptions_.size())
+            pending_subscriptions_[name_id] = false;
+
         MessageBuilder message(Topic::EVENT, Action::SUBSCRIBE);
-        message.add_argument(name);
-        send_(message);
+        message.add_argument_reference(name);
+        send(message);
     }
 
-    assert(std::find(subscribers.cbegin(), subscribers.cend(), subscription_id)
-            == subscribers.end());
-    subscribers.push_back(subscription_id);
-
-    return subscription_id;
+    return subscribers.add(callback);
 }
 
 /**
@@ -92,27 +284,28 @@ SubscriptionId Event::subscribe(const Name& name, const SubscribeFn callback)
  */
 void Event::unsubscribe(const Name& name)
 {
-    SubscriberMap::iterator sub_map_it = subscriber_map_.find(name);
+    unsubscribe(name, send_);
+}
 
-    if (sub_map_it == subscriber_map_.end()) {
-        // TODO: warn, subscription did not exist
-        return;
-    }
+void Event::unsubscribe_many(const std::vector<Name>& names)
+{
+    for (const Name& name : names)
+        unsubscribe(name, send_bulk_);
 
-    assert(sub_map_it->first == name);
-    SubscriberList &subscribers = sub_map_it->second;
-    for (SubscriptionId id: subscribers) {
-        const size_t removed = subscribe_fn_map_.erase(id);
-        assert(removed == 1);
-    }
+    flush_();
+}
 
-    subscriber_map_.erase(sub_map_it);
+void Event::unsubscribe(const Name& name, const SendFn& send)
+{
+    const NameTable::Id name_id = subscription_names_.find(name);
 
-    if (subscriber_map_.empty()) {
-        MessageBuilder message(Topic::EVENT, Action::UNSUBSCRIBE);
-        message.add_argument(name);
-        send_(message);
+    if (name_id == NameTable::NONE || subscriber_lists_[name_id].empty()) {
+        // TODO: warn, subscription did not exist
+        return;
     }
+
+    subscriber_lists_[name_id].clear();
+    drop_subscription(name_id, name, send);
 }
 
 /**
@@ -120,44 +313,60 @@ void Event::unsubscribe(const Name& name)
  */
 void Event::unsubscribe(const Name& name, const SubscriptionId subscription_id)
 {
-    const auto sub_map_it = subscriber_map_.find(name);
+    const NameTable::Id name_id = subscription_names_.find(name);
 
-    if (sub_map_it == subscriber_map_.end())
+    if (name_id == NameTable::NONE)
         return;
 
-    assert(sub_map_it->first == name);
-    SubscriberList &subscribers = sub_map_it->second;
+    SubscriberList &subscribers = subscriber_lists_[name_id];
 
-    const auto sub_it = std::find(subscribers.begin(), subscribers.end(), subscription_id);
-    if (sub_it == subscribers.end()) {
-        assert(subscribe_fn_map_.find(subscription_id) == subscribe_fn_map_.end());
+    if (!subscribers.remove(subscription_id)) {
         // TODO: warn, subscription did not exist
         return;
     }
-    subscribers.erase(sub_it);
-
-    // delete the callback
-    const size_t removed = subscribe_fn_map_.erase(subscription_id);
-    assert(removed == 1);
 
     if (subscribers.empty()) {
-        unsubscribe(name);
+        drop_subscription(name_id, name, send_);
     }
 }
 
+void Event::drop_subscription(NameTable::Id name_id, const Name& name,
+        const SendFn& send)
+{
+    assert(subscription_names_.contains(name_id));
+    assert(subscriber_lists_[name_id].empty());
+
+    if (name_id < pending_subscriptions_.size())
+        pending_subscriptions_[name_id] = false;
+
+    // a list that is notifying its subscribers must stay in place; the name
+    // is released when the notification is finished
+    if (!subscriber_lists_[name_id].is_notifying())
+        subscription_names_.erase(name_id);
+
+    MessageBuilder message(Topic::EVENT, Action::UNSUBSCRIBE);
+    message.add_argument_reference(name);
+    send(message);
+}
+
 void Event::listen(const Name& pattern, const ListenFn callback)
 {
     if (pattern.empty())
         throw std::invalid_argument("Cannot listen for empty patterns");
 
-    auto listener_it = listener_map_.find(pattern);
-
-    if (listener_it != listener_map_.end()) {
+    if (listener_patterns_.find(pattern) != NameTable::NONE) {
         // TODO: error, there is already a listener!
         return;
     }
 
-    listener_map_[pattern] = callback;
+    const NameTable::Id pattern_id = listener_patterns_.intern(pattern);
+    if (pattern_id >= listeners_.size())
+        listeners_.resize(listener_patterns_.id_limit());
+
+    listeners_[pattern_id] = callback;
+
+    if (pattern_id < pending_listeners_.size())
+        pending_listeners_[pattern_id] = false;
 
     MessageBuilder message(Topic::EVENT, Action::LISTEN);
     message.add_argument(pattern);
@@ -166,14 +375,18 @@ void Event::listen(const Name& pattern, const ListenFn callback)
 
 void Event::unlisten(const Name& pattern)
 {
-    auto listen_map_it = listener_map_.find(pattern);
+    const NameTable::Id pattern_id = listener_patterns_.find(pattern);
 
-    if (listen_map_it == listener_map_.end()) {
+    if (pattern_id == NameTable::NONE) {
         //TODO: warn, not currently listening to the given pattern
         return;
     }
 
-    listener_map_.erase(listen_map_it);
+    listeners_[pattern_id] = nullptr;
+    listener_patterns_.erase(pattern_id);
+
+    if (pattern_id < pending_listeners_.size())
+        pending_listeners_[pattern_id] = false;
 
     MessageBuilder message(Topic::EVENT, Action::UNLISTEN);
     message.add_argument(pattern);
@@ -218,33 +431,31 @@ void Event::notify_subscribers_(const Message& message)
     if (message.is_ack())
         return;
 
-    Name name = message[0];
-    const Buffer& data = message[1];
+    const BufferView name = message[0];
+    const BufferView data = message[1];
 
-    SubscriberMap::iterator it = subscriber_map_.find(name);
+    const NameTable::Id name_id = subscription_names_.find(name);
 
-    if (it == subscriber_map_.end()) {
-        name.push_back(0);
-
-        std::fprintf(stderr, "E|EVT: no subscriber named '%s'\n", name.data());
+    if (name_id == NameTable::NONE || subscriber_lists_[name_id].empty()) {
+        std::fprintf(stderr, "E|EVT: no subscriber named '%.*s'\n",
+            static_cast<int>(name.size()), name.data());
         return;
     }
 
-    assert(it->first == name);
-
-    // Copying the list of subscribers is a necessity here because the callbacks
-    // may unsubscribe during their execution and modifications of a subscriber
-    // list may invalidate iterations and ranges.
-    SubscriberList subscribers = it->second;
+    if (p_executor_) {
+        NotificationTask task{ subscriber_lists_[name_id].snapshot(), Buffer(data) };
+        p_executor_->execute(subscription_names_.hash(name_id), std::move(task));
+        return;
+    }
 
-    // The iterator `it` may be invalid after executing a callback because the
-    // list of subscribers for this `name` may have been erased.
-    it = subscriber_map_.end();
+    // The callbacks may subscribe and unsubscribe during their execution;
+    // the list tolerates this without being copied and the deque keeps it in
+    // place when other names are subscribed.
+    SubscriberList &subscribers = subscriber_lists_[name_id];
+    subscribers.notify(data);
 
-    for (const SubscriptionId& id : subscribers) {
-        const SubscribeFn &callback = subscribe_fn_map_[id];
-        callback(data);
-    }
+    if (subscribers.empty() && !subscribers.is_notifying())
+        subscription_names_.erase(name_id);
 }
 
 void Event::notify_listeners_(const Message& message)
@@ -253,26 +464,23 @@ void Event::notify_listeners_(const Message& message)
     assert(!message.is_ack());
     assert(message.num_arguments() == 2);
 
-    const Name& pattern = message[0];
-    const Name& match = message[1];
+    const BufferView pattern = message[0];
+    const Name match(message[1]);
 
     bool is_subscribed = message.action() == Action::SUBSCRIPTION_FOR_PATTERN_FOUND;
 
-    ListenerMap::iterator it = listener_map_.find(pattern);
+    const NameTable::Id pattern_id = listener_patterns_.find(pattern);
 
-    if (it == listener_map_.end()) {
-        Name pattern_str(pattern);
-        pattern_str.push_back(0);
-
-        std::fprintf(stderr, "%s: no listener for pattern '%s'\n",
-            message.header().to_string(), pattern_str.data());
+    if (pattern_id == NameTable::NONE) {
+        std::fprintf(stderr, "%s: no listener for pattern '%.*s'\n",
+            message.header().to_string(),
+            static_cast<int>(pattern.size()), pattern.data());
 
         return;
     }
 
-    assert(it->first == pattern);
-
-    ListenFn callback = it->second;
+    // the callback may stop listening during its execution
+    ListenFn callback = listeners_[pattern_id];
     bool accept = callback(match, is_subscribed);
 
     if (message.action() == Action::SUBSCRIPTION_FOR_PATTERN_REMOVED)
@@ -280,37 +488,145 @@ void Event::notify_listeners_(const Message& message)
 
     Action action = accept ? Action::LISTEN_ACCEPT : Action::LISTEN_REJECT;
     MessageBuilder el(Topic::EVENT, action);
-    el.add_argument(pattern);
+    el.add_argument_reference(pattern);
     el.add_argument(match);
     send_(el);
 }
 
+const Event::SubscriberList* Event::subscribers(const BufferView& name) const
+{
+    const NameTable::Id name_id = subscription_names_.find(name);
+
+    if (name_id == NameTable::NONE || subscriber_lists_[name_id].empty())
+        return nullptr;
+
+    return &subscriber_lists_[name_id];
+}
+
+const Event::ListenFn* Event::listener(const BufferView& pattern) const
+{
+    const NameTable::Id pattern_id = listener_patterns_.find(pattern);
+
+    if (pattern_id == NameTable::NONE)
+        return nullptr;
+
+    return &listeners_[pattern_id];
+}
+
+void Event::outbox_policy(const Outbox::Policy& policy)
+{
+    outbox_.policy(policy);
+}
+
+void Event::persistent_outbox(PersistentOutbox* p_outbox)
+{
+    p_persistent_outbox_ = p_outbox;
+}
+
+void Event::executor(Executor* p_executor)
+{
+    p_executor_ = p_executor;
+}
+
+void Event::pace_resubscription(std::size_t max_messages)
+{
+    resubscription_step_size_ = max_messages;
+}
+
 void Event::on_connection_state_change_(const ConnectionState state)
 {
-    if (state == ConnectionState::OPEN) {
-        for (const auto &subscription: subscriber_map_) {
-            const Name &subscriptionName = subscription.first;
-            MessageBuilder message(Topic::EVENT, Action::SUBSCRIBE);
-            message.add_argument(subscriptionName);
-            if (!send_(message)) {
-                break;
-            }
-        }
-        for (const auto &listen: listener_map_) {
-            const Name &pattern = listen.first;
-            MessageBuilder message(Topic::EVENT, Action::LISTEN);
-            message.add_argument(pattern);
-            if (!send_(message)) {
-                break;
-            }
-        }
-        while (send_queue_.size() > 0) {
-            const auto &message = *send_queue_.front();
-            if (!send_(message)) {
-                break;
-            }
-            send_queue_.pop();
-        }
+    if (state != ConnectionState::OPEN) {
+        is_resubscribing_ = false;
+        return;
+    }
+
+    // mark everything the server must learn about again
+    pending_subscriptions_.assign(subscription_names_.id_limit(), false);
+    for (NameTable::Id id = 0; id < subscription_names_.id_limit(); ++id) {
+        pending_subscriptions_[id] = subscription_names_.contains(id)
+            && !subscriber_lists_[id].empty();
+    }
+
+    pending_listeners_.assign(listener_patterns_.id_limit(), false);
+    for (NameTable::Id id = 0; id < listener_patterns_.id_limit(); ++id)
+        pending_listeners_[id] = listener_patterns_.contains(id);
+
+    next_subscription_ = 0;
+    next_listener_ = 0;
+    is_resubscribing_ = true;
+
+    resubscribe_();
+}
+
+bool Event::resubscribe_()
+{
+    if (!is_resubscribing_) {
+        // a replay may have been cut short by a failed send
+        if (is_holding_emits())
+            replay_outbox();
+
+        return true;
+    }
+
+    const std::size_t max_messages = (resubscription_step_size_ > 0)
+        ? resubscription_step_size_ : static_cast<std::size_t>(-1);
+    std::size_t num_messages = 0;
+    bool ok = true;
+
+    // names and patterns added after the connection was opened were sent
+    // directly; only ids below the sizes of the flag vectors can be pending
+    for (; ok && num_messages < max_messages
+            && next_subscription_ < pending_subscriptions_.size();
+            ++next_subscription_) {
+        const NameTable::Id id = next_subscription_;
+
+        if (!pending_subscriptions_[id])
+            continue;
+
+        pending_subscriptions_[id] = false;
+        assert(subscription_names_.contains(id));
+
+        MessageBuilder message(Topic::EVENT, Action::SUBSCRIBE);
+        message.add_argument_reference(subscription_names_.name(id));
+        ok = send_bulk_(message);
+        ++num_messages;
+    }
+
+    for (; ok && num_messages < max_messages
+            && next_listener_ < pending_listeners_.size();
+            ++next_listener_) {
+        const NameTable::Id id = next_listener_;
+
+        if (!pending_listeners_[id])
+            continue;
+
+        pending_listeners_[id] = false;
+        assert(listener_patterns_.contains(id));
+
+        MessageBuilder message(Topic::EVENT, Action::LISTEN);
+        message.add_argument_reference(listener_patterns_.name(id));
+        ok = send_bulk_(message);
+        ++num_messages;
+    }
+
+    ok = flush_() && ok;
+
+    if (!ok) {
+        // the connection is down; everything is renewed on the next open
+        is_resubscribing_ = false;
+        return true;
     }
+
+    if (next_subscription_ < pending_subscriptions_.size()
+            || next_listener_ < pending_listeners_.size())
+        return false;
+
+    is_resubscribing_ = false;
+
+    // the events emitted while the connection was down or while the
+    // subscriptions were renewed
+    replay_outbox();
+
+    return true;
 }
 }
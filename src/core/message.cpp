@@ -22,6 +22,8 @@
 
 #include <deepstream/core/buffer.hpp>
 #include "message.hpp"
+#include "parser.h"
+#include "protocol.h"
 
 #include <cassert>
 
@@ -45,125 +47,135 @@ std::ostream& operator<<(std::ostream& os, Sender sender)
     return os;
 }
 
-// The list order follows from lexicographical ordering of its tokens, i.e.,
-// A|A <= A|E|INVALID_AUTH_DATA <= A|REQ <= C|A ...
+// The headers are generated from the protocol description in `protocol.h`
+// and they are in the order of the scanner tokens, i.e., the header of the
+// token `t` is `HEADERS[DS_HEADER_INDEX(t)]`.
 //
 // The information about all headers is spread over the three arrays below so
 // that `Message::Header::all()` can return a pair of iterators to the
-// beginning and the one past the end of the list of headers.  The information
-// could be kept in one array (of a struct or a tuple) but the accessing the
-// information would be more involved for users of `message.hpp`.
-const Message::Header HEADERS[] = {
-    Message::Header(Topic::AUTH, Action::REQUEST, true),
-    Message::Header(Topic::AUTH, Action::ERROR_INVALID_AUTH_DATA),
-    Message::Header(Topic::AUTH, Action::ERROR_INVALID_AUTH_MSG),
-    Message::Header(Topic::AUTH, Action::ERROR_TOO_MANY_AUTH_ATTEMPTS),
-    Message::Header(Topic::AUTH, Action::REQUEST),
-
-    Message::Header(Topic::CONNECTION, Action::CHALLENGE_RESPONSE, true),
-    Message::Header(Topic::CONNECTION, Action::CHALLENGE),
-    Message::Header(Topic::CONNECTION, Action::CHALLENGE_RESPONSE),
-    Message::Header(Topic::CONNECTION, Action::PING),
-    Message::Header(Topic::CONNECTION, Action::PONG),
-    Message::Header(Topic::CONNECTION, Action::REDIRECT),
-    Message::Header(Topic::CONNECTION, Action::REJECT),
-
-    Message::Header(Topic::EVENT, Action::LISTEN, true),
-    Message::Header(Topic::EVENT, Action::SUBSCRIBE, true),
-    Message::Header(Topic::EVENT, Action::UNSUBSCRIBE, true),
-    Message::Header(Topic::EVENT, Action::EVENT),
-    Message::Header(Topic::EVENT, Action::LISTEN),
-    Message::Header(Topic::EVENT, Action::LISTEN_ACCEPT),
-    Message::Header(Topic::EVENT, Action::LISTEN_REJECT),
-    Message::Header(Topic::EVENT, Action::SUBSCRIBE),
-    Message::Header(Topic::EVENT, Action::SUBSCRIPTION_FOR_PATTERN_FOUND),
-    Message::Header(Topic::EVENT, Action::SUBSCRIPTION_FOR_PATTERN_REMOVED),
-    Message::Header(Topic::EVENT, Action::UNSUBSCRIBE),
-
-    Message::Header(Topic::PRESENCE, Action::SUBSCRIBE, true),
-    Message::Header(Topic::PRESENCE, Action::UNSUBSCRIBE, true),
-    Message::Header(Topic::PRESENCE, Action::PRESENCE_JOIN),
-    Message::Header(Topic::PRESENCE, Action::PRESENCE_LEAVE),
-    Message::Header(Topic::PRESENCE, Action::QUERY),
-    Message::Header(Topic::PRESENCE, Action::SUBSCRIBE),
-    Message::Header(Topic::PRESENCE, Action::UNSUBSCRIBE)
+// beginning and the one past the end of the list of headers.
+#define DS_HEADER(TOKEN, TOPIC, ACTION, IS_ACK, TEXT, MIN_ARGS, MAX_ARGS) \
+    Message::Header(Topic::TOPIC, Action::ACTION, IS_ACK),
+
+#define DS_HEADER_TEXT(TOKEN, TOPIC, ACTION, IS_ACK, TEXT, MIN_ARGS, MAX_ARGS) \
+    TEXT,
+
+#define DS_HEADER_INFO(TOKEN, TOPIC, ACTION, IS_ACK, TEXT, MIN_ARGS, MAX_ARGS) \
+    { TEXT, sizeof(TEXT) - 1, MIN_ARGS, MAX_ARGS },
+
+constexpr Message::Header HEADERS[] = {
+    DEEPSTREAM_PROTOCOL(DS_HEADER, "|")
 };
 
 const std::size_t NUM_HEADERS = sizeof(HEADERS) / sizeof(HEADERS[0]);
 
-const char* HEADER_TO_STRING[] = { "A|A",
-    "A|E|INVALID_AUTH_DATA",
-    "A|E|INVALID_AUTH_MSG",
-    "A|E|TOO_MANY_AUTH_ATTEMPTS",
-    "A|REQ",
-
-    "C|A",
-    "C|CH",
-    "C|CHR",
-    "C|PI",
-    "C|PO",
-    "C|RED",
-    "C|REJ",
-
-    "E|A|L",
-    "E|A|S",
-    "E|A|US",
-    "E|EVT",
-    "E|L",
-    "E|LA",
-    "E|LR",
-    "E|S",
-    "E|SP",
-    "E|SR",
-    "E|US",
-
-    "U|A|S",
-    "U|A|US",
-    "U|PNJ",
-    "U|PNL",
-    "U|Q",
-    "U|S|S",
-    "U|US|US" };
-
-const std::pair<std::size_t, std::size_t> HEADER_NUM_PAYLOAD[] = {
-    std::pair<std::size_t, std::size_t>(0, 1),
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(1, 1),
-
-    std::pair<std::size_t, std::size_t>(0, 0),
-    std::pair<std::size_t, std::size_t>(0, 0),
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(0, 0),
-    std::pair<std::size_t, std::size_t>(0, 0),
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(0, 1),
-
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(2, 2),
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(2, 2),
-    std::pair<std::size_t, std::size_t>(2, 2),
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(2, 2),
-    std::pair<std::size_t, std::size_t>(2, 2),
-    std::pair<std::size_t, std::size_t>(1, 1),
-
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(1, 1),
-    std::pair<std::size_t, std::size_t>(0, SIZE_MAX),
-    std::pair<std::size_t, std::size_t>(0, 0),
-    std::pair<std::size_t, std::size_t>(0, 0)
+constexpr const char* HEADER_TO_STRING[] = {
+    DEEPSTREAM_PROTOCOL(DS_HEADER_TEXT, "|")
+};
+
+namespace {
+
+struct HeaderInfo {
+    const char* binary; ///< the header as it appears in a deepstream message
+    std::size_t size;
+    std::size_t min_num_arguments;
+    std::size_t max_num_arguments;
+};
+
+constexpr HeaderInfo HEADER_INFO[] = {
+    DEEPSTREAM_PROTOCOL(DS_HEADER_INFO, "\x1f")
 };
 
+#undef DS_HEADER
+#undef DS_HEADER_TEXT
+#undef DS_HEADER_INFO
+
 #define DS_COUNT(XS) (sizeof(XS) / sizeof(XS[0]))
 static_assert(DS_COUNT(HEADERS) == DS_COUNT(HEADER_TO_STRING), "");
-static_assert(DS_COUNT(HEADERS) == DS_COUNT(HEADER_NUM_PAYLOAD), "");
+static_assert(DS_COUNT(HEADERS) == DS_COUNT(HEADER_INFO), "");
+static_assert(DS_COUNT(HEADERS) == TOKEN_MAXVAL - TOKEN_MESSAGE_SEPARATOR - 1, "");
+static_assert(DS_COUNT(HEADERS) < UINT8_MAX, "");
+
+// the last enumerators are Topic::RPC and Action::UNSUBSCRIBE
+const std::size_t NUM_TOPICS = static_cast<std::size_t>(Topic::RPC) + 1;
+const std::size_t NUM_ACTIONS = static_cast<std::size_t>(Action::UNSUBSCRIBE) + 1;
+
+const std::size_t NUM_HEADER_CELLS = NUM_TOPICS * NUM_ACTIONS * 2;
+
+constexpr std::size_t header_cell(Topic topic, Action action, bool is_ack)
+{
+    return (static_cast<std::size_t>(topic) * NUM_ACTIONS
+        + static_cast<std::size_t>(action)) * 2 + (is_ack ? 1 : 0);
+}
+
+// The position of the header with the given cell in `HEADERS`, or
+// `NUM_HEADERS` for invalid headers, as a chain of conditional expressions
+// generated from the protocol description.
+#define DS_HEADER_CELL(TOKEN, TOPIC, ACTION, IS_ACK, TEXT, MIN_ARGS, MAX_ARGS) \
+    (cell == header_cell(Topic::TOPIC, Action::ACTION, IS_ACK)) ? DS_HEADER_INDEX(TOKEN) :
+
+constexpr std::size_t find_header(std::size_t cell)
+{
+    return DEEPSTREAM_PROTOCOL(DS_HEADER_CELL, "|") NUM_HEADERS;
+}
+
+#undef DS_HEADER_CELL
+
+template <std::size_t... Is>
+struct IndexSequence {
+};
+
+template <std::size_t N, std::size_t... Is>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, Is...> {
+};
+
+template <std::size_t... Is>
+struct MakeIndexSequence<0, Is...> {
+    typedef IndexSequence<Is...> type;
+};
+
+/**
+ * This table maps topic, action, and the acknowledgement flag to the
+ * position of the header in `HEADERS` (or `NUM_HEADERS` for invalid headers)
+ * with a single array access; it is computed by the compiler.
+ */
+struct HeaderIndex {
+    std::uint8_t index[NUM_HEADER_CELLS];
+};
+
+template <std::size_t... Is>
+constexpr HeaderIndex make_header_index(IndexSequence<Is...>)
+{
+    return HeaderIndex{ { static_cast<std::uint8_t>(find_header(Is))... } };
+}
+
+constexpr HeaderIndex HEADER_INDEX = make_header_index(MakeIndexSequence<NUM_HEADER_CELLS>::type());
+
+// every header is found at its own position, i.e., there are no duplicates
+constexpr bool is_indexed(std::size_t i)
+{
+    return i == NUM_HEADERS
+        || (HEADER_INDEX.index[header_cell(HEADERS[i].topic(), HEADERS[i].action(), HEADERS[i].is_ack())] == i
+            && is_indexed(i + 1));
+}
+
+static_assert(is_indexed(0), "");
+
+/**
+ * @return The position of the header in `HEADERS` or `NUM_HEADERS` if the
+ * header is invalid
+ */
+std::size_t header_index(const Message::Header& header)
+{
+    const std::size_t topic = static_cast<std::size_t>(header.topic());
+    const std::size_t action = static_cast<std::size_t>(header.action());
+
+    if (topic >= NUM_TOPICS || action >= NUM_ACTIONS)
+        return NUM_HEADERS;
+
+    return HEADER_INDEX.index[header_cell(header.topic(), header.action(), header.is_ack())];
+}
+}
 
 std::pair<const Message::Header*, const Message::Header*>
 Message::Header::all()
@@ -184,20 +196,44 @@ std::size_t Message::Header::size(Topic topic, Action action, bool is_ack)
 
 const char* Message::Header::to_string() const
 {
-    for (std::size_t i = 0; i < NUM_HEADERS; ++i) {
-        if (*this == HEADERS[i])
-            return HEADER_TO_STRING[i];
+    const std::size_t i = header_index(*this);
+
+    if (i == NUM_HEADERS) {
+        assert(0);
+        return nullptr;
     }
 
-    assert(0);
-    return nullptr;
+    return HEADER_TO_STRING[i];
 }
 
-std::size_t Message::Header::size() const { return std::strlen(to_string()); }
+std::size_t Message::Header::size() const
+{
+    const std::size_t i = header_index(*this);
+
+    if (i == NUM_HEADERS) {
+        assert(0);
+        return 0;
+    }
+
+    return HEADER_INFO[i].size;
+}
 
 Buffer Message::Header::to_binary() const
 {
-    return from_human_readable(to_string());
+    return Buffer(to_binary_view());
+}
+
+BufferView Message::Header::to_binary_view() const
+{
+    const std::size_t i = header_index(*this);
+
+    if (i == NUM_HEADERS) {
+        assert(0);
+        return BufferView();
+    }
+
+    const HeaderInfo& info = HEADER_INFO[i];
+    return BufferView(info.binary, info.size);
 }
 
 Buffer Message::from_human_readable(const char* p)
@@ -226,21 +262,20 @@ std::string Message::to_human_readable(const Buffer &buff)
 std::pair<std::size_t, std::size_t>
 Message::num_arguments(const Message::Header& header)
 {
-    typedef std::pair<std::size_t, std::size_t> RetType;
+    const std::size_t i = header_index(header);
 
-    for (std::size_t i = 0; i < NUM_HEADERS; ++i) {
-        if (header == HEADERS[i])
-            return HEADER_NUM_PAYLOAD[i];
-    }
+    if (i == NUM_HEADERS) {
+        const std::size_t max = std::numeric_limits<std::size_t>::max();
 
-    const std::size_t max = std::numeric_limits<std::size_t>::max();
-    const RetType error(max, max);
+        assert(0);
+        return std::make_pair(max, max);
+    }
 
-    assert(0);
-    return error;
+    const HeaderInfo& info = HEADER_INFO[i];
+    return std::make_pair(info.min_num_arguments, info.max_num_arguments);
 }
 
-Buffer Message::operator[](std::size_t i) const { return get_impl_(i); }
+BufferView Message::operator[](std::size_t i) const { return get_impl_(i); }
 
 Buffer Message::to_binary() const { return to_binary_impl_(); }
 
@@ -20,9 +20,11 @@
 
 #include <iosfwd>
 #include <utility>
+#include <vector>
 
 namespace deepstream {
 struct Buffer;
+struct BufferView;
 
 const char ASCII_RECORD_SEPARATOR = 30;
 const char ASCII_UNIT_SEPARATOR = 31;
@@ -79,6 +81,12 @@ std::ostream& operator<<(std::ostream&, Sender);
  * http://www.gotw.ca/publications/mill18.htm
  */
 struct Message {
+    /**
+     * A serialized message as a list of memory ranges, e.g., for
+     * scatter-gather I/O.
+     */
+    typedef std::vector<BufferView> SegmentList;
+
     struct Header {
         /**
          * This function returns the list of all valid message headers.
@@ -103,7 +111,7 @@ struct Message {
          */
         static std::size_t size(Topic, Action, bool is_ack = false);
 
-        explicit Header(Topic topic, Action action, bool is_ack = false)
+        constexpr explicit Header(Topic topic, Action action, bool is_ack = false)
             : topic_impl_(topic)
             , action_impl_(action)
             , is_ack_impl_(is_ack)
@@ -127,11 +135,17 @@ struct Message {
          */
         Buffer to_binary() const;
 
-        Topic topic() const { return topic_impl_; }
+        /**
+         * This method returns the representation of this header in a
+         * deepstream message without copying it; the memory is static.
+         */
+        BufferView to_binary_view() const;
 
-        Action action() const { return action_impl_; }
+        constexpr Topic topic() const { return topic_impl_; }
 
-        bool is_ack() const { return is_ack_impl_; }
+        constexpr Action action() const { return action_impl_; }
+
+        constexpr bool is_ack() const { return is_ack_impl_; }
 
         Topic topic_impl_;
         Action action_impl_;
@@ -181,24 +195,34 @@ struct Message {
     std::size_t num_arguments() const { return num_arguments_impl_(); }
 
     /**
-     * This operator returns the i-th argument of a message.
+     * This operator returns the i-th argument of a message. The view is valid
+     * as long as the message.
      */
-    Buffer operator[](std::size_t) const;
+    BufferView operator[](std::size_t) const;
 
     /**
      * This method returns the assembled deepstream message.
      */
     Buffer to_binary() const;
 
+    /**
+     * This method appends the pieces of the serialized message to the given
+     * list without copying the message. The segments are valid as long as
+     * the message.
+     */
+    void to_segments(SegmentList& segments) const { to_segments_impl_(segments); }
+
     virtual std::size_t size_impl_() const = 0;
 
     virtual const Header& header_impl_() const = 0;
 
     virtual std::size_t num_arguments_impl_() const = 0;
 
-    virtual Buffer get_impl_(std::size_t) const = 0;
+    virtual BufferView get_impl_(std::size_t) const = 0;
 
     virtual Buffer to_binary_impl_() const = 0;
+
+    virtual void to_segments_impl_(SegmentList&) const = 0;
 };
 
 std::ostream& operator<<(std::ostream&, const Message::Header&);
@@ -34,14 +34,43 @@ MessageBuilder::MessageBuilder(Topic topic, Action action, bool is_ack)
 {
 }
 
-void MessageBuilder::add_argument(const Argument& arg)
+MessageBuilder::MessageBuilder(const MessageBuilder& other)
+    : Message()
+    , header_(other.header_)
 {
-    auto it = std::find(arg.cbegin(), arg.cend(), ASCII_UNIT_SEPARATOR);
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < other.num_arguments(); ++i)
+        size += other.arguments_[i].size_;
+
+    arguments_.reserve(other.arguments_.size());
+    storage_.reserve(size);
+
+    for (std::size_t i = 0; i < other.num_arguments(); ++i) {
+        const BufferView arg = other[i];
+
+        ArgumentLocation location = { nullptr, storage_.size(), arg.size() };
+        storage_.insert(storage_.end(), arg.cbegin(), arg.cend());
+        arguments_.push_back(location);
+    }
+}
+
+namespace {
+    void check_argument(const BufferView& arg)
+    {
+        auto it = std::find(arg.cbegin(), arg.cend(), ASCII_UNIT_SEPARATOR);
 
-    if (it != arg.cend())
-        throw std::invalid_argument("ASCII unit separator in payload detected");
+        if (it != arg.cend())
+            throw std::invalid_argument("ASCII unit separator in payload detected");
+    }
+}
 
-    arguments_.push_back(arg);
+void MessageBuilder::add_argument(const Argument& arg)
+{
+    check_argument(arg);
+
+    ArgumentLocation location = { nullptr, storage_.size(), arg.size() };
+    storage_.insert(storage_.end(), arg.cbegin(), arg.cend());
+    arguments_.push_back(location);
 }
 
 void MessageBuilder::add_argument(const std::string& string)
@@ -49,12 +78,20 @@ void MessageBuilder::add_argument(const std::string& string)
     add_argument(Buffer(string.cbegin(), string.cend()));
 }
 
+void MessageBuilder::add_argument_reference(const BufferView& arg)
+{
+    check_argument(arg);
+
+    ArgumentLocation location = { arg.data(), 0, arg.size() };
+    arguments_.push_back(location);
+}
+
 std::size_t MessageBuilder::size_impl_() const
 {
     std::size_t size = header_.size() + arguments_.size() + // one separator for every argument
-        std::accumulate(arguments_.cbegin(), arguments_.cend(), 0,
-                           [](std::size_t k, const Argument& arg) {
-                               return k + arg.size();
+        std::accumulate(arguments_.cbegin(), arguments_.cend(), std::size_t(0),
+                           [](std::size_t k, const ArgumentLocation& arg) {
+                               return k + arg.size_;
                            })
         + 1; // message separator
 
@@ -68,7 +105,15 @@ std::size_t MessageBuilder::num_arguments_impl_() const
     return arguments_.size();
 }
 
-Buffer MessageBuilder::get_impl_(std::size_t i) const { return arguments_[i]; }
+BufferView MessageBuilder::get_impl_(std::size_t i) const
+{
+    assert(i < arguments_.size());
+
+    const ArgumentLocation& arg = arguments_[i];
+    const char* data = arg.data_ ? arg.data_ : storage_.data() + arg.offset_;
+
+    return BufferView(data, arg.size_);
+}
 
 Buffer MessageBuilder::to_binary_impl_() const
 {
@@ -77,13 +122,15 @@ Buffer MessageBuilder::to_binary_impl_() const
 
     auto out = buffer.begin();
 
-    const Buffer bin_header = header_.to_binary();
+    const BufferView bin_header = header_.to_binary_view();
     out = std::copy(bin_header.cbegin(), bin_header.cend(), out);
 
-    for (auto in = arguments_.cbegin(); in != arguments_.cend(); ++in) {
+    for (std::size_t i = 0; i < arguments_.size(); ++i) {
+        const BufferView arg = get_impl_(i);
+
         *out = ASCII_UNIT_SEPARATOR;
         ++out;
-        out = std::copy(in->cbegin(), in->cend(), out);
+        out = std::copy(arg.cbegin(), arg.cend(), out);
     }
 
     *out = ASCII_RECORD_SEPARATOR;
@@ -91,4 +138,19 @@ Buffer MessageBuilder::to_binary_impl_() const
 
     return buffer;
 }
+
+void MessageBuilder::to_segments_impl_(SegmentList& segments) const
+{
+    static const char UNIT_SEPARATOR = ASCII_UNIT_SEPARATOR;
+    static const char RECORD_SEPARATOR = ASCII_RECORD_SEPARATOR;
+
+    segments.push_back(header_.to_binary_view());
+
+    for (std::size_t i = 0; i < arguments_.size(); ++i) {
+        segments.push_back(BufferView(&UNIT_SEPARATOR, 1));
+        segments.push_back(get_impl_(i));
+    }
+
+    segments.push_back(BufferView(&RECORD_SEPARATOR, 1));
+}
 }
@@ -19,36 +19,65 @@
 #include <string>
 #include <vector>
 
+#include <deepstream/core/buffer.hpp>
 #include "message.hpp"
 
 namespace deepstream {
 /**
  * This class aids with the construction of deepstream messages.
+ *
+ * Arguments are either copied into the builder or they reference memory owned
+ * by the caller; the latter must outlive the builder. Copies of a builder own
+ * all of their arguments.
  */
 struct MessageBuilder : public Message {
     typedef Buffer Argument;
-    typedef std::vector<Argument> ArgumentList;
 
     explicit MessageBuilder(const Message::Header&);
 
     explicit MessageBuilder(Topic topic, Action action, bool is_ack = false);
 
+    MessageBuilder(const MessageBuilder&);
+
+    MessageBuilder& operator=(const MessageBuilder&) = delete;
+
     void add_argument(const Argument& arg);
 
     void add_argument(const std::string&);
 
+    /**
+     * This method adds an argument without copying it.
+     */
+    void add_argument_reference(const BufferView&);
+
     virtual std::size_t size_impl_() const;
 
     virtual const Header& header_impl_() const;
 
     virtual std::size_t num_arguments_impl_() const;
 
-    virtual Buffer get_impl_(std::size_t) const;
+    virtual BufferView get_impl_(std::size_t) const;
 
     virtual Buffer to_binary_impl_() const;
 
+    virtual void to_segments_impl_(SegmentList&) const;
+
+    /**
+     * An argument references either caller memory (`data_` is non-null) or
+     * the bytes at `offset_` in `storage_`; the offset is needed because the
+     * storage may be reallocated.
+     */
+    struct ArgumentLocation {
+        const char* data_;
+        std::size_t offset_;
+        std::size_t size_;
+    };
+
+    typedef std::vector<ArgumentLocation> ArgumentList;
+
     const Message::Header header_;
     ArgumentList arguments_;
+    Buffer storage_;
 };
 }
 
@@ -54,21 +54,21 @@ namespace parser {
         return arguments_.size();
     }
 
-    Buffer MessageProxy::get_impl_(std::size_t i) const
+    BufferView MessageProxy::get_impl_(std::size_t i) const
     {
         assert(i < arguments_.size());
 
-        const char* first = base_ + arguments_[i].offset();
-        const char* last = first + arguments_[i].size();
-
-        Buffer ret(first, last);
-
-        return ret;
+        return BufferView(base_ + arguments_[i].offset(), arguments_[i].size());
     }
 
     Buffer MessageProxy::to_binary_impl_() const
     {
-        return Buffer(base_, base_ + size_);
+        return Buffer(base_ + offset_, base_ + offset_ + size_);
+    }
+
+    void MessageProxy::to_segments_impl_(SegmentList& segments) const
+    {
+        segments.push_back(BufferView(base_ + offset_, size_));
     }
 }
 }
@@ -88,10 +88,12 @@ namespace parser {
 
         virtual std::size_t num_arguments_impl_() const;
 
-        virtual Buffer get_impl_(std::size_t) const;
+        virtual BufferView get_impl_(std::size_t) const;
 
         virtual Buffer to_binary_impl_() const;
 
+        virtual void to_segments_impl_(SegmentList&) const;
+
         const char* const base_;
         const std::size_t offset_;
         /**
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cassert>
+
+#include <limits>
+
+#include <deepstream/core/name_table.hpp>
+
+namespace deepstream {
+
+const NameTable::Id NameTable::NONE = std::numeric_limits<NameTable::Id>::max();
+
+namespace {
+    // the number of slots is a power of two
+    const std::size_t MIN_NUM_SLOTS = 16;
+}
+
+NameTable::NameTable()
+    : size_(0)
+{
+}
+
+NameTable::Hash NameTable::hash_of(const BufferView& name)
+{
+    Hash hash = 2166136261u;
+
+    for (char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+std::size_t NameTable::find_slot(const BufferView& name, Hash hash) const
+{
+    assert(!slots_.empty());
+
+    const std::size_t mask = slots_.size() - 1;
+
+    // the load factor is at most 1/2 so there is always an empty slot
+    for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Slot& slot = slots_[i];
+
+        if (slot.id == NONE)
+            return i;
+
+        if (slot.hash == hash && entries_[slot.id].name == name)
+            return i;
+    }
+}
+
+NameTable::Id NameTable::find(const BufferView& name) const
+{
+    if (size_ == 0)
+        return NONE;
+
+    const std::size_t i = find_slot(name, hash_of(name));
+
+    return slots_[i].id;
+}
+
+NameTable::Id NameTable::intern(const BufferView& name)
+{
+    if (2 * (size_ + 1) > slots_.size())
+        grow();
+
+    const Hash hash = hash_of(name);
+    const std::size_t i = find_slot(name, hash);
+
+    if (slots_[i].id != NONE)
+        return slots_[i].id;
+
+    Id id = NONE;
+
+    if (free_ids_.empty()) {
+        assert(entries_.size() < NONE);
+        id = static_cast<Id>(entries_.size());
+        entries_.emplace_back();
+    } else {
+        id = free_ids_.back();
+        free_ids_.pop_back();
+    }
+
+    Entry& entry = entries_[id];
+    assert(!entry.used);
+
+    entry.name.assign(name.cbegin(), name.cend());
+    entry.hash = hash;
+    entry.used = true;
+
+    slots_[i].id = id;
+    slots_[i].hash = hash;
+    ++size_;
+
+    return id;
+}
+
+void NameTable::erase(Id id)
+{
+    assert(contains(id));
+
+    Entry& entry = entries_[id];
+    const std::size_t mask = slots_.size() - 1;
+
+    std::size_t i = find_slot(entry.name, entry.hash);
+    assert(slots_[i].id == id);
+
+    // Backward-shift deletion: move every following entry of the probe
+    // sequence whose home slot is not in the cyclic range (i, j] into the
+    // hole so that no tombstones are needed.
+    for (std::size_t j = (i + 1) & mask; slots_[j].id != NONE; j = (j + 1) & mask) {
+        const std::size_t k = slots_[j].hash & mask;
+        const bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+
+        if (stays)
+            continue;
+
+        slots_[i] = slots_[j];
+        i = j;
+    }
+
+    slots_[i].id = NONE;
+
+    entry.name.clear();
+    entry.used = false;
+    free_ids_.push_back(id);
+    --size_;
+}
+
+void NameTable::grow()
+{
+    const std::size_t num_slots
+        = slots_.empty() ? MIN_NUM_SLOTS : 2 * slots_.size();
+    const std::size_t mask = num_slots - 1;
+
+    std::vector<Slot> slots(num_slots, Slot{ NONE, 0 });
+
+    for (const Slot& slot : slots_) {
+        if (slot.id == NONE)
+            continue;
+
+        std::size_t i = slot.hash & mask;
+        while (slots[i].id != NONE)
+            i = (i + 1) & mask;
+
+        slots[i] = slot;
+    }
+
+    slots_.swap(slots);
+}
+}
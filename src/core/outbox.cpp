@@ -0,0 +1,231 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cassert>
+
+#include <deepstream/core/outbox.hpp>
+
+#include "message.hpp"
+
+namespace deepstream {
+
+const std::size_t Outbox::DEFAULT_MAX_BYTES;
+
+namespace {
+    // the log is not compacted for less garbage than this
+    const std::size_t MIN_COMPACTION_SIZE = 4096;
+}
+
+Outbox::Outbox()
+    : Outbox(Policy())
+{
+}
+
+Outbox::Outbox(const Policy& policy)
+    : policy_(policy)
+    , first_sequence_number_(0)
+    , num_messages_(0)
+    , num_bytes_(0)
+    , num_dropped_(0)
+{
+}
+
+void Outbox::policy(const Policy& policy)
+{
+    policy_ = policy;
+
+    while (num_bytes_ > policy_.max_bytes) {
+        if (!entries_.front().removed)
+            ++num_dropped_;
+        pop_front();
+    }
+
+    compact_if_sparse();
+}
+
+bool Outbox::push(const Message& message)
+{
+    segments_.clear();
+    message.to_segments(segments_);
+
+    std::size_t size = 0;
+    for (const BufferView& segment : segments_)
+        size += segment.size();
+
+    const bool conflate = policy_.conflate && message.num_arguments() > 0;
+    const NameTable::Id previous_name = conflate ? names_.find(message[0]) : NameTable::NONE;
+    const std::size_t previous = (previous_name != NameTable::NONE)
+        ? latest_[previous_name] - first_sequence_number_ : entries_.size();
+    const std::size_t freed_size = (previous < entries_.size()) ? entries_[previous].size : 0;
+
+    if (size > policy_.max_bytes
+        || (policy_.overflow == Overflow::DROP_NEWEST
+               && num_bytes_ - freed_size + size > policy_.max_bytes)) {
+        ++num_dropped_;
+        return false;
+    }
+
+    // the new message replaces the previous one with the same name
+    if (previous < entries_.size()) {
+        Entry& entry = entries_[previous];
+        assert(!entry.removed);
+
+        forget_name(previous);
+        entry.removed = true;
+        num_bytes_ -= entry.size;
+        --num_messages_;
+    }
+
+    while (num_bytes_ + size > policy_.max_bytes) {
+        if (!entries_.front().removed)
+            ++num_dropped_;
+        pop_front();
+    }
+
+    const std::size_t offset = log_.size();
+    for (const BufferView& segment : segments_)
+        log_.insert(log_.end(), segment.cbegin(), segment.cend());
+
+    NameTable::Id name = NameTable::NONE;
+    if (conflate) {
+        name = names_.intern(message[0]);
+        if (name >= latest_.size())
+            latest_.resize(names_.id_limit());
+        latest_[name] = first_sequence_number_ + entries_.size();
+    }
+
+    entries_.push_back(Entry{ offset, size, name, false });
+    ++num_messages_;
+    num_bytes_ += size;
+
+    compact_if_sparse();
+
+    return true;
+}
+
+bool Outbox::replay(const WriteFn& write, std::size_t max_write_size)
+{
+    assert(write);
+
+    // afterwards, the messages are stored back to back
+    if (log_.size() != num_bytes_)
+        compact();
+
+    while (!entries_.empty()) {
+        const std::size_t begin = entries_.front().offset;
+        std::size_t end = begin;
+        std::size_t n = 0;
+
+        for (; n < entries_.size(); ++n) {
+            const Entry& entry = entries_[n];
+            assert(!entry.removed);
+            assert(entry.offset == end);
+
+            if (end > begin && end - begin + entry.size > max_write_size)
+                break;
+
+            end += entry.size;
+        }
+
+        if (!write(BufferView(log_.data() + begin, end - begin)))
+            return false;
+
+        for (; n > 0; --n)
+            pop_front();
+    }
+
+    compact_if_sparse();
+
+    return true;
+}
+
+void Outbox::clear()
+{
+    while (!entries_.empty())
+        pop_front();
+
+    compact_if_sparse();
+}
+
+void Outbox::pop_front()
+{
+    assert(!entries_.empty());
+
+    const Entry& entry = entries_.front();
+
+    if (!entry.removed) {
+        forget_name(0);
+        num_bytes_ -= entry.size;
+        --num_messages_;
+    }
+
+    entries_.pop_front();
+    ++first_sequence_number_;
+}
+
+void Outbox::forget_name(std::size_t index)
+{
+    Entry& entry = entries_[index];
+
+    if (entry.name == NameTable::NONE)
+        return;
+
+    names_.erase(entry.name);
+    entry.name = NameTable::NONE;
+}
+
+void Outbox::compact_if_sparse()
+{
+    if (num_messages_ == 0) {
+        first_sequence_number_ += entries_.size();
+        entries_.clear();
+        log_.clear();
+        return;
+    }
+
+    const std::size_t garbage = log_.size() - num_bytes_;
+
+    if (garbage >= MIN_COMPACTION_SIZE && garbage > num_bytes_)
+        compact();
+}
+
+void Outbox::compact()
+{
+    spare_log_.clear();
+    spare_log_.reserve(num_bytes_);
+
+    std::size_t j = 0;
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+        Entry entry = entries_[i];
+
+        if (entry.removed)
+            continue;
+
+        const char* p = log_.data() + entry.offset;
+        entry.offset = spare_log_.size();
+        spare_log_.insert(spare_log_.end(), p, p + entry.size);
+
+        if (entry.name != NameTable::NONE)
+            latest_[entry.name] = first_sequence_number_ + j;
+
+        entries_[j] = entry;
+        ++j;
+    }
+
+    entries_.resize(j);
+    log_.swap(spare_log_);
+    spare_log_.clear();
+}
+}
@@ -24,13 +24,10 @@
 #include "message.hpp"
 #include "parser.h"
 #include "parser.hpp"
+#include "scanner.h"
 #include "scope_guard.hpp"
 #include "use.hpp"
 
-extern "C" {
-#include <lexer.h>
-}
-
 #include <cassert>
 
 namespace deepstream {
@@ -71,16 +68,53 @@ namespace parser {
         return os;
     }
 
+    namespace {
+        struct Collector : public Handler {
+            virtual void handle_message(const MessageProxy& message) override
+            {
+                messages.push_back(message);
+            }
+
+            virtual void handle_error(const Error& error) override
+            {
+                errors.push_back(error);
+            }
+
+            MessageList messages;
+            ErrorList errors;
+        };
+    }
+
     std::pair<MessageList, ErrorList> execute(char* p, std::size_t size)
     {
-        assert(p);
-        assert(p[size - 2] == 0);
-        assert(p[size - 1] == 0);
+        Collector collector;
+        Context context;
+        context.execute(p, size, collector);
+
+        return std::make_pair(std::move(collector.messages),
+            std::move(collector.errors));
+    }
+
+    Context::Context()
+        : scanner_(nullptr)
+        , state_("", 0)
+    {
+        reset_scanner();
+    }
 
-        yyscan_t scanner = nullptr;
-        deepstream::parser::State parser(p, size - 2);
+    Context::~Context()
+    {
+        yylex_destroy(scanner_);
+    }
+
+    void Context::reset_scanner()
+    {
+        if (scanner_) {
+            yylex_destroy(scanner_);
+            scanner_ = nullptr;
+        }
 
-        if (yylex_init(&scanner) != 0) {
+        if (yylex_init(&scanner_) != 0) {
             if (errno == ENOMEM)
                 throw std::bad_alloc();
 
@@ -89,30 +123,125 @@ namespace parser {
             throw std::invalid_argument("nullptr given to yylex_init");
         }
 
-        assert(scanner);
-        YY_BUFFER_STATE lexer_buffer = yy_scan_buffer(p, size, scanner);
-        assert(lexer_buffer);
+        assert(scanner_);
+        yyset_extra(&state_, scanner_);
+    }
+
+    void Context::execute(char* p, std::size_t size)
+    {
+        assert(p);
+        assert(size >= 2);
+        assert(p[size - 2] == 0);
+        assert(p[size - 1] == 0);
 
-        yyset_extra(&parser, scanner);
+        state_.reset(p, size - 2);
 
-        DEEPSTREAM_ON_EXIT([lexer_buffer, scanner]() {
-            yy_delete_buffer(lexer_buffer, scanner);
-            yylex_destroy(scanner);
-        });
+        YY_BUFFER_STATE lexer_buffer = yy_scan_buffer(p, size, scanner_);
+        if (!lexer_buffer)
+            throw std::bad_alloc();
 
-        while (yylex(scanner))
+        while (yylex(scanner_))
             ;
 
-        return std::make_pair(parser.messages_, parser.errors_);
+        yy_delete_buffer(lexer_buffer, scanner_);
+
+        if (state_.exception_) {
+            std::exception_ptr exception = state_.exception_;
+            state_.exception_ = nullptr;
+
+            // the scanner stopped in the middle of the input
+            reset_scanner();
+
+            std::rethrow_exception(exception);
+        }
+    }
+
+    void Context::execute(char* p, std::size_t size, Handler& handler)
+    {
+        state_.handler_ = &handler;
+        DEEPSTREAM_ON_EXIT([this]() { this->state_.handler_ = nullptr; });
+
+        execute(p, size);
+    }
+
+    void Context::clear()
+    {
+        state_.reset("", 0);
+    }
+
+    Stream::Stream()
+        : data_(nullptr)
+        , size_(0)
+    {
+    }
+
+    bool Stream::assemble(char* p, std::size_t sz)
+    {
+        assert(p);
+
+        std::size_t complete = sz;
+        while (complete > 0 && p[complete - 1] != ASCII_RECORD_SEPARATOR)
+            --complete;
+
+        if (complete == 0) {
+            pending_.insert(pending_.end(), p, p + sz);
+            data_ = nullptr;
+            size_ = 0;
+            return false;
+        }
+
+        if (pending_.empty()) {
+            // save the tail before its first bytes are overwritten
+            pending_.assign(p + complete, p + sz);
+
+            p[complete] = 0;
+            p[complete + 1] = 0;
+
+            data_ = p;
+            size_ = complete;
+        } else {
+            // the messages returned by the last call reference input_ but
+            // they must not be used anymore
+            input_.swap(pending_);
+            input_.insert(input_.end(), p, p + complete);
+            input_.push_back(0);
+            input_.push_back(0);
+
+            pending_.assign(p + complete, p + sz);
+
+            data_ = input_.data();
+            size_ = input_.size() - 2;
+        }
+
+        return true;
+    }
+
+    const Context& Stream::feed(char* p, std::size_t sz)
+    {
+        if (assemble(p, sz))
+            context_.execute(data_, size_ + 2);
+        else
+            context_.clear();
+
+        return context_;
+    }
+
+    void Stream::feed(char* p, std::size_t sz, Handler& handler)
+    {
+        if (assemble(p, sz))
+            context_.execute(data_, size_ + 2, handler);
+    }
+
+    void Stream::reset()
+    {
+        pending_.clear();
     }
 }
 }
 
 bool is_header_token(enum deepstream_token token)
 {
-    int min_event_num = TOKEN_A_A;
-
-    return token >= min_event_num;
+    return token > TOKEN_MESSAGE_SEPARATOR && token < TOKEN_MAXVAL;
 }
 
 deepstream_parser_state::deepstream_parser_state(const char* p, std::size_t sz)
@@ -120,10 +249,62 @@ deepstream_parser_state::deepstream_parser_state(const char* p, std::size_t sz)
     , buffer_size_(sz)
     , tokenizing_header_(true)
     , offset_(0)
+    , handler_(nullptr)
 {
     assert(buffer_);
 }
 
+void deepstream_parser_state::reset(const char* p, std::size_t sz)
+{
+    assert(p);
+
+    buffer_ = p;
+    buffer_size_ = sz;
+    tokenizing_header_ = true;
+    offset_ = 0;
+
+    while (!messages_.empty())
+        pop_message();
+
+    errors_.clear();
+}
+
+void deepstream_parser_state::add_message(const deepstream::Message::Header& header)
+{
+    messages_.emplace_back(buffer_, offset_, header);
+
+    if (!spare_arguments_.empty()) {
+        messages_.back().arguments_.swap(spare_arguments_.back());
+        spare_arguments_.pop_back();
+    }
+}
+
+void deepstream_parser_state::pop_message()
+{
+    assert(!messages_.empty());
+
+    auto& arguments = messages_.back().arguments_;
+
+    if (arguments.capacity() > 0) {
+        arguments.clear();
+        spare_arguments_.emplace_back();
+        spare_arguments_.back().swap(arguments);
+    }
+
+    messages_.pop_back();
+}
+
+void deepstream_parser_state::add_error(std::size_t offset, std::size_t size,
+    deepstream::parser::Error::Tag tag)
+{
+    errors_.emplace_back(offset, size, tag);
+
+    if (handler_) {
+        DEEPSTREAM_ON_EXIT([this]() { this->errors_.pop_back(); });
+        handler_->handle_error(errors_.back());
+    }
+}
+
 int deepstream_parser_handle(deepstream::parser::State* p_state,
     deepstream_token token, const char* text,
     std::size_t textlen)
@@ -131,7 +312,14 @@ int deepstream_parser_handle(deepstream::parser::State* p_state,
     assert(p_state);
     assert(token != TOKEN_MAXVAL);
 
-    return p_state->handle_token(token, text, textlen);
+    // do not let exceptions propagate through the scanner; returning zero
+    // stops the scanner
+    try {
+        return p_state->handle_token(token, text, textlen);
+    } catch (...) {
+        p_state->exception_ = std::current_exception();
+        return 0;
+    }
 }
 
 int deepstream_parser_state::handle_token(deepstream_token token,
@@ -190,12 +378,12 @@ void deepstream_parser_state::handle_error(deepstream_token token, const char*,
         assert(!tokenizing_header_);
         assert(!messages_.empty());
 
-        messages_.pop_back();
-        errors_.emplace_back(offset_, textlen, Error::UNEXPECTED_EOF);
+        pop_message();
+        add_error(offset_, textlen, Error::UNEXPECTED_EOF);
     }
 
     if (token == TOKEN_UNKNOWN && tokenizing_header_) {
-        errors_.emplace_back(offset_, textlen, Error::UNEXPECTED_TOKEN);
+        add_error(offset_, textlen, Error::UNEXPECTED_TOKEN);
     }
 
     if (token == TOKEN_UNKNOWN && !tokenizing_header_) {
@@ -203,26 +391,18 @@ void deepstream_parser_state::handle_error(deepstream_token token, const char*,
 
         std::size_t msg_start = messages_.back().offset();
         std::size_t msg_size = messages_.back().size();
-        messages_.pop_back();
+        pop_message();
 
         assert(msg_start + msg_size == offset_);
 
-        errors_.emplace_back(msg_start, msg_size + textlen, Error::CORRUPT_PAYLOAD);
+        add_error(msg_start, msg_size + textlen, Error::CORRUPT_PAYLOAD);
     }
 }
 
-#define DS_ADD_MSG(...)                                        \
-    do {                                                       \
-        messages_.emplace_back(buffer_, offset_, __VA_ARGS__); \
-    } while (false)
-
 void deepstream_parser_state::handle_header(deepstream_token token,
     const char* text,
     std::size_t textlen)
 {
-    using deepstream::Topic;
-    using deepstream::Action;
-
     deepstream::use(text);
     deepstream::use(textlen);
 
@@ -231,141 +411,15 @@ void deepstream_parser_state::handle_header(deepstream_token token,
 
     DEEPSTREAM_ON_EXIT([this]() { this->tokenizing_header_ = false; });
 
-    switch (token) {
-    // avoid compiler warnings [-Wswitch]
-    case TOKEN_EOF:
-    case TOKEN_UNKNOWN:
-    case TOKEN_PAYLOAD:
-    case TOKEN_MESSAGE_SEPARATOR:
-    case TOKEN_MAXVAL:
-        assert(0);
-        break;
-
-    case TOKEN_A_A:
-        DS_ADD_MSG(Topic::AUTH, Action::REQUEST, true);
-        break;
-
-    case TOKEN_A_E_IAD:
-        DS_ADD_MSG(Topic::AUTH, Action::ERROR_INVALID_AUTH_DATA);
-        break;
-
-    case TOKEN_A_E_IAM:
-        DS_ADD_MSG(Topic::AUTH, Action::ERROR_INVALID_AUTH_MSG);
-        break;
+    // the headers are stored in the order of the header tokens
+    const deepstream::Message::Header* headers =
+        deepstream::Message::Header::all().first;
 
-    case TOKEN_A_E_TMAA:
-        DS_ADD_MSG(Topic::AUTH, Action::ERROR_TOO_MANY_AUTH_ATTEMPTS);
-        break;
-
-    case TOKEN_A_REQ:
-        DS_ADD_MSG(Topic::AUTH, Action::REQUEST);
-        break;
-
-    case TOKEN_C_A:
-        DS_ADD_MSG(Topic::CONNECTION, Action::CHALLENGE_RESPONSE, true);
-        break;
-
-    case TOKEN_C_CH:
-        DS_ADD_MSG(Topic::CONNECTION, Action::CHALLENGE);
-        break;
-
-    case TOKEN_C_CHR:
-        DS_ADD_MSG(Topic::CONNECTION, Action::CHALLENGE_RESPONSE);
-        break;
-
-    case TOKEN_C_PI:
-        DS_ADD_MSG(Topic::CONNECTION, Action::PING);
-        break;
-
-    case TOKEN_C_PO:
-        DS_ADD_MSG(Topic::CONNECTION, Action::PONG);
-        break;
-
-    case TOKEN_C_RED:
-        DS_ADD_MSG(Topic::CONNECTION, Action::REDIRECT);
-        break;
-
-    case TOKEN_C_REJ:
-        DS_ADD_MSG(Topic::CONNECTION, Action::REJECT);
-        break;
-
-    case TOKEN_E_A_L:
-        DS_ADD_MSG(Topic::EVENT, Action::LISTEN, true);
-        break;
-
-    case TOKEN_E_A_S:
-        DS_ADD_MSG(Topic::EVENT, Action::SUBSCRIBE, true);
-        break;
-
-    case TOKEN_E_A_US:
-        DS_ADD_MSG(Topic::EVENT, Action::UNSUBSCRIBE, true);
-        break;
-
-    case TOKEN_E_EVT:
-        DS_ADD_MSG(Topic::EVENT, Action::EVENT);
-        break;
-
-    case TOKEN_E_L:
-        DS_ADD_MSG(Topic::EVENT, Action::LISTEN);
-        break;
-
-    case TOKEN_E_LA:
-        DS_ADD_MSG(Topic::EVENT, Action::LISTEN_ACCEPT);
-        break;
-
-    case TOKEN_E_LR:
-        DS_ADD_MSG(Topic::EVENT, Action::LISTEN_REJECT);
-        break;
-
-    case TOKEN_E_S:
-        DS_ADD_MSG(Topic::EVENT, Action::SUBSCRIBE);
-        break;
-
-    case TOKEN_E_SP:
-        DS_ADD_MSG(Topic::EVENT, Action::SUBSCRIPTION_FOR_PATTERN_FOUND);
-        break;
-
-    case TOKEN_E_SR:
-        DS_ADD_MSG(Topic::EVENT, Action::SUBSCRIPTION_FOR_PATTERN_REMOVED);
-        break;
-
-    case TOKEN_E_US:
-        DS_ADD_MSG(Topic::EVENT, Action::UNSUBSCRIBE);
-        break;
-
-    case TOKEN_U_A_S:
-        DS_ADD_MSG(Topic::PRESENCE, Action::SUBSCRIBE, true);
-        break;
-
-    case TOKEN_U_A_US:
-        DS_ADD_MSG(Topic::PRESENCE, Action::UNSUBSCRIBE, true);
-        break;
-
-    case TOKEN_U_PNJ:
-        DS_ADD_MSG(Topic::PRESENCE, Action::PRESENCE_JOIN);
-        break;
-
-    case TOKEN_U_PNL:
-        DS_ADD_MSG(Topic::PRESENCE, Action::PRESENCE_LEAVE);
-        break;
-
-    case TOKEN_U_Q:
-        DS_ADD_MSG(Topic::PRESENCE, Action::QUERY);
-        break;
-
-    case TOKEN_U_S:
-        DS_ADD_MSG(Topic::PRESENCE, Action::SUBSCRIBE);
-        break;
-
-    case TOKEN_U_US:
-        DS_ADD_MSG(Topic::PRESENCE, Action::UNSUBSCRIBE);
-        break;
-    }
+    add_message(headers[DS_HEADER_INDEX(token)]);
 
 #ifndef NDEBUG
     const auto& msg = messages_.back();
-    const char* p = msg.header().to_string();
-    deepstream::Buffer bin = deepstream::Message::from_human_readable(p);
+    deepstream::Buffer bin = msg.header().to_binary();
 
     assert(textlen == msg.header().size());
     assert(textlen == bin.size());
@@ -421,10 +475,15 @@ void deepstream_parser_state::handle_message_separator(deepstream_token token,
     std::size_t min_num_args = expected_num_args.first;
     std::size_t max_num_args = expected_num_args.second;
 
-    if (num_args >= min_num_args && num_args <= max_num_args)
+    if (num_args >= min_num_args && num_args <= max_num_args) {
+        if (handler_) {
+            DEEPSTREAM_ON_EXIT([this]() { this->pop_message(); });
+            handler_->handle_message(msg);
+        }
+
         return;
+    }
 
-    messages_.pop_back();
-    errors_.emplace_back(msg_offset, msg_size,
-        Error::INVALID_NUMBER_OF_ARGUMENTS);
+    pop_message();
+    add_error(msg_offset, msg_size, Error::INVALID_NUMBER_OF_ARGUMENTS);
 }
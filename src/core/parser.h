@@ -27,6 +27,8 @@
 #include <stddef.h>
 #include <stdio.h>
 
+#include "protocol.h"
+
 #if __cplusplus
 extern "C" {
 #endif
@@ -35,6 +37,8 @@ struct deepstream_parser_state;
 
 /**
  * This enumeration contains all tokens that are recognized by the scanner.
+ * There is one token for every message header in `protocol.h` and the header
+ * tokens follow `TOKEN_MESSAGE_SEPARATOR` in the order of that list.
  *
  * The use of `UCHAR_MAX` below is motivated by the functions in, e.g.,
  * `ctype.h` which assume char values in the interval [0, 255]. GNU Bison uses
@@ -46,39 +50,10 @@ enum deepstream_token {
     TOKEN_PAYLOAD,
     TOKEN_MESSAGE_SEPARATOR,
 
-    TOKEN_A_A,
-    TOKEN_A_E_IAM, // A|E|INVALID_AUTH_MSG
-    TOKEN_A_E_IAD, // A|E|INVALID_AUTH_DATA
-    TOKEN_A_E_TMAA, // A|E|TOO_MANY_AUTH_ATTEMPTS
-    TOKEN_A_REQ,
-
-    TOKEN_C_A,
-    TOKEN_C_CH,
-    TOKEN_C_CHR,
-    TOKEN_C_PI,
-    TOKEN_C_PO,
-    TOKEN_C_RED,
-    TOKEN_C_REJ,
-
-    TOKEN_E_A_L,
-    TOKEN_E_A_S,
-    TOKEN_E_A_US,
-    TOKEN_E_EVT,
-    TOKEN_E_L,
-    TOKEN_E_LA,
-    TOKEN_E_LR,
-    TOKEN_E_S,
-    TOKEN_E_SP,
-    TOKEN_E_SR,
-    TOKEN_E_US,
+#define DS_TOKEN(TOKEN, ...) TOKEN,
+    DEEPSTREAM_PROTOCOL(DS_TOKEN, "")
+#undef DS_TOKEN
 
-    TOKEN_U_A_S,
-    TOKEN_U_A_US,
-    TOKEN_U_PNJ,
-    TOKEN_U_PNL,
-    TOKEN_U_Q,
-    TOKEN_U_S,
-    TOKEN_U_US,
     /**
      * The following token is a dummy value for development purposes, e.g.,
      * the number of valid tokens is TOKENS_MAXVAL - TOKEN_UNKNOWN + 1.
@@ -88,6 +63,11 @@ enum deepstream_token {
 
 bool is_header_token(enum deepstream_token);
 
+/**
+ * This macro returns the position of the header token in `protocol.h`.
+ */
+#define DS_HEADER_INDEX(TOKEN) ((size_t)((TOKEN)-TOKEN_MESSAGE_SEPARATOR - 1))
+
 /**
  * The callback handed to the scanner.
  */
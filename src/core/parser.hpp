@@ -18,10 +18,14 @@
 
 #include <cstddef>
 
+#include <exception>
 #include <iosfwd>
+#include <utility>
 
+#include <deepstream/core/buffer.hpp>
 #include "message_proxy.hpp"
 #include "parser.h"
+#include "scanner.h"
 
 namespace deepstream {
 namespace parser {
@@ -51,6 +55,23 @@ namespace parser {
     typedef std::vector<deepstream::parser::MessageProxy> MessageList;
     typedef std::vector<deepstream::parser::Error> ErrorList;
 
+    /**
+     * This interface receives the results of the push-style parser: every
+     * message is handed over as soon as its record separator was scanned
+     * and errors are handed over as soon as they are detected.
+     */
+    struct Handler {
+        virtual ~Handler() = default;
+
+        /**
+         * The message and the memory it references are only valid during
+         * the call.
+         */
+        virtual void handle_message(const MessageProxy&) = 0;
+
+        virtual void handle_error(const Error&) = 0;
+    };
+
     /**
      * This function returns the contents of a serialized deepstream
      * message.
@@ -77,6 +98,15 @@ struct deepstream_parser_state {
      */
     explicit deepstream_parser_state(const char* p, std::size_t sz);
 
+    /**
+     * Prepares the parser for a new input. The capacity of the message list,
+     * the error list, and of the argument lists of the messages is kept.
+     *
+     * @param[in] p A reference to an array of size sz
+     * @param[in] sz The size of the array referenced by p
+     */
+    void reset(const char* p, std::size_t sz);
+
     // the lexer modifies its input. thus, the lexer works with a copy of the
     // input so the argument text cannot be assumed to be a substring of buffer_
     // starting at offset_.
@@ -90,14 +120,161 @@ struct deepstream_parser_state {
 
     void handle_message_separator(deepstream_token, const char*, std::size_t);
 
-    const char* const buffer_;
-    const std::size_t buffer_size_;
+    void add_message(const deepstream::Message::Header&);
+
+    void pop_message();
+
+    void add_error(std::size_t offset, std::size_t size,
+        deepstream::parser::Error::Tag);
+
+    const char* buffer_;
+    std::size_t buffer_size_;
 
     bool tokenizing_header_;
     std::size_t offset_; ///< number of bytes in `buffer_` consumed so far
 
+    /**
+     * If a handler is set, complete messages and errors are handed to the
+     * handler instead of being stored in `messages_` and `errors_`.
+     */
+    deepstream::parser::Handler* handler_;
+
+    /**
+     * An exception thrown while handling a token; it must not propagate
+     * through the scanner (C code) so it is stored and scanning stops.
+     */
+    std::exception_ptr exception_;
+
     MessageList messages_;
     ErrorList errors_;
+
+    /**
+     * argument lists of discarded messages; they are handed to new
+     * messages so that their storage is reused
+     */
+    std::vector<deepstream::parser::MessageProxy::LocationList> spare_arguments_;
 };
 
+namespace deepstream {
+namespace parser {
+    /**
+     * This class holds everything needed for parsing that can outlive a
+     * single input: the scanner, the parser state, and the storage of the
+     * parsed messages. It is meant to be long-lived; after the first few
+     * inputs, parsing does not allocate memory anymore.
+     */
+    struct Context {
+        Context(const Context&) = delete;
+
+    public:
+        Context();
+
+        ~Context();
+
+        /**
+         * Parses the given input. The results are available until the next
+         * call of this method or of clear().
+         *
+         * @param[in] p The last two characters must be zero
+         * @param[in] sz The size of the array referenced by p
+         */
+        void execute(char* p, std::size_t sz);
+
+        /**
+         * Parses the given input and hands every message and every error
+         * to the handler right away; nothing is stored in the context.
+         * Exceptions thrown by the handler abort parsing and are rethrown.
+         */
+        void execute(char* p, std::size_t sz, Handler&);
+
+        /**
+         * Discards the results of the last call to execute().
+         */
+        void clear();
+
+        const MessageList& messages() const { return state_.messages_; }
+
+        const ErrorList& errors() const { return state_.errors_; }
+
+    private:
+        void reset_scanner();
+
+        yyscan_t scanner_;
+        State state_;
+    };
+
+    /**
+     * This class parses a stream of deepstream messages that arrives in
+     * chunks, e.g., WebSocket frames, where a message may be split across
+     * chunks.
+     *
+     * The record separator cannot occur inside a message so everything up
+     * to the last record separator of a chunk consists of complete
+     * messages. Only this part is handed to the scanner; the incomplete
+     * tail is stored and prepended to the next chunk. Thus, every message
+     * is returned by the call that supplies its record separator and no
+     * byte is scanned twice.
+     */
+    struct Stream {
+        Stream(const Stream&) = delete;
+
+    public:
+        Stream();
+
+        /**
+         * Parses the complete messages in the given chunk including the
+         * stored tail of the previous chunks.
+         *
+         * The messages in the returned context reference memory that is
+         * valid until the next call to this method.
+         *
+         * @param[in] p A chunk of size sz followed by two writable bytes.
+         * The chunk is parsed in place if there is no stored tail so its
+         * contents may be modified.
+         * @param[in] sz The size of the chunk
+         */
+        const Context& feed(char* p, std::size_t sz);
+
+        /**
+         * Like feed() above but the complete messages are handed to the
+         * handler, see Context::execute().
+         */
+        void feed(char* p, std::size_t sz, Handler&);
+
+        /**
+         * Discards the stored tail, e.g., after reconnecting.
+         */
+        void reset();
+
+        /**
+         * The input of the scanner in the last call to feed(); error
+         * locations refer to this array.
+         */
+        const char* data() const { return data_; }
+
+        std::size_t size() const { return size_; }
+
+        /**
+         * The number of bytes of incomplete messages.
+         */
+        std::size_t pending() const { return pending_.size(); }
+
+    private:
+        /**
+         * Splits the chunk into complete messages and a new tail; returns
+         * false if the chunk does not complete any message.
+         */
+        bool assemble(char* p, std::size_t sz);
+
+        Context context_;
+
+        char* data_;
+        std::size_t size_;
+
+        Buffer input_;
+        Buffer pending_;
+    };
+}
+}
+
 #endif
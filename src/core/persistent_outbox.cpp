@@ -0,0 +1,434 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cassert>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <system_error>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <deepstream/core/persistent_outbox.hpp>
+
+#include "message.hpp"
+
+namespace deepstream {
+
+const std::size_t PersistentOutbox::DEFAULT_SEGMENT_SIZE;
+
+namespace {
+    const char CHECKPOINT_FILE[] = "checkpoint";
+    const char SEGMENT_SUFFIX[] = ".seg";
+    // the segment name is the base offset as 16 hexadecimal digits
+    const std::size_t SEGMENT_NAME_SIZE = 16 + sizeof(SEGMENT_SUFFIX) - 1;
+
+    std::system_error system_error(const std::string& what)
+    {
+        return std::system_error(errno, std::system_category(), what);
+    }
+
+    std::size_t page_size()
+    {
+        static const std::size_t size = sysconf(_SC_PAGESIZE);
+        return size;
+    }
+
+    void sync_range(char* data, std::size_t begin, std::size_t end)
+    {
+        if (begin >= end)
+            return;
+
+        // msync() requires a page-aligned address
+        const std::size_t aligned_begin = begin - begin % page_size();
+
+        if (msync(data + aligned_begin, end - aligned_begin, MS_SYNC) != 0)
+            throw system_error("msync");
+    }
+
+    /**
+     * @return The size of the complete messages among the first `size`
+     * bytes of the segment
+     */
+    std::size_t recover_size(const char* data, std::size_t size)
+    {
+        // after a system crash, the checkpoint may have reached the disk
+        // before the messages
+        while (size > 0 && data[size - 1] != ASCII_RECORD_SEPARATOR)
+            --size;
+
+        return size;
+    }
+
+    /**
+     * @return The end of the last message starting before `begin + max_size`
+     * or the end of the first message
+     */
+    std::size_t find_run_end(const char* data, std::size_t begin, std::size_t end,
+        std::size_t max_size)
+    {
+        assert(begin < end);
+
+        std::size_t run_end = (end - begin > max_size) ? begin + max_size : end;
+
+        while (run_end > begin && data[run_end - 1] != ASCII_RECORD_SEPARATOR)
+            --run_end;
+
+        if (run_end > begin)
+            return run_end;
+
+        // the first message is larger than the maximum size
+        const void* p = std::memchr(data + begin, ASCII_RECORD_SEPARATOR, end - begin);
+        assert(p);
+        return static_cast<const char*>(p) - data + 1;
+    }
+}
+
+PersistentOutbox::PersistentOutbox(const std::string& directory, const Options& options)
+    : directory_(directory)
+    , options_(options)
+    , checkpoint_fd_(-1)
+    , checkpoint_(nullptr)
+    , acknowledged_(0)
+    , end_(0)
+    , synced_size_(0)
+    , last_sync_(std::chrono::steady_clock::now())
+    , num_dropped_bytes_(0)
+{
+    assert(options_.segment_size > 0);
+    assert(options_.max_segments > 0);
+
+    if (mkdir(directory_.c_str(), 0777) != 0 && errno != EEXIST)
+        throw system_error("mkdir " + directory_);
+
+    const std::string checkpoint_path = directory_ + "/" + CHECKPOINT_FILE;
+    checkpoint_fd_ = open(checkpoint_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (checkpoint_fd_ < 0)
+        throw system_error("open " + checkpoint_path);
+
+    // a new file is zero-filled
+    void* p = nullptr;
+    if (ftruncate(checkpoint_fd_, sizeof(Checkpoint)) != 0
+        || (p = mmap(nullptr, sizeof(Checkpoint), PROT_READ | PROT_WRITE,
+                MAP_SHARED, checkpoint_fd_, 0)) == MAP_FAILED) {
+        const std::system_error e = system_error("map " + checkpoint_path);
+        close(checkpoint_fd_);
+        throw e;
+    }
+    checkpoint_ = static_cast<Checkpoint*>(p);
+
+    try {
+        recover();
+    } catch (...) {
+        for (Segment& segment : segments_)
+            close_segment(segment);
+        munmap(checkpoint_, sizeof(Checkpoint));
+        close(checkpoint_fd_);
+        throw;
+    }
+}
+
+PersistentOutbox::~PersistentOutbox()
+{
+    try {
+        sync();
+    } catch (const std::system_error&) {
+        // the messages since the last sync may be lost if the system crashes
+    }
+
+    for (Segment& segment : segments_)
+        close_segment(segment);
+
+    munmap(checkpoint_, sizeof(Checkpoint));
+    close(checkpoint_fd_);
+}
+
+void PersistentOutbox::recover()
+{
+    acknowledged_ = checkpoint_->acknowledged;
+
+    DIR* dir = opendir(directory_.c_str());
+    if (!dir)
+        throw system_error("opendir " + directory_);
+
+    std::vector<std::uint64_t> bases;
+    while (const dirent* entry = readdir(dir)) {
+        const std::size_t size = std::strlen(entry->d_name);
+        std::uint64_t base = 0;
+
+        if (size == SEGMENT_NAME_SIZE
+            && std::strcmp(entry->d_name + 16, SEGMENT_SUFFIX) == 0
+            && std::sscanf(entry->d_name, "%16" SCNx64, &base) == 1)
+            bases.push_back(base);
+    }
+    closedir(dir);
+
+    std::sort(bases.begin(), bases.end());
+
+    for (std::uint64_t base : bases) {
+        Segment segment = open_segment(base, false);
+
+        if (!segments_.empty()) {
+            Segment& previous = segments_.back();
+
+            if (base - previous.base <= previous.capacity) {
+                // a segment is rotated when the next message does not fit
+                previous.size = base - previous.base;
+            } else {
+                // the offsets are not contiguous: the older segments are stale
+                for (Segment& s : segments_) {
+                    close_segment(s);
+                    unlink(segment_path(s.base).c_str());
+                }
+                segments_.clear();
+            }
+        }
+
+        segments_.push_back(segment);
+    }
+
+    if (segments_.empty())
+        segments_.push_back(open_segment(acknowledged_, true));
+
+    Segment& last = segments_.back();
+    const std::uint64_t end = checkpoint_->end;
+
+    // the end offset is written after every message; the process may have
+    // stopped in the middle of a message after it
+    if (end > last.base && end - last.base <= last.capacity) {
+        last.size = recover_size(last.data, end - last.base);
+    } else {
+        // the checkpoint was lost or nothing was written to the segment: the
+        // unused tail of a segment is zero-filled, thus the messages end at
+        // the last separator
+        last.size = recover_size(last.data, last.capacity);
+    }
+
+    end_ = last.base + last.size;
+    checkpoint_->end = end_;
+
+    if (acknowledged_ < segments_.front().base || acknowledged_ > end_) {
+        // the checkpoint does not belong to the segments
+        acknowledge(segments_.front().base);
+    }
+
+    remove_sent_segments();
+    synced_size_ = segments_.back().size;
+}
+
+PersistentOutbox::Segment PersistentOutbox::open_segment(std::uint64_t base, bool create)
+{
+    const std::string path = segment_path(base);
+    const int flags = O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_TRUNC : 0);
+
+    Segment segment{ base, open(path.c_str(), flags, 0666), nullptr, 0, 0 };
+    if (segment.fd < 0)
+        throw system_error("open " + path);
+
+    // without reserved blocks, a store into the mapping would raise SIGBUS
+    // if the disk is full; a segment that cannot be reserved stays empty
+    if (create && posix_fallocate(segment.fd, 0, options_.segment_size) != 0
+        && ftruncate(segment.fd, 0) != 0) {
+        const std::system_error e = system_error("truncate " + path);
+        close(segment.fd);
+        throw e;
+    }
+
+    struct stat st;
+    if (fstat(segment.fd, &st) != 0) {
+        const std::system_error e = system_error("stat " + path);
+        close(segment.fd);
+        throw e;
+    }
+
+    segment.capacity = st.st_size;
+
+    if (segment.capacity == 0) {
+        segment.data = nullptr;
+        return segment;
+    }
+
+    void* p = mmap(nullptr, segment.capacity, PROT_READ | PROT_WRITE, MAP_SHARED, segment.fd, 0);
+    if (p == MAP_FAILED) {
+        const std::system_error e = system_error("mmap " + path);
+        close(segment.fd);
+        throw e;
+    }
+
+    segment.data = static_cast<char*>(p);
+
+    return segment;
+}
+
+void PersistentOutbox::close_segment(Segment& segment)
+{
+    if (segment.data)
+        munmap(segment.data, segment.capacity);
+
+    close(segment.fd);
+    segment.fd = -1;
+    segment.data = nullptr;
+}
+
+std::string PersistentOutbox::segment_path(std::uint64_t base) const
+{
+    char name[SEGMENT_NAME_SIZE + 1];
+    std::snprintf(name, sizeof(name), "%016" PRIx64 "%s", base, SEGMENT_SUFFIX);
+
+    return directory_ + "/" + name;
+}
+
+bool PersistentOutbox::push(const Message& message)
+{
+    message_segments_.clear();
+    message.to_segments(message_segments_);
+
+    std::size_t size = 0;
+    for (const BufferView& segment : message_segments_)
+        size += segment.size();
+
+    if (size > options_.segment_size) {
+        num_dropped_bytes_ += size;
+        return false;
+    }
+
+    if (segments_.back().capacity - segments_.back().size < size)
+        rotate();
+
+    Segment& segment = segments_.back();
+    if (segment.capacity - segment.size < size) {
+        // the new segment could not be reserved
+        num_dropped_bytes_ += size;
+        return false;
+    }
+
+    for (const BufferView& s : message_segments_) {
+        std::memcpy(segment.data + segment.size, s.data(), s.size());
+        segment.size += s.size();
+    }
+    end_ += size;
+    checkpoint_->end = end_;
+
+    if (segment.size - synced_size_ >= options_.sync_bytes
+        || std::chrono::steady_clock::now() - last_sync_ >= options_.sync_interval)
+        sync();
+
+    return true;
+}
+
+bool PersistentOutbox::replay(const WriteFn& write, std::size_t max_write_size)
+{
+    assert(write);
+
+    bool ok = true;
+
+    for (std::size_t i = 0; ok && i < segments_.size() && acknowledged_ < end_; ++i) {
+        const Segment& segment = segments_[i];
+
+        if (acknowledged_ >= segment.base + segment.size)
+            continue;
+
+        std::size_t begin = acknowledged_ - segment.base;
+
+        while (begin < segment.size) {
+            const std::size_t end = find_run_end(segment.data, begin, segment.size, max_write_size);
+
+            if (!write(BufferView(segment.data + begin, end - begin))) {
+                ok = false;
+                break;
+            }
+
+            acknowledge(segment.base + end);
+            begin = end;
+        }
+    }
+
+    remove_sent_segments();
+    sync();
+
+    return ok;
+}
+
+void PersistentOutbox::sync()
+{
+    const Segment& segment = segments_.back();
+
+    sync_range(segment.data, synced_size_, segment.size);
+    synced_size_ = segment.size;
+
+    sync_range(reinterpret_cast<char*>(checkpoint_), 0, sizeof(Checkpoint));
+
+    last_sync_ = std::chrono::steady_clock::now();
+}
+
+void PersistentOutbox::rotate()
+{
+    sync();
+
+    // an empty segment is too small, e.g., it was created with other options
+    // or it could not be reserved
+    if (segments_.back().size == 0) {
+        close_segment(segments_.back());
+        unlink(segment_path(segments_.back().base).c_str());
+        segments_.pop_back();
+    }
+
+    while (!segments_.empty() && segments_.size() >= options_.max_segments) {
+        Segment& oldest = segments_.front();
+        const std::uint64_t oldest_end = oldest.base + oldest.size;
+
+        if (acknowledged_ < oldest_end) {
+            num_dropped_bytes_ += oldest_end - acknowledged_;
+            acknowledge(oldest_end);
+        }
+
+        close_segment(oldest);
+        unlink(segment_path(oldest.base).c_str());
+        segments_.pop_front();
+    }
+
+    segments_.push_back(open_segment(end_, true));
+    synced_size_ = 0;
+
+    remove_sent_segments();
+}
+
+void PersistentOutbox::remove_sent_segments()
+{
+    while (segments_.size() > 1
+        && segments_.front().base + segments_.front().size <= acknowledged_) {
+        Segment& segment = segments_.front();
+
+        close_segment(segment);
+        unlink(segment_path(segment.base).c_str());
+        segments_.pop_front();
+    }
+}
+
+void PersistentOutbox::acknowledge(std::uint64_t offset)
+{
+    assert(offset >= acknowledged_ || offset == segments_.front().base);
+
+    acknowledged_ = offset;
+    checkpoint_->acknowledged = offset;
+}
+}
@@ -16,9 +16,12 @@
 #include <cstdio>
 
 #include <algorithm>
+#include <memory>
 #include <stdexcept>
+#include <utility>
 
 #include <deepstream/core/buffer.hpp>
+#include <deepstream/core/name_table.hpp>
 #include "message_builder.hpp"
 #include <deepstream/core/presence.hpp>
 
@@ -26,9 +29,43 @@
 
 namespace deepstream {
 
-Presence::Presence(const SendFn& send, SubscriptionId &subscription_counter)
+namespace {
+    /**
+     * Notifies the presence subscribers on the thread of an executor.
+     */
+    struct NotificationTask {
+        void operator()() const
+        {
+            for (const Presence::SubscribeFn& callback : *p_callbacks)
+                callback(user, is_login);
+        }
+
+        std::shared_ptr<const Presence::SubscriberList::Snapshot> p_callbacks;
+        Buffer user;
+        bool is_login;
+    };
+
+    /**
+     * Answers presence queries on the thread of an executor.
+     */
+    struct QueryTask {
+        void operator()() const
+        {
+            const Presence::UserList user_list(users.cbegin(), users.cend());
+
+            for (const Presence::QueryFn& f : querents)
+                f(user_list);
+        }
+
+        Presence::QuerentList querents;
+        std::vector<Buffer> users;
+    };
+}
+
+Presence::Presence(const SendFn& send, SubscriptionSlots &subscription_slots)
     : send_(send)
-    , subscription_counter_(subscription_counter)
+    , subscribers_(subscription_slots)
+    , p_executor_(nullptr)
 {
     assert(send_);
 }
@@ -39,40 +76,21 @@ Presence::~Presence()
 
 SubscriptionId Presence::subscribe(const SubscribeFn callback)
 {
-    const SubscriptionId subscription_id = subscription_counter_++;
-
-    const auto insert_result =
-        subscribe_fn_map_.insert(std::make_pair(subscription_id, callback));
-    const bool insert_success = insert_result.second;
-    assert(insert_success);
-
     if (subscribers_.empty()) {
         MessageBuilder presence_subscribe(Topic::PRESENCE, Action::SUBSCRIBE);
         send_(presence_subscribe);
     }
 
-    subscribers_.push_back(subscription_id);
-
-    return subscription_id;
+    return subscribers_.add(callback);
 }
 
 void Presence::unsubscribe(const SubscriptionId subscription_id)
 {
-    assert(subscribe_fn_map_.size() == subscribers_.size());
-
-    auto sub_it = std::find(subscribers_.begin(), subscribers_.end(), subscription_id);
-
-    if (sub_it == subscribers_.end()) {
+    if (!subscribers_.remove(subscription_id)) {
         // TODO: warn, subscription did not exist
         return;
     }
 
-    subscribers_.erase(sub_it);
-
-    // delete the callback
-    const size_t removed = subscribe_fn_map_.erase(subscription_id);
-    assert(removed == 1);
-
     if (subscribers_.empty()) {
         MessageBuilder presence_unsubscribe(Topic::PRESENCE, Action::UNSUBSCRIBE);
         send_(presence_unsubscribe);
@@ -81,9 +99,6 @@ void Presence::unsubscribe(const SubscriptionId subscription_id)
 
 void Presence::unsubscribe()
 {
-    assert(subscribe_fn_map_.size() == subscribers_.size());
-
-    subscribe_fn_map_.clear();
     subscribers_.clear();
 
     MessageBuilder presence_unsubscribe(Topic::PRESENCE, Action::UNSUBSCRIBE);
@@ -101,6 +116,11 @@ void Presence::get_all(const QueryFn& f)
     }
 }
 
+void Presence::executor(Executor* p_executor)
+{
+    p_executor_ = p_executor;
+}
+
 void Presence::notify_(const Message& message)
 {
     assert(message.topic() == Topic::PRESENCE);
@@ -110,10 +130,22 @@ void Presence::notify_(const Message& message)
     if (message.action() == Action::UNSUBSCRIBE && message.is_ack())
         return;
 
+    if (message.action() == Action::QUERY && p_executor_) {
+        QueryTask task;
+        task.querents.swap(querents_);
+        for (std::size_t i = 0; i < message.num_arguments(); ++i)
+            task.users.emplace_back(message[i]);
+
+        // queries are not related to a user name
+        p_executor_->execute(0, std::move(task));
+        return;
+    }
+
     if (message.action() == Action::QUERY) {
         UserList users;
+        users.reserve(message.num_arguments());
         for (std::size_t i = 0; i < message.num_arguments(); ++i)
-            users.emplace_back(message[i]);
+            users.push_back(message[i]);
 
         for (const QueryFn& f : querents_)
             f(users);
@@ -129,13 +161,14 @@ void Presence::notify_(const Message& message)
 
     bool is_login = message.action() == Action::PRESENCE_JOIN;
 
-    // copy the list because subscribers may unsubscribe in the range-based for
-    // loop  below
-    SubscriberList subscribers(subscribers_);
-
-    for (const SubscriptionId id : subscribers) {
-        SubscribeFn &callback = subscribe_fn_map_[id];
-        callback(message[0], is_login);
+    if (p_executor_) {
+        const BufferView user = message[0];
+        NotificationTask task{ subscribers_.snapshot(), Buffer(user), is_login };
+        p_executor_->execute(NameTable::hash_of(user), std::move(task));
+        return;
     }
+
+    // subscribers may unsubscribe during the notification
+    subscribers_.notify(message[0], is_login);
 }
 }
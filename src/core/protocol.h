@@ -0,0 +1,83 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEEPSTREAM_PROTOCOL_H
+#define DEEPSTREAM_PROTOCOL_H
+
+/**
+ * @file
+ *
+ * This header contains the only description of the deepstream message headers
+ * known to the client. It is shared by the C scanner and the C++ code: the
+ * scanner token enumeration, the scanner header table, `Message::Header`
+ * (string and binary representation), and the argument count checks are all
+ * generated from the list below.
+ *
+ * `DEEPSTREAM_PROTOCOL(X, S)` invokes the macro `X` once for every message
+ * header with the arguments
+ * - scanner token,
+ * - topic (a `deepstream::Topic` enumerator),
+ * - action (a `deepstream::Action` enumerator),
+ * - acknowledgement flag,
+ * - header string with the separator `S` between the header parts,
+ * - minimum number of arguments,
+ * - maximum number of arguments.
+ *
+ * The list order follows from lexicographical ordering of the headers, i.e.,
+ * A|A <= A|E|INVALID_AUTH_DATA <= A|REQ <= C|A ...
+ *
+ * The Flex scanner `lexer.l` cannot include this list; its rules must be kept
+ * in sync by hand (the lexer unit tests check every header).
+ */
+
+#define DEEPSTREAM_PROTOCOL(X, S)                                                   \
+    X(TOKEN_A_A, AUTH, REQUEST, 1, "A" S "A", 0, 1)                                 \
+    X(TOKEN_A_E_IAD, AUTH, ERROR_INVALID_AUTH_DATA, 0,                              \
+        "A" S "E" S "INVALID_AUTH_DATA", 1, 1)                                      \
+    X(TOKEN_A_E_IAM, AUTH, ERROR_INVALID_AUTH_MSG, 0,                               \
+        "A" S "E" S "INVALID_AUTH_MSG", 1, 1)                                       \
+    X(TOKEN_A_E_TMAA, AUTH, ERROR_TOO_MANY_AUTH_ATTEMPTS, 0,                        \
+        "A" S "E" S "TOO_MANY_AUTH_ATTEMPTS", 1, 1)                                 \
+    X(TOKEN_A_REQ, AUTH, REQUEST, 0, "A" S "REQ", 1, 1)                             \
+                                                                                    \
+    X(TOKEN_C_A, CONNECTION, CHALLENGE_RESPONSE, 1, "C" S "A", 0, 0)                \
+    X(TOKEN_C_CH, CONNECTION, CHALLENGE, 0, "C" S "CH", 0, 0)                       \
+    X(TOKEN_C_CHR, CONNECTION, CHALLENGE_RESPONSE, 0, "C" S "CHR", 1, 1)            \
+    X(TOKEN_C_PI, CONNECTION, PING, 0, "C" S "PI", 0, 0)                            \
+    X(TOKEN_C_PO, CONNECTION, PONG, 0, "C" S "PO", 0, 0)                            \
+    X(TOKEN_C_RED, CONNECTION, REDIRECT, 0, "C" S "RED", 1, 1)                      \
+    X(TOKEN_C_REJ, CONNECTION, REJECT, 0, "C" S "REJ", 0, 1)                        \
+                                                                                    \
+    X(TOKEN_E_A_L, EVENT, LISTEN, 1, "E" S "A" S "L", 1, 1)                         \
+    X(TOKEN_E_A_S, EVENT, SUBSCRIBE, 1, "E" S "A" S "S", 1, 1)                      \
+    X(TOKEN_E_A_US, EVENT, UNSUBSCRIBE, 1, "E" S "A" S "US", 1, 1)                  \
+    X(TOKEN_E_EVT, EVENT, EVENT, 0, "E" S "EVT", 2, 2)                              \
+    X(TOKEN_E_L, EVENT, LISTEN, 0, "E" S "L", 1, 1)                                 \
+    X(TOKEN_E_LA, EVENT, LISTEN_ACCEPT, 0, "E" S "LA", 2, 2)                        \
+    X(TOKEN_E_LR, EVENT, LISTEN_REJECT, 0, "E" S "LR", 2, 2)                        \
+    X(TOKEN_E_S, EVENT, SUBSCRIBE, 0, "E" S "S", 1, 1)                              \
+    X(TOKEN_E_SP, EVENT, SUBSCRIPTION_FOR_PATTERN_FOUND, 0, "E" S "SP", 2, 2)       \
+    X(TOKEN_E_SR, EVENT, SUBSCRIPTION_FOR_PATTERN_REMOVED, 0, "E" S "SR", 2, 2)     \
+    X(TOKEN_E_US, EVENT, UNSUBSCRIBE, 0, "E" S "US", 1, 1)                          \
+                                                                                    \
+    X(TOKEN_U_A_S, PRESENCE, SUBSCRIBE, 1, "U" S "A" S "S", 1, 1)                   \
+    X(TOKEN_U_A_US, PRESENCE, UNSUBSCRIBE, 1, "U" S "A" S "US", 1, 1)               \
+    X(TOKEN_U_PNJ, PRESENCE, PRESENCE_JOIN, 0, "U" S "PNJ", 1, 1)                   \
+    X(TOKEN_U_PNL, PRESENCE, PRESENCE_LEAVE, 0, "U" S "PNL", 1, 1)                  \
+    X(TOKEN_U_Q, PRESENCE, QUERY, 0, "U" S "Q", 0, SIZE_MAX)                        \
+    X(TOKEN_U_S, PRESENCE, SUBSCRIBE, 0, "U" S "S" S "S", 0, 0)                     \
+    X(TOKEN_U_US, PRESENCE, UNSUBSCRIBE, 0, "U" S "US" S "US", 0, 0)
+
+#endif
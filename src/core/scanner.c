@@ -0,0 +1,449 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * A hand-written replacement for the Flex scanner in `lexer.l`. It returns
+ * exactly the same token stream (token, text, and length) but it does not
+ * walk the payload through a state machine: the only characters that end a
+ * payload are the unit separator and the record separator, and both are found
+ * 16 (SSE2) or 32 (AVX2) bytes at a time. Table matching is only done for the
+ * short message header.
+ *
+ * The vector instruction set is selected at run-time in `yylex_init()`; the
+ * scalar code is used on other architectures.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "scanner.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DEEPSTREAM_SCANNER_X86 1
+#include <immintrin.h>
+#endif
+
+/* `__builtin_cpu_supports()` and `target` attributes */
+#if defined(DEEPSTREAM_SCANNER_X86)
+#if defined(__clang__)
+#if __clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8)
+#define DEEPSTREAM_SCANNER_AVX2 1
+#endif
+#elif __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define DEEPSTREAM_SCANNER_AVX2 1
+#endif
+#endif
+
+/* message part separator */
+#define MPS "\x1f"
+
+enum { ASCII_RECORD_SEPARATOR = 0x1e, ASCII_UNIT_SEPARATOR = 0x1f };
+
+/*
+ * Returns a pointer to the first record separator or unit separator in
+ * [first, last) or `last` if there is none.
+ */
+typedef const char* (*find_fn)(const char* first, const char* last);
+
+struct yy_buffer_state {
+    char* base;
+    /* input size without the two terminating null characters */
+    size_t size;
+    char* position;
+};
+
+struct deepstream_scanner {
+    struct deepstream_parser_state* extra;
+    YY_BUFFER_STATE buffer;
+
+    /*
+     * The parser scans one buffer at a time so yy_scan_buffer() hands out
+     * this buffer state instead of allocating memory.
+     */
+    struct yy_buffer_state embedded_buffer;
+    int embedded_buffer_in_use;
+
+    char* text;
+    size_t leng;
+
+    /* corresponds to the Flex start condition yypayload */
+    int in_payload;
+
+    find_fn find_separator;
+    find_fn find_record_separator;
+};
+
+struct header {
+    const char* text;
+    size_t size;
+    enum deepstream_token token;
+};
+
+#define DS_HEADER(TOKEN, TOPIC, ACTION, IS_ACK, TEXT, MIN_ARGS, MAX_ARGS) \
+    { TEXT, sizeof(TEXT) - 1, TOKEN },
+
+static const struct header HEADERS[] = {
+    DEEPSTREAM_PROTOCOL(DS_HEADER, MPS)
+};
+
+#undef DS_HEADER
+
+static const size_t NUM_HEADERS = sizeof(HEADERS) / sizeof(HEADERS[0]);
+
+/*
+ * Returns the length of the longest header that is a prefix of [p, last) and
+ * stores its token or returns zero if there is no such header.
+ */
+static size_t match_header(const char* p, const char* last,
+    enum deepstream_token* token)
+{
+    const size_t available = (size_t)(last - p);
+    size_t match = 0;
+    size_t i;
+
+    assert(p < last);
+
+    for (i = 0; i < NUM_HEADERS; ++i) {
+        const struct header* h = &HEADERS[i];
+
+        if (h->text[0] != *p || h->size <= match || h->size > available)
+            continue;
+
+        if (memcmp(p, h->text, h->size) == 0) {
+            match = h->size;
+            *token = h->token;
+        }
+    }
+
+    return match;
+}
+
+static const char* find_separator_scalar(const char* first, const char* last)
+{
+    for (; first != last; ++first) {
+        if (*first == ASCII_RECORD_SEPARATOR || *first == ASCII_UNIT_SEPARATOR)
+            break;
+    }
+
+    return first;
+}
+
+static const char* find_record_separator_scalar(
+    const char* first, const char* last)
+{
+    const char* p = memchr(first, ASCII_RECORD_SEPARATOR, (size_t)(last - first));
+
+    return p ? p : last;
+}
+
+#ifdef __SSE2__
+/*
+ * The record separator 0x1e and the unit separator 0x1f differ only in the
+ * least significant bit so a single comparison after masking this bit finds
+ * both of them.
+ */
+static const char* find_separator_sse2(const char* first, const char* last)
+{
+    const __m128i mask = _mm_set1_epi8((char)0xfe);
+    const __m128i separator = _mm_set1_epi8(ASCII_RECORD_SEPARATOR);
+
+    for (; last - first >= 16; first += 16) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)first);
+        const __m128i eq = _mm_cmpeq_epi8(_mm_and_si128(chunk, mask), separator);
+        const int bits = _mm_movemask_epi8(eq);
+
+        if (bits)
+            return first + __builtin_ctz((unsigned)bits);
+    }
+
+    return find_separator_scalar(first, last);
+}
+
+static const char* find_record_separator_sse2(
+    const char* first, const char* last)
+{
+    const __m128i separator = _mm_set1_epi8(ASCII_RECORD_SEPARATOR);
+
+    for (; last - first >= 16; first += 16) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)first);
+        const int bits = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, separator));
+
+        if (bits)
+            return first + __builtin_ctz((unsigned)bits);
+    }
+
+    return find_record_separator_scalar(first, last);
+}
+#endif
+
+#ifdef DEEPSTREAM_SCANNER_AVX2
+__attribute__((target("avx2"))) static const char* find_separator_avx2(
+    const char* first, const char* last)
+{
+    const __m256i mask = _mm256_set1_epi8((char)0xfe);
+    const __m256i separator = _mm256_set1_epi8(ASCII_RECORD_SEPARATOR);
+
+    for (; last - first >= 32; first += 32) {
+        const __m256i chunk = _mm256_loadu_si256((const __m256i*)first);
+        const __m256i eq = _mm256_cmpeq_epi8(_mm256_and_si256(chunk, mask), separator);
+        const unsigned bits = (unsigned)_mm256_movemask_epi8(eq);
+
+        if (bits)
+            return first + __builtin_ctz(bits);
+    }
+
+    return find_separator_scalar(first, last);
+}
+
+__attribute__((target("avx2"))) static const char* find_record_separator_avx2(
+    const char* first, const char* last)
+{
+    const __m256i separator = _mm256_set1_epi8(ASCII_RECORD_SEPARATOR);
+
+    for (; last - first >= 32; first += 32) {
+        const __m256i chunk = _mm256_loadu_si256((const __m256i*)first);
+        const unsigned bits = (unsigned)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(chunk, separator));
+
+        if (bits)
+            return first + __builtin_ctz(bits);
+    }
+
+    return find_record_separator_scalar(first, last);
+}
+#endif
+
+static void select_implementation(struct deepstream_scanner* s)
+{
+    s->find_separator = find_separator_scalar;
+    s->find_record_separator = find_record_separator_scalar;
+
+#ifdef __SSE2__
+    s->find_separator = find_separator_sse2;
+    s->find_record_separator = find_record_separator_sse2;
+#endif
+
+#ifdef DEEPSTREAM_SCANNER_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        s->find_separator = find_separator_avx2;
+        s->find_record_separator = find_record_separator_avx2;
+    }
+#endif
+}
+
+/*
+ * Sets the current match and hands it to the parser; the `yyscanner`
+ * parameter is referenced by the DS_PARSE macro.
+ */
+static int emit(yyscan_t yyscanner, enum deepstream_token token, char* text,
+    size_t leng)
+{
+    struct deepstream_scanner* s = yyscanner;
+
+    s->text = text;
+    s->leng = leng;
+
+    return DS_PARSE(token);
+}
+
+int yylex_init(yyscan_t* scanner)
+{
+    struct deepstream_scanner* s;
+
+    if (!scanner) {
+        errno = EINVAL;
+        return 1;
+    }
+
+    s = calloc(1, sizeof(*s));
+    if (!s) {
+        errno = ENOMEM;
+        return 1;
+    }
+
+    select_implementation(s);
+    *scanner = s;
+
+    return 0;
+}
+
+int yylex_destroy(yyscan_t scanner)
+{
+    struct deepstream_scanner* s = scanner;
+
+    if (s->buffer)
+        yy_delete_buffer(s->buffer, scanner);
+
+    free(s);
+
+    return 0;
+}
+
+YY_BUFFER_STATE yy_scan_buffer(char* base, size_t size, yyscan_t scanner)
+{
+    struct deepstream_scanner* s = scanner;
+    YY_BUFFER_STATE buffer;
+
+    if (size < 2 || base[size - 2] || base[size - 1])
+        return NULL;
+
+    if (!s->embedded_buffer_in_use) {
+        buffer = &s->embedded_buffer;
+        s->embedded_buffer_in_use = 1;
+    } else {
+        buffer = malloc(sizeof(*buffer));
+        if (!buffer) {
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
+    buffer->base = base;
+    buffer->size = size - 2;
+    buffer->position = base;
+
+    yy_switch_to_buffer(buffer, scanner);
+
+    return buffer;
+}
+
+void yy_switch_to_buffer(YY_BUFFER_STATE buffer, yyscan_t scanner)
+{
+    struct deepstream_scanner* s = scanner;
+
+    s->buffer = buffer;
+}
+
+void yy_delete_buffer(YY_BUFFER_STATE buffer, yyscan_t scanner)
+{
+    struct deepstream_scanner* s = scanner;
+
+    if (!buffer)
+        return;
+
+    if (s->buffer == buffer)
+        s->buffer = NULL;
+
+    if (buffer == &s->embedded_buffer)
+        s->embedded_buffer_in_use = 0;
+    else
+        free(buffer);
+}
+
+void yyset_extra(struct deepstream_parser_state* extra, yyscan_t scanner)
+{
+    struct deepstream_scanner* s = scanner;
+
+    s->extra = extra;
+}
+
+struct deepstream_parser_state* yyget_extra(yyscan_t scanner)
+{
+    struct deepstream_scanner* s = scanner;
+
+    return s->extra;
+}
+
+char* yyget_text(yyscan_t scanner)
+{
+    struct deepstream_scanner* s = scanner;
+
+    return s->text;
+}
+
+int yyget_leng(yyscan_t scanner)
+{
+    struct deepstream_scanner* s = scanner;
+
+    return (int)s->leng;
+}
+
+int yylex(yyscan_t yyscanner)
+{
+    static char empty[2] = { 0, 0 };
+
+    struct deepstream_scanner* s = yyscanner;
+    YY_BUFFER_STATE buffer = s->buffer;
+    char* p;
+    char* last;
+    char* q;
+    enum deepstream_token token = TOKEN_UNKNOWN;
+    size_t size;
+
+    if (!buffer) {
+        (void)emit(yyscanner, TOKEN_EOF, empty, 1);
+        return 0;
+    }
+
+    p = buffer->position;
+    last = buffer->base + buffer->size;
+
+    /* like Flex, the text of the end-of-file token is the first sentinel */
+    if (p == last) {
+        s->in_payload = 0;
+        (void)emit(yyscanner, TOKEN_EOF, last, 1);
+        return 0;
+    }
+
+    if (s->in_payload) {
+        if (*p == ASCII_UNIT_SEPARATOR) {
+            q = (char*)s->find_separator(p + 1, last);
+
+            if (q != p + 1) {
+                buffer->position = q;
+                return emit(yyscanner, TOKEN_PAYLOAD, p, (size_t)(q - p));
+            }
+        } else if (*p == ASCII_RECORD_SEPARATOR) {
+            s->in_payload = 0;
+            buffer->position = p + 1;
+            return emit(yyscanner, TOKEN_MESSAGE_SEPARATOR, p, 1);
+        }
+    } else {
+        size = match_header(p, last, &token);
+
+        if (size) {
+            s->in_payload = 1;
+            buffer->position = p + size;
+            return emit(yyscanner, token, p, size);
+        }
+
+        if (*p == ASCII_RECORD_SEPARATOR) {
+            buffer->position = p + 1;
+            return emit(yyscanner, TOKEN_UNKNOWN, p, 1);
+        }
+    }
+
+    /*
+     * Error recovery: discard the input up to and including the next
+     * sequence of record separators.
+     */
+    s->in_payload = 0;
+
+    if (p + 1 == last) {
+        buffer->position = last;
+        return emit(yyscanner, TOKEN_UNKNOWN, p, 1);
+    }
+
+    q = (char*)s->find_record_separator(p + 1, last);
+    while (q != last && *q == ASCII_RECORD_SEPARATOR)
+        ++q;
+
+    buffer->position = q;
+    return emit(yyscanner, TOKEN_UNKNOWN, p, (size_t)(q - p));
+}
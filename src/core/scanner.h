@@ -0,0 +1,66 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEEPSTREAM_SCANNER_H
+#define DEEPSTREAM_SCANNER_H
+
+/**
+ * @file
+ *
+ * This header declares the subset of the reentrant Flex API that is used by the
+ * parser and the unit tests. It is implemented by the Flex scanner generated
+ * from `lexer.l` and by its drop-in replacement in `scanner.c` so the scanner
+ * can be chosen at link time.
+ */
+
+#include <stddef.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+struct deepstream_parser_state;
+
+typedef void* yyscan_t;
+typedef struct yy_buffer_state* YY_BUFFER_STATE;
+
+int yylex_init(yyscan_t* scanner);
+int yylex_destroy(yyscan_t scanner);
+
+/**
+ * Returns the next token or, if the parser callback is active, the return
+ * value of the callback. Returns zero at the end of the input.
+ */
+int yylex(yyscan_t scanner);
+
+/**
+ * The last two bytes of the buffer must be null characters; they are not part
+ * of the input.
+ */
+YY_BUFFER_STATE yy_scan_buffer(char* base, size_t size, yyscan_t scanner);
+void yy_switch_to_buffer(YY_BUFFER_STATE buffer, yyscan_t scanner);
+void yy_delete_buffer(YY_BUFFER_STATE buffer, yyscan_t scanner);
+
+void yyset_extra(struct deepstream_parser_state* extra, yyscan_t scanner);
+struct deepstream_parser_state* yyget_extra(yyscan_t scanner);
+
+char* yyget_text(yyscan_t scanner);
+int yyget_leng(yyscan_t scanner);
+
+#if __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cassert>
+
+#include <limits>
+
+#include <deepstream/core/subscription_slots.hpp>
+
+namespace deepstream {
+
+SubscriptionSlots::SubscriptionSlots()
+    : size_(0)
+{
+}
+
+SubscriptionId SubscriptionSlots::acquire(Position position)
+{
+    std::uint32_t index = 0;
+
+    if (free_slots_.empty()) {
+        assert(slots_.size() < std::numeric_limits<std::uint32_t>::max());
+        index = static_cast<std::uint32_t>(slots_.size());
+        slots_.push_back(Slot{ 0, 0 });
+    } else {
+        index = free_slots_.back();
+        free_slots_.pop_back();
+    }
+
+    Slot& slot = slots_[index];
+    assert(slot.generation % 2 == 0);
+
+    ++slot.generation;
+    slot.position = position;
+    ++size_;
+
+    return (static_cast<SubscriptionId>(slot.generation) << 32) | index;
+}
+
+void SubscriptionSlots::release(SubscriptionId id)
+{
+    assert(is_valid(id));
+
+    const std::uint32_t index = index_of(id);
+    Slot& slot = slots_[index];
+
+    // the generation wraps around from 2^32 - 1 to zero
+    ++slot.generation;
+    free_slots_.push_back(index);
+
+    assert(size_ > 0);
+    --size_;
+}
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cassert>
+
+#include <algorithm>
+#include <utility>
+
+#include <deepstream/core/thread_pool.hpp>
+
+namespace deepstream {
+
+namespace {
+    const std::size_t STRANDS_PER_THREAD = 64;
+}
+
+ThreadPool::ThreadPool(std::size_t num_threads, std::size_t num_strands,
+    ExceptionHandler exception_handler)
+    : exception_handler_(std::move(exception_handler))
+    , strands_()
+    , workers_()
+    , stopping_(false)
+    , num_queued_(0)
+    , num_sleeping_(0)
+    , num_pending_(0)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    if (num_strands == 0)
+        num_strands = STRANDS_PER_THREAD * num_threads;
+
+    // the elements are neither copyable nor movable
+    std::vector<Strand>(num_strands).swap(strands_);
+    std::vector<Worker>(num_threads).swap(workers_);
+
+    threads_.reserve(num_threads);
+    for (std::size_t i = 0; i < num_threads; ++i)
+        threads_.emplace_back(&ThreadPool::run, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    wait();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_available_.notify_all();
+
+    for (std::thread& thread : threads_)
+        thread.join();
+}
+
+void ThreadPool::execute(std::size_t key, Task task)
+{
+    const std::size_t strand_index = key % strands_.size();
+    Strand& strand = strands_[strand_index];
+    bool is_idle = false;
+
+    num_pending_.fetch_add(1);
+
+    {
+        std::lock_guard<std::mutex> lock(strand.mutex);
+        strand.tasks.push_back(std::move(task));
+        is_idle = !strand.is_scheduled;
+        strand.is_scheduled = true;
+    }
+
+    if (is_idle)
+        schedule(&strand, strand_index % workers_.size());
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return num_pending_.load() == 0; });
+}
+
+void ThreadPool::schedule(Strand* p_strand, std::size_t index)
+{
+    Worker& worker = workers_[index];
+
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.strands.push_back(p_strand);
+    }
+
+    // pairs with the sleeping worker: either the worker sees the strand or
+    // this thread sees the sleeping worker
+    num_queued_.fetch_add(1);
+
+    if (num_sleeping_.load() > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        work_available_.notify_one();
+    }
+}
+
+ThreadPool::Strand* ThreadPool::next_strand(std::size_t index)
+{
+    Strand* p_strand = nullptr;
+
+    // the own queue is served in order, the other queues are robbed from
+    // the back
+    for (std::size_t i = 0; i < workers_.size() && !p_strand; ++i) {
+        Worker& worker = workers_[(index + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+
+        if (worker.strands.empty())
+            continue;
+
+        if (i == 0) {
+            p_strand = worker.strands.front();
+            worker.strands.pop_front();
+        } else {
+            p_strand = worker.strands.back();
+            worker.strands.pop_back();
+        }
+    }
+
+    if (p_strand)
+        num_queued_.fetch_sub(1);
+
+    return p_strand;
+}
+
+void ThreadPool::run_strand(Strand* p_strand, std::size_t index, std::deque<Task>& tasks)
+{
+    assert(p_strand);
+    assert(tasks.empty());
+
+    {
+        std::lock_guard<std::mutex> lock(p_strand->mutex);
+        assert(p_strand->is_scheduled);
+        tasks.swap(p_strand->tasks);
+    }
+
+    const std::size_t n = tasks.size();
+
+    for (Task& task : tasks) {
+        try {
+            task();
+        } catch (...) {
+            if (exception_handler_)
+                exception_handler_(std::current_exception());
+        }
+    }
+    tasks.clear();
+
+    bool is_pending = false;
+    {
+        std::lock_guard<std::mutex> lock(p_strand->mutex);
+        is_pending = !p_strand->tasks.empty();
+        p_strand->is_scheduled = is_pending;
+    }
+
+    // the strand goes to the back of the queue so that other strands are
+    // not starved
+    if (is_pending)
+        schedule(p_strand, index);
+
+    finish_tasks(n);
+}
+
+void ThreadPool::finish_tasks(std::size_t n)
+{
+    if (n == 0)
+        return;
+
+    if (num_pending_.fetch_sub(n) == n) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.notify_all();
+    }
+}
+
+void ThreadPool::run(std::size_t index)
+{
+    std::deque<Task> tasks;
+
+    for (;;) {
+        Strand* p_strand = next_strand(index);
+
+        if (p_strand) {
+            run_strand(p_strand, index, tasks);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        num_sleeping_.fetch_add(1);
+        work_available_.wait(lock, [this]() { return stopping_ || num_queued_.load() > 0; });
+        num_sleeping_.fetch_sub(1);
+
+        if (stopping_ && num_queued_.load() == 0)
+            return;
+    }
+}
+}
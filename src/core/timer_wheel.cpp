@@ -0,0 +1,191 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "timer_wheel.hpp"
+
+#include <cassert>
+
+namespace deepstream {
+
+const std::uint32_t TimerWheel::NIL;
+
+TimerWheel::TimerWheel(Clock::duration resolution, std::size_t num_slots,
+    Clock::time_point start)
+    : resolution_(resolution)
+    , start_(start)
+    , mask_(num_slots - 1)
+    , current_tick_(0)
+    , slots_(num_slots, NIL)
+    , size_(0)
+{
+    assert(resolution > Clock::duration::zero());
+    assert(num_slots > 0);
+    assert((num_slots & mask_) == 0);
+}
+
+std::uint64_t TimerWheel::tick_of(Clock::time_point t) const
+{
+    if (t <= start_)
+        return 0;
+
+    const Clock::rep d = (t - start_).count();
+    const Clock::rep r = resolution_.count();
+
+    return static_cast<std::uint64_t>((d + r - 1) / r);
+}
+
+TimerWheel::TimerId TimerWheel::start(Clock::time_point deadline, const Callback& callback)
+{
+    std::uint32_t index = 0;
+
+    if (free_timers_.empty()) {
+        assert(timers_.size() < NIL);
+        index = static_cast<std::uint32_t>(timers_.size());
+        timers_.push_back(Timer{ 0, NIL, NIL, 0, nullptr });
+    } else {
+        index = free_timers_.back();
+        free_timers_.pop_back();
+    }
+
+    Timer& timer = timers_[index];
+    assert(timer.generation % 2 == 0);
+
+    ++timer.generation;
+    timer.tick = std::max(tick_of(deadline), current_tick_ + 1);
+    timer.callback = callback;
+
+    const std::size_t slot = slot_of(timer.tick);
+    timer.prev = NIL;
+    timer.next = slots_[slot];
+
+    if (timer.next != NIL)
+        timers_[timer.next].prev = index;
+
+    slots_[slot] = index;
+    ++size_;
+
+    return (static_cast<TimerId>(timer.generation) << 32) | index;
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+    if (!is_active(id))
+        return false;
+
+    const std::uint32_t index = static_cast<std::uint32_t>(id);
+    release(index);
+    timers_[index].callback = nullptr;
+
+    return true;
+}
+
+void TimerWheel::release(std::uint32_t index)
+{
+    Timer& timer = timers_[index];
+    assert(timer.generation % 2 == 1);
+
+    if (timer.prev == NIL)
+        slots_[slot_of(timer.tick)] = timer.next;
+    else
+        timers_[timer.prev].next = timer.next;
+
+    if (timer.next != NIL)
+        timers_[timer.next].prev = timer.prev;
+
+    // the generation wraps around from 2^32 - 1 to zero
+    ++timer.generation;
+    free_timers_.push_back(index);
+
+    assert(size_ > 0);
+    --size_;
+}
+
+std::size_t TimerWheel::advance(Clock::time_point now)
+{
+    if (now < start_)
+        return 0;
+
+    const std::uint64_t tick = static_cast<std::uint64_t>((now - start_) / resolution_);
+
+    if (tick <= current_tick_)
+        return 0;
+
+    // timers started by the callbacks expire after `tick`; after a long
+    // pause, every slot is visited once
+    const std::uint64_t first_tick = current_tick_ + 1;
+    const std::uint64_t num_ticks = std::min<std::uint64_t>(tick - current_tick_, slots_.size());
+    current_tick_ = tick;
+
+    std::size_t num_expired = 0;
+    for (std::uint64_t i = 0; i < num_ticks; ++i)
+        num_expired += expire(slot_of(first_tick + i), tick);
+
+    return num_expired;
+}
+
+std::size_t TimerWheel::expire(std::size_t slot, std::uint64_t tick)
+{
+    std::size_t num_expired = 0;
+    std::uint32_t index = slots_[slot];
+
+    while (index != NIL) {
+        Timer& timer = timers_[index];
+
+        if (timer.tick > tick) {
+            index = timer.next;
+            continue;
+        }
+
+        Callback callback(std::move(timer.callback));
+        timer.callback = nullptr;
+        release(index);
+        ++num_expired;
+
+        callback();
+
+        // the callback may have cancelled any timer of the slot
+        index = slots_[slot];
+    }
+
+    return num_expired;
+}
+
+bool TimerWheel::next_expiry(Clock::time_point* p_expiry) const
+{
+    assert(p_expiry);
+
+    if (size_ == 0)
+        return false;
+
+    // the timers of the next revolution are found in the slot of their
+    // tick; later timers are only found by visiting all slots
+    std::uint64_t next_tick = std::numeric_limits<std::uint64_t>::max();
+
+    for (std::uint64_t tick = current_tick_ + 1; tick <= current_tick_ + slots_.size(); ++tick) {
+        for (std::uint32_t index = slots_[slot_of(tick)]; index != NIL; index = timers_[index].next)
+            next_tick = std::min(next_tick, timers_[index].tick);
+
+        if (next_tick <= tick)
+            break;
+    }
+
+    *p_expiry = start_ + resolution_ * static_cast<Clock::rep>(next_tick);
+    return true;
+}
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEEPSTREAM_TIMER_WHEEL_HPP
+#define DEEPSTREAM_TIMER_WHEEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace deepstream {
+
+/**
+ * This class is a hashed timer wheel: the time is divided into ticks of a
+ * fixed duration and a timer expiring in tick `t` is kept in the slot
+ * `t mod num_slots`. Starting and cancelling a timer take constant time and
+ * advancing the wheel visits only the slots of the elapsed ticks; timers
+ * more than one revolution ahead share their slot with nearer timers and
+ * are skipped until their tick was reached.
+ *
+ * The wheel does not read the clock; it is driven by advance(). A timer
+ * never fires before its deadline and at most one tick late, relative to
+ * the time passed to advance().
+ *
+ * Timer ids combine the index of the timer storage (lower 32 bits) with a
+ * generation (upper 32 bits) as in `SubscriptionSlots`, i.e., stale ids
+ * are recognized and valid ids are never zero.
+ */
+class TimerWheel {
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::function<void()> Callback;
+    typedef std::uint64_t TimerId;
+
+    /**
+     * @param[in] resolution The duration of a tick
+     * @param[in] num_slots A power of two
+     * @param[in] start The beginning of the first tick
+     */
+    TimerWheel(Clock::duration resolution, std::size_t num_slots, Clock::time_point start);
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /**
+     * Starts a timer calling the given function once the wheel was advanced
+     * to the deadline; deadlines in the past expire with the next tick.
+     */
+    TimerId start(Clock::time_point deadline, const Callback&);
+
+    /**
+     * @return `false` if the timer expired or was cancelled before
+     */
+    bool cancel(TimerId);
+
+    bool is_active(TimerId id) const
+    {
+        const std::size_t index = static_cast<std::uint32_t>(id);
+        const std::uint32_t generation = static_cast<std::uint32_t>(id >> 32);
+
+        return index < timers_.size() && timers_[index].generation == generation
+            && (generation & 1);
+    }
+
+    /**
+     * This method calls the functions of the timers expiring up to the
+     * given time. The functions may start and cancel timers; timers started
+     * by them expire in a later call.
+     *
+     * @return The number of expired timers
+     */
+    std::size_t advance(Clock::time_point now);
+
+    /**
+     * @return `false` if no timer is active; otherwise, the time the next
+     * timer expires (its deadline rounded up to a tick) is stored
+     */
+    bool next_expiry(Clock::time_point* p_expiry) const;
+
+    /**
+     * @return The number of active timers
+     */
+    std::size_t size() const { return size_; }
+
+private:
+    static const std::uint32_t NIL = 0xffffffff;
+
+    /**
+     * The timers of a slot form a doubly linked list.
+     */
+    struct Timer {
+        std::uint32_t generation;
+        std::uint32_t prev;
+        std::uint32_t next;
+        std::uint64_t tick;
+        Callback callback;
+    };
+
+    /**
+     * @return The first tick beginning at or after the given time
+     */
+    std::uint64_t tick_of(Clock::time_point) const;
+
+    std::size_t slot_of(std::uint64_t tick) const { return tick & mask_; }
+
+    /**
+     * Unlinks the timer and invalidates its id.
+     */
+    void release(std::uint32_t index);
+
+    /**
+     * Fires the timers of the slot expiring up to the given tick.
+     */
+    std::size_t expire(std::size_t slot, std::uint64_t tick);
+
+    const Clock::duration resolution_;
+    const Clock::time_point start_;
+    const std::uint64_t mask_;
+
+    // every active timer expires after this tick
+    std::uint64_t current_tick_;
+
+    // the first timer of every slot
+    std::vector<std::uint32_t> slots_;
+    std::vector<Timer> timers_;
+    std::vector<std::uint32_t> free_timers_;
+    std::size_t size_;
+};
+}
+
+#endif
@@ -0,0 +1,915 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <deepstream/lib/epoll-ws.hpp>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace deepstream {
+
+    namespace {
+        const char WEBSOCKET_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+        // the free space requested from the receive buffer for every read
+        const std::size_t MIN_READ_SIZE = 16 * 1024;
+        // the amount of data read per round unless a frame needs more
+        const std::size_t MAX_READ_SIZE = 1024 * 1024;
+        // the upgrade response must fit into this many bytes
+        const std::size_t MAX_HANDSHAKE_SIZE = 16 * 1024;
+        const std::size_t MAX_CONTROL_PAYLOAD_SIZE = 125;
+
+        std::uint32_t rotate_left(std::uint32_t x, unsigned n)
+        {
+            return (x << n) | (x >> (32 - n));
+        }
+
+        /*
+         * Computes the SHA-1 digest needed for the opening handshake.
+         */
+        std::string sha1(const std::string& input)
+        {
+            std::uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+            std::string data(input);
+            const std::uint64_t num_bits = static_cast<std::uint64_t>(input.size()) * 8;
+            data.push_back(static_cast<char>(0x80));
+            while (data.size() % 64 != 56)
+                data.push_back(0);
+            for (int i = 7; i >= 0; --i)
+                data.push_back(static_cast<char>(num_bits >> (8 * i)));
+
+            for (std::size_t offset = 0; offset < data.size(); offset += 64) {
+                std::uint32_t w[80];
+                for (std::size_t i = 0; i < 16; ++i) {
+                    const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data() + offset + 4 * i);
+                    w[i] = (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16)
+                        | (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+                }
+                for (std::size_t i = 16; i < 80; ++i)
+                    w[i] = rotate_left(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+                std::uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+                for (std::size_t i = 0; i < 80; ++i) {
+                    std::uint32_t f = 0;
+                    std::uint32_t k = 0;
+                    if (i < 20) {
+                        f = (b & c) | (~b & d);
+                        k = 0x5A827999;
+                    } else if (i < 40) {
+                        f = b ^ c ^ d;
+                        k = 0x6ED9EBA1;
+                    } else if (i < 60) {
+                        f = (b & c) | (b & d) | (c & d);
+                        k = 0x8F1BBCDC;
+                    } else {
+                        f = b ^ c ^ d;
+                        k = 0xCA62C1D6;
+                    }
+
+                    const std::uint32_t t = rotate_left(a, 5) + f + e + k + w[i];
+                    e = d;
+                    d = c;
+                    c = rotate_left(b, 30);
+                    b = a;
+                    a = t;
+                }
+
+                h[0] += a;
+                h[1] += b;
+                h[2] += c;
+                h[3] += d;
+                h[4] += e;
+            }
+
+            std::string digest;
+            for (std::uint32_t x : h)
+                for (int i = 3; i >= 0; --i)
+                    digest.push_back(static_cast<char>(x >> (8 * i)));
+
+            return digest;
+        }
+
+        std::string base64(const std::string& input)
+        {
+            const char alphabet[]
+                = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+            std::string output;
+            for (std::size_t i = 0; i < input.size(); i += 3) {
+                std::uint32_t x = std::uint32_t(static_cast<unsigned char>(input[i])) << 16;
+                if (i + 1 < input.size())
+                    x |= std::uint32_t(static_cast<unsigned char>(input[i + 1])) << 8;
+                if (i + 2 < input.size())
+                    x |= std::uint32_t(static_cast<unsigned char>(input[i + 2]));
+
+                output.push_back(alphabet[(x >> 18) & 0x3F]);
+                output.push_back(alphabet[(x >> 12) & 0x3F]);
+                output.push_back((i + 1 < input.size()) ? alphabet[(x >> 6) & 0x3F] : '=');
+                output.push_back((i + 2 < input.size()) ? alphabet[x & 0x3F] : '=');
+            }
+
+            return output;
+        }
+
+        /*
+         * XORs the data with the masking key; `offset` is the position of
+         * the data in the frame payload.
+         */
+        void apply_mask(char* data, std::size_t size, const unsigned char key[4], std::size_t offset)
+        {
+            unsigned char k[8];
+            for (std::size_t i = 0; i < 8; ++i)
+                k[i] = key[(offset + i) % 4];
+
+            std::uint64_t word_mask = 0;
+            std::memcpy(&word_mask, k, sizeof(word_mask));
+
+            std::size_t i = 0;
+            for (; i + 8 <= size; i += 8) {
+                std::uint64_t word = 0;
+                std::memcpy(&word, data + i, sizeof(word));
+                word ^= word_mask;
+                std::memcpy(data + i, &word, sizeof(word));
+            }
+
+            for (; i < size; ++i)
+                data[i] ^= k[i % 8];
+        }
+
+        std::string lower_case(std::string s)
+        {
+            for (char& c : s)
+                if (c >= 'A' && c <= 'Z')
+                    c = static_cast<char>(c - 'A' + 'a');
+            return s;
+        }
+
+        /*
+         * returns the value of the given header field (lower-case name) or
+         * an empty string
+         */
+        std::string header_field(const std::string& response, const std::string& name)
+        {
+            const std::string lower = lower_case(response);
+            std::size_t pos = lower.find("\r\n" + name + ":");
+
+            if (pos == std::string::npos)
+                return std::string();
+
+            pos += 2 + name.size() + 1;
+            const std::size_t end = response.find("\r\n", pos);
+            std::string value = response.substr(pos, end - pos);
+
+            const std::size_t first = value.find_first_not_of(" \t");
+            const std::size_t last = value.find_last_not_of(" \t");
+
+            return (first == std::string::npos) ? std::string() : value.substr(first, last - first + 1);
+        }
+    }
+
+    EpollWSHandler::EpollWSHandler(std::size_t max_message_size)
+        : WSHandler()
+        , max_message_size_(max_message_size)
+        , epoll_fd_(-1)
+        , socket_fd_(-1)
+        , addresses_(nullptr)
+        , next_address_(nullptr)
+        , phase_(Phase::IDLE)
+        , is_writable_watched_(false)
+        , in_begin_(0)
+        , in_end_(0)
+        , in_needed_(0)
+        , is_fragmented_(false)
+        , is_close_received_(false)
+        , out_begin_(0)
+        , mask_engine_(std::random_device()())
+    {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+
+        if (epoll_fd_ < 0) {
+            throw std::system_error(errno, std::system_category(), "epoll_create1");
+        }
+    }
+
+    EpollWSHandler::~EpollWSHandler()
+    {
+        close_socket();
+        ::close(epoll_fd_);
+    }
+
+    std::string EpollWSHandler::accept_key(const std::string& key)
+    {
+        return base64(sha1(key + WEBSOCKET_GUID));
+    }
+
+    std::string EpollWSHandler::URI() const
+    {
+        return uri_;
+    }
+
+    void EpollWSHandler::URI(std::string uri)
+    {
+        uri_ = uri;
+
+        std::string rest = uri;
+        const std::size_t scheme_end = rest.find("://");
+        if (scheme_end != std::string::npos) {
+            rest = rest.substr(scheme_end + 3);
+        }
+
+        const std::size_t path_begin = rest.find('/');
+        const std::string authority = rest.substr(0, path_begin);
+        path_ = (path_begin == std::string::npos) ? "/" : rest.substr(path_begin);
+
+        // IPv6 addresses are enclosed in brackets
+        const std::size_t bracket = authority.find(']');
+        const std::size_t colon = authority.find(':', (bracket == std::string::npos) ? 0 : bracket);
+
+        host_ = authority.substr(0, colon);
+        port_ = (colon == std::string::npos) ? "80" : authority.substr(colon + 1);
+
+        if (!host_.empty() && host_.front() == '[') {
+            host_ = host_.substr(1, host_.size() - 2);
+        }
+
+        if (state_ == WSState::OPEN) {
+            open();
+        }
+    }
+
+    void EpollWSHandler::open()
+    {
+        const bool initialised = (on_message_ || on_frame_) && on_error_ && on_open_ && on_close_;
+        if (!initialised) {
+            throw std::runtime_error("Unable to open websocket: not all handlers have been set");
+        }
+
+        if (uri_.empty()) {
+            throw std::runtime_error("Unable to open websocket: no URI is set");
+        }
+
+        if (uri_.compare(0, 6, "wss://") == 0) {
+            throw std::runtime_error("Unable to open websocket: TLS is not supported");
+        }
+
+        close_socket();
+
+        addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        const int ret = getaddrinfo(host_.c_str(), port_.c_str(), &hints, &addresses_);
+        if (ret != 0) {
+            addresses_ = nullptr;
+            fail(std::string("Unable to resolve ") + host_ + ": " + gai_strerror(ret));
+            return;
+        }
+
+        next_address_ = addresses_;
+        connect_next(0);
+    }
+
+    bool EpollWSHandler::connect_next(int error)
+    {
+        assert(socket_fd_ < 0);
+
+        while (next_address_ && socket_fd_ < 0) {
+            const addrinfo* p = next_address_;
+            next_address_ = p->ai_next;
+
+            const int fd = socket(p->ai_family, p->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, p->ai_protocol);
+            if (fd < 0) {
+                error = errno;
+                continue;
+            }
+
+            if (connect(fd, p->ai_addr, p->ai_addrlen) == 0 || errno == EINPROGRESS) {
+                socket_fd_ = fd;
+            } else {
+                error = errno;
+                ::close(fd);
+            }
+        }
+
+        if (socket_fd_ < 0) {
+            fail(std::string("Unable to connect: ") + std::strerror(error));
+            return false;
+        }
+
+        const int one = 1;
+        setsockopt(socket_fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLOUT;
+        event.data.fd = socket_fd_;
+
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket_fd_, &event) != 0) {
+            fail(std::string("epoll_ctl: ") + std::strerror(errno));
+            return false;
+        }
+
+        phase_ = Phase::CONNECTING;
+        is_writable_watched_ = true;
+
+        return true;
+    }
+
+    void EpollWSHandler::free_addresses()
+    {
+        if (addresses_) {
+            freeaddrinfo(addresses_);
+            addresses_ = nullptr;
+            next_address_ = nullptr;
+        }
+    }
+
+    void EpollWSHandler::process_messages()
+    {
+        if (socket_fd_ < 0) {
+            return;
+        }
+
+        const std::uint32_t events = poll_events();
+
+        if (phase_ == Phase::CONNECTING) {
+            if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) || !finish_connect()) {
+                return;
+            }
+        }
+
+        if ((events & EPOLLOUT) && !write_queued()) {
+            return;
+        }
+
+        if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+            bool eof = false;
+            if (!read_available(&eof)) {
+                return;
+            }
+
+            if (phase_ == Phase::HANDSHAKE && !finish_handshake()) {
+                return;
+            }
+
+            // the open handler may have closed the connection
+            if (phase_ == Phase::OPEN) {
+                if (!parse_frames()) {
+                    return;
+                }
+
+                dispatch();
+            }
+
+            // the handlers may have closed or reopened the connection
+            if (socket_fd_ < 0 || phase_ == Phase::CONNECTING) {
+                return;
+            }
+
+            if (is_close_received_ || eof) {
+                finish_close();
+                return;
+            }
+        }
+
+        // e.g., answers to pings
+        if (out_begin_ < out_.size() && !write_queued()) {
+            return;
+        }
+
+        update_events();
+
+        if (on_processed_ && state_ == WSState::OPEN) {
+            (*on_processed_)();
+        }
+    }
+
+    std::uint32_t EpollWSHandler::poll_events()
+    {
+        epoll_event event;
+        const int num_events = epoll_wait(epoll_fd_, &event, 1, 0);
+
+        return (num_events > 0) ? event.events : 0;
+    }
+
+    int EpollWSHandler::native_handle() const
+    {
+        return epoll_fd_;
+    }
+
+    bool EpollWSHandler::send(const Buffer& buffer)
+    {
+        const BufferView segment(buffer);
+        return send_segments(&segment, 1);
+    }
+
+    bool EpollWSHandler::send_segments(const BufferView* segments, std::size_t num_segments)
+    {
+        if (state_ != WSState::OPEN) {
+            state_ = WSState::ERROR;
+            (*on_error_)("Unable to send message on closed socket");
+            return false;
+        }
+
+        queue_frame(OP_TEXT, segments, num_segments);
+
+        if (!write_queued()) {
+            return false;
+        }
+
+        update_events();
+        return true;
+    }
+
+    void EpollWSHandler::queue_frame(Opcode opcode, const BufferView* segments, std::size_t num_segments)
+    {
+        std::size_t size = 0;
+        for (std::size_t i = 0; i < num_segments; ++i) {
+            size += segments[i].size();
+        }
+
+        unsigned char header[14];
+        std::size_t header_size = 2;
+
+        header[0] = static_cast<unsigned char>(0x80 | opcode);
+
+        if (size < 126) {
+            header[1] = static_cast<unsigned char>(0x80 | size);
+        } else if (size <= 0xFFFF) {
+            header[1] = 0x80 | 126;
+            header[2] = static_cast<unsigned char>(size >> 8);
+            header[3] = static_cast<unsigned char>(size);
+            header_size = 4;
+        } else {
+            header[1] = 0x80 | 127;
+            for (std::size_t i = 0; i < 8; ++i) {
+                header[2 + i] = static_cast<unsigned char>(static_cast<std::uint64_t>(size) >> (56 - 8 * i));
+            }
+            header_size = 10;
+        }
+
+        // client frames are masked with a fresh key
+        const std::uint32_t key = mask_engine_();
+        unsigned char* p_key = header + header_size;
+        std::memcpy(p_key, &key, 4);
+        header_size += 4;
+
+        out_.insert(out_.end(), header, header + header_size);
+
+        std::size_t offset = 0;
+        for (std::size_t i = 0; i < num_segments; ++i) {
+            const BufferView& segment = segments[i];
+            const std::size_t begin = out_.size();
+
+            out_.insert(out_.end(), segment.cbegin(), segment.cend());
+            apply_mask(out_.data() + begin, segment.size(), p_key, offset);
+            offset += segment.size();
+        }
+    }
+
+    bool EpollWSHandler::write_queued()
+    {
+        while (out_begin_ < out_.size()) {
+            const ssize_t n = ::send(socket_fd_, out_.data() + out_begin_,
+                out_.size() - out_begin_, MSG_NOSIGNAL);
+
+            if (n > 0) {
+                consume_queued(static_cast<std::size_t>(n));
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else {
+                fail(std::string("Unable to send: ") + std::strerror(errno));
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void EpollWSHandler::consume_queued(std::size_t size)
+    {
+        assert(size <= out_.size() - out_begin_);
+
+        out_begin_ += size;
+
+        if (out_begin_ == out_.size()) {
+            out_.clear();
+            out_begin_ = 0;
+        } else if (out_begin_ >= out_.size() / 2) {
+            // drop the written half so that the queue does not grow while
+            // the socket keeps up
+            out_.erase(out_.begin(), out_.begin() + out_begin_);
+            out_begin_ = 0;
+        }
+    }
+
+    char* EpollWSHandler::reserve_input(std::size_t size)
+    {
+        if (in_.size() - in_end_ < size) {
+            // move the unparsed data to the front before growing
+            if (in_begin_ > 0) {
+                std::memmove(in_.data(), in_.data() + in_begin_, in_end_ - in_begin_);
+                in_end_ -= in_begin_;
+                in_begin_ = 0;
+            }
+
+            if (in_.size() - in_end_ < size) {
+                in_.resize(std::max(2 * in_.size(), in_end_ + std::max(size, in_needed_)));
+            }
+        }
+
+        return in_.data() + in_end_;
+    }
+
+    bool EpollWSHandler::read_available(bool* p_eof)
+    {
+        assert(p_eof);
+
+        std::size_t num_read = 0;
+
+        while (num_read < std::max(MAX_READ_SIZE, in_needed_)) {
+            char* p = reserve_input(MIN_READ_SIZE);
+            const std::size_t capacity = in_.size() - in_end_;
+            const ssize_t n = ::recv(socket_fd_, p, capacity, 0);
+
+            if (n > 0) {
+                commit_input(static_cast<std::size_t>(n));
+                num_read += static_cast<std::size_t>(n);
+
+                // the socket is drained
+                if (static_cast<std::size_t>(n) < capacity) {
+                    break;
+                }
+            } else if (n == 0) {
+                *p_eof = true;
+                break;
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else {
+                fail(std::string("Unable to receive: ") + std::strerror(errno));
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool EpollWSHandler::finish_connect()
+    {
+        int error = 0;
+        socklen_t length = sizeof(error);
+
+        if (getsockopt(socket_fd_, SOL_SOCKET, SO_ERROR, &error, &length) != 0) {
+            error = errno;
+        }
+
+        if (error != 0) {
+            // e.g., localhost resolved to ::1 but the server only listens on
+            // IPv4
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket_fd_, nullptr);
+            ::close(socket_fd_);
+            socket_fd_ = -1;
+
+            connect_next(error);
+            return false;
+        }
+
+        free_addresses();
+
+        std::string key(16, 0);
+        for (char& c : key) {
+            c = static_cast<char>(mask_engine_());
+        }
+        key_ = base64(key);
+
+        const std::string request
+            = "GET " + path_ + " HTTP/1.1\r\n"
+            + "Host: " + host_ + ":" + port_ + "\r\n"
+            + "Upgrade: websocket\r\n"
+            + "Connection: Upgrade\r\n"
+            + "Sec-WebSocket-Key: " + key_ + "\r\n"
+            + "Sec-WebSocket-Version: 13\r\n"
+            + "\r\n";
+
+        out_.insert(out_.end(), request.cbegin(), request.cend());
+        phase_ = Phase::HANDSHAKE;
+
+        return write_queued();
+    }
+
+    bool EpollWSHandler::finish_handshake()
+    {
+        static const char END[] = "\r\n\r\n";
+
+        const char* begin = in_.data() + in_begin_;
+        const char* end = in_.data() + in_end_;
+        const char* header_end = std::search(begin, end, END, END + 4);
+
+        if (header_end == end) {
+            if (static_cast<std::size_t>(end - begin) > MAX_HANDSHAKE_SIZE) {
+                fail("Invalid handshake response");
+                return false;
+            }
+            return true;
+        }
+
+        const std::string response(begin, header_end + 2);
+        in_begin_ += response.size() + 2;
+
+        if (response.compare(0, 12, "HTTP/1.1 101") != 0) {
+            fail("WebSocket upgrade refused: " + response.substr(0, response.find("\r\n")));
+            return false;
+        }
+
+        const std::string accept = header_field(response, "sec-websocket-accept");
+        if (accept != accept_key(key_)) {
+            fail("Invalid Sec-WebSocket-Accept header");
+            return false;
+        }
+
+        phase_ = Phase::OPEN;
+        if (!on_upgraded()) {
+            return false;
+        }
+
+        state_ = WSState::OPEN;
+        (*on_open_)();
+
+        return true;
+    }
+
+    bool EpollWSHandler::parse_frames()
+    {
+        in_needed_ = 0;
+
+        while (!is_close_received_ && in_end_ - in_begin_ >= 2) {
+            unsigned char* p = reinterpret_cast<unsigned char*>(in_.data() + in_begin_);
+            const std::size_t available = in_end_ - in_begin_;
+
+            const bool is_final = p[0] & 0x80;
+            const unsigned opcode = p[0] & 0x0F;
+            const bool is_masked = p[1] & 0x80;
+            std::uint64_t size = p[1] & 0x7F;
+            std::size_t header_size = 2;
+
+            if (p[0] & 0x70) {
+                fail("Invalid WebSocket frame: reserved bits are set");
+                return false;
+            }
+
+            if (size == 126) {
+                if (available < 4) {
+                    break;
+                }
+                size = (std::uint64_t(p[2]) << 8) | p[3];
+                header_size = 4;
+            } else if (size == 127) {
+                if (available < 10) {
+                    break;
+                }
+                size = 0;
+                for (std::size_t i = 0; i < 8; ++i) {
+                    size = (size << 8) | p[2 + i];
+                }
+                header_size = 10;
+            }
+
+            if (is_masked) {
+                header_size += 4;
+            }
+
+            if (size > max_message_size_) {
+                fail("WebSocket frame exceeds the maximum message size");
+                return false;
+            }
+
+            if (available < header_size + size) {
+                in_needed_ = header_size + static_cast<std::size_t>(size);
+                break;
+            }
+
+            char* payload = in_.data() + in_begin_ + header_size;
+            const std::size_t payload_size = static_cast<std::size_t>(size);
+
+            if (is_masked) {
+                apply_mask(payload, payload_size, p + header_size - 4, 0);
+            }
+
+            in_begin_ += header_size + payload_size;
+
+            if (opcode >= OP_CLOSE && (!is_final || payload_size > MAX_CONTROL_PAYLOAD_SIZE)) {
+                fail("Invalid WebSocket control frame");
+                return false;
+            }
+
+            switch (opcode) {
+            case OP_CONTINUATION:
+            case OP_TEXT:
+            case OP_BINARY:
+                if ((opcode == OP_CONTINUATION) != is_fragmented_) {
+                    fail("Invalid WebSocket frame: unexpected continuation");
+                    return false;
+                }
+
+                if (fragments_.size() + payload_size > max_message_size_) {
+                    fail("WebSocket message exceeds the maximum message size");
+                    return false;
+                }
+
+                if (is_final && !is_fragmented_) {
+                    message_.insert(message_.end(), payload, payload + payload_size);
+                } else {
+                    fragments_.insert(fragments_.end(), payload, payload + payload_size);
+                }
+
+                if (is_final && is_fragmented_) {
+                    message_.insert(message_.end(), fragments_.cbegin(), fragments_.cend());
+                    fragments_.clear();
+                }
+
+                is_fragmented_ = !is_final;
+                break;
+
+            case OP_PING: {
+                const BufferView data(payload, payload_size);
+                queue_frame(OP_PONG, &data, 1);
+                break;
+            }
+
+            case OP_PONG:
+                break;
+
+            case OP_CLOSE:
+                is_close_received_ = true;
+                // the status code is echoed
+                if (payload_size >= 2) {
+                    const BufferView status(payload, 2);
+                    queue_frame(OP_CLOSE, &status, 1);
+                } else {
+                    queue_frame(OP_CLOSE, nullptr, 0);
+                }
+                break;
+
+            default:
+                fail("Invalid WebSocket frame: unknown opcode");
+                return false;
+            }
+        }
+
+        if (in_begin_ == in_end_) {
+            in_begin_ = 0;
+            in_end_ = 0;
+        }
+
+        return true;
+    }
+
+    void EpollWSHandler::dispatch()
+    {
+        if (message_.empty()) {
+            return;
+        }
+
+        // take the buffer in case the handler sends or receives
+        Buffer buffer;
+        buffer.swap(message_);
+
+        const std::size_t size = buffer.size();
+
+        if (on_frame_) {
+            buffer.resize(size + FRAME_PADDING);
+            (*on_frame_)(buffer.data(), size);
+
+            buffer.clear();
+            if (message_.empty()) {
+                message_.swap(buffer);
+            }
+            return;
+        }
+
+        (*on_message_)(std::move(buffer));
+    }
+
+    void EpollWSHandler::finish_close()
+    {
+        if (!is_close_received_) {
+            queue_frame(OP_CLOSE, nullptr, 0);
+        }
+
+        // best effort; the connection is closed regardless
+        write_queued();
+
+        close_socket();
+        state_ = WSState::CLOSED;
+        (*on_close_)();
+    }
+
+    void EpollWSHandler::update_events()
+    {
+        if (socket_fd_ < 0) {
+            return;
+        }
+
+        const bool is_writable_needed = phase_ == Phase::CONNECTING || out_begin_ < out_.size();
+
+        if (is_writable_needed == is_writable_watched_) {
+            return;
+        }
+
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = is_writable_needed ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        event.data.fd = socket_fd_;
+
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, socket_fd_, &event) == 0) {
+            is_writable_watched_ = is_writable_needed;
+        }
+    }
+
+    void EpollWSHandler::fail(const std::string& what)
+    {
+        close_socket();
+        state_ = WSState::ERROR;
+        (*on_error_)(std::string(what));
+    }
+
+    void EpollWSHandler::close_socket()
+    {
+        if (socket_fd_ >= 0) {
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket_fd_, nullptr);
+            ::close(socket_fd_);
+            socket_fd_ = -1;
+        }
+
+        free_addresses();
+
+        phase_ = Phase::IDLE;
+        is_writable_watched_ = false;
+        in_begin_ = 0;
+        in_end_ = 0;
+        in_needed_ = 0;
+        message_.clear();
+        fragments_.clear();
+        is_fragmented_ = false;
+        is_close_received_ = false;
+        out_.clear();
+        out_begin_ = 0;
+    }
+
+    void EpollWSHandler::close()
+    {
+        if (phase_ == Phase::OPEN) {
+            queue_frame(OP_CLOSE, nullptr, 0);
+            write_queued();
+        }
+
+        close_socket();
+        state_ = WSState::CLOSED;
+        (*on_close_)();
+    }
+
+    void EpollWSHandler::reconnect()
+    {
+        close();
+        open();
+    }
+
+    void EpollWSHandler::shutdown()
+    {
+        if (socket_fd_ >= 0) {
+            ::shutdown(socket_fd_, SHUT_RDWR);
+        }
+    }
+}
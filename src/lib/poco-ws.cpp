@@ -25,6 +25,7 @@
 #include <Poco/Net/KeyConsoleHandler.h>
 #include <Poco/Net/NetException.h>
 #include <Poco/Net/SSLManager.h>
+#include <Poco/Net/SocketImpl.h>
 #include <Poco/Net/WebSocket.h>
 #include <Poco/Timespan.h>
 #include <Poco/URI.h>
@@ -32,6 +33,10 @@
 #include <deepstream/lib/poco-ws.hpp>
 
 #include <algorithm> // std::max
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <new>
 
 #ifndef NDEBUG
 #include <iostream>
@@ -82,11 +87,20 @@ namespace deepstream {
 
     using namespace Poco::Net;
 
-    PocoWSHandler::PocoWSHandler()
+    namespace {
+        // the smallest arena that is allocated
+        const std::size_t MIN_ARENA_SIZE = 16 * 1024;
+    }
+
+    PocoWSHandler::PocoWSHandler(std::size_t max_frame_size, std::size_t high_water_mark)
         : WSHandler()
         , uri_()
         , session_(nullptr)
         , websocket_(nullptr)
+        , max_frame_size_(max_frame_size)
+        , high_water_mark_(std::max(high_water_mark, MIN_ARENA_SIZE))
+        , arena_(nullptr)
+        , arena_size_(0)
     {
     }
 
@@ -96,58 +110,179 @@ namespace deepstream {
 
     void PocoWSHandler::process_messages()
     {
-        if (state_ != WSState::OPEN) {
-            return;
+        receive_frames();
+
+        if (on_processed_ && state_ == WSState::OPEN) {
+            (*on_processed_)();
         }
+    }
 
-        if (!next_read_non_blocking()) {
+    void PocoWSHandler::receive_frames()
+    {
+        if (state_ != WSState::OPEN) {
             return;
         }
 
-        // WebSocket.available always returns 0 on secure websockets
-        // see https://github.com/pocoproject/poco/issues/1482
+        const bool is_secure = websocket_->secure();
 
-        // If a frame exceeds the buffer size, a WebSocket Exception is thrown
-        // and the socket must be discarded, so best to declare large enough!
-        // The development branch of Poco supports use of the dynamic
-        // `Poco::Buffer` for `receiveFrame`, but this was not in the most recent
-        // release (1.7.8)
+        std::size_t offset = 0;
+        bool is_too_large = false;
+        bool is_out_of_memory = false;
+        while (next_read_non_blocking()) {
+            std::size_t frame_size = 0;
+            std::size_t size = 0;
 
-        const std::size_t bytes_available = websocket_->available();
-        const std::size_t min_buffer_size = 1024;
-        const std::size_t buffer_size = std::max(bytes_available, min_buffer_size);
+            if (is_secure) {
+                // the size is not known before the frame was read; Poco
+                // rejects frames larger than the given space
+                if (offset > 0 && offset + max_frame_size_ + FRAME_PADDING > arena_size_) {
+                    break;
+                }
 
-        Buffer buffer(buffer_size, 0);
+                frame_size = max_frame_size_;
+                size = high_water_mark_ + max_frame_size_ + FRAME_PADDING;
+            } else {
+                if (!next_frame_size(&frame_size)) {
+                    break;
+                }
+
+                if (frame_size > max_frame_size_) {
+                    is_too_large = true;
+                    break;
+                }
+
+                size = offset + frame_size + FRAME_PADDING;
+            }
 
-        int offset = 0;
-        int bytes_read = 0;
-        do {
-            bytes_read = read_frame(buffer, offset);
+            // reserve space behind the received data so that the frame
+            // handler can work on the arena in place
+            if (!reserve_arena(size, offset)) {
+                is_out_of_memory = true;
+                break;
+            }
+
+            const int bytes_read = read_frame(arena_.get() + offset, frame_size);
+            if (bytes_read == 0) {
+                break;
+            }
             offset += bytes_read;
-        } while (bytes_read != 0 && next_read_non_blocking());
+        }
 
-        if (offset == 0) {
-            return;
+        if (offset > 0) {
+            if (on_frame_) {
+                (*on_frame_)(arena_.get(), offset);
+            } else {
+                (*on_message_)(Buffer(arena_.get(), arena_.get() + offset));
+            }
         }
 
-        buffer.resize(offset);
+        if (is_too_large) {
+            state(WSState::ERROR);
+            (*on_error_)("WebSocket frame exceeds the maximum frame size");
+        } else if (is_out_of_memory) {
+            state(WSState::ERROR);
+            (*on_error_)("Unable to allocate memory for a WebSocket frame");
+        }
 
-        (*on_message_)(std::move(buffer));
+        // release the memory taken by exceptionally large frames
+        if (!is_secure && arena_size_ > high_water_mark_) {
+            arena_.reset(new char[high_water_mark_]);
+            arena_size_ = high_water_mark_;
+        }
+    }
+
+    bool PocoWSHandler::next_frame_size(std::size_t* p_size)
+    {
+        assert(p_size);
+        assert(!websocket_->secure());
+
+        // the WebSocket class reads frames; the socket is read directly
+        unsigned char header[10];
+        int n = 0;
+        try {
+            n = websocket_->impl()->SocketImpl::receiveBytes(header, sizeof(header), MSG_PEEK);
+        } catch (Poco::Exception &) {
+            return false;
+        }
+
+        if (n < 2) {
+            return false;
+        }
+
+        std::size_t size = header[1] & 0x7F;
+        if (size == 126) {
+            if (n < 4) {
+                return false;
+            }
+            size = (std::size_t(header[2]) << 8) | header[3];
+        } else if (size == 127) {
+            if (n < 10) {
+                return false;
+            }
+            std::uint64_t size64 = 0;
+            for (std::size_t i = 0; i < 8; ++i) {
+                size64 = (size64 << 8) | header[2 + i];
+            }
+            size = (size64 > max_frame_size_) ? max_frame_size_ + 1 : static_cast<std::size_t>(size64);
+        }
+
+        *p_size = size;
+        return true;
+    }
+
+    bool PocoWSHandler::reserve_arena(std::size_t size, std::size_t used)
+    {
+        assert(used <= arena_size_);
+
+        if (size <= arena_size_) {
+            return true;
+        }
+
+        const std::size_t new_size = std::max(size,
+            std::max(MIN_ARENA_SIZE, std::min(2 * arena_size_, max_frame_size_ + FRAME_PADDING)));
+
+        // not zero-filled
+        std::unique_ptr<char[]> arena(new (std::nothrow) char[new_size]);
+        if (!arena) {
+            return false;
+        }
+
+        if (used > 0) {
+            std::memcpy(arena.get(), arena_.get(), used);
+        }
+
+        arena_.swap(arena);
+        arena_size_ = new_size;
+
+        return true;
+    }
+
+    int PocoWSHandler::native_handle() const
+    {
+        if (!websocket_) {
+            return -1;
+        }
+
+        return websocket_->impl()->sockfd();
     }
 
     bool PocoWSHandler::next_read_non_blocking()
     {
+        // the data decrypted by OpenSSL is no longer in the socket
+        if (websocket_->secure() && websocket_->available() > 0) {
+            return true;
+        }
+
         return websocket_->poll(Poco::Timespan(), Socket::SelectMode::SELECT_READ);
     }
 
-    int PocoWSHandler::read_frame(Buffer &buffer, int offset)
+    int PocoWSHandler::read_frame(char* data, std::size_t size)
     {
         int bytes_received = 0;
         int flags = 0;
 
         try {
-            bytes_received = websocket_->receiveFrame(
-                    buffer.data() + offset, buffer.size() - offset, flags);
+            bytes_received = websocket_->receiveFrame(data, static_cast<int>(size), flags);
         } catch (Poco::TimeoutException &e) {
             assert(websocket_->secure());
 
@@ -0,0 +1,409 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+
+#include <exception>
+#include <system_error>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include <deepstream/lib/threaded-ws.hpp>
+
+#ifndef NDEBUG
+#include <iostream>
+#define DEBUG_MSG(str) do { std::cout << "# "<< str << std::endl; } while( false )
+#else
+#define DEBUG_MSG(str) do { } while ( false )
+#endif
+
+namespace deepstream {
+
+    namespace {
+        // the I/O thread wakes up at least this often while the socket is
+        // open because TLS sockets may buffer data without being readable
+        const int MAX_IO_WAIT_MS = 100;
+        // the polling interval for transports without file descriptor
+        const int POLL_INTERVAL_MS = 10;
+
+        int to_poll_timeout(std::chrono::milliseconds timeout)
+        {
+            return (timeout.count() < 0) ? -1 : static_cast<int>(timeout.count());
+        }
+    }
+
+    Notifier::Notifier()
+        : read_fd_(-1)
+        , write_fd_(-1)
+    {
+#ifdef __linux__
+        read_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (read_fd_ < 0) {
+            throw std::system_error(errno, std::system_category(), "eventfd");
+        }
+        write_fd_ = read_fd_;
+#else
+        int fds[2];
+        if (pipe(fds) != 0) {
+            throw std::system_error(errno, std::system_category(), "pipe");
+        }
+        for (int fd : fds) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+        read_fd_ = fds[0];
+        write_fd_ = fds[1];
+#endif
+    }
+
+    Notifier::~Notifier()
+    {
+        ::close(read_fd_);
+        if (write_fd_ != read_fd_) {
+            ::close(write_fd_);
+        }
+    }
+
+    void Notifier::notify()
+    {
+#ifdef __linux__
+        const std::uint64_t value = 1;
+#else
+        const char value = 0;
+#endif
+        // a full pipe or counter is readable anyway
+        ssize_t ret = ::write(write_fd_, &value, sizeof(value));
+        (void)ret;
+    }
+
+    void Notifier::clear()
+    {
+        char buffer[64];
+        while (::read(read_fd_, buffer, sizeof(buffer)) > 0) {
+        }
+    }
+
+    bool Notifier::wait(std::chrono::milliseconds timeout) const
+    {
+        pollfd fd = { read_fd_, POLLIN, 0 };
+        int ret = 0;
+
+        do {
+            ret = poll(&fd, 1, to_poll_timeout(timeout));
+        } while (ret < 0 && errno == EINTR);
+
+        return ret > 0;
+    }
+
+    ThreadedWSHandler::ThreadedWSHandler(WSHandler &transport, std::size_t ring_capacity)
+        : WSHandler()
+        , transport_(transport)
+        , uri_(transport.URI())
+        , events_(ring_capacity)
+        , commands_(ring_capacity)
+        , event_()
+        , command_()
+        , io_event_()
+        , io_command_()
+        , io_waiting_(false)
+        , events_pushed_(false)
+        , io_connecting_(false)
+        , stopping_(false)
+        , wake_pending_(false)
+    {
+        transport_.on_open([this]() {
+            io_connecting_ = false;
+            push_event(IOEvent::OPEN, nullptr, 0);
+        });
+        transport_.on_close([this]() {
+            io_connecting_ = false;
+            push_event(IOEvent::CLOSE, nullptr, 0);
+        });
+        transport_.on_error([this](const std::string &&what) {
+            io_connecting_ = false;
+            push_event(IOEvent::ERROR, what.data(), what.size());
+        });
+        transport_.on_message([this](const Buffer &&frame) {
+            push_event(IOEvent::FRAME, frame.data(), frame.size());
+        });
+        transport_.on_frame([this](char *data, std::size_t size) {
+            push_event(IOEvent::FRAME, data, size);
+        });
+
+        thread_ = std::thread(&ThreadedWSHandler::run, this);
+    }
+
+    ThreadedWSHandler::~ThreadedWSHandler()
+    {
+        stopping_.store(true);
+        command(IOCommand::STOP);
+        thread_.join();
+    }
+
+    void ThreadedWSHandler::process_messages()
+    {
+        // frames pushed and wake() calls from now on make the notifier
+        // readable again; the exchange makes the work of the threads that
+        // called wake() visible to this thread
+        events_notifier_.clear();
+        wake_pending_.exchange(false);
+
+        while (events_.try_pop(event_)) {
+            switch (event_.type) {
+            case IOEvent::OPEN:
+                state_ = WSState::OPEN;
+                (*on_open_)();
+                break;
+            case IOEvent::CLOSE:
+                state_ = WSState::CLOSED;
+                (*on_close_)();
+                break;
+            case IOEvent::ERROR:
+                state_ = WSState::ERROR;
+                (*on_error_)(std::string(event_.data.data(), event_.size));
+                break;
+            case IOEvent::FRAME:
+                if (on_frame_) {
+                    (*on_frame_)(event_.data.data(), event_.size);
+                } else {
+                    Buffer frame(event_.data.cbegin(), event_.data.cbegin() + event_.size);
+                    (*on_message_)(std::move(frame));
+                }
+                break;
+            }
+        }
+
+        if (on_processed_ && state_ == WSState::OPEN) {
+            (*on_processed_)();
+        }
+    }
+
+    bool ThreadedWSHandler::wait(std::chrono::milliseconds timeout)
+    {
+        if (!events_.empty() || wake_pending_.load()) {
+            return true;
+        }
+
+        events_notifier_.wait(timeout);
+
+        return !events_.empty() || wake_pending_.load();
+    }
+
+    void ThreadedWSHandler::wake()
+    {
+        if (!wake_pending_.exchange(true)) {
+            events_notifier_.notify();
+        }
+    }
+
+    int ThreadedWSHandler::native_handle() const
+    {
+        return events_notifier_.native_handle();
+    }
+
+    std::string ThreadedWSHandler::URI() const
+    {
+        return uri_;
+    }
+
+    void ThreadedWSHandler::URI(std::string uri)
+    {
+        uri_ = uri;
+        command(IOCommand::SET_URI, uri_.data(), uri_.size());
+    }
+
+    bool ThreadedWSHandler::send(const Buffer &buffer)
+    {
+        const BufferView segment(buffer);
+        return send_segments(&segment, 1);
+    }
+
+    bool ThreadedWSHandler::send_segments(const BufferView* segments, std::size_t num_segments)
+    {
+        if (state_ != WSState::OPEN) {
+            return false;
+        }
+
+        command_.type = IOCommand::SEND;
+        command_.data.clear();
+        for (std::size_t i = 0; i < num_segments; ++i) {
+            command_.data.insert(command_.data.end(), segments[i].cbegin(), segments[i].cend());
+        }
+
+        push_command(command_);
+
+        return true;
+    }
+
+    void ThreadedWSHandler::open()
+    {
+        command(IOCommand::OPEN);
+    }
+
+    void ThreadedWSHandler::close()
+    {
+        command(IOCommand::CLOSE);
+    }
+
+    void ThreadedWSHandler::reconnect()
+    {
+        command(IOCommand::RECONNECT);
+    }
+
+    void ThreadedWSHandler::shutdown()
+    {
+        command(IOCommand::SHUTDOWN);
+    }
+
+    void ThreadedWSHandler::command(IOCommand::Type type, const char* data, std::size_t size)
+    {
+        command_.type = type;
+        command_.data.assign(data, data + size);
+
+        push_command(command_);
+    }
+
+    void ThreadedWSHandler::push_command(IOCommand &command)
+    {
+        while (!commands_.try_push(command)) {
+            commands_notifier_.notify();
+            std::this_thread::yield();
+        }
+
+        // pairs with the fence in wait_for_io(): either the I/O thread sees
+        // the command or this thread sees that the I/O thread is waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (io_waiting_.load(std::memory_order_relaxed)) {
+            commands_notifier_.notify();
+        }
+    }
+
+    void ThreadedWSHandler::run()
+    {
+        while (execute_commands()) {
+            if (is_transport_active()) {
+                transport_.process_messages();
+            }
+
+            if (events_pushed_) {
+                events_pushed_ = false;
+                events_notifier_.notify();
+            }
+
+            wait_for_io();
+        }
+    }
+
+    bool ThreadedWSHandler::execute_commands()
+    {
+        while (commands_.try_pop(io_command_)) {
+            const Buffer &data = io_command_.data;
+
+            try {
+                switch (io_command_.type) {
+                case IOCommand::SEND:
+                    transport_.send(data);
+                    break;
+                case IOCommand::SET_URI:
+                    transport_.URI(std::string(data.cbegin(), data.cend()));
+                    break;
+                case IOCommand::OPEN:
+                    // the transport may report the outcome right away
+                    io_connecting_ = true;
+                    transport_.open();
+                    break;
+                case IOCommand::CLOSE:
+                    transport_.close();
+                    break;
+                case IOCommand::RECONNECT:
+                    io_connecting_ = true;
+                    transport_.reconnect();
+                    break;
+                case IOCommand::SHUTDOWN:
+                    transport_.shutdown();
+                    break;
+                case IOCommand::STOP:
+                    return false;
+                }
+            } catch (const std::exception &e) {
+                DEBUG_MSG("I/O thread: " << e.what());
+                io_connecting_ = false;
+                const std::string what(e.what());
+                push_event(IOEvent::ERROR, what.data(), what.size());
+            }
+        }
+
+        return true;
+    }
+
+    void ThreadedWSHandler::push_event(IOEvent::Type type, const char* data, std::size_t size)
+    {
+        io_event_.type = type;
+        io_event_.size = size;
+        io_event_.data.clear();
+        io_event_.data.insert(io_event_.data.end(), data, data + size);
+        io_event_.data.insert(io_event_.data.end(), FRAME_PADDING, 0);
+
+        while (!events_.try_push(io_event_)) {
+            // the application thread is behind; stop reading until it
+            // caught up
+            if (stopping_.load()) {
+                return;
+            }
+            events_notifier_.notify();
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        events_pushed_ = true;
+    }
+
+    void ThreadedWSHandler::wait_for_io()
+    {
+        io_waiting_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (commands_.empty()) {
+            const bool is_active = is_transport_active();
+            const int socket_fd = is_active ? transport_.native_handle() : -1;
+
+            pollfd fds[2] = {
+                { commands_notifier_.native_handle(), POLLIN, 0 },
+                { socket_fd, POLLIN, 0 }
+            };
+            const nfds_t num_fds = (socket_fd >= 0) ? 2 : 1;
+            const int timeout = !is_active ? -1
+                : (socket_fd >= 0) ? MAX_IO_WAIT_MS : POLL_INTERVAL_MS;
+
+            poll(fds, num_fds, timeout);
+        }
+
+        io_waiting_.store(false, std::memory_order_relaxed);
+        commands_notifier_.clear();
+    }
+
+    bool ThreadedWSHandler::is_transport_active()
+    {
+        return io_connecting_ || transport_.state() == WSState::OPEN;
+    }
+}
@@ -0,0 +1,550 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#include <deepstream/lib/uring-ws.hpp>
+
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+namespace deepstream {
+
+    namespace {
+        const unsigned NUM_ENTRIES = 64;
+        const std::uint16_t BUFFER_GROUP = 0;
+
+        static_assert((UringWSHandler::NUM_RECEIVE_BUFFERS & (UringWSHandler::NUM_RECEIVE_BUFFERS - 1)) == 0,
+            "the size of the buffer ring must be a power of two");
+
+        // liburing is not required for the few system calls
+        int io_uring_setup(unsigned entries, io_uring_params* p)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+        }
+
+        int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+        }
+
+        int io_uring_register(int fd, unsigned opcode, void* arg, unsigned num_args)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, num_args));
+        }
+
+        void* map(std::size_t size, int fd, off_t offset)
+        {
+            void* p = (fd < 0)
+                ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+                : mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+
+            if (p == MAP_FAILED) {
+                throw std::system_error(errno, std::system_category(), "mmap");
+            }
+
+            return p;
+        }
+
+        /*
+         * Multishot receive requests need Linux 6.0; older kernels reject
+         * them only when they are submitted.
+         */
+        bool has_multishot_receive()
+        {
+            utsname name;
+            int major = 0;
+            int minor = 0;
+
+            return uname(&name) == 0 && std::sscanf(name.release, "%d.%d", &major, &minor) == 2
+                && major >= 6;
+        }
+    }
+
+    UringWSHandler::UringWSHandler(std::size_t max_message_size)
+        : EpollWSHandler(max_message_size)
+        , ring_fd_(-1)
+        , ring_(nullptr)
+        , ring_size_(0)
+        , sqes_(nullptr)
+        , sqes_size_(0)
+        , sq_head_(nullptr)
+        , sq_tail_(nullptr)
+        , sq_array_(nullptr)
+        , sq_mask_(0)
+        , sq_entries_(0)
+        , sq_local_tail_(0)
+        , num_prepared_(0)
+        , cq_head_(nullptr)
+        , cq_tail_(nullptr)
+        , cq_mask_(0)
+        , cqes_(nullptr)
+        , buffer_ring_(nullptr)
+        , receive_buffers_(nullptr)
+        , buffer_ring_tail_(0)
+        , send_buffer_(SEND_BUFFER_SIZE)
+        , send_begin_(0)
+        , send_end_(0)
+        , generation_(0)
+        , is_active_(false)
+        , is_receiving_(false)
+        , is_sending_(false)
+        , is_eof_(false)
+        , receive_error_(0)
+        , send_error_(0)
+        , num_in_flight_(0)
+    {
+        try {
+            set_up();
+        } catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    UringWSHandler::~UringWSHandler()
+    {
+        close_socket();
+
+        // the kernel may write to the buffers until the requests completed
+        while (num_in_flight_ > 0) {
+            if (io_uring_enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                break;
+            }
+            reap_completions();
+        }
+
+        release();
+    }
+
+    bool UringWSHandler::is_supported()
+    {
+        static const bool is_supported = []() {
+            if (!has_multishot_receive()) {
+                return false;
+            }
+
+            try {
+                UringWSHandler wsh;
+            } catch (const std::system_error&) {
+                return false;
+            }
+
+            return true;
+        }();
+
+        return is_supported;
+    }
+
+    void UringWSHandler::set_up()
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        ring_fd_ = io_uring_setup(NUM_ENTRIES, &params);
+        if (ring_fd_ < 0) {
+            throw std::system_error(errno, std::system_category(), "io_uring_setup");
+        }
+
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+            throw std::system_error(ENOSYS, std::system_category(), "io_uring_setup");
+        }
+
+        // the submission and the completion queue share one mapping
+        ring_size_ = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+            params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        ring_ = map(ring_size_, ring_fd_, IORING_OFF_SQ_RING);
+
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, ring_fd_, IORING_OFF_SQES));
+
+        char* p = static_cast<char*>(ring_);
+        sq_head_ = reinterpret_cast<unsigned*>(p + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(p + params.sq_off.tail);
+        sq_array_ = reinterpret_cast<unsigned*>(p + params.sq_off.array);
+        sq_mask_ = *reinterpret_cast<unsigned*>(p + params.sq_off.ring_mask);
+        sq_entries_ = params.sq_entries;
+        sq_local_tail_ = *sq_tail_;
+
+        cq_head_ = reinterpret_cast<unsigned*>(p + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(p + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(p + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(p + params.cq_off.cqes);
+
+        // the buffer ring must be page-aligned
+        buffer_ring_ = map(NUM_RECEIVE_BUFFERS * sizeof(io_uring_buf), -1, 0);
+        receive_buffers_ = static_cast<char*>(map(NUM_RECEIVE_BUFFERS * RECEIVE_BUFFER_SIZE, -1, 0));
+
+        io_uring_buf_reg reg;
+        std::memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = reinterpret_cast<std::uintptr_t>(buffer_ring_);
+        reg.ring_entries = NUM_RECEIVE_BUFFERS;
+        reg.bgid = BUFFER_GROUP;
+
+        if (io_uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+            throw std::system_error(errno, std::system_category(), "IORING_REGISTER_PBUF_RING");
+        }
+
+        for (unsigned id = 0; id < NUM_RECEIVE_BUFFERS; ++id) {
+            recycle_buffer(id);
+        }
+        publish_buffers();
+    }
+
+    void UringWSHandler::release()
+    {
+        if (receive_buffers_) {
+            munmap(receive_buffers_, NUM_RECEIVE_BUFFERS * RECEIVE_BUFFER_SIZE);
+        }
+
+        if (buffer_ring_) {
+            munmap(buffer_ring_, NUM_RECEIVE_BUFFERS * sizeof(io_uring_buf));
+        }
+
+        if (sqes_) {
+            munmap(sqes_, sqes_size_);
+        }
+
+        if (ring_) {
+            munmap(ring_, ring_size_);
+        }
+
+        if (ring_fd_ >= 0) {
+            ::close(ring_fd_);
+        }
+    }
+
+    io_uring_sqe* UringWSHandler::prepare(Request request)
+    {
+        if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == sq_entries_) {
+            submit();
+        }
+
+        const unsigned index = sq_local_tail_ & sq_mask_;
+        io_uring_sqe* sqe = sqes_ + index;
+
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = (generation_ << 8) | request;
+        sq_array_[index] = index;
+
+        ++sq_local_tail_;
+        ++num_prepared_;
+        ++num_in_flight_;
+
+        return sqe;
+    }
+
+    bool UringWSHandler::submit()
+    {
+        if (num_prepared_ == 0) {
+            return true;
+        }
+
+        __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+
+        while (num_prepared_ > 0) {
+            const int n = io_uring_enter(ring_fd_, num_prepared_, 0, 0);
+
+            if (n >= 0) {
+                num_prepared_ -= static_cast<unsigned>(n);
+            } else if (errno != EINTR) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    std::uint32_t UringWSHandler::reap_completions()
+    {
+        std::uint32_t events = 0;
+        unsigned head = *cq_head_;
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; ++head) {
+            events |= complete(cqes_[head & cq_mask_]);
+        }
+
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        publish_buffers();
+
+        return events;
+    }
+
+    std::uint32_t UringWSHandler::complete(const io_uring_cqe& cqe)
+    {
+        const bool is_current = is_active_ && (cqe.user_data >> 8) == generation_;
+
+        switch (cqe.user_data & 0xFF) {
+        case RECEIVE:
+            if (cqe.flags & IORING_CQE_F_BUFFER) {
+                const unsigned id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+
+                if (is_current && cqe.res > 0) {
+                    const std::size_t size = static_cast<std::size_t>(cqe.res);
+                    std::memcpy(reserve_input(size), receive_buffers_ + id * RECEIVE_BUFFER_SIZE, size);
+                    commit_input(size);
+                }
+
+                recycle_buffer(id);
+            }
+
+            if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                --num_in_flight_;
+
+                if (is_current) {
+                    is_receiving_ = false;
+                }
+            }
+
+            if (!is_current || cqe.res == -ENOBUFS) {
+                // the request is rearmed once the buffers were recycled
+                return 0;
+            }
+
+            if (cqe.res == 0) {
+                is_eof_ = true;
+            } else if (cqe.res < 0) {
+                receive_error_ = -cqe.res;
+            }
+            return EPOLLIN;
+
+        case SEND:
+            --num_in_flight_;
+
+            if (!is_current) {
+                is_sending_ = false;
+                return 0;
+            }
+
+            if (cqe.res < 0) {
+                send_error_ = -cqe.res;
+            } else {
+                send_begin_ += static_cast<std::size_t>(cqe.res);
+            }
+
+            if (send_error_ == 0 && send_begin_ < send_end_) {
+                prepare_send();
+            } else {
+                is_sending_ = false;
+            }
+            return EPOLLOUT;
+
+        default:
+            --num_in_flight_;
+            return 0;
+        }
+    }
+
+    void UringWSHandler::prepare_receive()
+    {
+        io_uring_sqe* sqe = prepare(RECEIVE);
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = socket_fd();
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+
+        is_receiving_ = true;
+    }
+
+    void UringWSHandler::prepare_send()
+    {
+        assert(send_begin_ < send_end_);
+
+        io_uring_sqe* sqe = prepare(SEND);
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = socket_fd();
+        sqe->addr = reinterpret_cast<std::uintptr_t>(send_buffer_.data() + send_begin_);
+        sqe->len = static_cast<std::uint32_t>(send_end_ - send_begin_);
+        sqe->msg_flags = MSG_NOSIGNAL;
+
+        is_sending_ = true;
+    }
+
+    void UringWSHandler::recycle_buffer(unsigned id)
+    {
+        assert(id < NUM_RECEIVE_BUFFERS);
+
+        // the tail of the ring overlays the reserved field of the first
+        // entry; it must not be written here
+        io_uring_buf* buffers = static_cast<io_uring_buf*>(buffer_ring_);
+        io_uring_buf& buffer = buffers[buffer_ring_tail_ & (NUM_RECEIVE_BUFFERS - 1)];
+
+        buffer.addr = reinterpret_cast<std::uintptr_t>(receive_buffers_ + id * RECEIVE_BUFFER_SIZE);
+        buffer.len = RECEIVE_BUFFER_SIZE;
+        buffer.bid = static_cast<std::uint16_t>(id);
+
+        ++buffer_ring_tail_;
+    }
+
+    void UringWSHandler::publish_buffers()
+    {
+        std::uint16_t* p_tail = reinterpret_cast<std::uint16_t*>(
+            static_cast<char*>(buffer_ring_) + offsetof(io_uring_buf, resv));
+
+        __atomic_store_n(p_tail, buffer_ring_tail_, __ATOMIC_RELEASE);
+    }
+
+    std::uint32_t UringWSHandler::poll_events()
+    {
+        if (!is_active_) {
+            return EpollWSHandler::poll_events();
+        }
+
+        const std::uint32_t events = reap_completions();
+
+        // e.g., after the kernel ran out of buffers; the request is
+        // submitted with the other requests of this round
+        if (is_active_ && !is_receiving_ && !is_eof_ && receive_error_ == 0) {
+            prepare_receive();
+        }
+
+        return events;
+    }
+
+    bool UringWSHandler::write_queued()
+    {
+        if (!is_active_) {
+            return EpollWSHandler::write_queued();
+        }
+
+        if (send_error_ != 0) {
+            fail(std::string("Unable to send: ") + std::strerror(send_error_));
+            return false;
+        }
+
+        if (!is_sending_ && num_queued_bytes() > 0) {
+            const std::size_t size = std::min(num_queued_bytes(), send_buffer_.size());
+
+            std::memcpy(send_buffer_.data(), queued_data(), size);
+            consume_queued(size);
+
+            send_begin_ = 0;
+            send_end_ = size;
+            prepare_send();
+        }
+
+        return true;
+    }
+
+    bool UringWSHandler::read_available(bool* p_eof)
+    {
+        assert(p_eof);
+
+        if (!is_active_) {
+            return EpollWSHandler::read_available(p_eof);
+        }
+
+        // the data was copied when the completions were reaped
+        if (receive_error_ != 0) {
+            fail(std::string("Unable to receive: ") + std::strerror(receive_error_));
+            return false;
+        }
+
+        *p_eof = is_eof_;
+        return true;
+    }
+
+    void UringWSHandler::update_events()
+    {
+        if (!is_active_) {
+            EpollWSHandler::update_events();
+            return;
+        }
+
+        if (!submit()) {
+            fail(std::string("io_uring_enter: ") + std::strerror(errno));
+        }
+    }
+
+    bool UringWSHandler::on_upgraded()
+    {
+        // completions of the previous connection
+        reap_completions();
+
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = ring_fd_;
+
+        epoll_ctl(epoll_fd(), EPOLL_CTL_DEL, socket_fd(), nullptr);
+
+        if (epoll_ctl(epoll_fd(), EPOLL_CTL_ADD, ring_fd_, &event) != 0) {
+            fail(std::string("epoll_ctl: ") + std::strerror(errno));
+            return false;
+        }
+
+        ++generation_;
+        is_active_ = true;
+        is_eof_ = false;
+        receive_error_ = 0;
+        send_error_ = 0;
+
+        prepare_receive();
+
+        if (!submit()) {
+            fail(std::string("io_uring_enter: ") + std::strerror(errno));
+            return false;
+        }
+
+        return true;
+    }
+
+    void UringWSHandler::close_socket()
+    {
+        if (is_active_) {
+            epoll_ctl(epoll_fd(), EPOLL_CTL_DEL, ring_fd_, nullptr);
+            is_active_ = false;
+            is_receiving_ = false;
+
+            // a queued closing frame is submitted first
+            io_uring_sqe* sqe = prepare(CANCEL);
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = socket_fd();
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+
+            submit();
+        }
+
+        EpollWSHandler::close_socket();
+    }
+
+    std::unique_ptr<EpollWSHandler> make_native_ws_handler(std::size_t max_message_size)
+    {
+        if (UringWSHandler::is_supported()) {
+            try {
+                return std::unique_ptr<EpollWSHandler>(new UringWSHandler(max_message_size));
+            } catch (const std::system_error&) {
+                // e.g., the limit of locked memory was reached
+            }
+        }
+
+        return std::unique_ptr<EpollWSHandler>(new EpollWSHandler(max_message_size));
+    }
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <deepstream/core/callback_list.hpp>
+#include <deepstream/core/subscription_slots.hpp>
+
+namespace deepstream {
+
+typedef std::function<void(int)> Fn;
+typedef CallbackList<Fn> List;
+
+BOOST_AUTO_TEST_CASE(simple)
+{
+    SubscriptionSlots slots;
+    List list(slots);
+    std::vector<int> calls;
+
+    BOOST_CHECK(list.empty());
+
+    const SubscriptionId id1 = list.add([&calls](int x) { calls.push_back(10 + x); });
+    const SubscriptionId id2 = list.add([&calls](int x) { calls.push_back(20 + x); });
+    const SubscriptionId id3 = list.add([&calls](int x) { calls.push_back(30 + x); });
+    BOOST_CHECK_EQUAL(list.size(), 3);
+    BOOST_CHECK_EQUAL(slots.size(), 3);
+    BOOST_CHECK(list.contains(id2));
+
+    list.notify(1);
+    BOOST_CHECK((calls == std::vector<int>{ 11, 21, 31 }));
+
+    BOOST_CHECK(list.remove(id2));
+    BOOST_CHECK(!list.remove(id2));
+    BOOST_CHECK(!list.contains(id2));
+    BOOST_CHECK_EQUAL(list.size(), 2);
+    BOOST_CHECK_EQUAL(slots.size(), 2);
+
+    calls.clear();
+    list.notify(2);
+    BOOST_CHECK((calls == std::vector<int>{ 12, 32 }));
+
+    list.clear();
+    BOOST_CHECK(list.empty());
+    BOOST_CHECK_EQUAL(slots.size(), 0);
+    BOOST_CHECK(!list.contains(id1));
+    BOOST_CHECK(!list.contains(id3));
+
+    calls.clear();
+    list.notify(3);
+    BOOST_CHECK(calls.empty());
+}
+
+BOOST_AUTO_TEST_CASE(stale_ids)
+{
+    SubscriptionSlots slots;
+    List list(slots);
+    List other(slots);
+
+    const SubscriptionId id1 = list.add([](int) {});
+    BOOST_CHECK(list.remove(id1));
+
+    // the slot is reused with a new generation
+    const SubscriptionId id2 = list.add([](int) {});
+    BOOST_CHECK(id1 != id2);
+    BOOST_CHECK(!list.remove(id1));
+    BOOST_CHECK(list.contains(id2));
+
+    // ids of other lists are not found
+    const SubscriptionId id3 = other.add([](int) {});
+    BOOST_CHECK(!list.contains(id3));
+    BOOST_CHECK(!list.remove(id3));
+    BOOST_CHECK(!other.remove(id2));
+    BOOST_CHECK(!list.remove(0));
+
+    BOOST_CHECK_EQUAL(list.size(), 1);
+    BOOST_CHECK_EQUAL(other.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(modification_during_notification)
+{
+    SubscriptionSlots slots;
+    List list(slots);
+    std::vector<int> calls;
+
+    // removes itself and the next subscriber, adds a new subscriber
+    SubscriptionId id1 = 0;
+    SubscriptionId id2 = 0;
+    SubscriptionId id4 = 0;
+    id1 = list.add([&](int x) {
+        calls.push_back(10 + x);
+        BOOST_CHECK(list.is_notifying());
+        BOOST_CHECK(list.remove(id1));
+        BOOST_CHECK(list.remove(id2));
+        id4 = list.add([&calls](int y) { calls.push_back(40 + y); });
+        BOOST_CHECK(list.contains(id4));
+        // the callback must still be usable after its removal
+        calls.push_back(10 + x);
+    });
+    id2 = list.add([&calls](int x) { calls.push_back(20 + x); });
+    const SubscriptionId id3 = list.add([&calls](int x) { calls.push_back(30 + x); });
+
+    list.notify(1);
+    BOOST_CHECK(!list.is_notifying());
+    BOOST_CHECK((calls == std::vector<int>{ 11, 11, 31 }));
+    BOOST_CHECK_EQUAL(list.size(), 2);
+    BOOST_CHECK(list.contains(id3));
+    BOOST_CHECK(list.contains(id4));
+
+    // the positions were updated by the compaction
+    BOOST_CHECK(list.remove(id4));
+    BOOST_CHECK(list.remove(id3));
+    BOOST_CHECK(list.empty());
+    list.add([&calls](int x) { calls.push_back(50 + x); });
+
+    calls.clear();
+    list.notify(2);
+    BOOST_CHECK((calls == std::vector<int>{ 52 }));
+}
+
+BOOST_AUTO_TEST_CASE(nested_notification)
+{
+    SubscriptionSlots slots;
+    List list(slots);
+    std::vector<int> calls;
+
+    list.add([&calls, &list](int x) {
+        calls.push_back(10 + x);
+        if (x == 1) {
+            list.notify(2);
+            list.clear();
+        }
+    });
+    list.add([&calls](int x) { calls.push_back(20 + x); });
+
+    list.notify(1);
+    BOOST_CHECK((calls == std::vector<int>{ 11, 12, 22 }));
+    BOOST_CHECK(list.empty());
+}
+
+BOOST_AUTO_TEST_CASE(exceptions)
+{
+    SubscriptionSlots slots;
+    List list(slots);
+
+    SubscriptionId id = 0;
+    id = list.add([&list, &id](int) {
+        list.remove(id);
+        throw std::runtime_error("callback");
+    });
+
+    BOOST_CHECK_THROW(list.notify(0), std::runtime_error);
+    BOOST_CHECK(!list.is_notifying());
+    BOOST_CHECK(list.empty());
+    BOOST_CHECK_EQUAL(slots.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot)
+{
+    SubscriptionSlots slots;
+    List list(slots);
+    std::vector<int> calls;
+
+    BOOST_CHECK(list.snapshot()->empty());
+
+    list.add([&calls](int x) { calls.push_back(10 + x); });
+    const SubscriptionId id2 = list.add([&calls](int x) { calls.push_back(20 + x); });
+
+    const std::shared_ptr<const List::Snapshot> p1 = list.snapshot();
+    BOOST_REQUIRE_EQUAL(p1->size(), 2);
+    BOOST_CHECK_EQUAL(list.snapshot(), p1);
+
+    // the snapshot is immutable
+    list.remove(id2);
+    const std::shared_ptr<const List::Snapshot> p2 = list.snapshot();
+    BOOST_CHECK(p2 != p1);
+    BOOST_CHECK_EQUAL(p1->size(), 2);
+    BOOST_REQUIRE_EQUAL(p2->size(), 1);
+
+    for (const Fn& f : *p1)
+        f(1);
+    BOOST_CHECK((calls == std::vector<int>{ 11, 21 }));
+}
+}
@@ -20,6 +20,9 @@
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <arpa/inet.h>
 
@@ -46,15 +49,15 @@ namespace deepstream {
     };
 
     struct EventMock : public Event {
-         EventMock(const SendFn &send_fn, SubscriptionId &subscription_counter)
-             : Event(send_fn, subscription_counter)
+         EventMock(const SendFn &send_fn, SubscriptionSlots &subscription_slots)
+             : Event(send_fn, subscription_slots)
          {
          }
     };
 
     struct PresenceMock : public Presence {
-         PresenceMock(const SendFn &send_fn, SubscriptionId &subscription_counter)
-             : Presence(send_fn, subscription_counter)
+         PresenceMock(const SendFn &send_fn, SubscriptionSlots &subscription_slots)
+             : Presence(send_fn, subscription_slots)
          {
          }
     };
@@ -69,7 +72,7 @@ namespace deepstream {
         {
         }
 
-        void process_messages()
+        void process_messages() override
         {
         }
 
@@ -120,9 +123,9 @@ namespace deepstream {
     {
         SimpleWSHandler wsh;
         FailHandler errh;
-        SubscriptionId sub_ctr = 0;
-        EventMock evt([](const Message &){ return true; }, sub_ctr);
-        PresenceMock pres([](const Message &){ return true; }, sub_ctr);
+        SubscriptionSlots subscription_slots;
+        EventMock evt([](const Message &){ return true; }, subscription_slots);
+        PresenceMock pres([](const Message &){ return true; }, subscription_slots);
         Connection conn("ws://uri", wsh, errh, evt, pres);
 
         conn.login(Buffer("auth"), [](const Buffer &){});
@@ -139,7 +142,7 @@ namespace deepstream {
         {
         }
 
-        void process_messages() {}
+        void process_messages() override {}
 
         std::string URI() const override {
             return uri_;
@@ -188,9 +191,9 @@ namespace deepstream {
     {
         RedirectionWSHandler wsh;
         FailHandler errh;
-        SubscriptionId sub_ctr = 0;
-        EventMock evt([](const Message &){ return true; }, sub_ctr);
-        PresenceMock pres([](const Message &){ return true; }, sub_ctr);
+        SubscriptionSlots subscription_slots;
+        EventMock evt([](const Message &){ return true; }, subscription_slots);
+        PresenceMock pres([](const Message &){ return true; }, subscription_slots);
         Connection conn("ws://initial.uri", wsh, errh, evt, pres);
 
         conn.login(Buffer("auth"), [](const Buffer &){});
@@ -199,6 +202,376 @@ namespace deepstream {
         BOOST_CHECK_EQUAL(wsh.URI(), "ws://redirection.uri");
     }
 
+    struct BatchingWSHandler : public SimpleWSHandler {
+        void process_messages() override
+        {
+            if (on_processed_)
+                (*on_processed_)();
+        }
+
+        bool send(const Buffer &message) override
+        {
+            if (message.front() == 'E') {
+                frames.push_back(message);
+                return true;
+            }
+
+            return SimpleWSHandler::send(message);
+        }
+
+        std::vector<Buffer> frames;
+    };
+
+    BOOST_AUTO_TEST_CASE(batching)
+    {
+        BatchingWSHandler wsh;
+        FailHandler errh;
+        SubscriptionSlots subscription_slots;
+        EventMock evt([](const Message &){ return true; }, subscription_slots);
+        PresenceMock pres([](const Message &){ return true; }, subscription_slots);
+        Connection conn("ws://uri", wsh, errh, evt, pres);
+
+        conn.login(Buffer("auth"), [](const Buffer &){});
+        BOOST_REQUIRE_EQUAL(conn.state(), ConnectionState::OPEN);
+
+        MessageBuilder message(Topic::EVENT, Action::EVENT);
+        message.add_argument(Buffer("name"));
+        message.add_argument(Buffer("Sdata"));
+
+        const Buffer binary = message.to_binary();
+        Buffer two_messages(binary);
+        two_messages.insert(two_messages.end(), binary.cbegin(), binary.cend());
+
+        // without batching, every message is a frame
+        conn.send(message);
+        BOOST_REQUIRE_EQUAL(wsh.frames.size(), 1);
+        BOOST_CHECK(wsh.frames[0] == binary);
+        wsh.frames.clear();
+
+        // explicit flush
+        conn.batching(1024, std::chrono::hours(1));
+        BOOST_CHECK(conn.send(message));
+        BOOST_CHECK(conn.send(message));
+        BOOST_CHECK(wsh.frames.empty());
+
+        BOOST_CHECK(conn.flush());
+        BOOST_REQUIRE_EQUAL(wsh.frames.size(), 1);
+        BOOST_CHECK(wsh.frames[0] == two_messages);
+        wsh.frames.clear();
+
+        // end of message processing
+        conn.send(message);
+        BOOST_CHECK(wsh.frames.empty());
+        wsh.process_messages();
+        BOOST_REQUIRE_EQUAL(wsh.frames.size(), 1);
+        BOOST_CHECK(wsh.frames[0] == binary);
+        wsh.frames.clear();
+
+        // size threshold
+        conn.batching(binary.size() + 1, std::chrono::hours(1));
+        conn.send(message);
+        BOOST_CHECK(wsh.frames.empty());
+        conn.send(message);
+        BOOST_REQUIRE_EQUAL(wsh.frames.size(), 1);
+        BOOST_CHECK(wsh.frames[0] == two_messages);
+        wsh.frames.clear();
+
+        // latency bound
+        conn.batching(1024, std::chrono::milliseconds(0));
+        conn.send(message);
+        BOOST_REQUIRE_EQUAL(wsh.frames.size(), 1);
+        wsh.frames.clear();
+
+        // disabling batching sends collected messages
+        conn.batching(1024, std::chrono::hours(1));
+        conn.send(message);
+        conn.batching(0, std::chrono::milliseconds(0));
+        BOOST_REQUIRE_EQUAL(wsh.frames.size(), 1);
+        BOOST_CHECK(wsh.frames[0] == binary);
+    }
+
+    struct RecordingWSHandler : public SimpleWSHandler {
+        RecordingWSHandler()
+            : is_recording(false)
+        {
+        }
+
+        bool send(const Buffer &message) override
+        {
+            if (!is_recording)
+                return SimpleWSHandler::send(message);
+
+            frames.push_back(message);
+            return true;
+        }
+
+        bool is_recording;
+        std::vector<Buffer> frames;
+    };
+
+    BOOST_AUTO_TEST_CASE(lanes)
+    {
+        RecordingWSHandler wsh;
+        FailHandler errh;
+        SubscriptionSlots subscription_slots;
+        EventMock evt([](const Message &){ return true; }, subscription_slots);
+        PresenceMock pres([](const Message &){ return true; }, subscription_slots);
+        Connection conn("ws://uri", wsh, errh, evt, pres);
+
+        conn.login(Buffer("auth"), [](const Buffer &){});
+        BOOST_REQUIRE_EQUAL(conn.state(), ConnectionState::OPEN);
+        wsh.is_recording = true;
+
+        MessageBuilder event(Topic::EVENT, Action::EVENT);
+        event.add_argument(Buffer("name"));
+        event.add_argument(Buffer("Sdata"));
+
+        MessageBuilder subscription(Topic::EVENT, Action::SUBSCRIBE);
+        subscription.add_argument(Buffer("name"));
+
+        const MessageBuilder pong(Topic::CONNECTION, Action::PONG);
+
+        BOOST_CHECK_EQUAL(Connection::lane(pong), Connection::CONTROL);
+        BOOST_CHECK_EQUAL(Connection::lane(subscription), Connection::SUBSCRIPTIONS);
+        BOOST_CHECK_EQUAL(Connection::lane(event), Connection::EVENTS);
+
+        conn.batching(1024, std::chrono::hours(1));
+        BOOST_CHECK(conn.send(event));
+        BOOST_CHECK(conn.send(subscription));
+        BOOST_CHECK(wsh.frames.empty());
+
+        // the pong overtakes the collected messages
+        BOOST_CHECK(conn.send(pong));
+        BOOST_REQUIRE_EQUAL(wsh.frames.size(), 1);
+        BOOST_CHECK(wsh.frames[0] == pong.to_binary());
+        wsh.frames.clear();
+
+        // the subscriptions go first
+        BOOST_CHECK(conn.flush());
+        BOOST_REQUIRE_EQUAL(wsh.frames.size(), 2);
+        BOOST_CHECK(wsh.frames[0] == subscription.to_binary());
+        BOOST_CHECK(wsh.frames[1] == event.to_binary());
+        wsh.frames.clear();
+
+        // a full subscription batch leaves the event batch alone
+        conn.batching(event.to_binary().size() + 1, std::chrono::hours(1));
+        BOOST_CHECK(conn.send(event));
+        BOOST_CHECK(conn.send(subscription));
+        BOOST_CHECK(conn.send(subscription));
+        BOOST_REQUIRE_EQUAL(wsh.frames.size(), 1);
+        BOOST_CHECK_EQUAL(wsh.frames[0].size(), 2 * subscription.to_binary().size());
+        wsh.frames.clear();
+
+        // without batching, collected messages of the lanes with a higher
+        // priority go first
+        conn.batching(0, std::chrono::milliseconds(0));
+        BOOST_REQUIRE_EQUAL(wsh.frames.size(), 1);
+        BOOST_CHECK(wsh.frames[0] == event.to_binary());
+        wsh.frames.clear();
+
+        BOOST_CHECK(conn.send_bulk(subscription));
+        BOOST_CHECK(wsh.frames.empty());
+        BOOST_CHECK(conn.send(event));
+        BOOST_REQUIRE_EQUAL(wsh.frames.size(), 2);
+        BOOST_CHECK(wsh.frames[0] == subscription.to_binary());
+        BOOST_CHECK(wsh.frames[1] == event.to_binary());
+    }
+
+    struct BurstWSHandler : public SimpleWSHandler {
+        void process_messages() override
+        {
+            for (Buffer& frame : frames) {
+                const std::size_t size = frame.size();
+                frame.resize(size + FRAME_PADDING);
+                (*on_frame_)(frame.data(), size);
+            }
+            frames.clear();
+
+            if (on_processed_)
+                (*on_processed_)();
+        }
+
+        void receive(const Buffer& messages, std::size_t split)
+        {
+            frames.emplace_back(messages.cbegin(), messages.cbegin() + split);
+            frames.emplace_back(messages.cbegin() + split, messages.cend());
+        }
+
+        std::vector<Buffer> frames;
+    };
+
+    BOOST_AUTO_TEST_CASE(budget)
+    {
+        BurstWSHandler wsh;
+        FailHandler errh;
+        SubscriptionSlots subscription_slots;
+        EventMock evt([](const Message &){ return true; }, subscription_slots);
+        PresenceMock pres([](const Message &){ return true; }, subscription_slots);
+        Connection conn("ws://uri", wsh, errh, evt, pres);
+
+        conn.login(Buffer("auth"), [](const Buffer &){});
+        BOOST_REQUIRE_EQUAL(conn.state(), ConnectionState::OPEN);
+
+        std::vector<std::string> received;
+        evt.subscribe(Buffer("name"), [&received](const BufferView& data) {
+            received.emplace_back(data.cbegin(), data.cend());
+        });
+
+        auto make_events = [](int first, int last) {
+            Buffer messages;
+            for (int i = first; i < last; ++i) {
+                MessageBuilder message(Topic::EVENT, Action::EVENT);
+                message.add_argument(Buffer("name"));
+                message.add_argument(Buffer("S" + std::to_string(i)));
+
+                const Buffer binary = message.to_binary();
+                messages.insert(messages.end(), binary.cbegin(), binary.cend());
+            }
+            return messages;
+        };
+
+        // a message is split across the two frames
+        const Buffer burst = make_events(0, 5);
+        wsh.receive(burst, burst.size() / 2);
+
+        const ProcessingBudget two_messages(2, 0, std::chrono::microseconds::zero());
+        BOOST_CHECK(conn.process_messages(two_messages));
+        BOOST_CHECK_EQUAL(received.size(), 2);
+        BOOST_CHECK(conn.has_backlog());
+
+        // the handler is not read while the backlog exhausts the budget
+        const Buffer next = make_events(5, 7);
+        wsh.receive(next, 1);
+        BOOST_CHECK(conn.process_messages(two_messages));
+        BOOST_CHECK_EQUAL(received.size(), 4);
+        BOOST_CHECK_EQUAL(wsh.frames.size(), 2);
+
+        // the last message of the backlog leaves room for the new frames
+        BOOST_CHECK(conn.process_messages(two_messages));
+        BOOST_CHECK_EQUAL(received.size(), 6);
+        BOOST_CHECK(wsh.frames.empty());
+
+        // at least one message is dispatched per call
+        const ProcessingBudget one_byte(0, 1, std::chrono::microseconds::zero());
+        BOOST_CHECK(!conn.process_messages(one_byte));
+        BOOST_REQUIRE_EQUAL(received.size(), 7);
+
+        for (std::size_t i = 0; i < received.size(); ++i)
+            BOOST_CHECK_EQUAL(received[i], "S" + std::to_string(i));
+
+        // without a limit, everything is dispatched
+        const Buffer more = make_events(7, 10);
+        wsh.receive(more, more.size() - 1);
+        BOOST_CHECK(!conn.process_messages(ProcessingBudget()));
+        BOOST_CHECK_EQUAL(received.size(), 10);
+        BOOST_CHECK(!conn.has_backlog());
+
+        // the backlog is parsed in chunks
+        const Buffer large_burst = make_events(10, 3000);
+        BOOST_REQUIRE_GT(large_burst.size(), 2 * Connection::BACKLOG_CHUNK_SIZE);
+        wsh.receive(large_burst, large_burst.size() / 3);
+
+        const ProcessingBudget many_messages(1000, 0, std::chrono::microseconds::zero());
+        std::size_t num_calls = 1;
+        while (conn.process_messages(many_messages))
+            ++num_calls;
+
+        BOOST_CHECK_EQUAL(num_calls, 3);
+        BOOST_REQUIRE_EQUAL(received.size(), 3000);
+
+        for (std::size_t i = 0; i < received.size(); ++i)
+            BOOST_CHECK_EQUAL(received[i], "S" + std::to_string(i));
+    }
+
+    struct CollectingErrorHandler : public ErrorHandler {
+        void on_error(const std::string &error) override
+        {
+            errors.push_back(error);
+        }
+
+        std::vector<std::string> errors;
+    };
+
+    struct HeartbeatWSHandler : public BurstWSHandler {
+        HeartbeatWSHandler()
+            : num_opens(0)
+        {
+        }
+
+        bool send(const Buffer &message) override
+        {
+            if (message == Message::from_human_readable("C|PO+"))
+                return true;
+
+            return BurstWSHandler::send(message);
+        }
+
+        void open() override
+        {
+            ++num_opens;
+            BurstWSHandler::open();
+        }
+
+        void close() override
+        {
+            (*on_close_)();
+        }
+
+        int num_opens;
+    };
+
+    BOOST_AUTO_TEST_CASE(heartbeat)
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        HeartbeatWSHandler wsh;
+        CollectingErrorHandler errh;
+        SubscriptionSlots subscription_slots;
+        EventMock evt([](const Message &){ return true; }, subscription_slots);
+        PresenceMock pres([](const Message &){ return true; }, subscription_slots);
+        Connection conn("ws://uri", wsh, errh, evt, pres);
+
+        conn.login(Buffer("auth"), [](const Buffer &){});
+        BOOST_REQUIRE_EQUAL(conn.state(), ConnectionState::OPEN);
+
+        Clock::time_point deadline;
+        BOOST_CHECK(!conn.next_timer_deadline(&deadline));
+
+        const auto timeout = std::chrono::milliseconds(200);
+        conn.heartbeat_timeout(timeout);
+        BOOST_REQUIRE(conn.next_timer_deadline(&deadline));
+        BOOST_CHECK(deadline > Clock::now());
+
+        // pings keep the connection alive
+        const Clock::time_point start = Clock::now();
+        while (Clock::now() - start < 2 * timeout) {
+            wsh.frames.push_back(Message::from_human_readable("C|PI+"));
+            conn.process_messages(ProcessingBudget());
+            std::this_thread::sleep_for(timeout / 10);
+        }
+
+        BOOST_CHECK(errh.errors.empty());
+        BOOST_CHECK_EQUAL(wsh.num_opens, 1);
+
+        // silence
+        while (errh.errors.empty() && Clock::now() - start < 10 * timeout) {
+            conn.process_messages(ProcessingBudget());
+            std::this_thread::sleep_for(timeout / 10);
+        }
+
+        BOOST_REQUIRE_EQUAL(errh.errors.size(), 1);
+        BOOST_CHECK(errh.errors[0].find("heartbeat timeout") != std::string::npos);
+        BOOST_CHECK(errh.errors[0].find("last ping") != std::string::npos);
+
+        // the connection was reopened right away
+        BOOST_CHECK_EQUAL(wsh.num_opens, 2);
+        BOOST_CHECK_EQUAL(conn.state(), ConnectionState::OPEN);
+        BOOST_CHECK(conn.next_timer_deadline(&deadline));
+
+        conn.heartbeat_timeout(std::chrono::milliseconds(0));
+        BOOST_CHECK(!conn.next_timer_deadline(&deadline));
+    }
+
     BOOST_AUTO_TEST_CASE(lifetime)
     {
         auto make_msg = [](Topic topic, Action action) {
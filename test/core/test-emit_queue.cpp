@@ -0,0 +1,165 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstddef>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/emit_queue.hpp>
+#include "src/core/message.hpp"
+
+namespace deepstream {
+
+BOOST_AUTO_TEST_CASE(simple)
+{
+    EmitQueue queue(4);
+    std::vector<EmitQueue::Record> records(8);
+
+    BOOST_CHECK_EQUAL(queue.drain(records), 0);
+    BOOST_CHECK_EQUAL(queue.num_lanes(), 0);
+
+    BOOST_CHECK(queue.push(Buffer("a"), Buffer("1")));
+    BOOST_CHECK(queue.push(Buffer("b"), Buffer("")));
+    BOOST_CHECK_EQUAL(queue.num_lanes(), 1);
+    BOOST_CHECK_THROW(queue.push(Buffer(""), Buffer("2")), std::invalid_argument);
+
+    BOOST_REQUIRE_EQUAL(queue.drain(records), 2);
+    BOOST_CHECK(records[0].message == Message::from_human_readable("E|EVT|a|1+"));
+    BOOST_CHECK(Buffer(records[0].name()) == Buffer("a"));
+    BOOST_CHECK(Buffer(records[0].data()) == Buffer("1"));
+    BOOST_CHECK(records[1].message == Message::from_human_readable("E|EVT|b|+"));
+    BOOST_CHECK_EQUAL(records[1].data().size(), 0);
+
+    // the lane of the thread is full
+    for (std::size_t i = 0; i < 4; ++i)
+        BOOST_CHECK(queue.push(Buffer("c"), Buffer(std::to_string(i))));
+    BOOST_CHECK(!queue.push(Buffer("c"), Buffer("4")));
+
+    records.resize(3);
+    BOOST_CHECK_EQUAL(queue.drain(records), 3);
+    BOOST_CHECK_EQUAL(queue.drain(records), 1);
+    BOOST_CHECK(Buffer(records[0].data()) == Buffer("3"));
+}
+
+BOOST_AUTO_TEST_CASE(threads)
+{
+    const std::size_t NUM_THREADS = 16;
+    const std::size_t NUM_EVENTS = 10000;
+
+    EmitQueue queue(256);
+
+    std::vector<std::thread> producers;
+    for (std::size_t t = 0; t < NUM_THREADS; ++t) {
+        producers.emplace_back([&queue, t]() {
+            const Buffer name(std::to_string(t));
+
+            for (std::size_t i = 0; i < NUM_EVENTS;) {
+                if (queue.push(name, Buffer(std::to_string(i))))
+                    ++i;
+                else
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    // the events of every thread arrive in order
+    std::vector<std::size_t> next(NUM_THREADS, 0);
+    std::vector<EmitQueue::Record> records(64);
+    std::size_t num_events = 0;
+    bool ok = true;
+
+    while (ok && num_events < NUM_THREADS * NUM_EVENTS) {
+        const std::size_t n = queue.drain(records);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            const std::size_t t = std::stoul(std::string(records[i].name().data(), records[i].name().size()));
+            const std::size_t value = std::stoul(std::string(records[i].data().data(), records[i].data().size()));
+
+            ok = ok && t < NUM_THREADS && value == next[t];
+            ++next[t];
+        }
+
+        num_events += n;
+    }
+
+    for (std::thread& producer : producers)
+        producer.join();
+
+    BOOST_CHECK(ok);
+    BOOST_CHECK_EQUAL(num_events, NUM_THREADS * NUM_EVENTS);
+    // lanes of exited threads may have been reused
+    BOOST_CHECK(queue.num_lanes() <= NUM_THREADS);
+    BOOST_CHECK_EQUAL(queue.drain(records), 0);
+}
+
+BOOST_AUTO_TEST_CASE(many_queues)
+{
+    const std::size_t NUM_QUEUES = 40;
+
+    std::vector<std::unique_ptr<EmitQueue>> queues;
+    for (std::size_t i = 0; i < NUM_QUEUES; ++i)
+        queues.emplace_back(new EmitQueue(4));
+
+    for (std::size_t i = 0; i < 3; ++i)
+        for (std::unique_ptr<EmitQueue>& queue : queues)
+            BOOST_CHECK(queue->push(Buffer("a"), Buffer(std::to_string(i))));
+
+    // the thread keeps one lane per queue
+    std::vector<EmitQueue::Record> records(8);
+    for (std::unique_ptr<EmitQueue>& queue : queues) {
+        BOOST_CHECK_EQUAL(queue->num_lanes(), 1);
+        BOOST_REQUIRE_EQUAL(queue->drain(records), 3);
+        BOOST_CHECK(Buffer(records[0].data()) == Buffer("0"));
+        BOOST_CHECK(Buffer(records[2].data()) == Buffer("2"));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(thread_exit)
+{
+    EmitQueue queue(4);
+    std::vector<EmitQueue::Record> records(8);
+
+    // more threads than lanes, one after another
+    for (std::size_t t = 0; t < 2 * EmitQueue::MAX_LANES; ++t) {
+        bool ok = false;
+        std::thread producer([&queue, &ok, t]() {
+            ok = queue.push(Buffer("a"), Buffer(std::to_string(t)));
+        });
+        producer.join();
+
+        BOOST_REQUIRE(ok);
+        BOOST_REQUIRE_EQUAL(queue.drain(records), 1);
+        BOOST_CHECK(Buffer(records[0].data()) == Buffer(std::to_string(t)));
+    }
+
+    // the lane is reused once it was drained
+    BOOST_CHECK_EQUAL(queue.num_lanes(), 1);
+
+    std::thread producer([&queue]() { queue.push(Buffer("a"), Buffer("x")); });
+    producer.join();
+    BOOST_CHECK(queue.push(Buffer("a"), Buffer("y")));
+    BOOST_CHECK_EQUAL(queue.num_lanes(), 2);
+    BOOST_CHECK_EQUAL(queue.drain(records), 2);
+}
+}
@@ -17,14 +17,26 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <cstdlib>
+
 #include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <deepstream/core/buffer.hpp>
+#include <deepstream/core/client.hpp>
 #include <deepstream/core/event.hpp>
+#include <deepstream/core/executor.hpp>
+#include <deepstream/core/name_table.hpp>
+#include <deepstream/core/persistent_outbox.hpp>
 #include "src/core/message.hpp"
 #include "src/core/message_builder.hpp"
 #include "src/core/scope_guard.hpp"
 
+#include <unistd.h>
+
 namespace deepstream {
 
 BOOST_AUTO_TEST_CASE(simple)
@@ -48,7 +60,7 @@ BOOST_AUTO_TEST_CASE(simple)
             BOOST_CHECK(!message.is_ack());
 
             BOOST_REQUIRE_EQUAL(message.num_arguments(), 1);
-            const Event::Name& my_name = message[0];
+            const BufferView my_name = message[0];
             BOOST_REQUIRE_EQUAL(name.size(), my_name.size());
             BOOST_CHECK(std::equal(name.cbegin(), name.cend(), my_name.cbegin()));
 
@@ -60,7 +72,7 @@ BOOST_AUTO_TEST_CASE(simple)
             BOOST_CHECK(!message.is_ack());
 
             BOOST_REQUIRE_EQUAL(message.num_arguments(), 1);
-            const Event::Name& my_pattern = message[0];
+            const BufferView my_pattern = message[0];
             BOOST_REQUIRE_EQUAL(pattern.size(), my_pattern.size());
             BOOST_CHECK(
                 std::equal(pattern.cbegin(), pattern.cend(), my_pattern.cbegin()));
@@ -73,7 +85,7 @@ BOOST_AUTO_TEST_CASE(simple)
             BOOST_CHECK(!message.is_ack());
 
             BOOST_REQUIRE_EQUAL(message.num_arguments(), 1);
-            const Event::Name& my_name = message[0];
+            const BufferView my_name = message[0];
             BOOST_REQUIRE_EQUAL(name.size(), my_name.size());
             BOOST_CHECK(std::equal(name.cbegin(), name.cend(), my_name.cbegin()));
 
@@ -85,7 +97,7 @@ BOOST_AUTO_TEST_CASE(simple)
             BOOST_CHECK(!message.is_ack());
 
             BOOST_REQUIRE_EQUAL(message.num_arguments(), 1);
-            const Event::Name& my_pattern = message[0];
+            const BufferView my_pattern = message[0];
             BOOST_REQUIRE_EQUAL(pattern.size(), my_pattern.size());
             BOOST_CHECK(
                 std::equal(pattern.cbegin(), pattern.cend(), my_pattern.begin()));
@@ -97,41 +109,41 @@ BOOST_AUTO_TEST_CASE(simple)
         return false;
     };
 
-    SubscriptionId subscription_counter = 0;
-    Event event(send, subscription_counter);
+    SubscriptionSlots subscription_slots;
+    Event event(send, subscription_slots);
 
-    Event::SubscribeFn f = [](const Buffer&) {};
+    Event::SubscribeFn f = [](const BufferView&) {};
 
     state = 0;
     const SubscriptionId s1 = event.subscribe(name, f);
     {
-        BOOST_CHECK_EQUAL(event.subscriber_map_.size(), 1);
-        BOOST_CHECK_EQUAL(subscription_counter, 1);
-        auto it = event.subscriber_map_.find(name);
-        BOOST_REQUIRE(it != event.subscriber_map_.end());
-        BOOST_CHECK_EQUAL(it->second.size(), 1);
-        BOOST_CHECK_EQUAL(it->second.front(), s1);
+        BOOST_CHECK_EQUAL(event.subscription_names_.size(), 1);
+        BOOST_CHECK_EQUAL(subscription_slots.size(), 1);
+        const Event::SubscriberList* subscribers = event.subscribers(name);
+        BOOST_REQUIRE(subscribers);
+        BOOST_CHECK_EQUAL(subscribers->size(), 1);
+        BOOST_CHECK(subscribers->contains(s1));
     }
 
     const SubscriptionId s2 = event.subscribe(name, f);
     {
-        BOOST_CHECK_EQUAL(event.subscriber_map_.size(), 1);
-        BOOST_CHECK_EQUAL(subscription_counter, 2);
-        auto it = event.subscriber_map_.find(name);
-        BOOST_REQUIRE(it != event.subscriber_map_.end());
-        BOOST_CHECK_EQUAL(it->second.size(), 2);
+        BOOST_CHECK_EQUAL(event.subscription_names_.size(), 1);
+        BOOST_CHECK_EQUAL(subscription_slots.size(), 2);
+        const Event::SubscriberList* subscribers = event.subscribers(name);
+        BOOST_REQUIRE(subscribers);
+        BOOST_CHECK_EQUAL(subscribers->size(), 2);
     }
 
     event.unsubscribe(name, s1);
     {
-        BOOST_CHECK_EQUAL(event.subscriber_map_.size(), 1);
-        BOOST_CHECK_EQUAL(subscription_counter, 2);
-        auto it = event.subscriber_map_.find(name);
-        BOOST_REQUIRE(it != event.subscriber_map_.end());
-        BOOST_CHECK_EQUAL(it->second.size(), 1);
+        BOOST_CHECK_EQUAL(event.subscription_names_.size(), 1);
+        BOOST_CHECK_EQUAL(subscription_slots.size(), 1);
+        const Event::SubscriberList* subscribers = event.subscribers(name);
+        BOOST_REQUIRE(subscribers);
+        BOOST_CHECK_EQUAL(subscribers->size(), 1);
     }
 
-    BOOST_CHECK(event.listener_map_.empty());
+    BOOST_CHECK(event.listener_patterns_.empty());
 
     Event::ListenFn g1 = [](const Name&, bool) { return true; };
     Event::ListenFn g2 = [](const Name&, bool) { return true; };
@@ -139,37 +151,35 @@ BOOST_AUTO_TEST_CASE(simple)
     state = 1;
     event.listen(pattern, g1);
     {
-        BOOST_CHECK_EQUAL(event.listener_map_.size(), 1);
-        auto it = event.listener_map_.find(pattern);
-        BOOST_REQUIRE(it != event.listener_map_.end());
-        BOOST_REQUIRE_EQUAL(pattern.size(), it->first.size());
-        BOOST_REQUIRE(
-            std::equal(pattern.cbegin(), pattern.cend(), it->first.cbegin()));
+        BOOST_CHECK_EQUAL(event.listener_patterns_.size(), 1);
+        const NameTable::Id id = event.listener_patterns_.find(pattern);
+        BOOST_REQUIRE(id != NameTable::NONE);
+        BOOST_CHECK(event.listener_patterns_.name(id) == pattern);
+        BOOST_REQUIRE(event.listener(pattern));
     }
 
     event.listen(pattern, g2);
     {
-        BOOST_CHECK_EQUAL(event.listener_map_.size(), 1);
-        auto it = event.listener_map_.find(pattern);
-        BOOST_REQUIRE(it != event.listener_map_.end());
-        BOOST_REQUIRE_EQUAL(pattern.size(), it->first.size());
-        BOOST_REQUIRE(
-            std::equal(pattern.cbegin(), pattern.cend(), it->first.cbegin()));
+        BOOST_CHECK_EQUAL(event.listener_patterns_.size(), 1);
+        const NameTable::Id id = event.listener_patterns_.find(pattern);
+        BOOST_REQUIRE(id != NameTable::NONE);
+        BOOST_CHECK(event.listener_patterns_.name(id) == pattern);
+        BOOST_REQUIRE(event.listener(pattern));
     }
 
-    BOOST_CHECK_EQUAL(event.subscriber_map_.size(), 1);
+    BOOST_CHECK_EQUAL(event.subscription_names_.size(), 1);
     event.unsubscribe(name, s1); // we removed s1 above already
-    BOOST_CHECK_EQUAL(event.subscriber_map_.size(), 1);
+    BOOST_CHECK_EQUAL(event.subscription_names_.size(), 1);
 
     state = 2;
     event.unsubscribe(name, s2);
-    BOOST_CHECK(event.subscriber_map_.empty());
-    BOOST_CHECK_EQUAL(event.listener_map_.size(), 1);
+    BOOST_CHECK(event.subscription_names_.empty());
+    BOOST_CHECK_EQUAL(event.listener_patterns_.size(), 1);
 
     state = 3;
     event.unlisten(pattern);
-    BOOST_CHECK(event.subscriber_map_.empty());
-    BOOST_CHECK(event.listener_map_.empty());
+    BOOST_CHECK(event.subscription_names_.empty());
+    BOOST_CHECK(event.listener_patterns_.empty());
 }
 
 BOOST_AUTO_TEST_CASE(subscriber_notification)
@@ -179,7 +189,7 @@ BOOST_AUTO_TEST_CASE(subscriber_notification)
 
     bool is_subscribed = false;
     auto send = [name, &is_subscribed](const Message& message) -> bool {
-        const Event::Name& my_name = message[0];
+        const BufferView my_name = message[0];
 
         BOOST_CHECK_EQUAL(message.topic(), Topic::EVENT);
         BOOST_REQUIRE_EQUAL(name.size(), my_name.size());
@@ -195,19 +205,19 @@ BOOST_AUTO_TEST_CASE(subscriber_notification)
         return true;
     };
 
-    SubscriptionId subscription_counter = 0;
-    Event event(send, subscription_counter);
+    SubscriptionSlots subscription_slots;
+    Event event(send, subscription_slots);
 
     unsigned num_calls = 0;
-    Event::SubscribeFn f = [data, &num_calls](const Buffer& my_data) {
+    Event::SubscribeFn f = [data, &num_calls](const BufferView& my_data) {
         BOOST_CHECK(std::equal(data.cbegin(), data.cend(), my_data.cbegin()));
         ++num_calls;
     };
 
     SubscriptionId sub_id = event.subscribe(name, f);
     BOOST_CHECK(is_subscribed);
-    BOOST_CHECK_EQUAL(event.subscriber_map_.size(), 1);
-    BOOST_CHECK_EQUAL(subscription_counter, 1);
+    BOOST_CHECK_EQUAL(event.subscription_names_.size(), 1);
+    BOOST_CHECK_EQUAL(subscription_slots.size(), 1);
 
     MessageBuilder message(Topic::EVENT, Action::EVENT);
     message.add_argument(name);
@@ -216,7 +226,7 @@ BOOST_AUTO_TEST_CASE(subscriber_notification)
     event.notify_(message);
     BOOST_CHECK_EQUAL(num_calls, 1);
 
-    Event::SubscribeFn g = [name, data, &num_calls, &event, sub_id](const Buffer& my_data) {
+    Event::SubscribeFn g = [name, data, &num_calls, &event, sub_id](const BufferView& my_data) {
         BOOST_CHECK(std::equal(data.cbegin(), data.cend(), my_data.cbegin()));
 
         num_calls += 10;
@@ -227,17 +237,17 @@ BOOST_AUTO_TEST_CASE(subscriber_notification)
     event.notify_(message);
     BOOST_CHECK_EQUAL(num_calls, 12);
 
-    BOOST_CHECK_EQUAL(event.subscriber_map_.size(), 1);
-    BOOST_CHECK_EQUAL(subscription_counter, 2);
+    BOOST_CHECK_EQUAL(event.subscription_names_.size(), 1);
+    BOOST_CHECK_EQUAL(subscription_slots.size(), 1);
 
-    Event::SubscriberMap::const_iterator ci = event.subscriber_map_.cbegin();
-    const Event::SubscriberList& subscribers = ci->second;
+    BOOST_REQUIRE(event.subscribers(name));
+    const Event::SubscriberList& subscribers = *event.subscribers(name);
     BOOST_CHECK_EQUAL(subscribers.size(), 1);
-    BOOST_CHECK_EQUAL(subscribers.front(), p_g);
+    BOOST_CHECK(subscribers.contains(p_g));
 
     event.unsubscribe(name);
-    BOOST_CHECK(event.subscriber_map_.empty());
-    BOOST_CHECK_EQUAL(subscription_counter, 2);
+    BOOST_CHECK(event.subscription_names_.empty());
+    BOOST_CHECK_EQUAL(subscription_slots.size(), 0);
     BOOST_CHECK(!is_subscribed);
 }
 
@@ -251,7 +261,7 @@ BOOST_AUTO_TEST_CASE(emit)
     auto send = [name, data, &is_subscribed, &num_emit](const Message& message) {
         BOOST_CHECK_EQUAL(message.topic(), Topic::EVENT);
 
-        const Event::Name& my_name = message[0];
+        const BufferView my_name = message[0];
         BOOST_REQUIRE_EQUAL(name.size(), my_name.size());
         BOOST_CHECK(std::equal(name.cbegin(), name.cend(), my_name.cbegin()));
 
@@ -262,7 +272,7 @@ BOOST_AUTO_TEST_CASE(emit)
         else if (message.action() == Action::EVENT) {
             BOOST_REQUIRE_EQUAL(message.num_arguments(), 2);
 
-            const Buffer& my_data = message[1];
+            const BufferView my_data = message[1];
             BOOST_REQUIRE_EQUAL(data.size(), my_data.size());
             BOOST_CHECK(std::equal(data.cbegin(), data.cend(), my_data.cbegin()));
 
@@ -273,25 +283,25 @@ BOOST_AUTO_TEST_CASE(emit)
         return true;
     };
 
-    SubscriptionId subscription_counter = 0;
-    Event event(send, subscription_counter);
+    SubscriptionSlots subscription_slots;
+    Event event(send, subscription_slots);
 
     unsigned num_calls = 0;
-    Event::SubscribeFn f = [data, &num_calls](const Buffer& my_data) {
+    Event::SubscribeFn f = [data, &num_calls](const BufferView& my_data) {
         BOOST_CHECK(std::equal(data.cbegin(), data.cend(), my_data.cbegin()));
         ++num_calls;
     };
 
     SubscriptionId sub = event.subscribe(name, f);
     BOOST_CHECK(is_subscribed);
-    BOOST_CHECK_EQUAL(event.subscriber_map_.size(), 1);
-    BOOST_CHECK_EQUAL(subscription_counter, 1);
+    BOOST_CHECK_EQUAL(event.subscription_names_.size(), 1);
+    BOOST_CHECK_EQUAL(subscription_slots.size(), 1);
 
     event.emit(name, data);
     BOOST_CHECK_EQUAL(num_emit, 1);
     BOOST_CHECK_EQUAL(num_calls, 1);
 
-    Event::SubscribeFn g = [name, data, &num_calls, &event, sub](const Buffer& my_data) {
+    Event::SubscribeFn g = [name, data, &num_calls, &event, sub](const BufferView& my_data) {
         BOOST_CHECK(std::equal(data.cbegin(), data.cend(), my_data.cbegin()));
 
         num_calls += 10;
@@ -303,16 +313,16 @@ BOOST_AUTO_TEST_CASE(emit)
     BOOST_CHECK_EQUAL(num_emit, 2);
     BOOST_CHECK_EQUAL(num_calls, 12);
 
-    BOOST_CHECK_EQUAL(event.subscriber_map_.size(), 1);
-    Event::SubscriberMap::const_iterator ci = event.subscriber_map_.cbegin();
-    const Event::SubscriberList& subscribers = ci->second;
+    BOOST_CHECK_EQUAL(event.subscription_names_.size(), 1);
+    BOOST_REQUIRE(event.subscribers(name));
+    const Event::SubscriberList& subscribers = *event.subscribers(name);
     BOOST_CHECK_EQUAL(subscribers.size(), 1);
-    BOOST_CHECK_EQUAL(subscription_counter, 2);
-    BOOST_CHECK_EQUAL(subscribers.front(), p_g);
+    BOOST_CHECK_EQUAL(subscription_slots.size(), 1);
+    BOOST_CHECK(subscribers.contains(p_g));
 
     event.unsubscribe(name);
-    BOOST_CHECK(event.subscriber_map_.empty());
-    BOOST_CHECK_EQUAL(subscription_counter, 2);
+    BOOST_CHECK(event.subscription_names_.empty());
+    BOOST_CHECK_EQUAL(subscription_slots.size(), 0);
     BOOST_CHECK(!is_subscribed);
 }
 
@@ -331,7 +341,7 @@ BOOST_AUTO_TEST_CASE(listener_notification)
         BOOST_REQUIRE_EQUAL(message.num_arguments(),
             (message.action() == Action::LISTEN_ACCEPT) ? 2 : 1);
 
-        const Event::Name& my_pattern = message[0];
+        const BufferView my_pattern = message[0];
         BOOST_REQUIRE_EQUAL(pattern.size(), my_pattern.size());
         BOOST_CHECK(
             std::equal(pattern.cbegin(), pattern.cend(), my_pattern.cbegin()));
@@ -358,12 +368,12 @@ BOOST_AUTO_TEST_CASE(listener_notification)
         return true;
     };
 
-    SubscriptionId subscription_counter = 0;
-    Event event(send, subscription_counter);
+    SubscriptionSlots subscription_slots;
+    Event event(send, subscription_slots);
     event.listen(pattern, f);
 
     BOOST_CHECK(is_listening);
-    BOOST_CHECK_EQUAL(event.listener_map_.size(), 1);
+    BOOST_CHECK_EQUAL(event.listener_patterns_.size(), 1);
 
     // E|SP
     MessageBuilder sp(Topic::EVENT, Action::SUBSCRIPTION_FOR_PATTERN_FOUND);
@@ -389,6 +399,482 @@ BOOST_AUTO_TEST_CASE(listener_notification)
     event.unlisten(pattern);
 
     BOOST_CHECK(!is_listening);
-    BOOST_CHECK(event.listener_map_.empty());
+    BOOST_CHECK(event.listener_patterns_.empty());
+}
+
+BOOST_AUTO_TEST_CASE(many_names)
+{
+    const std::size_t NUM_NAMES = 100;
+
+    std::vector<Buffer> unsubscribed;
+    auto send = [&unsubscribed](const Message& message) {
+        if (message.action() == Action::UNSUBSCRIBE)
+            unsubscribed.emplace_back(message[0]);
+        return true;
+    };
+
+    SubscriptionSlots subscription_slots;
+    Event event(send, subscription_slots);
+
+    std::vector<Buffer> names;
+    std::vector<unsigned> num_calls(NUM_NAMES, 0);
+    for (std::size_t i = 0; i < NUM_NAMES; ++i) {
+        names.emplace_back("event/" + std::to_string(i));
+        event.subscribe(names[i], [&num_calls, i](const BufferView&) { ++num_calls[i]; });
+    }
+
+    BOOST_CHECK_EQUAL(event.subscription_names_.size(), NUM_NAMES);
+
+    event.unsubscribe(names[7]);
+    BOOST_REQUIRE_EQUAL(unsubscribed.size(), 1);
+    BOOST_CHECK(unsubscribed.front() == names[7]);
+    BOOST_CHECK(!event.subscribers(names[7]));
+    BOOST_CHECK_EQUAL(event.subscription_names_.size(), NUM_NAMES - 1);
+
+    for (std::size_t i = 0; i < NUM_NAMES; ++i) {
+        MessageBuilder message(Topic::EVENT, Action::EVENT);
+        message.add_argument(names[i]);
+        message.add_argument(Buffer("data"));
+        event.notify_(message);
+
+        BOOST_CHECK_EQUAL(num_calls[i], (i == 7) ? 0 : 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(resubscription_during_notification)
+{
+    const Event::Name name("name");
+    const Event::Name other("other");
+
+    std::vector<Action> actions;
+    auto send = [&actions](const Message& message) {
+        actions.push_back(message.action());
+        return true;
+    };
+
+    SubscriptionSlots subscription_slots;
+    Event event(send, subscription_slots);
+
+    unsigned num_calls = 0;
+    event.subscribe(name, [&](const BufferView&) {
+        ++num_calls;
+
+        // drop all subscriptions of this event, subscribe to another event
+        // (possibly moving the subscriber lists), and subscribe again
+        event.unsubscribe(name);
+        BOOST_CHECK(!event.subscribers(name));
+        event.subscribe(other, [](const BufferView&) {});
+        event.subscribe(name, [&num_calls](const BufferView&) { num_calls += 10; });
+    });
+    event.subscribe(name, [&num_calls](const BufferView&) { num_calls += 100; });
+
+    MessageBuilder message(Topic::EVENT, Action::EVENT);
+    message.add_argument(name);
+    message.add_argument(Buffer("data"));
+
+    event.notify_(message);
+    BOOST_CHECK_EQUAL(num_calls, 1);
+    BOOST_REQUIRE(event.subscribers(name));
+    BOOST_CHECK_EQUAL(event.subscribers(name)->size(), 1);
+
+    event.notify_(message);
+    BOOST_CHECK_EQUAL(num_calls, 11);
+
+    const std::vector<Action> expected{ Action::SUBSCRIBE, Action::UNSUBSCRIBE,
+        Action::SUBSCRIBE, Action::SUBSCRIBE };
+    BOOST_CHECK(actions == expected);
+}
+
+BOOST_AUTO_TEST_CASE(stale_subscription_ids)
+{
+    const Event::Name name("name");
+    const Event::Name other("other");
+
+    SubscriptionSlots subscription_slots;
+    Event event([](const Message&) { return true; }, subscription_slots);
+
+    const SubscriptionId s1 = event.subscribe(name, [](const BufferView&) {});
+    const SubscriptionId s2 = event.subscribe(other, [](const BufferView&) {});
+
+    // the id belongs to another event
+    event.unsubscribe(name, s2);
+    BOOST_CHECK_EQUAL(subscription_slots.size(), 2);
+
+    event.unsubscribe(name, s1);
+    BOOST_CHECK(!event.subscribers(name));
+
+    // the slot of s1 is reused
+    const SubscriptionId s3 = event.subscribe(other, [](const BufferView&) {});
+    BOOST_CHECK(s1 != s3);
+    event.unsubscribe(other, s1);
+    BOOST_REQUIRE(event.subscribers(other));
+    BOOST_CHECK_EQUAL(event.subscribers(other)->size(), 2);
+    BOOST_CHECK(event.subscribers(other)->contains(s3));
+}
+
+BOOST_AUTO_TEST_CASE(bulk_subscriptions)
+{
+    std::vector<Buffer> names{ Buffer("a"), Buffer("b"), Buffer("c") };
+
+    unsigned num_sent = 0;
+    std::vector<Buffer> collected;
+    unsigned num_flushes = 0;
+
+    auto send = [&num_sent](const Message&) { ++num_sent; return true; };
+    auto send_bulk = [&collected](const Message& message) {
+        BOOST_CHECK_EQUAL(message.topic(), Topic::EVENT);
+        collected.emplace_back(message.to_binary());
+        return true;
+    };
+    auto flush = [&num_flushes]() { ++num_flushes; return true; };
+
+    SubscriptionSlots subscription_slots;
+    Event event(send, send_bulk, flush, subscription_slots);
+
+    event.subscribe(names[1], [](const BufferView&) {});
+    BOOST_CHECK_EQUAL(num_sent, 1);
+
+    const std::vector<SubscriptionId> ids
+        = event.subscribe_many(names, [](const BufferView&) {});
+    BOOST_REQUIRE_EQUAL(ids.size(), 3);
+    BOOST_CHECK_EQUAL(subscription_slots.size(), 4);
+    BOOST_CHECK(event.subscribers(names[2])->contains(ids[2]));
+
+    // "b" was subscribed before
+    BOOST_REQUIRE_EQUAL(collected.size(), 2);
+    MessageBuilder expected(Topic::EVENT, Action::SUBSCRIBE);
+    expected.add_argument(names[0]);
+    BOOST_CHECK(collected[0] == expected.to_binary());
+    BOOST_CHECK_EQUAL(num_flushes, 1);
+    BOOST_CHECK_EQUAL(num_sent, 1);
+
+    collected.clear();
+    event.unsubscribe_many(names);
+    BOOST_CHECK_EQUAL(collected.size(), 3);
+    BOOST_CHECK_EQUAL(num_flushes, 2);
+    BOOST_CHECK(event.subscription_names_.empty());
+    BOOST_CHECK_EQUAL(subscription_slots.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(paced_resubscription)
+{
+    const std::size_t NUM_NAMES = 10;
+
+    bool is_open = false;
+    std::vector<Buffer> subscribed;
+    std::vector<Buffer> listened;
+    std::vector<Buffer> emitted;
+
+    auto send = [&](const Message& message) {
+        if (!is_open)
+            return false;
+
+        if (message.action() == Action::SUBSCRIBE)
+            subscribed.emplace_back(message[0]);
+        else if (message.action() == Action::EVENT)
+            emitted.emplace_back(message[0]);
+        return true;
+    };
+    auto send_bulk = [&](const Message& message) {
+        if (!is_open)
+            return false;
+
+        if (message.action() == Action::SUBSCRIBE)
+            subscribed.emplace_back(message[0]);
+        else if (message.action() == Action::LISTEN)
+            listened.emplace_back(message[0]);
+        else
+            BOOST_FAIL("unexpected bulk message");
+        return true;
+    };
+
+    SubscriptionSlots subscription_slots;
+    Event event(send, send_bulk, []() { return true; }, subscription_slots);
+    event.pace_resubscription(4);
+
+    std::vector<Buffer> names;
+    for (std::size_t i = 0; i < NUM_NAMES; ++i) {
+        names.emplace_back("event/" + std::to_string(i));
+        event.subscribe(names.back(), [](const BufferView&) {});
+    }
+    event.listen(Buffer("pattern"), [](const Event::Name&, bool) { return true; });
+    event.emit(Buffer("offline"), Buffer("data"));
+
+    BOOST_CHECK(subscribed.empty());
+    BOOST_CHECK(emitted.empty());
+
+    is_open = true;
+    event.on_connection_state_change_(ConnectionState::OPEN);
+    BOOST_CHECK_EQUAL(subscribed.size(), 4);
+
+    // a subscription made by the user in between is not repeated
+    event.unsubscribe(names[5]);
+    event.subscribe(names[5], [](const BufferView&) {});
+    BOOST_CHECK_EQUAL(subscribed.size(), 5);
+
+    // the name was renewed by the user
+    BOOST_CHECK(!event.resubscribe_());
+    BOOST_CHECK_EQUAL(subscribed.size(), 9);
+    BOOST_CHECK(emitted.empty());
+
+    BOOST_CHECK(event.resubscribe_());
+    BOOST_CHECK_EQUAL(subscribed.size(), NUM_NAMES);
+    BOOST_REQUIRE_EQUAL(listened.size(), 1);
+    BOOST_CHECK(listened.front() == Buffer("pattern"));
+
+    // the queued events are sent after the resubscription
+    BOOST_REQUIRE_EQUAL(emitted.size(), 1);
+    BOOST_CHECK(emitted.front() == Buffer("offline"));
+
+    for (const Buffer& name : names)
+        BOOST_CHECK_EQUAL(std::count(subscribed.cbegin(), subscribed.cend(), name), 1);
+
+    BOOST_CHECK(event.resubscribe_());
+}
+
+BOOST_AUTO_TEST_CASE(emit_during_resubscription)
+{
+    bool is_open = false;
+    Buffer wire;
+
+    auto send = [&](const Message& message) {
+        if (!is_open)
+            return false;
+
+        if (message.action() == Action::EVENT) {
+            const Buffer binary = message.to_binary();
+            wire.insert(wire.end(), binary.cbegin(), binary.cend());
+        }
+        return true;
+    };
+    auto send_serialized = [&](const BufferView& messages) {
+        if (!is_open)
+            return false;
+
+        wire.insert(wire.end(), messages.cbegin(), messages.cend());
+        return true;
+    };
+
+    SubscriptionSlots subscription_slots;
+    Event event(send, send, []() { return true; }, send_serialized, subscription_slots);
+    event.pace_resubscription(2);
+
+    for (int i = 0; i < 5; ++i)
+        event.subscribe(Buffer("event/" + std::to_string(i)), [](const BufferView&) {});
+
+    event.emit(Buffer("a"), Buffer("offline"));
+
+    is_open = true;
+    event.on_connection_state_change_(ConnectionState::OPEN);
+
+    // the live events queue up behind the offline event
+    event.emit(Buffer("a"), Buffer("live-1"));
+    BOOST_CHECK(event.emit_async(Buffer("a"), Buffer("live-2")));
+    BOOST_CHECK(event.drain_emits_());
+    BOOST_CHECK(wire.empty());
+
+    while (!event.resubscribe_())
+        BOOST_CHECK(wire.empty());
+
+    event.emit(Buffer("a"), Buffer("live-3"));
+
+    BOOST_CHECK(event.outbox().empty());
+    BOOST_CHECK(wire == Message::from_human_readable(
+        "E|EVT|a|offline+E|EVT|a|live-1+E|EVT|a|live-2+E|EVT|a|live-3+"));
+}
+
+BOOST_AUTO_TEST_CASE(outbox)
+{
+    bool is_open = false;
+    std::vector<std::size_t> frames;
+    Buffer replayed;
+
+    auto send = [&is_open](const Message&) { return is_open; };
+    auto send_serialized = [&](const BufferView& messages) {
+        frames.push_back(messages.size());
+        replayed.insert(replayed.end(), messages.cbegin(), messages.cend());
+        return true;
+    };
+
+    SubscriptionSlots subscription_slots;
+    Event event(send, send, []() { return true; }, send_serialized, subscription_slots);
+    event.outbox_policy(Outbox::Policy(Outbox::DEFAULT_MAX_BYTES, Outbox::Overflow::DROP_OLDEST, true));
+
+    const std::size_t NUM_VALUES = 1000;
+    for (std::size_t i = 0; i < NUM_VALUES; ++i) {
+        event.emit(Buffer("a"), Buffer(std::to_string(i)));
+        event.emit(Buffer("b"), Buffer(std::to_string(i)));
+    }
+
+    BOOST_CHECK_EQUAL(event.outbox().size(), 2);
+
+    is_open = true;
+    event.on_connection_state_change_(ConnectionState::OPEN);
+
+    BOOST_CHECK(event.outbox().empty());
+    BOOST_REQUIRE_EQUAL(frames.size(), 1);
+    BOOST_CHECK(replayed == Message::from_human_readable("E|EVT|a|999+E|EVT|b|999+"));
+}
+
+BOOST_AUTO_TEST_CASE(persistent_outbox)
+{
+    char directory[] = "/tmp/deepstream-event-XXXXXX";
+    BOOST_REQUIRE(mkdtemp(directory));
+
+    bool is_open = false;
+    Buffer replayed;
+
+    auto send = [&is_open](const Message&) { return is_open; };
+    auto send_serialized = [&](const BufferView& messages) {
+        replayed.insert(replayed.end(), messages.cbegin(), messages.cend());
+        return true;
+    };
+
+    {
+        PersistentOutbox outbox(directory);
+
+        SubscriptionSlots subscription_slots;
+        Event event(send, send, []() { return true; }, send_serialized, subscription_slots);
+        event.persistent_outbox(&outbox);
+        event.emit(Buffer("a"), Buffer("1"));
+
+        BOOST_CHECK(event.outbox().empty());
+        BOOST_CHECK(!outbox.empty());
+    }
+
+    // the event is sent by the next process
+    PersistentOutbox outbox(directory);
+
+    SubscriptionSlots subscription_slots;
+    Event event(send, send, []() { return true; }, send_serialized, subscription_slots);
+    event.persistent_outbox(&outbox);
+
+    is_open = true;
+    event.on_connection_state_change_(ConnectionState::OPEN);
+
+    BOOST_CHECK(outbox.empty());
+    BOOST_CHECK(replayed == Message::from_human_readable("E|EVT|a|1+"));
+
+    BOOST_CHECK_EQUAL(outbox.num_segments(), 1);
+    unlink((std::string(directory) + "/checkpoint").c_str());
+    unlink((std::string(directory) + "/0000000000000000.seg").c_str());
+    rmdir(directory);
+}
+
+BOOST_AUTO_TEST_CASE(emit_async)
+{
+    bool is_open = true;
+    std::vector<std::size_t> frames;
+    Buffer sent;
+
+    auto send = [](const Message&) { return false; };
+    auto send_serialized = [&](const BufferView& messages) {
+        if (!is_open)
+            return false;
+
+        frames.push_back(messages.size());
+        sent.insert(sent.end(), messages.cbegin(), messages.cend());
+        return true;
+    };
+
+    SubscriptionSlots subscription_slots;
+    Event event(send, send, []() { return true; }, send_serialized, subscription_slots);
+
+    std::size_t num_wakeups = 0;
+    event.on_emit_async([&num_wakeups]() { ++num_wakeups; });
+
+    std::vector<Buffer> received;
+    event.subscribe(Buffer("a"), [&received](const BufferView& data) {
+        received.emplace_back(data);
+    });
+
+    std::thread producer([&event]() {
+        BOOST_CHECK(event.emit_async(Buffer("a"), Buffer("1")));
+        BOOST_CHECK(event.emit_async(Buffer("b"), Buffer("2")));
+    });
+    producer.join();
+
+    BOOST_CHECK_EQUAL(num_wakeups, 2);
+    BOOST_CHECK(received.empty());
+
+    // both events are sent in one frame on the connection thread
+    BOOST_CHECK(event.drain_emits_());
+    BOOST_REQUIRE_EQUAL(frames.size(), 1);
+    BOOST_CHECK(sent == Message::from_human_readable("E|EVT|a|1+E|EVT|b|2+"));
+    BOOST_REQUIRE_EQUAL(received.size(), 1);
+    BOOST_CHECK(received.front() == Buffer("1"));
+
+    // events that cannot be sent go to the outbox
+    is_open = false;
+    BOOST_CHECK(event.emit_async(Buffer("a"), Buffer("3")));
+    BOOST_CHECK(event.drain_emits_());
+    BOOST_CHECK_EQUAL(event.outbox().size(), 1);
+    BOOST_CHECK_EQUAL(received.size(), 2);
+
+    BOOST_CHECK_THROW(event.emit_async(Buffer(""), Buffer("4")), std::invalid_argument);
+}
+
+/**
+ * This executor keeps the tasks until they are run by the test.
+ */
+struct DeferredExecutor : public Executor {
+    void execute(std::size_t key, Task task) override
+    {
+        keys.push_back(key);
+        tasks.push_back(std::move(task));
+    }
+
+    std::vector<std::size_t> keys;
+    std::vector<Task> tasks;
+};
+
+BOOST_AUTO_TEST_CASE(executor)
+{
+    auto send = [](const Message&) { return true; };
+
+    SubscriptionSlots subscription_slots;
+    Event event(send, subscription_slots);
+
+    DeferredExecutor executor;
+    event.executor(&executor);
+
+    const Buffer name("a");
+    std::vector<Buffer> received;
+    const SubscriptionId id = event.subscribe(name, [&received](const BufferView& data) {
+        received.emplace_back(data);
+    });
+
+    {
+        const Buffer data("1");
+        MessageBuilder message(Topic::EVENT, Action::EVENT);
+        message.add_argument_reference(name);
+        message.add_argument_reference(data);
+        event.notify_(message);
+    }
+    event.emit(name, Buffer("2"));
+
+    // the subscriber is removed before the tasks run
+    event.unsubscribe(name, id);
+    BOOST_CHECK(received.empty());
+
+    BOOST_REQUIRE_EQUAL(executor.tasks.size(), 2);
+    BOOST_CHECK_EQUAL(executor.keys[0], NameTable::hash_of(name));
+    BOOST_CHECK_EQUAL(executor.keys[1], NameTable::hash_of(name));
+
+    // the tasks own copies of the data and the callbacks
+    for (const Executor::Task& task : executor.tasks)
+        task();
+
+    BOOST_REQUIRE_EQUAL(received.size(), 2);
+    BOOST_CHECK(received[0] == Buffer("1"));
+    BOOST_CHECK(received[1] == Buffer("2"));
+
+    event.executor(nullptr);
+    event.subscribe(name, [&received](const BufferView& data) {
+        received.emplace_back(data);
+    });
+    event.emit(name, Buffer("3"));
+    BOOST_CHECK_EQUAL(executor.tasks.size(), 2);
+    BOOST_CHECK_EQUAL(received.size(), 3);
 }
 }
@@ -19,13 +19,11 @@
 
 #include <cstring>
 
+#include <string>
 #include <vector>
 
 #include "src/core/parser.h"
-
-extern "C" {
-#include <lexer.h>
-}
+#include "src/core/scanner.h"
 
 struct State {
     /**
@@ -94,6 +92,30 @@ BOOST_AUTO_TEST_CASE(auth_ack)
     BOOST_CHECK_EQUAL(ret, 0);
 }
 
+BOOST_AUTO_TEST_CASE(all_headers)
+{
+#define DS_HEADER(TOKEN, TOPIC, ACTION, IS_ACK, TEXT, MIN_ARGS, MAX_ARGS) \
+    { TOKEN, TEXT "+" },
+
+    const struct {
+        int token;
+        const char* text;
+    } headers[] = { DEEPSTREAM_PROTOCOL(DS_HEADER, "|") };
+
+#undef DS_HEADER
+
+    for (const auto& header : headers) {
+        State state(header.text);
+
+        int ret = yylex(state.scanner);
+        BOOST_CHECK_EQUAL(ret, header.token);
+        BOOST_CHECK_EQUAL(yyget_leng(state.scanner), std::strlen(header.text) - 1);
+
+        ret = yylex(state.scanner);
+        BOOST_CHECK_EQUAL(ret, TOKEN_MESSAGE_SEPARATOR);
+    }
+}
+
 // newline tests
 // Flex treats newline special, i.e., newlines are not matched by '.'
 
@@ -380,3 +402,33 @@ BOOST_AUTO_TEST_CASE(caret_in_payload)
         BOOST_CHECK(!strncmp(yyget_text(state.scanner), TEXTS[i], len));
     }
 }
+
+// payloads and invalid messages that are longer than the vector registers used
+// by the hand-written scanner
+BOOST_AUTO_TEST_CASE(long_payload)
+{
+    const std::string payload_1(33, 'x');
+    const std::string payload_2(70, 'y');
+    const std::string garbage(40, 'z');
+    const std::string input = "E|EVT|" + payload_1 + "|" + payload_2 + "+" + garbage + "++A|A+";
+
+    const int TOKENS[] = {
+        TOKEN_E_EVT, TOKEN_PAYLOAD, TOKEN_PAYLOAD, TOKEN_MESSAGE_SEPARATOR,
+        TOKEN_UNKNOWN, TOKEN_A_A, TOKEN_MESSAGE_SEPARATOR, 0
+    };
+    const std::size_t NUM_TOKENS = sizeof(TOKENS) / sizeof(TOKENS[0]);
+
+    State state(input.c_str(), input.size());
+
+    const std::size_t TEXTLENS[NUM_TOKENS] = { 5, 34, 71, 1, 42, 3, 1, 1 };
+    const std::size_t OFFSETS[NUM_TOKENS] = { 0, 5, 39, 110, 111, 153, 156, 157 };
+
+    for (std::size_t i = 0; i < NUM_TOKENS; ++i) {
+        int ret = yylex(state.scanner);
+        BOOST_CHECK_EQUAL(ret, TOKENS[i]);
+
+        BOOST_REQUIRE_EQUAL(yyget_leng(state.scanner), TEXTLENS[i]);
+        const char* text = yyget_text(state.scanner);
+        BOOST_CHECK_EQUAL(static_cast<std::size_t>(text - &state.input[0]), OFFSETS[i]);
+    }
+}
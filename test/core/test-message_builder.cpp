@@ -113,4 +113,44 @@ BOOST_AUTO_TEST_CASE(check_args)
 
     BOOST_CHECK_THROW(builder.add_argument(arg), std::invalid_argument);
 }
+BOOST_AUTO_TEST_CASE(argument_references)
+{
+    const Buffer name("name");
+    Buffer data("data");
+
+    MessageBuilder builder(Topic::EVENT, Action::EVENT);
+    builder.add_argument_reference(name);
+    builder.add_argument_reference(data);
+
+    BOOST_REQUIRE_EQUAL(builder.num_arguments(), 2);
+    BOOST_CHECK(builder[0].data() == name.data());
+    BOOST_CHECK(builder[1].data() == data.data());
+
+    Buffer expected = Message::from_human_readable("E|EVT|name|data+");
+    BOOST_CHECK(builder.to_binary() == expected);
+
+    Message::SegmentList segments;
+    builder.to_segments(segments);
+    BOOST_REQUIRE_EQUAL(segments.size(), 6);
+    BOOST_CHECK(segments[0] == Message::from_human_readable("E|EVT"));
+    BOOST_CHECK(segments[2].data() == name.data());
+    BOOST_CHECK(segments[4].data() == data.data());
+
+    Buffer gathered;
+    for (const BufferView& segment : segments)
+        gathered.insert(gathered.end(), segment.cbegin(), segment.cend());
+    BOOST_CHECK(gathered == expected);
+
+    // copies own their arguments
+    MessageBuilder copy(builder);
+    data[0] = 'D';
+
+    BOOST_CHECK(builder[1] == Buffer("Data"));
+    BOOST_CHECK(copy[1] == Buffer("data"));
+    BOOST_CHECK(copy.to_binary() == expected);
+
+    MessageBuilder::Argument separator{ ASCII_UNIT_SEPARATOR };
+    BOOST_CHECK_THROW(
+        builder.add_argument_reference(separator), std::invalid_argument);
+}
 }
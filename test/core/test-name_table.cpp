@@ -0,0 +1,105 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/name_table.hpp>
+
+namespace deepstream {
+
+BOOST_AUTO_TEST_CASE(simple)
+{
+    NameTable table;
+    const Buffer a("a");
+    const Buffer b("b");
+
+    BOOST_CHECK(table.empty());
+    BOOST_CHECK(table.find(a) == NameTable::NONE);
+
+    const NameTable::Id id_a = table.intern(a);
+    BOOST_CHECK_EQUAL(id_a, 0);
+    BOOST_CHECK_EQUAL(table.size(), 1);
+    BOOST_CHECK_EQUAL(table.find(a), id_a);
+    BOOST_CHECK_EQUAL(table.intern(a), id_a);
+    BOOST_CHECK_EQUAL(table.size(), 1);
+    BOOST_CHECK(table.name(id_a) == a);
+    BOOST_CHECK_EQUAL(table.hash(id_a), NameTable::hash_of(a));
+
+    const NameTable::Id id_b = table.intern(b);
+    BOOST_CHECK_EQUAL(id_b, 1);
+    BOOST_CHECK_EQUAL(table.size(), 2);
+    BOOST_CHECK_EQUAL(table.id_limit(), 2);
+
+    table.erase(id_a);
+    BOOST_CHECK_EQUAL(table.size(), 1);
+    BOOST_CHECK(!table.contains(id_a));
+    BOOST_CHECK(table.find(a) == NameTable::NONE);
+    BOOST_CHECK_EQUAL(table.find(b), id_b);
+
+    // ids are reused
+    const Buffer c("c");
+    BOOST_CHECK_EQUAL(table.intern(c), id_a);
+    BOOST_CHECK_EQUAL(table.id_limit(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(many_names)
+{
+    const std::size_t NUM_NAMES = 10000;
+
+    std::vector<Buffer> names;
+    for (std::size_t i = 0; i < NUM_NAMES; ++i)
+        names.emplace_back("event/" + std::to_string(i));
+
+    NameTable table;
+    for (std::size_t i = 0; i < NUM_NAMES; ++i)
+        BOOST_REQUIRE_EQUAL(table.intern(names[i]), i);
+
+    BOOST_CHECK_EQUAL(table.size(), NUM_NAMES);
+
+    // erase every other name; the remaining names must still be found
+    // after the probe sequences were shortened
+    for (std::size_t i = 0; i < NUM_NAMES; i += 2)
+        table.erase(static_cast<NameTable::Id>(i));
+
+    BOOST_CHECK_EQUAL(table.size(), NUM_NAMES / 2);
+
+    for (std::size_t i = 0; i < NUM_NAMES; ++i) {
+        const NameTable::Id id = table.find(names[i]);
+
+        if (i % 2 == 0)
+            BOOST_CHECK(id == NameTable::NONE);
+        else
+            BOOST_CHECK_EQUAL(id, i);
+    }
+
+    for (std::size_t i = 0; i < NUM_NAMES; i += 2)
+        table.intern(names[i]);
+
+    BOOST_CHECK_EQUAL(table.size(), NUM_NAMES);
+    BOOST_CHECK_EQUAL(table.id_limit(), NUM_NAMES);
+
+    for (std::size_t i = 0; i < NUM_NAMES; ++i) {
+        const NameTable::Id id = table.find(names[i]);
+        BOOST_REQUIRE(id != NameTable::NONE);
+        BOOST_CHECK(table.name(id) == names[i]);
+    }
+}
+}
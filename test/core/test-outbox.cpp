@@ -0,0 +1,211 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+
+#include <string>
+#include <vector>
+
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/outbox.hpp>
+#include "src/core/message_builder.hpp"
+
+namespace deepstream {
+
+namespace {
+    Buffer serialize(const char* name, const char* data)
+    {
+        MessageBuilder message(Topic::EVENT, Action::EVENT);
+        message.add_argument(Buffer(name));
+        message.add_argument(Buffer(data));
+
+        return message.to_binary();
+    }
+
+    bool push(Outbox& outbox, const char* name, const char* data)
+    {
+        MessageBuilder message(Topic::EVENT, Action::EVENT);
+        message.add_argument_reference(BufferView(name, std::strlen(name)));
+        message.add_argument_reference(BufferView(data, std::strlen(data)));
+
+        return outbox.push(message);
+    }
+
+    Buffer replay_all(Outbox& outbox)
+    {
+        Buffer output;
+        auto write = [&output](const BufferView& messages) {
+            output.insert(output.end(), messages.cbegin(), messages.cend());
+            return true;
+        };
+
+        BOOST_CHECK(outbox.replay(write, static_cast<std::size_t>(-1)));
+        BOOST_CHECK(outbox.empty());
+        BOOST_CHECK_EQUAL(outbox.num_bytes(), 0);
+
+        return output;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(simple)
+{
+    Outbox outbox;
+
+    BOOST_CHECK(outbox.empty());
+    BOOST_CHECK(push(outbox, "a", "1"));
+    BOOST_CHECK(push(outbox, "b", "2"));
+    BOOST_CHECK(push(outbox, "a", "3"));
+    BOOST_CHECK_EQUAL(outbox.size(), 3);
+
+    Buffer expected = serialize("a", "1");
+    const Buffer b2 = serialize("b", "2");
+    const Buffer a3 = serialize("a", "3");
+    expected.insert(expected.end(), b2.cbegin(), b2.cend());
+    expected.insert(expected.end(), a3.cbegin(), a3.cend());
+
+    BOOST_CHECK_EQUAL(outbox.num_bytes(), expected.size());
+    BOOST_CHECK(replay_all(outbox) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(drop_oldest)
+{
+    const std::size_t message_size = serialize("a", "0").size();
+
+    Outbox outbox(Outbox::Policy(2 * message_size, Outbox::Overflow::DROP_OLDEST));
+    BOOST_CHECK(push(outbox, "a", "0"));
+    BOOST_CHECK(push(outbox, "a", "1"));
+    BOOST_CHECK(push(outbox, "a", "2"));
+    BOOST_CHECK_EQUAL(outbox.size(), 2);
+    BOOST_CHECK_EQUAL(outbox.num_dropped(), 1);
+
+    // the message can never fit
+    BOOST_CHECK(!push(outbox, "a", std::string(2 * message_size, 'x').c_str()));
+    BOOST_CHECK_EQUAL(outbox.size(), 2);
+    BOOST_CHECK_EQUAL(outbox.num_dropped(), 2);
+
+    Buffer expected = serialize("a", "1");
+    const Buffer a2 = serialize("a", "2");
+    expected.insert(expected.end(), a2.cbegin(), a2.cend());
+    BOOST_CHECK(replay_all(outbox) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(drop_newest)
+{
+    const std::size_t message_size = serialize("a", "0").size();
+
+    Outbox outbox(Outbox::Policy(2 * message_size, Outbox::Overflow::DROP_NEWEST));
+    BOOST_CHECK(push(outbox, "a", "0"));
+    BOOST_CHECK(push(outbox, "a", "1"));
+    BOOST_CHECK(!push(outbox, "a", "2"));
+    BOOST_CHECK_EQUAL(outbox.size(), 2);
+    BOOST_CHECK_EQUAL(outbox.num_dropped(), 1);
+
+    Buffer expected = serialize("a", "0");
+    const Buffer a1 = serialize("a", "1");
+    expected.insert(expected.end(), a1.cbegin(), a1.cend());
+    BOOST_CHECK(replay_all(outbox) == expected);
+
+    // a smaller budget discards the oldest messages
+    BOOST_CHECK(push(outbox, "a", "3"));
+    BOOST_CHECK(push(outbox, "a", "4"));
+    outbox.policy(Outbox::Policy(message_size, Outbox::Overflow::DROP_NEWEST));
+    BOOST_CHECK_EQUAL(outbox.size(), 1);
+    BOOST_CHECK(replay_all(outbox) == serialize("a", "4"));
+}
+
+BOOST_AUTO_TEST_CASE(conflation)
+{
+    const std::size_t message_size = serialize("a", "0").size();
+
+    Outbox outbox(Outbox::Policy(3 * message_size, Outbox::Overflow::DROP_NEWEST, true));
+    BOOST_CHECK(push(outbox, "a", "0"));
+    BOOST_CHECK(push(outbox, "b", "1"));
+    BOOST_CHECK(push(outbox, "a", "2"));
+    BOOST_CHECK(push(outbox, "c", "3"));
+    BOOST_CHECK_EQUAL(outbox.size(), 3);
+    BOOST_CHECK_EQUAL(outbox.num_bytes(), 3 * message_size);
+    BOOST_CHECK_EQUAL(outbox.num_dropped(), 0);
+
+    // the budget is exhausted but the message replaces an older one
+    BOOST_CHECK(push(outbox, "b", "4"));
+    BOOST_CHECK(!push(outbox, "d", "5"));
+
+    Buffer expected;
+    for (const Buffer& m : { serialize("a", "2"), serialize("c", "3"), serialize("b", "4") })
+        expected.insert(expected.end(), m.cbegin(), m.cend());
+
+    BOOST_CHECK(replay_all(outbox) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(many_values)
+{
+    const std::size_t NUM_NAMES = 100;
+    const std::size_t NUM_VALUES = 100;
+
+    Outbox outbox(Outbox::Policy(Outbox::DEFAULT_MAX_BYTES, Outbox::Overflow::DROP_OLDEST, true));
+
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < NUM_NAMES; ++i)
+        names.push_back("event/" + std::to_string(i));
+
+    // the log is compacted in between
+    for (std::size_t j = 0; j < NUM_VALUES; ++j)
+        for (const std::string& name : names)
+            push(outbox, name.c_str(), std::to_string(j).c_str());
+
+    BOOST_CHECK_EQUAL(outbox.size(), NUM_NAMES);
+
+    Buffer expected;
+    for (const std::string& name : names) {
+        const Buffer m = serialize(name.c_str(), std::to_string(NUM_VALUES - 1).c_str());
+        expected.insert(expected.end(), m.cbegin(), m.cend());
+    }
+
+    BOOST_CHECK(replay_all(outbox) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(replay)
+{
+    const std::size_t message_size = serialize("a", "0").size();
+
+    Outbox outbox;
+    for (int i = 0; i < 5; ++i)
+        push(outbox, "a", std::to_string(i).c_str());
+
+    std::vector<std::size_t> writes;
+    bool ok = true;
+    auto write = [&](const BufferView& messages) {
+        if (ok)
+            writes.push_back(messages.size());
+        return ok;
+    };
+
+    // whole messages are written
+    ok = false;
+    BOOST_CHECK(!outbox.replay(write, 2 * message_size + 1));
+    BOOST_CHECK_EQUAL(outbox.size(), 5);
+
+    ok = true;
+    BOOST_CHECK(outbox.replay(write, 2 * message_size + 1));
+    BOOST_REQUIRE_EQUAL(writes.size(), 3);
+    BOOST_CHECK_EQUAL(writes[0], 2 * message_size);
+    BOOST_CHECK_EQUAL(writes[1], 2 * message_size);
+    BOOST_CHECK_EQUAL(writes[2], message_size);
+}
+}
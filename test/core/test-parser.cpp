@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <numeric>
 #include <random>
+#include <stdexcept>
 #include <vector>
 
 #include <deepstream/core/buffer.hpp>
@@ -29,12 +30,9 @@
 #include "src/core/message_builder.hpp"
 #include "src/core/parser.hpp"
 #include "src/core/random.hpp"
+#include "src/core/scanner.h"
 #include "src/core/scope_guard.hpp"
 
-extern "C" {
-#include "lexer.h"
-}
-
 // Remarks:
 // - Do not use BOOST_CHECK_EQUAL() to compare const char* variables as
 //   Boost.Test attempts to be smart by calling std::strcmp()
@@ -349,5 +347,220 @@ namespace parser {
                 BOOST_CHECK_EQUAL(*i, j->header());
         }
     }
+
+    BOOST_AUTO_TEST_CASE(context_reuse)
+    {
+        Buffer first = Message::from_human_readable("E|EVT|a|Sb+E|S|c");
+        Buffer second = Message::from_human_readable("A|A+E|S|d+");
+
+        first.resize(first.size() + 2);
+        second.resize(second.size() + 2);
+
+        Context context;
+
+        context.execute(first.data(), first.size());
+        BOOST_CHECK_EQUAL(context.messages().size(), 1);
+        BOOST_REQUIRE_EQUAL(context.errors().size(), 1);
+        BOOST_CHECK_EQUAL(context.errors().front().tag(), Error::UNEXPECTED_EOF);
+
+        const MessageProxy* p_messages = context.messages().data();
+
+        // the scanner must not remember that the last input ended inside a
+        // message
+        context.execute(second.data(), second.size());
+        BOOST_CHECK(context.errors().empty());
+        BOOST_REQUIRE_EQUAL(context.messages().size(), 2);
+
+        BOOST_CHECK(context.messages().data() == p_messages);
+
+        const MessageProxy& auth = context.messages().front();
+        BOOST_CHECK_EQUAL(auth.topic(), Topic::AUTH);
+        BOOST_CHECK_EQUAL(auth.num_arguments(), 0);
+        BOOST_CHECK(auth.base() == second.data());
+
+        // the argument lists of the last input are recycled
+        BOOST_CHECK_GE(auth.arguments_.capacity(), 1);
+        BOOST_CHECK_GE(context.messages().back().arguments_.capacity(), 1);
+    }
+
+    // streaming tests
+
+    BOOST_AUTO_TEST_CASE(stream_split_messages)
+    {
+        random::Engine engine(0);
+
+        std::vector<Message::Header> headers;
+        std::vector<Buffer> arguments;
+        Buffer input;
+
+        for (std::size_t i = 0; i < 10; ++i) {
+            MessageBuilder message = random::make_message(&engine);
+
+            Buffer bin = message.to_binary();
+            input.insert(input.end(), bin.cbegin(), bin.cend());
+
+            headers.push_back(message.header());
+            for (std::size_t k = 0; k < message.num_arguments(); ++k)
+                arguments.emplace_back(message[k]);
+        }
+
+        for (std::size_t chunk_size = 1; chunk_size <= input.size(); ++chunk_size) {
+            Stream stream;
+
+            std::vector<Message::Header> stream_headers;
+            std::vector<Buffer> stream_arguments;
+
+            for (std::size_t first = 0; first < input.size(); first += chunk_size) {
+                const std::size_t last = std::min(first + chunk_size, input.size());
+
+                Buffer chunk(input.cbegin() + first, input.cbegin() + last);
+                chunk.resize(chunk.size() + 2);
+
+                const Context& context = stream.feed(chunk.data(), last - first);
+                BOOST_CHECK(context.errors().empty());
+
+                for (const MessageProxy& msg : context.messages()) {
+                    stream_headers.push_back(msg.header());
+                    for (std::size_t k = 0; k < msg.num_arguments(); ++k)
+                        stream_arguments.emplace_back(msg[k]);
+                }
+            }
+
+            BOOST_CHECK_EQUAL(stream.pending(), 0);
+
+            BOOST_REQUIRE_EQUAL(stream_headers.size(), headers.size());
+            BOOST_CHECK(stream_headers == headers);
+            BOOST_CHECK(stream_arguments == arguments);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(stream_pending_tail)
+    {
+        Buffer first = Message::from_human_readable("E|EVT|name|Spay");
+        Buffer second = Message::from_human_readable("load+E|S|");
+        Buffer third = Message::from_human_readable("name+");
+
+        first.resize(first.size() + 2);
+        second.resize(second.size() + 2);
+        third.resize(third.size() + 2);
+
+        Stream stream;
+
+        const Context& context = stream.feed(first.data(), first.size() - 2);
+        BOOST_CHECK(context.messages().empty());
+        BOOST_CHECK(context.errors().empty());
+        BOOST_CHECK_EQUAL(stream.pending(), first.size() - 2);
+
+        stream.feed(second.data(), second.size() - 2);
+        BOOST_REQUIRE_EQUAL(context.messages().size(), 1);
+        BOOST_CHECK(context.errors().empty());
+        BOOST_CHECK_EQUAL(stream.pending(), 4);
+
+        const MessageProxy& event = context.messages().front();
+        BOOST_CHECK_EQUAL(event.topic(), Topic::EVENT);
+        BOOST_CHECK_EQUAL(event.action(), Action::EVENT);
+        BOOST_REQUIRE_EQUAL(event.num_arguments(), 2);
+        BOOST_CHECK(event[1] == Buffer("Spayload"));
+
+        stream.reset();
+        BOOST_CHECK_EQUAL(stream.pending(), 0);
+
+        // after a reset, the tail "E|S|" is gone
+        stream.feed(third.data(), third.size() - 2);
+        BOOST_CHECK(context.messages().empty());
+        BOOST_CHECK_EQUAL(context.errors().size(), 1);
+    }
+
+    struct RecordingHandler : public Handler {
+        RecordingHandler() : throw_on_message(false) {}
+
+        virtual void handle_message(const MessageProxy& message) override
+        {
+            if (throw_on_message)
+                throw std::runtime_error("handler failure");
+
+            headers.push_back(message.header());
+            for (std::size_t i = 0; i < message.num_arguments(); ++i)
+                arguments.emplace_back(message[i]);
+        }
+
+        virtual void handle_error(const Error& error) override
+        {
+            errors.push_back(error);
+        }
+
+        bool throw_on_message;
+        std::vector<Message::Header> headers;
+        std::vector<Buffer> arguments;
+        ErrorList errors;
+    };
+
+    BOOST_AUTO_TEST_CASE(handler)
+    {
+        Buffer input = Message::from_human_readable(
+            "E|S|first+X|Y+E|EVT|second|Spayload+");
+        input.resize(input.size() + 2);
+
+        Context context;
+        RecordingHandler handler;
+
+        context.execute(input.data(), input.size(), handler);
+
+        BOOST_CHECK(context.messages().empty());
+        BOOST_CHECK(context.errors().empty());
+
+        BOOST_REQUIRE_EQUAL(handler.headers.size(), 2);
+        BOOST_CHECK_EQUAL(handler.headers[0].topic(), Topic::EVENT);
+        BOOST_CHECK_EQUAL(handler.headers[0].action(), Action::SUBSCRIBE);
+        BOOST_CHECK_EQUAL(handler.headers[1].action(), Action::EVENT);
+
+        BOOST_REQUIRE_EQUAL(handler.arguments.size(), 3);
+        BOOST_CHECK(handler.arguments[0] == Buffer("first"));
+        BOOST_CHECK(handler.arguments[1] == Buffer("second"));
+        BOOST_CHECK(handler.arguments[2] == Buffer("Spayload"));
+
+        BOOST_REQUIRE_EQUAL(handler.errors.size(), 1);
+        BOOST_CHECK_EQUAL(handler.errors[0].tag(), Error::UNEXPECTED_TOKEN);
+
+        // exceptions thrown by the handler are rethrown
+        handler.throw_on_message = true;
+        BOOST_CHECK_THROW(
+            context.execute(input.data(), input.size(), handler),
+            std::runtime_error);
+
+        // the context remains usable
+        handler.throw_on_message = false;
+        handler.headers.clear();
+        context.execute(input.data(), input.size(), handler);
+        BOOST_CHECK_EQUAL(handler.headers.size(), 2);
+
+        context.execute(input.data(), input.size());
+        BOOST_CHECK_EQUAL(context.messages().size(), 2);
+        BOOST_CHECK_EQUAL(context.errors().size(), 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(arguments_reference_input)
+    {
+        Buffer input = Message::from_human_readable("E|EVT|name|Sdata+");
+        input.resize(input.size() + 2);
+
+        Context context;
+        context.execute(input.data(), input.size());
+
+        BOOST_REQUIRE_EQUAL(context.messages().size(), 1);
+
+        const MessageProxy& message = context.messages().front();
+        const BufferView name = message[0];
+        const BufferView data = message[1];
+
+        BOOST_CHECK(name.data() == input.data() + 6);
+        BOOST_CHECK_EQUAL(name.size(), 4);
+        BOOST_CHECK(name == Buffer("name"));
+        BOOST_CHECK(name != Buffer("nam"));
+
+        BOOST_CHECK(data.data() == input.data() + 11);
+        BOOST_CHECK(data == Buffer("Sdata"));
+        BOOST_CHECK(Buffer(data) == Buffer("Sdata"));
+    }
 }
 }
@@ -0,0 +1,294 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/persistent_outbox.hpp>
+#include "src/core/message_builder.hpp"
+
+namespace deepstream {
+
+namespace {
+    struct TemporaryDirectory {
+        TemporaryDirectory()
+        {
+            char name[] = "/tmp/deepstream-outbox-XXXXXX";
+            BOOST_REQUIRE(mkdtemp(name));
+            path = name;
+        }
+
+        ~TemporaryDirectory()
+        {
+            DIR* dir = opendir(path.c_str());
+            if (!dir)
+                return;
+
+            while (const dirent* entry = readdir(dir))
+                if (std::strcmp(entry->d_name, ".") != 0 && std::strcmp(entry->d_name, "..") != 0)
+                    unlink((path + "/" + entry->d_name).c_str());
+            closedir(dir);
+            rmdir(path.c_str());
+        }
+
+        std::string path;
+    };
+
+    MessageBuilder make_event(const std::string& name, const std::string& data)
+    {
+        MessageBuilder message(Topic::EVENT, Action::EVENT);
+        message.add_argument(name);
+        message.add_argument(data);
+
+        return message;
+    }
+
+    Buffer replay_all(PersistentOutbox& outbox, std::size_t max_write_size = 1024)
+    {
+        Buffer output;
+        auto write = [&output](const BufferView& messages) {
+            output.insert(output.end(), messages.cbegin(), messages.cend());
+            return true;
+        };
+
+        BOOST_CHECK(outbox.replay(write, max_write_size));
+        BOOST_CHECK(outbox.empty());
+
+        return output;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(restart)
+{
+    TemporaryDirectory directory;
+    Buffer expected;
+
+    {
+        PersistentOutbox outbox(directory.path);
+        BOOST_CHECK(outbox.empty());
+
+        for (int i = 0; i < 100; ++i) {
+            const MessageBuilder message = make_event("a", std::to_string(i));
+            const Buffer binary = message.to_binary();
+            expected.insert(expected.end(), binary.cbegin(), binary.cend());
+
+            BOOST_CHECK(outbox.push(message));
+        }
+
+        BOOST_CHECK_EQUAL(outbox.num_bytes(), expected.size());
+    }
+
+    {
+        PersistentOutbox outbox(directory.path);
+        BOOST_CHECK_EQUAL(outbox.num_bytes(), expected.size());
+        BOOST_CHECK(replay_all(outbox) == expected);
+    }
+
+    // the checkpoint was kept
+    {
+        PersistentOutbox outbox(directory.path);
+        BOOST_CHECK(outbox.empty());
+        BOOST_CHECK_EQUAL(outbox.acknowledged_offset(), expected.size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(null_bytes)
+{
+    TemporaryDirectory directory;
+    const Buffer binary = make_event("a", std::string("\0\0x\0", 4)).to_binary();
+
+    {
+        PersistentOutbox outbox(directory.path);
+        outbox.push(make_event("a", std::string("\0\0x\0", 4)));
+    }
+
+    PersistentOutbox outbox(directory.path);
+    BOOST_CHECK_EQUAL(outbox.num_bytes(), binary.size());
+    BOOST_CHECK(replay_all(outbox) == binary);
+}
+
+BOOST_AUTO_TEST_CASE(lost_checkpoint)
+{
+    TemporaryDirectory directory;
+    const Buffer binary = make_event("a", "0").to_binary();
+
+    {
+        PersistentOutbox outbox(directory.path);
+        outbox.push(make_event("a", "0"));
+    }
+
+    BOOST_REQUIRE_EQUAL(unlink((directory.path + "/checkpoint").c_str()), 0);
+
+    PersistentOutbox outbox(directory.path);
+    BOOST_CHECK_EQUAL(outbox.num_bytes(), binary.size());
+    BOOST_CHECK(replay_all(outbox) == binary);
+}
+
+BOOST_AUTO_TEST_CASE(incomplete_message)
+{
+    TemporaryDirectory directory;
+    const MessageBuilder message = make_event("a", "complete");
+    const Buffer binary = message.to_binary();
+
+    {
+        PersistentOutbox outbox(directory.path);
+        outbox.push(message);
+    }
+
+    // simulate a process stopping while it copies a message
+    {
+        const std::string path = directory.path + "/0000000000000000.seg";
+        std::FILE* file = std::fopen(path.c_str(), "r+b");
+        BOOST_REQUIRE(file);
+        std::fseek(file, binary.size(), SEEK_SET);
+        std::fputs("E\x1f" "EVT\x1f" "a\x1fincompl", file);
+        std::fclose(file);
+    }
+
+    PersistentOutbox outbox(directory.path);
+    BOOST_CHECK_EQUAL(outbox.num_bytes(), binary.size());
+
+    outbox.push(message);
+    Buffer expected = binary;
+    expected.insert(expected.end(), binary.cbegin(), binary.cend());
+    BOOST_CHECK(replay_all(outbox) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(rotation)
+{
+    TemporaryDirectory directory;
+    const std::size_t message_size = make_event("a", "0000").size();
+
+    // four messages per segment, at most three segments
+    const PersistentOutbox::Options options(4 * message_size, 3);
+    PersistentOutbox outbox(directory.path, options);
+
+    for (int i = 0; i < 12; ++i)
+        BOOST_CHECK(outbox.push(make_event("a", std::to_string(1000 + i))));
+
+    BOOST_CHECK_EQUAL(outbox.num_segments(), 3);
+    BOOST_CHECK_EQUAL(outbox.num_dropped_bytes(), 0);
+
+    // the oldest segment is deleted
+    BOOST_CHECK(outbox.push(make_event("a", "2000")));
+    BOOST_CHECK_EQUAL(outbox.num_segments(), 3);
+    BOOST_CHECK_EQUAL(outbox.num_dropped_bytes(), 4 * message_size);
+    BOOST_CHECK_EQUAL(outbox.num_bytes(), 9 * message_size);
+
+    // too large
+    BOOST_CHECK(!outbox.push(make_event("a", std::string(4 * message_size, 'x'))));
+
+    const Buffer output = replay_all(outbox, message_size);
+    BOOST_CHECK_EQUAL(output.size(), 9 * message_size);
+    BOOST_CHECK(std::equal(output.cbegin(), output.cbegin() + message_size,
+        make_event("a", "1004").to_binary().cbegin()));
+
+    // the segments with sent messages are deleted
+    BOOST_CHECK_EQUAL(outbox.num_segments(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(stale_segments)
+{
+    TemporaryDirectory directory;
+    const MessageBuilder message = make_event("a", "0");
+
+    {
+        PersistentOutbox outbox(directory.path);
+        outbox.push(message);
+    }
+
+    // a segment far behind the current one
+    const std::string stale_path = directory.path + "/0000000000100000.seg";
+    std::rename((directory.path + "/0000000000000000.seg").c_str(), stale_path.c_str());
+    {
+        const std::string path = directory.path + "/0000000001000000.seg";
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        BOOST_REQUIRE(file);
+        std::fclose(file);
+    }
+
+    PersistentOutbox outbox(directory.path);
+    BOOST_CHECK_EQUAL(outbox.num_segments(), 1);
+    BOOST_CHECK(outbox.empty());
+    BOOST_CHECK_EQUAL(access(stale_path.c_str(), F_OK), -1);
+}
+
+BOOST_AUTO_TEST_CASE(reservation_failure)
+{
+    TemporaryDirectory directory;
+    const MessageBuilder message = make_event("a", "0");
+    const PersistentOutbox::Options options(4096);
+
+    // simulate a full disk
+    rlimit limit;
+    BOOST_REQUIRE_EQUAL(getrlimit(RLIMIT_FSIZE, &limit), 0);
+    const rlimit small_limit = { 1024, limit.rlim_max };
+    void (*handler)(int) = signal(SIGXFSZ, SIG_IGN);
+    BOOST_REQUIRE_EQUAL(setrlimit(RLIMIT_FSIZE, &small_limit), 0);
+
+    PersistentOutbox outbox(directory.path, options);
+    BOOST_CHECK(!outbox.push(message));
+    BOOST_CHECK(!outbox.push(message));
+    BOOST_CHECK_EQUAL(outbox.num_dropped_bytes(), 2 * message.size());
+    BOOST_CHECK(outbox.empty());
+
+    BOOST_REQUIRE_EQUAL(setrlimit(RLIMIT_FSIZE, &limit), 0);
+    signal(SIGXFSZ, handler);
+
+    BOOST_CHECK(outbox.push(message));
+    BOOST_CHECK_EQUAL(outbox.num_segments(), 1);
+    BOOST_CHECK(replay_all(outbox) == message.to_binary());
+}
+
+BOOST_AUTO_TEST_CASE(failed_replay)
+{
+    TemporaryDirectory directory;
+    const std::size_t message_size = make_event("a", "0").size();
+
+    PersistentOutbox outbox(directory.path);
+    for (int i = 0; i < 5; ++i)
+        outbox.push(make_event("a", std::to_string(i)));
+
+    std::vector<std::size_t> writes;
+    auto write = [&writes](const BufferView& messages) {
+        writes.push_back(messages.size());
+        return writes.size() < 2;
+    };
+
+    // whole messages are written
+    BOOST_CHECK(!outbox.replay(write, 2 * message_size + 1));
+    BOOST_REQUIRE_EQUAL(writes.size(), 2);
+    BOOST_CHECK_EQUAL(writes[0], 2 * message_size);
+    BOOST_CHECK_EQUAL(outbox.num_bytes(), 3 * message_size);
+
+    const Buffer output = replay_all(outbox);
+    BOOST_CHECK(std::equal(output.cbegin(), output.cbegin() + message_size,
+        make_event("a", "2").to_binary().cbegin()));
+}
+}
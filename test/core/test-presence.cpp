@@ -18,6 +18,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <algorithm>
+#include <vector>
 
 #include <deepstream/core/buffer.hpp>
 #include "src/core/message.hpp"
@@ -51,7 +52,7 @@ BOOST_AUTO_TEST_CASE(subscription)
     };
 
     unsigned num_calls = 0;
-    Presence::SubscribeFn f = [name, &num_calls](const Name& my_name,
+    Presence::SubscribeFn f = [name, &num_calls](const BufferView& my_name,
         bool is_login) {
         BOOST_REQUIRE_EQUAL(name.size(), my_name.size());
         BOOST_CHECK(std::equal(name.cbegin(), name.cend(), my_name.cbegin()));
@@ -60,16 +61,16 @@ BOOST_AUTO_TEST_CASE(subscription)
         ++num_calls;
     };
 
-    SubscriptionId subscription_counter = 0;
-    Presence presence(send, subscription_counter);
+    SubscriptionSlots subscription_slots;
+    Presence presence(send, subscription_slots);
 
     const std::size_t N = 10;
-    Presence::SubscriberList subscribers;
+    std::vector<SubscriptionId> subscribers;
     for (std::size_t i = 0; i < N; ++i)
         subscribers.push_back(presence.subscribe(f));
 
     BOOST_CHECK(is_subscribed);
-    BOOST_CHECK_EQUAL(subscription_counter, N);
+    BOOST_CHECK_EQUAL(subscription_slots.size(), N);
     BOOST_CHECK_EQUAL(presence.subscribers_.size(), N);
 
     MessageBuilder pnl(Topic::PRESENCE, Action::PRESENCE_LEAVE);
@@ -120,8 +121,8 @@ BOOST_AUTO_TEST_CASE(queries)
         ++num_calls;
     };
 
-    SubscriptionId subscription_counter = 0;
-    Presence presence(send, subscription_counter);
+    SubscriptionSlots subscription_slots;
+    Presence presence(send, subscription_slots);
 
     presence.get_all(f);
     BOOST_CHECK_EQUAL(num_queries, 1);
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstddef>
+
+#include <thread>
+#include <vector>
+
+#include <deepstream/core/buffer.hpp>
+#include <deepstream/core/spsc_ring.hpp>
+
+namespace deepstream {
+
+BOOST_AUTO_TEST_CASE(simple)
+{
+    SpscRing<int> ring(3);
+    BOOST_CHECK_EQUAL(ring.capacity(), 4);
+    BOOST_CHECK(ring.empty());
+
+    for (int i = 0; i < 4; ++i) {
+        int value = i;
+        BOOST_CHECK(ring.try_push(value));
+    }
+
+    int value = 4;
+    BOOST_CHECK(!ring.try_push(value));
+    BOOST_CHECK_EQUAL(value, 4);
+    BOOST_CHECK(!ring.empty());
+
+    for (int i = 0; i < 4; ++i) {
+        BOOST_CHECK(ring.try_pop(value));
+        BOOST_CHECK_EQUAL(value, i);
+    }
+
+    BOOST_CHECK(!ring.try_pop(value));
+    BOOST_CHECK(ring.empty());
+}
+
+BOOST_AUTO_TEST_CASE(recycling)
+{
+    SpscRing<Buffer> ring(1);
+
+    Buffer buffer("message");
+    const char* data = buffer.data();
+
+    BOOST_CHECK(ring.try_push(buffer));
+    BOOST_CHECK(buffer.empty());
+
+    Buffer received;
+    BOOST_CHECK(ring.try_pop(received));
+    BOOST_CHECK(received == Buffer("message"));
+    BOOST_CHECK_EQUAL(received.data(), data);
+
+    // the consumer returns the storage to the producer
+    received.clear();
+    BOOST_CHECK(ring.try_pop(received) == false);
+    BOOST_CHECK(ring.try_push(buffer));
+    BOOST_CHECK(ring.try_pop(received));
+    BOOST_CHECK(ring.try_push(buffer));
+    BOOST_CHECK_EQUAL(buffer.data(), data);
+}
+
+BOOST_AUTO_TEST_CASE(threads)
+{
+    const std::size_t NUM_VALUES = 1000000;
+
+    SpscRing<std::size_t> ring(64);
+
+    std::thread producer([&ring, NUM_VALUES]() {
+        for (std::size_t i = 0; i < NUM_VALUES; ++i) {
+            std::size_t value = i;
+            while (!ring.try_push(value))
+                std::this_thread::yield();
+        }
+    });
+
+    std::size_t num_errors = 0;
+    for (std::size_t i = 0; i < NUM_VALUES; ++i) {
+        std::size_t value = 0;
+        while (!ring.try_pop(value))
+            std::this_thread::yield();
+
+        if (value != i)
+            ++num_errors;
+    }
+
+    producer.join();
+
+    BOOST_CHECK_EQUAL(num_errors, 0);
+    BOOST_CHECK(ring.empty());
+}
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <set>
+
+#include <deepstream/core/subscription_slots.hpp>
+
+namespace deepstream {
+
+BOOST_AUTO_TEST_CASE(simple)
+{
+    SubscriptionSlots slots;
+
+    BOOST_CHECK(!slots.is_valid(0));
+
+    const SubscriptionId a = slots.acquire(3);
+    const SubscriptionId b = slots.acquire(5);
+    BOOST_CHECK(a != 0);
+    BOOST_CHECK(a != b);
+    BOOST_CHECK_EQUAL(slots.size(), 2);
+    BOOST_CHECK(slots.is_valid(a));
+    BOOST_CHECK_EQUAL(slots.position(a), 3);
+    BOOST_CHECK_EQUAL(slots.position(b), 5);
+
+    slots.set_position(a, 7);
+    BOOST_CHECK_EQUAL(slots.position(a), 7);
+
+    slots.release(a);
+    BOOST_CHECK(!slots.is_valid(a));
+    BOOST_CHECK(slots.is_valid(b));
+    BOOST_CHECK_EQUAL(slots.size(), 1);
+
+    // the slot of `a` is reused; the old id stays invalid
+    const SubscriptionId c = slots.acquire(9);
+    BOOST_CHECK(c != a);
+    BOOST_CHECK(!slots.is_valid(a));
+    BOOST_CHECK(slots.is_valid(c));
+    BOOST_CHECK_EQUAL(slots.position(c), 9);
+}
+
+BOOST_AUTO_TEST_CASE(churn)
+{
+    SubscriptionSlots slots;
+    std::set<SubscriptionId> ids;
+
+    for (unsigned i = 0; i < 1000; ++i) {
+        const SubscriptionId id = slots.acquire(i);
+        BOOST_REQUIRE(ids.insert(id).second);
+        slots.release(id);
+    }
+
+    BOOST_CHECK_EQUAL(slots.size(), 0);
+
+    for (SubscriptionId id : ids)
+        BOOST_CHECK(!slots.is_valid(id));
+}
+}
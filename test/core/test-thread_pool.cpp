@@ -0,0 +1,149 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstddef>
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <deepstream/core/thread_pool.hpp>
+
+namespace deepstream {
+
+BOOST_AUTO_TEST_CASE(inline_executor)
+{
+    InlineExecutor executor;
+    int n = 0;
+
+    executor.execute(1, [&n]() { ++n; });
+    BOOST_CHECK_EQUAL(n, 1);
+}
+
+BOOST_AUTO_TEST_CASE(ordering)
+{
+    const std::size_t NUM_KEYS = 100;
+    const std::size_t NUM_TASKS = 1000;
+
+    ThreadPool pool(4, 16);
+    BOOST_CHECK_EQUAL(pool.num_threads(), 4);
+
+    // the tasks of one key must neither overlap nor be reordered
+    std::vector<std::size_t> next(NUM_KEYS, 0);
+    std::vector<std::atomic<int> > running(NUM_KEYS);
+    std::atomic<bool> ok(true);
+
+    for (std::size_t i = 0; i < NUM_TASKS; ++i) {
+        for (std::size_t key = 0; key < NUM_KEYS; ++key) {
+            pool.execute(key, [&, key, i]() {
+                if (running[key].fetch_add(1) != 0 || next[key] != i)
+                    ok = false;
+
+                ++next[key];
+                running[key].fetch_sub(1);
+            });
+        }
+    }
+
+    pool.wait();
+
+    BOOST_CHECK(ok);
+    for (std::size_t key = 0; key < NUM_KEYS; ++key)
+        BOOST_CHECK_EQUAL(next[key], NUM_TASKS);
+}
+
+BOOST_AUTO_TEST_CASE(parallelism)
+{
+    ThreadPool pool(2);
+
+    // the second task can only finish while the first one is running
+    std::atomic<bool> is_first_running(false);
+    std::atomic<bool> is_second_done(false);
+
+    pool.execute(0, [&]() {
+        is_first_running = true;
+        while (!is_second_done)
+            std::this_thread::yield();
+    });
+    pool.execute(1, [&]() {
+        while (!is_first_running)
+            std::this_thread::yield();
+        is_second_done = true;
+    });
+
+    pool.wait();
+    BOOST_CHECK(is_second_done);
+}
+
+BOOST_AUTO_TEST_CASE(nested_tasks)
+{
+    std::atomic<std::size_t> n(0);
+
+    {
+        ThreadPool pool(3);
+
+        for (std::size_t i = 0; i < 100; ++i) {
+            pool.execute(i, [&pool, &n, i]() {
+                pool.execute(i + 1, [&n]() { ++n; });
+                ++n;
+            });
+        }
+    }
+
+    // the destructor runs the pending tasks
+    BOOST_CHECK_EQUAL(n.load(), 200);
+}
+
+BOOST_AUTO_TEST_CASE(exceptions)
+{
+    std::mutex mutex;
+    std::vector<std::string> messages;
+    std::atomic<int> n(0);
+
+    {
+        ThreadPool pool(2, 2, [&mutex, &messages](std::exception_ptr p_exception) {
+            try {
+                std::rethrow_exception(p_exception);
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(mutex);
+                messages.push_back(e.what());
+            }
+        });
+
+        // the following tasks of the strand still run
+        pool.execute(0, []() { throw std::runtime_error("callback"); });
+        pool.execute(0, [&n]() { ++n; });
+        pool.wait();
+
+        BOOST_CHECK_EQUAL(n.load(), 1);
+        BOOST_REQUIRE_EQUAL(messages.size(), 1);
+        BOOST_CHECK_EQUAL(messages[0], "callback");
+    }
+
+    // without a handler, exceptions are dropped
+    ThreadPool pool(1);
+    pool.execute(0, []() { throw std::runtime_error("callback"); });
+    pool.execute(0, [&n]() { ++n; });
+    pool.wait();
+    BOOST_CHECK_EQUAL(n.load(), 2);
+}
+}
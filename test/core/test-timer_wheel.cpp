@@ -0,0 +1,163 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <random>
+#include <vector>
+
+#include "src/core/timer_wheel.hpp"
+
+namespace deepstream {
+
+typedef TimerWheel::Clock Clock;
+
+const Clock::time_point T0 = Clock::time_point() + std::chrono::hours(1);
+const Clock::duration TICK = std::chrono::milliseconds(10);
+
+BOOST_AUTO_TEST_CASE(simple)
+{
+    TimerWheel wheel(TICK, 8, T0);
+    std::vector<int> fired;
+    Clock::time_point expiry;
+
+    BOOST_CHECK(!wheel.next_expiry(&expiry));
+    BOOST_CHECK(!wheel.is_active(0));
+
+    const TimerWheel::TimerId a = wheel.start(T0 + 3 * TICK, [&fired]() { fired.push_back(1); });
+    const TimerWheel::TimerId b = wheel.start(T0 + 25 * TICK / 10, [&fired]() { fired.push_back(2); });
+    BOOST_CHECK(a != 0);
+    BOOST_CHECK(a != b);
+    BOOST_CHECK_EQUAL(wheel.size(), 2);
+
+    // the deadline of `b` is rounded up to a tick
+    BOOST_REQUIRE(wheel.next_expiry(&expiry));
+    BOOST_CHECK(expiry == T0 + 3 * TICK);
+
+    // timers never fire early
+    BOOST_CHECK_EQUAL(wheel.advance(T0 + 2 * TICK), 0);
+    BOOST_CHECK_EQUAL(wheel.advance(T0 + 3 * TICK - Clock::duration(1)), 0);
+    BOOST_CHECK(fired.empty());
+
+    BOOST_CHECK_EQUAL(wheel.advance(T0 + 3 * TICK), 2);
+    BOOST_CHECK_EQUAL(fired.size(), 2);
+    BOOST_CHECK_EQUAL(wheel.size(), 0);
+    BOOST_CHECK(!wheel.is_active(a));
+    BOOST_CHECK(!wheel.cancel(a));
+
+    // the storage is reused; the old id stays invalid
+    const TimerWheel::TimerId c = wheel.start(T0 + 5 * TICK, [&fired]() { fired.push_back(3); });
+    BOOST_CHECK(wheel.is_active(c));
+    BOOST_CHECK(!wheel.is_active(a) && !wheel.is_active(b));
+    BOOST_CHECK(wheel.cancel(c));
+    BOOST_CHECK(!wheel.cancel(c));
+    BOOST_CHECK_EQUAL(wheel.advance(T0 + 10 * TICK), 0);
+
+    // past deadlines expire with the next tick
+    wheel.start(T0, [&fired]() { fired.push_back(4); });
+    BOOST_CHECK_EQUAL(wheel.advance(T0 + 10 * TICK), 0);
+    BOOST_CHECK_EQUAL(wheel.advance(T0 + 11 * TICK), 1);
+    BOOST_CHECK_EQUAL(fired.back(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(revolutions)
+{
+    TimerWheel wheel(TICK, 4, T0);
+    std::vector<int> fired;
+    Clock::time_point expiry;
+
+    // the timers share a slot
+    wheel.start(T0 + 9 * TICK, [&fired]() { fired.push_back(9); });
+    wheel.start(T0 + 1 * TICK, [&fired]() { fired.push_back(1); });
+    wheel.start(T0 + 5 * TICK, [&fired]() { fired.push_back(5); });
+
+    BOOST_REQUIRE(wheel.next_expiry(&expiry));
+    BOOST_CHECK(expiry == T0 + TICK);
+
+    BOOST_CHECK_EQUAL(wheel.advance(T0 + 4 * TICK), 1);
+    BOOST_REQUIRE(wheel.next_expiry(&expiry));
+    BOOST_CHECK(expiry == T0 + 5 * TICK);
+
+    // a long pause visits every slot once
+    BOOST_CHECK_EQUAL(wheel.advance(T0 + 100 * TICK), 2);
+    BOOST_CHECK_EQUAL(fired.size(), 3);
+    BOOST_CHECK(!wheel.next_expiry(&expiry));
+
+    // a timer more than a revolution ahead is found, too
+    wheel.start(T0 + 150 * TICK, []() {});
+    BOOST_REQUIRE(wheel.next_expiry(&expiry));
+    BOOST_CHECK(expiry == T0 + 150 * TICK);
+}
+
+BOOST_AUTO_TEST_CASE(callbacks)
+{
+    TimerWheel wheel(TICK, 8, T0);
+    std::size_t num_calls = 0;
+    TimerWheel::TimerId other = 0;
+
+    // a periodic timer restarting itself expires once per call
+    std::function<void()> periodic = [&]() {
+        ++num_calls;
+        wheel.start(T0, periodic);
+        wheel.cancel(other);
+    };
+
+    // the other timer is in the same slot
+    wheel.start(T0 + TICK, periodic);
+    other = wheel.start(T0 + 9 * TICK, []() { BOOST_FAIL("the timer was cancelled"); });
+
+    BOOST_CHECK_EQUAL(wheel.advance(T0 + TICK), 1);
+    BOOST_CHECK_EQUAL(num_calls, 1);
+    BOOST_CHECK_EQUAL(wheel.size(), 1);
+
+    BOOST_CHECK_EQUAL(wheel.advance(T0 + 2 * TICK), 1);
+    BOOST_CHECK_EQUAL(num_calls, 2);
+
+    BOOST_CHECK_EQUAL(wheel.advance(T0 + 20 * TICK), 1);
+    BOOST_CHECK_EQUAL(num_calls, 3);
+}
+
+BOOST_AUTO_TEST_CASE(random_deadlines)
+{
+    TimerWheel wheel(TICK, 16, T0);
+    const Clock::duration max_step = std::chrono::milliseconds(3);
+    std::mt19937 engine(1);
+    std::uniform_int_distribution<int> dist(0, 100000);
+
+    std::vector<Clock::time_point> deadlines;
+    std::vector<Clock::time_point> fired_at;
+    Clock::time_point now = T0;
+
+    for (int i = 0; i < 1000; ++i) {
+        const Clock::time_point deadline = T0 + std::chrono::microseconds(dist(engine) * 10);
+        deadlines.push_back(deadline);
+        wheel.start(deadline, [&fired_at, &now, deadline, max_step]() {
+            // at most one tick late plus the step of the clock
+            BOOST_CHECK(now >= deadline);
+            BOOST_CHECK(now - deadline < TICK + max_step);
+            fired_at.push_back(now);
+        });
+    }
+
+    while (wheel.size() > 0) {
+        now += std::chrono::microseconds(dist(engine)) % max_step;
+        wheel.advance(now);
+    }
+
+    BOOST_CHECK_EQUAL(fired_at.size(), deadlines.size());
+}
+}
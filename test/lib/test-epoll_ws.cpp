@@ -0,0 +1,368 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <deepstream/core/buffer.hpp>
+#include "deepstream/lib/epoll-ws.hpp"
+#include "deepstream/lib/threaded-ws.hpp"
+#include "deepstream/lib/uring-ws.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace deepstream {
+
+/*
+ * A minimal WebSocket server with blocking sockets for a single client.
+ */
+struct EchoServer {
+    EchoServer()
+        : listen_fd(socket(AF_INET, SOCK_STREAM, 0))
+        , fd(-1)
+        , port(0)
+    {
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        socklen_t length = sizeof(address);
+        BOOST_REQUIRE(bind(listen_fd, reinterpret_cast<sockaddr*>(&address), length) == 0);
+        BOOST_REQUIRE(listen(listen_fd, 1) == 0);
+        BOOST_REQUIRE(getsockname(listen_fd, reinterpret_cast<sockaddr*>(&address), &length) == 0);
+        port = ntohs(address.sin_port);
+    }
+
+    ~EchoServer()
+    {
+        if (fd >= 0)
+            close(fd);
+        close(listen_fd);
+    }
+
+    void accept_client()
+    {
+        fd = accept(listen_fd, nullptr, nullptr);
+        BOOST_REQUIRE(fd >= 0);
+
+        std::string request;
+        while (request.find("\r\n\r\n") == std::string::npos) {
+            char c = 0;
+            BOOST_REQUIRE_EQUAL(read(fd, &c, 1), 1);
+            request.push_back(c);
+        }
+
+        const std::string field = "Sec-WebSocket-Key: ";
+        const std::size_t begin = request.find(field) + field.size();
+        const std::string key = request.substr(begin, request.find("\r\n", begin) - begin);
+
+        write_all("HTTP/1.1 101 Switching Protocols\r\n"
+                  "Upgrade: websocket\r\n"
+                  "Connection: Upgrade\r\n"
+                  "Sec-WebSocket-Accept: "
+            + EpollWSHandler::accept_key(key) + "\r\n\r\n");
+    }
+
+    void read_exact(char* p, std::size_t size)
+    {
+        while (size > 0) {
+            const ssize_t n = read(fd, p, size);
+            BOOST_REQUIRE(n > 0);
+            p += n;
+            size -= static_cast<std::size_t>(n);
+        }
+    }
+
+    void write_all(const std::string& data)
+    {
+        std::size_t offset = 0;
+        while (offset < data.size()) {
+            const ssize_t n = write(fd, data.data() + offset, data.size() - offset);
+            BOOST_REQUIRE(n > 0);
+            offset += static_cast<std::size_t>(n);
+        }
+    }
+
+    /*
+     * returns the opcode; client frames must be masked
+     */
+    unsigned read_frame(std::string* p_payload)
+    {
+        unsigned char header[2];
+        read_exact(reinterpret_cast<char*>(header), 2);
+        BOOST_CHECK(header[0] & 0x80);
+        BOOST_REQUIRE(header[1] & 0x80);
+
+        std::uint64_t size = header[1] & 0x7F;
+        if (size >= 126) {
+            unsigned char extended[8];
+            const std::size_t n = (size == 126) ? 2 : 8;
+            read_exact(reinterpret_cast<char*>(extended), n);
+
+            size = 0;
+            for (std::size_t i = 0; i < n; ++i)
+                size = (size << 8) | extended[i];
+        }
+
+        char key[4];
+        read_exact(key, 4);
+
+        p_payload->resize(size);
+        read_exact(&(*p_payload)[0], size);
+        for (std::size_t i = 0; i < size; ++i)
+            (*p_payload)[i] ^= key[i % 4];
+
+        return header[0] & 0x0F;
+    }
+
+    void write_frame(unsigned opcode, bool is_final, const std::string& payload)
+    {
+        std::string frame;
+        frame.push_back(static_cast<char>((is_final ? 0x80 : 0) | opcode));
+
+        if (payload.size() < 126) {
+            frame.push_back(static_cast<char>(payload.size()));
+        } else if (payload.size() <= 0xFFFF) {
+            frame.push_back(126);
+            frame.push_back(static_cast<char>(payload.size() >> 8));
+            frame.push_back(static_cast<char>(payload.size()));
+        } else {
+            frame.push_back(127);
+            for (int i = 7; i >= 0; --i)
+                frame.push_back(static_cast<char>(static_cast<std::uint64_t>(payload.size()) >> (8 * i)));
+        }
+
+        write_all(frame + payload);
+    }
+
+    int listen_fd;
+    int fd;
+    int port;
+};
+
+BOOST_AUTO_TEST_CASE(accept_key)
+{
+    // the example of RFC 6455, section 1.3
+    BOOST_CHECK_EQUAL(EpollWSHandler::accept_key("dGhlIHNhbXBsZSBub25jZQ=="),
+        "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+/*
+ * Exchanges messages of different sizes with an echo server listening on
+ * 127.0.0.1.
+ */
+void check_echo(EpollWSHandler& wsh, const std::string& host = "127.0.0.1")
+{
+    const std::size_t LARGE_SIZE = 3 * 1024 * 1024;
+
+    EchoServer server;
+    std::string large(LARGE_SIZE, 'x');
+    for (std::size_t i = 0; i < large.size(); i += 1000)
+        large[i] = static_cast<char>('a' + i % 26);
+
+    std::thread server_thread([&server, &large]() {
+        server.accept_client();
+
+        std::string payload;
+        BOOST_CHECK_EQUAL(server.read_frame(&payload), 0x1);
+        BOOST_CHECK_EQUAL(payload, "hello");
+
+        // a fragmented message with a ping in between
+        server.write_frame(0x1, false, "hel");
+        server.write_frame(0x9, true, "p");
+        server.write_frame(0x0, true, "lo");
+
+        BOOST_CHECK_EQUAL(server.read_frame(&payload), 0xA);
+        BOOST_CHECK_EQUAL(payload, "p");
+
+        BOOST_CHECK_EQUAL(server.read_frame(&payload), 0x1);
+        BOOST_CHECK(payload == large);
+        server.write_frame(0x1, true, payload);
+
+        server.write_frame(0x8, true, std::string("\x03\xe8", 2));
+        BOOST_CHECK_EQUAL(server.read_frame(&payload), 0x8);
+        BOOST_CHECK_EQUAL(payload, std::string("\x03\xe8", 2));
+    });
+
+    std::vector<std::string> messages;
+    bool is_closed = false;
+
+    wsh.on_open([&wsh]() { BOOST_CHECK(wsh.send(Buffer("hello"))); });
+    wsh.on_close([&is_closed]() { is_closed = true; });
+    wsh.on_error([](const std::string&& what) { BOOST_FAIL(what); });
+    wsh.on_message([](const Buffer&&) { BOOST_FAIL("unexpected message handler call"); });
+    wsh.on_frame([&wsh, &messages, &large](char* data, std::size_t size) {
+        messages.emplace_back(data, size);
+
+        if (messages.size() == 1) {
+            const Buffer message(large);
+            BOOST_CHECK(wsh.send(message));
+        }
+    });
+
+    wsh.URI("ws://" + host + ":" + std::to_string(server.port) + "/deepstream");
+    wsh.open();
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!is_closed && std::chrono::steady_clock::now() < deadline) {
+        pollfd fd = { wsh.native_handle(), POLLIN, 0 };
+        poll(&fd, 1, 100);
+        wsh.process_messages();
+    }
+
+    server_thread.join();
+
+    BOOST_CHECK(is_closed);
+    BOOST_CHECK(wsh.state() == WSState::CLOSED);
+    BOOST_REQUIRE_EQUAL(messages.size(), 2);
+    BOOST_CHECK_EQUAL(messages[0], "hello");
+    BOOST_CHECK(messages[1] == large);
+}
+
+BOOST_AUTO_TEST_CASE(echo)
+{
+    EpollWSHandler wsh;
+    check_echo(wsh);
+}
+
+BOOST_AUTO_TEST_CASE(address_fallback)
+{
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* p_addresses = nullptr;
+    BOOST_REQUIRE_EQUAL(getaddrinfo("localhost", "80", &hints, &p_addresses), 0);
+    if (p_addresses->ai_family == AF_INET)
+        BOOST_TEST_MESSAGE("localhost does not resolve to ::1 first");
+    freeaddrinfo(p_addresses);
+
+    // the connection to ::1 is refused
+    EpollWSHandler wsh;
+    check_echo(wsh, "localhost");
+}
+
+BOOST_AUTO_TEST_CASE(refused)
+{
+    EchoServer server;
+    const int port = server.port;
+    close(server.listen_fd);
+    server.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    EpollWSHandler wsh;
+    std::vector<std::string> errors;
+
+    wsh.on_open([]() { BOOST_FAIL("unexpected open handler call"); });
+    wsh.on_close([]() {});
+    wsh.on_error([&errors](const std::string&& what) { errors.push_back(what); });
+    wsh.on_frame([](char*, std::size_t) {});
+
+    // every address is tried before the error is reported once
+    wsh.URI("ws://localhost:" + std::to_string(port) + "/deepstream");
+    wsh.open();
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (errors.empty() && std::chrono::steady_clock::now() < deadline) {
+        pollfd fd = { wsh.native_handle(), POLLIN, 0 };
+        poll(&fd, 1, 100);
+        wsh.process_messages();
+    }
+
+    BOOST_REQUIRE_EQUAL(errors.size(), 1);
+    BOOST_CHECK_EQUAL(errors[0], "Unable to connect: Connection refused");
+    BOOST_CHECK(wsh.state() == WSState::ERROR);
+}
+
+BOOST_AUTO_TEST_CASE(uring_echo)
+{
+    if (!UringWSHandler::is_supported()) {
+        BOOST_TEST_MESSAGE("io_uring is not supported");
+        return;
+    }
+
+    UringWSHandler wsh;
+    check_echo(wsh);
+
+    // the handler is reusable after the connection was closed
+    check_echo(wsh);
+}
+
+BOOST_AUTO_TEST_CASE(threaded)
+{
+    EchoServer server;
+
+    std::thread server_thread([&server]() {
+        server.accept_client();
+
+        std::string payload;
+        BOOST_CHECK_EQUAL(server.read_frame(&payload), 0x1);
+        server.write_frame(0x1, true, payload);
+
+        server.write_frame(0x8, true, "");
+        BOOST_CHECK_EQUAL(server.read_frame(&payload), 0x8);
+    });
+
+    // the transport connects in process_messages() on the I/O thread
+    EpollWSHandler transport;
+    ThreadedWSHandler wsh(transport);
+    std::vector<std::string> messages;
+    bool is_closed = false;
+
+    wsh.on_open([&wsh]() { BOOST_CHECK(wsh.send(Buffer("hello"))); });
+    wsh.on_close([&is_closed]() { is_closed = true; });
+    wsh.on_error([](const std::string&& what) { BOOST_FAIL(what); });
+    wsh.on_message([](const Buffer&&) { BOOST_FAIL("unexpected message handler call"); });
+    wsh.on_frame([&messages](char* data, std::size_t size) { messages.emplace_back(data, size); });
+
+    wsh.URI("ws://127.0.0.1:" + std::to_string(server.port) + "/deepstream");
+    wsh.open();
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!is_closed && std::chrono::steady_clock::now() < deadline) {
+        wsh.wait(std::chrono::milliseconds(100));
+        wsh.process_messages();
+    }
+
+    server_thread.join();
+
+    BOOST_CHECK(is_closed);
+    BOOST_REQUIRE_EQUAL(messages.size(), 1);
+    BOOST_CHECK_EQUAL(messages[0], "hello");
+}
+
+BOOST_AUTO_TEST_CASE(native_ws_handler)
+{
+    std::unique_ptr<EpollWSHandler> p_wsh = make_native_ws_handler();
+    BOOST_REQUIRE(p_wsh);
+    BOOST_CHECK_EQUAL(
+        dynamic_cast<UringWSHandler*>(p_wsh.get()) != nullptr, UringWSHandler::is_supported());
+}
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2017 deepstreamHub GmbH
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <deepstream/core/buffer.hpp>
+#include "deepstream/lib/threaded-ws.hpp"
+
+namespace deepstream {
+
+/*
+ * This transport echoes every frame; it must only be used by the I/O
+ * thread.
+ */
+struct EchoTransport : public WSHandler {
+    EchoTransport()
+        : io_thread_id()
+        , num_foreign_calls(0)
+    {
+    }
+
+    void process_messages() override
+    {
+        check_thread();
+
+        for (Buffer &frame : pending) {
+            frame.resize(frame.size() + FRAME_PADDING);
+            (*on_frame_)(frame.data(), frame.size() - FRAME_PADDING);
+        }
+        pending.clear();
+    }
+
+    std::string URI() const override { return uri; }
+
+    void URI(std::string u) override
+    {
+        check_thread();
+        uri = u;
+    }
+
+    bool send(const Buffer &frame) override
+    {
+        check_thread();
+        pending.push_back(frame);
+        return true;
+    }
+
+    void open() override
+    {
+        check_thread();
+        state_ = WSState::OPEN;
+        (*on_open_)();
+    }
+
+    void close() override
+    {
+        check_thread();
+        state_ = WSState::CLOSED;
+        (*on_close_)();
+    }
+
+    void reconnect() override {}
+
+    void shutdown() override {}
+
+    void check_thread()
+    {
+        const std::thread::id id = std::this_thread::get_id();
+
+        if (io_thread_id == std::thread::id())
+            io_thread_id = id;
+        else if (io_thread_id != id)
+            ++num_foreign_calls;
+    }
+
+    std::string uri;
+    std::vector<Buffer> pending;
+    std::thread::id io_thread_id;
+    std::atomic<int> num_foreign_calls;
+};
+
+BOOST_AUTO_TEST_CASE(echo)
+{
+    const std::chrono::milliseconds TIMEOUT(5000);
+
+    EchoTransport transport;
+    ThreadedWSHandler wsh(transport, 4);
+
+    bool is_open = false;
+    bool is_closed = false;
+    std::vector<std::string> frames;
+
+    wsh.on_open([&is_open]() { is_open = true; });
+    wsh.on_close([&is_closed]() { is_closed = true; });
+    wsh.on_error([](const std::string &&what) { BOOST_FAIL(what); });
+    wsh.on_message([](const Buffer &&) { BOOST_FAIL("unexpected message handler call"); });
+    wsh.on_frame([&frames](char *data, std::size_t size) {
+        BOOST_CHECK_EQUAL(data[size], 0);
+        BOOST_CHECK_EQUAL(data[size + 1], 0);
+        frames.emplace_back(data, size);
+    });
+
+    wsh.URI("ws://localhost");
+    BOOST_CHECK_EQUAL(wsh.URI(), "ws://localhost");
+    BOOST_CHECK(!wsh.send(Buffer("not open")));
+
+    wsh.open();
+    while (!is_open) {
+        BOOST_REQUIRE(wsh.wait(TIMEOUT));
+        wsh.process_messages();
+    }
+    BOOST_CHECK(wsh.state() == WSState::OPEN);
+
+    // more frames than the rings hold
+    const std::size_t NUM_FRAMES = 100;
+    for (std::size_t i = 0; i < NUM_FRAMES; ++i) {
+        BOOST_CHECK(wsh.send(Buffer("frame " + std::to_string(i))));
+        wsh.process_messages();
+    }
+
+    while (frames.size() < NUM_FRAMES) {
+        BOOST_REQUIRE(wsh.wait(TIMEOUT));
+        wsh.process_messages();
+    }
+
+    for (std::size_t i = 0; i < NUM_FRAMES; ++i)
+        BOOST_CHECK_EQUAL(frames[i], "frame " + std::to_string(i));
+
+    wsh.close();
+    while (!is_closed) {
+        BOOST_REQUIRE(wsh.wait(TIMEOUT));
+        wsh.process_messages();
+    }
+    BOOST_CHECK(wsh.state() == WSState::CLOSED);
+
+    BOOST_CHECK_EQUAL(transport.uri, "ws://localhost");
+    BOOST_CHECK_EQUAL(transport.num_foreign_calls.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(wake)
+{
+    EchoTransport transport;
+    ThreadedWSHandler wsh(transport);
+
+    BOOST_CHECK(!wsh.wait(std::chrono::milliseconds(0)));
+
+    std::thread thread([&wsh]() {
+        wsh.wake();
+        wsh.wake();
+    });
+    BOOST_CHECK(wsh.wait(std::chrono::milliseconds(5000)));
+    thread.join();
+
+    wsh.process_messages();
+    BOOST_CHECK(!wsh.wait(std::chrono::milliseconds(0)));
+}
+
+BOOST_AUTO_TEST_CASE(notifier)
+{
+    Notifier notifier;
+
+    BOOST_CHECK(!notifier.wait(std::chrono::milliseconds(0)));
+
+    std::thread thread([&notifier]() { notifier.notify(); });
+    BOOST_CHECK(notifier.wait(std::chrono::milliseconds(5000)));
+    thread.join();
+
+    notifier.notify();
+    notifier.clear();
+    BOOST_CHECK(!notifier.wait(std::chrono::milliseconds(0)));
+}
+}